@@ -0,0 +1,82 @@
+/**
+ * Backs up an hse mongod with fsyncLock while a client keeps inserting. fsyncLock must hold
+ * the writes off, pause the connector's background writers and list the directories to
+ * snapshot. The media as left by fsyncLock, here frozen by killing mongod, must recover into
+ * exactly the documents acknowledged before the lock, with matching counts, even without a
+ * journal.
+ * @tags: [requires_persistence]
+ */
+(function() {
+    "use strict";
+
+    if (jsTest.options().storageEngine && jsTest.options().storageEngine !== "hse") {
+        jsTestLog("Skipping test, it requires the hse storage engine");
+        return;
+    }
+
+    var dbpath = MongoRunner.dataPath + "hse_backup_fsync_lock";
+    resetDbpath(dbpath);
+
+    // Without a journal only the sync of beginBackup puts the last writes on media.
+    var options = {dbpath: dbpath, storageEngine: "hse", nojournal: "", noCleanData: true};
+    var conn = MongoRunner.runMongod(options);
+    assert.neq(null, conn, "mongod failed to start");
+    var coll = conn.getDB("test").backup;
+
+    // Each insert is acknowledged before the next one is sent, so the documents present at
+    // any point are seq 0..n-1.
+    var writer = startParallelShell(function() {
+        var coll = db.getSiblingDB("test").backup;
+        var pad = new Array(512).join("x");
+        for (var seq = 0;; seq++) {
+            assert.writeOK(coll.insert({_id: seq, pad: pad}));
+        }
+    }, conn.port);
+
+    assert.soon(function() {
+        return coll.count() > 5000;
+    }, "writer made no progress");
+
+    // A drop just before the lock may leave work for the ident reaper, which must not run
+    // while the backup is in progress.
+    assert.writeOK(conn.getDB("test").dropped.insert({}));
+    assert(conn.getDB("test").dropped.drop());
+
+    assert.commandWorked(conn.getDB("admin").fsyncLock());
+
+    var status = conn.getDB("admin").serverStatus().hse;
+    assert.eq(true, status.backup.inProgress, tojson(status.backup));
+    assert.eq(1, status.backup.paths.length, "test expects no media class outside dbpath");
+
+    var lockedCount = coll.count();
+    sleep(1000);
+    assert.eq(lockedCount, coll.count(), "writes were not held off by fsyncLock");
+    assert.docEq(status.identDrops,
+                 conn.getDB("admin").serverStatus().hse.identDrops,
+                 "the ident reaper ran during the backup");
+
+    // The snapshot of the listed directories would be taken here. Killing mongod leaves the
+    // media as a snapshot would find it.
+    MongoRunner.stopMongod(conn, 9);
+    writer({checkExitSuccess: false});
+
+    conn = MongoRunner.runMongod(options);
+    assert.neq(null, conn, "mongod failed to recover the locked image");
+    coll = conn.getDB("test").backup;
+
+    var res = assert.commandWorked(coll.validate(true));
+    assert(res.valid, tojson(res));
+
+    assert.eq(lockedCount, coll.count(), "counts do not match the locked image");
+    assert.eq(lockedCount, coll.find().itcount(), "documents do not match the locked image");
+    assert.eq(lockedCount - 1, coll.find().sort({_id: -1}).limit(1).next()._id);
+    assert.eq(null, conn.getDB("test").getCollectionInfos({name: "dropped"})[0]);
+
+    // fsyncUnlock resumes writes and the background writers.
+    assert.commandWorked(conn.getDB("admin").fsyncLock());
+    assert.commandWorked(conn.getDB("admin").fsyncUnlock());
+    assert.eq(false, conn.getDB("admin").serverStatus().hse.backup.inProgress);
+    assert.writeOK(coll.insert({_id: lockedCount}));
+
+    MongoRunner.stopMongod(conn);
+})();
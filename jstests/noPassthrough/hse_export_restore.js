@@ -0,0 +1,69 @@
+/**
+ * Exports an hse mongod with hseExport while a client keeps inserting, then restores the
+ * export into a new mongod. The export must not hold writes off, and the restored mongod must
+ * hold a gap-free prefix of the acknowledged documents, at least every document acknowledged
+ * before the export started.
+ * @tags: [requires_persistence]
+ */
+(function() {
+    "use strict";
+
+    if (jsTest.options().storageEngine && jsTest.options().storageEngine !== "hse") {
+        jsTestLog("Skipping test, it requires the hse storage engine");
+        return;
+    }
+
+    var dbpath = MongoRunner.dataPath + "hse_export_restore";
+    var restoreDbpath = dbpath + "_restore";
+    var exportFile = MongoRunner.dataPath + "hse_export_restore.hsexport";
+    resetDbpath(dbpath);
+    resetDbpath(restoreDbpath);
+    removeFile(exportFile);
+
+    var conn = MongoRunner.runMongod({dbpath: dbpath, storageEngine: "hse"});
+    assert.neq(null, conn, "mongod failed to start");
+    var coll = conn.getDB("test").backup;
+
+    // Each insert is acknowledged before the next one is sent, so the documents present at
+    // any point are seq 0..n-1.
+    var writer = startParallelShell(function() {
+        var coll = db.getSiblingDB("test").backup;
+        var pad = new Array(512).join("x");
+        for (var seq = 0; !db.getSiblingDB("test").stop.findOne(); seq++) {
+            assert.writeOK(coll.insert({_id: seq, pad: pad}));
+        }
+    }, conn.port);
+
+    assert.soon(function() {
+        return coll.count() > 5000;
+    }, "writer made no progress");
+
+    var beforeCount = coll.count();
+    var res = assert.commandWorked(conn.adminCommand({hseExport: exportFile}));
+    jsTestLog("hseExport took " + res.millis + "ms: " + tojson(res.kvses));
+    var afterCount = coll.count();
+    assert.soon(function() {
+        return coll.count() > afterCount;
+    }, "writes did not continue after hseExport");
+
+    assert.writeOK(conn.getDB("test").stop.insert({}));
+    writer();
+    MongoRunner.stopMongod(conn);
+
+    var restored = MongoRunner.runMongod(
+        {dbpath: restoreDbpath, storageEngine: "hse", hseRestoreFrom: exportFile});
+    assert.neq(null, restored, "mongod failed to restore the export");
+    var restoredColl = restored.getDB("test").backup;
+
+    res = assert.commandWorked(restoredColl.validate(true));
+    assert(res.valid, tojson(res));
+
+    var restoredCount = restoredColl.count();
+    assert.gte(restoredCount, beforeCount, "export lost acknowledged documents");
+    assert.lte(restoredCount, afterCount, "export holds documents written after it finished");
+    assert.eq(restoredCount, restoredColl.find().itcount());
+    assert.eq(restoredCount - 1, restoredColl.find().sort({_id: -1}).limit(1).next()._id);
+
+    MongoRunner.stopMongod(restored);
+    removeFile(exportFile);
+})();
@@ -0,0 +1,69 @@
+// Hot document contention: many threads $inc the same few documents with benchRun, and the
+// update throughput is reported with the hse write conflict and retry counters.
+// Run against a mongod using the hse storage engine started with --hseEnableMetrics, e.g.
+//   mongo --eval 'var numDocs = 10, threads = 64, seconds = 60' \
+//       jstests/perf/hse_hot_document_updates.js
+(function() {
+    "use strict";
+
+    var nDocs = (typeof numDocs === "undefined") ? 10 : numDocs;
+    var nThreads = (typeof threads === "undefined") ? 64 : threads;
+    var nSeconds = (typeof seconds === "undefined") ? 20 : seconds;
+
+    var coll = db.perf.hse_hot_document_updates;
+    coll.drop();
+
+    for (var i = 0; i < nDocs; i++) {
+        assert.writeOK(coll.insert({_id: i, n: 0}));
+    }
+
+    var counterNames = [
+        "hseTxnCommitConflict",
+        "hseSubTxnRetry",
+        "hseKvsCursorCreateRetry",
+        "hseRetryBackoffMicros"
+    ];
+    var counters = function() {
+        return db.serverStatus().hse.counters || {};
+    };
+
+    var before = counters();
+    var res = benchRun({
+        ops: [{
+            ns: coll.getFullName(),
+            op: "update",
+            query: {_id: {"#RAND_INT": [0, nDocs]}},
+            update: {$inc: {n: 1}},
+            writeCmd: true
+        }],
+        parallel: nThreads,
+        seconds: nSeconds,
+        host: db.getMongo().host
+    });
+    var after = counters();
+
+    var total = 0;
+    coll.find().forEach(function(doc) {
+        total += doc.n;
+    });
+
+    var result = {
+        docs: nDocs,
+        threads: nThreads,
+        updatesPerSec: Math.round(res.update),
+        updatesApplied: total
+    };
+    counterNames.forEach(function(name) {
+        if (after[name] !== undefined) {
+            result[name] = after[name] - before[name];
+        }
+    });
+
+    var identStats = coll.stats().hse;
+    if (identStats) {
+        result.collectionWriteConflicts = identStats.writeConflicts;
+    }
+    printjson(result);
+
+    coll.drop();
+})();
@@ -0,0 +1,47 @@
+// Measures insert throughput as the number of secondary indexes on a collection grows.
+// Run against a mongod using the hse storage engine, e.g.
+//   mongo --eval 'var seconds = 30, parallel = 16' jstests/perf/hse_index_insert.js
+(function() {
+    "use strict";
+
+    var coll = db.perf.hse_index_insert;
+    var runSeconds = (typeof seconds === "undefined") ? 10 : seconds;
+    var runParallel = (typeof parallel === "undefined") ? 8 : parallel;
+    var maxIndexes = 10;
+
+    var doc = {};
+    for (var i = 0; i < maxIndexes; i++) {
+        doc["f" + i] = {"#RAND_INT": [0, 1000000]};
+    }
+    doc.pad = "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx";
+
+    var results = [];
+    for (var nIndexes = 0; nIndexes <= maxIndexes; nIndexes += 2) {
+        coll.drop();
+        assert.commandWorked(coll.getDB().createCollection(coll.getName()));
+        for (var i = 0; i < nIndexes; i++) {
+            var key = {};
+            key["f" + i] = 1;
+            assert.commandWorked(coll.createIndex(key));
+        }
+
+        var benchArgs = {
+            ops: [{ns: coll.getFullName(), op: "insert", doc: doc, writeCmd: true}],
+            parallel: runParallel,
+            seconds: runSeconds,
+            host: db.getMongo().host
+        };
+        if (jsTest.options().auth) {
+            benchArgs['db'] = 'admin';
+            benchArgs['username'] = jsTest.options().authUser;
+            benchArgs['password'] = jsTest.options().authPassword;
+        }
+
+        var res = benchRun(benchArgs);
+        results.push({indexes: nIndexes, insertsPerSec: Math.round(res.insert)});
+        print("indexes: " + nIndexes + "   inserts/sec: " + Math.round(res.insert));
+    }
+
+    printjson(results);
+    coll.drop();
+})();
@@ -0,0 +1,60 @@
+// Compares the size and covered scan throughput of a compound index stored with and
+// without the hse prefixDict key format. The leading field has few, long values.
+// Run against a mongod using the hse storage engine, e.g.
+//   mongo --eval 'var numDocs = 1000000, scans = 5' jstests/perf/hse_index_prefix_dict.js
+(function() {
+    "use strict";
+
+    var nDocs = (typeof numDocs === "undefined") ? 200000 : numDocs;
+    var nScans = (typeof scans === "undefined") ? 3 : scans;
+    var nTenants = 64;
+    var keyPattern = {tenant: 1, ts: 1};
+
+    var formats = [
+        {name: "default", options: {}},
+        {name: "prefixDict", options: {storageEngine: {hse: {keyFormat: "prefixDict"}}}}
+    ];
+
+    var results = [];
+    formats.forEach(function(format) {
+        var coll = db.perf["hse_index_prefix_dict_" + format.name];
+        coll.drop();
+        assert.commandWorked(coll.getDB().createCollection(coll.getName()));
+        assert.commandWorked(coll.createIndex(keyPattern, format.options));
+
+        var batch = coll.initializeUnorderedBulkOp();
+        for (var i = 0; i < nDocs; i++) {
+            var tenant = "org.example.tenant-" + (i % nTenants) + ".production.eu-west-1";
+            batch.insert({tenant: tenant, ts: i});
+            if (i % 10000 === 9999) {
+                assert.writeOK(batch.execute());
+                batch = coll.initializeUnorderedBulkOp();
+            }
+        }
+        if (nDocs % 10000) {
+            assert.writeOK(batch.execute());
+        }
+
+        var indexName = coll.getIndexes().filter(function(ix) {
+            return bsonWoCompare(ix.key, keyPattern) === 0;
+        })[0].name;
+        var indexSize = coll.stats().indexSizes[indexName];
+
+        // Covered scans of the whole index, so only index keys are read.
+        var start = Date.now();
+        for (var s = 0; s < nScans; s++) {
+            var n = coll.find({tenant: {$gte: ""}}, {_id: 0, tenant: 1, ts: 1})
+                        .hint(keyPattern)
+                        .itcount();
+            assert.eq(nDocs, n);
+        }
+        var keysPerSec = Math.round(nDocs * nScans * 1000 / Math.max(Date.now() - start, 1));
+
+        results.push({keyFormat: format.name, indexSize: indexSize, scanKeysPerSec: keysPerSec});
+        print("keyFormat: " + format.name + "   indexSize: " + indexSize +
+              "   scan keys/sec: " + keysPerSec);
+        coll.drop();
+    });
+
+    printjson(results);
+})();
@@ -0,0 +1,63 @@
+// Large documents: inserts, then reads back, documents of 16KB to 16MB into a collection with
+// the default large value layout and one with largeValueThreshold, and reports the throughput
+// of each with the hse large chunk counters of the collection.
+// Run against a mongod using the hse storage engine started with --hseEnableMetrics, e.g.
+//   mongo --eval 'var docsPerSize = 50, chunkSize = 262144' jstests/perf/hse_large_documents.js
+(function() {
+    "use strict";
+
+    var nDocs = (typeof docsPerSize === "undefined") ? 20 : docsPerSize;
+    var nChunkSize = (typeof chunkSize === "undefined") ? 262144 : chunkSize;
+
+    var sizes = [16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024];
+    // Leave room for _id and the field names below the 16MB document limit.
+    sizes.push(16 * 1024 * 1024 - 1024);
+
+    var layouts = {
+        "default": {},
+        "threshold": {largeValueThreshold: 16384, largeValueChunkSize: nChunkSize}
+    };
+
+    var results = [];
+    Object.keys(layouts).forEach(function(layout) {
+        sizes.forEach(function(size) {
+            var name = "hse_large_documents_" + layout;
+            db[name].drop();
+            assert.commandWorked(
+                db.createCollection(name, {storageEngine: {hse: layouts[layout]}}));
+            var coll = db[name];
+            var pad = new Array(size + 1).join("x");
+
+            var start = Date.now();
+            for (var i = 0; i < nDocs; i++) {
+                assert.writeOK(coll.insert({_id: i, pad: pad}));
+            }
+            var insertMillis = Math.max(Date.now() - start, 1);
+
+            start = Date.now();
+            for (var i = 0; i < nDocs; i++) {
+                assert.eq(size, coll.findOne({_id: i}).pad.length);
+            }
+            var readMillis = Math.max(Date.now() - start, 1);
+
+            var result = {
+                layout: layout,
+                docSize: size,
+                insertMBPerSec: Math.round(nDocs * size / 1048.576 / insertMillis),
+                readMBPerSec: Math.round(nDocs * size / 1048.576 / readMillis)
+            };
+            var identStats = coll.stats().hse;
+            if (identStats) {
+                result.largeChunksWritten = identStats.largeChunksWritten;
+                result.largeChunksRead = identStats.largeChunksRead;
+            }
+            results.push(result);
+
+            coll.drop();
+        });
+    });
+
+    results.forEach(function(result) {
+        printjson(result);
+    });
+})();
@@ -0,0 +1,59 @@
+// YCSB workload C style point reads: loads a collection, then runs concurrent findOne by
+// _id with benchRun and reports the read throughput and the hse sharedReadViews counters.
+// Run against a mongod using the hse storage engine, once started with
+// --hseSharedReadViews and once without, e.g.
+//   mongo --eval 'var numDocs = 1000000, threads = 32, seconds = 60' \
+//       jstests/perf/hse_shared_read_views.js
+(function() {
+    "use strict";
+
+    var nDocs = (typeof numDocs === "undefined") ? 200000 : numDocs;
+    var nThreads = (typeof threads === "undefined") ? 16 : threads;
+    var nSeconds = (typeof seconds === "undefined") ? 20 : seconds;
+
+    var coll = db.perf.hse_shared_read_views;
+    coll.drop();
+
+    // YCSB records: ten 100 byte fields.
+    var field = new Array(101).join("x");
+    var batch = coll.initializeUnorderedBulkOp();
+    for (var i = 0; i < nDocs; i++) {
+        var doc = {_id: i};
+        for (var f = 0; f < 10; f++) {
+            doc["field" + f] = field;
+        }
+        batch.insert(doc);
+        if (i % 10000 === 9999) {
+            assert.writeOK(batch.execute());
+            batch = coll.initializeUnorderedBulkOp();
+        }
+    }
+    if (nDocs % 10000) {
+        assert.writeOK(batch.execute());
+    }
+
+    var before = db.serverStatus().hse.sharedReadViews;
+    var res = benchRun({
+        ops: [{
+            ns: coll.getFullName(),
+            op: "findOne",
+            query: {_id: {"#RAND_INT": [0, nDocs]}},
+            readCmd: true
+        }],
+        parallel: nThreads,
+        seconds: nSeconds,
+        host: db.getMongo().host
+    });
+    var after = db.serverStatus().hse.sharedReadViews;
+
+    var result = {
+        sharedReadViews: after.enabled,
+        threads: nThreads,
+        readsPerSec: Math.round(res.findOne),
+        viewsBegun: after.viewsBegun - before.viewsBegun,
+        upgradeConflicts: after.upgradeConflicts - before.upgradeConflicts
+    };
+    printjson(result);
+
+    coll.drop();
+})();
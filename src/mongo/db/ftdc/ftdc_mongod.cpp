@@ -30,6 +30,8 @@
 
 #include "mongo/db/ftdc/ftdc_mongod.h"
 
+#include <vector>
+
 #include <boost/filesystem.hpp>
 
 #include "mongo/db/ftdc/constants.h"
@@ -42,6 +44,8 @@
 namespace mongo {
 
 namespace {
+std::vector<RegisterCollectorsFunction> extraCollectors;
+
 void registerMongoDCollectors(FTDCController* controller) {
     // These metrics are only collected if replication is enabled
     if (repl::getGlobalReplicationCoordinator()->getReplicationMode() !=
@@ -58,6 +62,10 @@ void registerMongoDCollectors(FTDCController* controller) {
                                                                   BSON("collStats"
                                                                        << "oplog.rs")));
     }
+
+    for (auto& registerCollectors : extraCollectors) {
+        registerCollectors(controller);
+    }
 }
 
 }  // namespace
@@ -73,4 +81,8 @@ void stopMongoDFTDC() {
     stopFTDC();
 }
 
+void addMongoDFTDCCollectors(RegisterCollectorsFunction registerCollectors) {
+    extraCollectors.push_back(std::move(registerCollectors));
+}
+
 }  // namespace mongo
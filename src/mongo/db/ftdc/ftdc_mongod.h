@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include "mongo/db/ftdc/ftdc_server.h"
+
 namespace mongo {
 
 /**
@@ -41,4 +43,10 @@ void startMongoDFTDC();
  */
 void stopMongoDFTDC();
 
+/**
+ * Adds a function that registers more collectors when mongod starts FTDC, such as those of the
+ * storage engine. Must be called before startMongoDFTDC().
+ */
+void addMongoDFTDCCollectors(RegisterCollectorsFunction registerCollectors);
+
 }  // namespace mongo
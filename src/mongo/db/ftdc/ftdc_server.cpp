@@ -301,11 +301,13 @@ void startFTDC(boost::filesystem::path& path,
     // hurt ftdc compression efficiency, because its output varies depending on the list of active
     // migrations.
     // TODO: do we need to enable "sharding" on MongoS?
+    // The "hse" section is filtered out because the hse storage engine registers a collector of
+    // its own, whose output has a fixed schema.
     controller->addPeriodicCollector(stdx::make_unique<FTDCSimpleInternalCommandCollector>(
         "serverStatus",
         "serverStatus",
         "",
-        BSON("serverStatus" << 1 << "tcMalloc" << true << "sharding" << false)));
+        BSON("serverStatus" << 1 << "tcMalloc" << true << "sharding" << false << "hse" << false)));
 
     registerCollectors(controller.get());
 
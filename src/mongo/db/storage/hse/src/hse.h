@@ -68,6 +68,7 @@ namespace hse {
 typedef void* KVSHandle;
 
 class ClientTxn;
+class KvsCursor;
 
 class Status {
 public:
@@ -287,10 +288,30 @@ public:
 
     virtual Status kvdb_close() = 0;
 
+    // Transactions, used through ClientTxn.
+    virtual struct hse_kvdb_txn* kvdb_txn_alloc() = 0;
+
+    virtual void kvdb_txn_free(struct hse_kvdb_txn* txn) = 0;
+
+    virtual Status kvdb_txn_begin(struct hse_kvdb_txn* txn) = 0;
+
+    virtual Status kvdb_txn_commit(struct hse_kvdb_txn* txn) = 0;
+
+    virtual Status kvdb_txn_abort(struct hse_kvdb_txn* txn) = 0;
+
+    // Cursor over the keys that start with prefix. A cursor bound to txn sees its view,
+    // including its writes, as of creation or the last KvsCursor::update().
+    virtual KvsCursor* kvs_cursor_create(KVSHandle handle,
+                                         KVDBData& prefix,
+                                         bool forward,
+                                         ClientTxn* txn) = 0;
+
+    // flags are HSE_KVS_PUT_* flags, e.g. to override the KVS value compression.
     virtual Status kvs_put(KVSHandle handle,
                            ClientTxn* txn,
                            const KVDBData& key,
-                           const KVDBData& val) = 0;
+                           const KVDBData& val,
+                           unsigned int flags) = 0;
 
     virtual Status kvs_sub_txn_put(KVSHandle handle, const KVDBData& key, const KVDBData& val) = 0;
 
@@ -326,6 +347,21 @@ public:
 
     virtual Status kvdb_sync() = 0;
 
+    // Compacts until space amplification is down to the low watermark.
+    virtual Status kvdb_compact() = 0;
+
+    // Cancels a compaction started by kvdb_compact(), HSE's own maintenance goes on.
+    virtual Status kvdb_compact_cancel() = 0;
+
+    // Space amplification and state of compaction.
+    virtual Status kvdb_compact_status(struct hse_kvdb_compact_status& status) = 0;
+
+    // Space of one media class. configured is false, and info untouched, if the KVDB
+    // has no such media class.
+    virtual Status kvdb_mclass_info(enum hse_mclass mclass,
+                                    bool& configured,
+                                    struct hse_mclass_info& info) = 0;
+
     bool keyStartsWith(KVDBData key, const uint8_t* prefix, unsigned long pLen) {
         if (pLen <= key.len() && 0 == memcmp(key.data(), prefix, pLen)) {
             return true;
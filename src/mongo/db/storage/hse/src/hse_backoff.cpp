@@ -0,0 +1,114 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "hse_backoff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "hse_stats.h"
+
+using hse_stat::_hseRetryBackoffMicrosCounter;
+
+namespace hse {
+
+namespace {
+
+// Weight of the newest outcome in the moving average is 1/2^kDecayShift.
+const int kDecayShift = 5;
+
+uint32_t nextRandom() {
+    static thread_local std::minstd_rand rng(static_cast<uint32_t>(
+        std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+        std::chrono::steady_clock::now().time_since_epoch().count()));
+
+    return static_cast<uint32_t>(rng());
+}
+
+}  // namespace
+
+const int KVDBBackoff::kFreeRetries;
+const int64_t KVDBBackoff::kBaseDelayMicros;
+const int64_t KVDBBackoff::kMaxDelayMicros;
+const uint32_t KVDBBackoff::kScale;
+const uint32_t KVDBBackoff::kHotContention;
+
+std::atomic<uint32_t> KVDBBackoff::_contention{0};
+
+void KVDBBackoff::noteConflict() {
+    uint32_t c = _contention.load(std::memory_order_relaxed);
+
+    c = std::min(c + ((kScale - c) >> kDecayShift) + 1, kScale);
+    _contention.store(c, std::memory_order_relaxed);
+}
+
+void KVDBBackoff::_decay() {
+    uint32_t c = _contention.load(std::memory_order_relaxed);
+
+    _contention.store(c - ((c + (1u << kDecayShift) - 1) >> kDecayShift),
+                      std::memory_order_relaxed);
+}
+
+int64_t KVDBBackoff::delayMicros(int attempt, uint32_t contention, uint32_t rand) {
+    contention = std::min(contention, kScale);
+
+    if (attempt < kFreeRetries && contention < kHotContention)
+        return 0;
+
+    // Up to 5 times the base ceiling when every recent outcome was a conflict.
+    int64_t ceiling = kBaseDelayMicros << std::min(attempt, 16);
+    ceiling = ceiling * (kScale + 4 * contention) / kScale;
+    ceiling = std::min(ceiling, kMaxDelayMicros);
+
+    return ceiling / 2 + rand % (ceiling / 2 + 1);
+}
+
+int64_t KVDBBackoff::pause(int attempt) {
+    int64_t delay = delayMicros(attempt, contention(), nextRandom());
+
+    if (delay > 0) {
+        _hseRetryBackoffMicrosCounter.add(delay);
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+    }
+
+    return delay;
+}
+
+}  // namespace hse
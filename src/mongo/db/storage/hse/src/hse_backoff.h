@@ -0,0 +1,87 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace hse {
+
+/**
+ * Backoff shared by the connector's retry loops: sub-transaction retries on ECANCELED and
+ * cursor creation retries on EAGAIN.
+ *
+ * Each sleep is drawn at random from the upper half of a ceiling that doubles with every
+ * attempt and grows with the share of recent transactions that conflicted, up to
+ * kMaxDelayMicros. Threads that conflicted on the same key therefore do not retry in
+ * lockstep, while the first retries of an isolated conflict do not sleep at all.
+ */
+class KVDBBackoff {
+public:
+    // Retries that do not sleep while contention is below kHotContention.
+    static const int kFreeRetries = 4;
+    static const int64_t kBaseDelayMicros = 20;
+    static const int64_t kMaxDelayMicros = 10 * 1000;
+
+    // Contention is the share of recent outcomes that were conflicts, in 1/kScale units.
+    static const uint32_t kScale = 1024;
+    static const uint32_t kHotContention = kScale / 8;
+
+    // Record the outcome of a transaction, or of a sub-transaction, for the estimate of
+    // contention. Successes cost a load only while nothing conflicts.
+    static void noteConflict();
+    static void noteSuccess() {
+        if (_contention.load(std::memory_order_relaxed))
+            _decay();
+    }
+
+    static uint32_t contention() {
+        return _contention.load(std::memory_order_relaxed);
+    }
+
+    // Sleeps before retry 'attempt', counting from 0, and returns the microseconds slept.
+    static int64_t pause(int attempt);
+
+    // The delay pause() sleeps for, given the contention and a random number.
+    static int64_t delayMicros(int attempt, uint32_t contention, uint32_t rand);
+
+private:
+    static void _decay();
+
+    // Exponentially weighted moving average of conflicts, updated without a CAS loop:
+    // an update lost to a race only makes the estimate slightly less precise.
+    static std::atomic<uint32_t> _contention;
+};
+
+}  // namespace hse
@@ -0,0 +1,663 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+/**
+ * storage_hse_bench drives the connector's record stores and indexes directly, without the
+ * query layer, and prints one line of JSON per run so results can be compared across
+ * connector versions.
+ *
+ *   storage_hse_bench --target=rs --threads=16 --docSize=65536 --dist=zipfian --readPct=95
+ *
+ * Each run loads --records documents or keys into an empty KVDB kvs, then runs reads and
+ * writes from --threads threads for --seconds seconds. Run with --help for the options.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mongo/base/initializer.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/ordering.h"
+#include "mongo/bson/timestamp.h"
+#include "mongo/db/client.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/service_context.h"
+#include "mongo/stdx/memory.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/util/log.h"
+
+#include "hse_counter_manager.h"
+#include "hse_durability_manager.h"
+#include "hse_impl.h"
+#include "hse_index.h"
+#include "hse_kvdb_mock.h"
+#include "hse_record_store.h"
+#include "hse_recovery_unit.h"
+#include "hse_stats.h"
+#include "hse_util.h"
+
+using hse::KVDB_prefix;
+using hse::KVSHandle;
+
+namespace mongo {
+namespace {
+
+using std::string;
+using std::vector;
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    string home{"/var/tmp/mongo-hse-bench"};
+    string kvdb{"hse"};      // hse or mock
+    string target{"rs"};     // rs, stdidx, uniqidx or oplog
+    string dist{"uniform"};  // uniform, zipfian or sequential
+    int threads{1};
+    int seconds{10};
+    int64_t records{100000};
+    int docSize{1024};
+    int readPct{50};
+    int largeValueThreshold{-1};  // rs collection options, unset if negative
+    int largeValueChunkSize{0};   // unset if 0
+    bool metrics{false};
+};
+
+const char* kUsage =
+    "usage: storage_hse_bench [--option=value ...]\n"
+    "  --home=<path>        KVDB home, created if needed (default /var/tmp/mongo-hse-bench).\n"
+    "                       Only the Bench* KVSes the run makes are dropped\n"
+    "  --kvdb=<k>           hse, or mock for the in-memory KVDB to profile the connector\n"
+    "                       alone (default hse)\n"
+    "  --target=<t>         rs, stdidx, uniqidx or oplog (default rs)\n"
+    "  --dist=<d>           uniform, zipfian or sequential key choice (default uniform)\n"
+    "  --threads=<n>        threads running operations (default 1)\n"
+    "  --seconds=<n>        length of the run (default 10)\n"
+    "  --records=<n>        documents or keys loaded before the run (default 100000)\n"
+    "  --docSize=<bytes>    document size, above 1MB documents are chunked (default 1024)\n"
+    "  --readPct=<0-100>    share of reads, the rest are writes (default 50)\n"
+    "  --largeValueThreshold=<bytes>\n"
+    "                       rs collection option, chunk documents above this size instead\n"
+    "  --largeValueChunkSize=<bytes>\n"
+    "                       rs collection option, size of the chunks (default 1MB)\n"
+    "  --metrics            enable the hse connector stats and report per-ident counters\n"
+    "\n"
+    "Reads are point reads. Writes update a document of a record store, replace a key of an\n"
+    "index, or append a document to the oplog.\n";
+
+// The hse collection options of the record store under test.
+BSONObj collectionOptions(const BenchOptions& opts) {
+    BSONObjBuilder bob;
+
+    if (opts.largeValueThreshold >= 0)
+        bob.append("largeValueThreshold", opts.largeValueThreshold);
+    if (opts.largeValueChunkSize > 0)
+        bob.append("largeValueChunkSize", opts.largeValueChunkSize);
+    return bob.obj();
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions* opts) {
+    for (int i = 1; i < argc; ++i) {
+        string arg{argv[i]};
+        if (arg == "--metrics") {
+            opts->metrics = true;
+            continue;
+        }
+
+        auto eq = arg.find('=');
+        if (arg.compare(0, 2, "--") || eq == string::npos)
+            return false;
+
+        string name = arg.substr(2, eq - 2);
+        string value = arg.substr(eq + 1);
+        try {
+            if (name == "home")
+                opts->home = value;
+            else if (name == "kvdb")
+                opts->kvdb = value;
+            else if (name == "target")
+                opts->target = value;
+            else if (name == "dist")
+                opts->dist = value;
+            else if (name == "threads")
+                opts->threads = std::stoi(value);
+            else if (name == "seconds")
+                opts->seconds = std::stoi(value);
+            else if (name == "records")
+                opts->records = std::stoll(value);
+            else if (name == "docSize")
+                opts->docSize = std::stoi(value);
+            else if (name == "readPct")
+                opts->readPct = std::stoi(value);
+            else if (name == "largeValueThreshold")
+                opts->largeValueThreshold = std::stoi(value);
+            else if (name == "largeValueChunkSize")
+                opts->largeValueChunkSize = std::stoi(value);
+            else
+                return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    if (opts->kvdb != "hse" && opts->kvdb != "mock")
+        return false;
+    if (opts->target != "rs" && opts->target != "stdidx" && opts->target != "uniqidx" &&
+        opts->target != "oplog")
+        return false;
+    if (opts->dist != "uniform" && opts->dist != "zipfian" && opts->dist != "sequential")
+        return false;
+    if (!KVDBRecordStore::parseOptions(collectionOptions(*opts), nullptr).isOK())
+        return false;
+
+    return opts->threads > 0 && opts->seconds > 0 && opts->records > 0 && opts->docSize > 0 &&
+        opts->readPct >= 0 && opts->readPct <= 100;
+}
+
+/**
+ * Zipfian distribution over [0, n) with the YCSB constant of 0.99, after Gray et al.,
+ * "Quickly Generating Billion-Record Synthetic Databases". The ranks are scrambled by a
+ * hash so the hot keys are spread over the key space rather than clustered at its start.
+ */
+class Zipfian {
+public:
+    explicit Zipfian(int64_t n) : _n(n) {
+        double zeta2 = 1 + std::pow(0.5, kTheta);
+
+        _zetan = 0;
+        for (int64_t i = 1; i <= n; ++i)
+            _zetan += 1 / std::pow(static_cast<double>(i), kTheta);
+
+        _alpha = 1 / (1 - kTheta);
+        _eta = (1 - std::pow(2.0 / n, 1 - kTheta)) / (1 - zeta2 / _zetan);
+    }
+
+    int64_t next(double u) const {
+        double uz = u * _zetan;
+        int64_t rank;
+
+        if (uz < 1)
+            rank = 0;
+        else if (uz < 1 + std::pow(0.5, kTheta))
+            rank = 1;
+        else
+            rank = static_cast<int64_t>(_n * std::pow(_eta * u - _eta + 1, _alpha));
+
+        return _scramble(std::min(rank, _n - 1)) % _n;
+    }
+
+private:
+    static constexpr double kTheta = 0.99;
+
+    // FNV-1a over the bytes of the rank.
+    static uint64_t _scramble(uint64_t v) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+
+        for (int i = 0; i < 8; ++i) {
+            h ^= (v >> (i * 8)) & 0xff;
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    int64_t _n;
+    double _zetan;
+    double _alpha;
+    double _eta;
+};
+
+constexpr double Zipfian::kTheta;
+
+class KeyChooser {
+public:
+    KeyChooser(const BenchOptions& opts, const Zipfian* zipf, int thread)
+        : _opts(opts),
+          _zipf(zipf),
+          _rng(0x5eed + thread),
+          _seq(opts.records * thread / opts.threads) {}
+
+    int64_t next() {
+        if (_opts.dist == "sequential")
+            return _seq++ % _opts.records;
+        if (_opts.dist == "zipfian")
+            return _zipf->next(std::uniform_real_distribution<double>(0, 1)(_rng));
+        return std::uniform_int_distribution<int64_t>(0, _opts.records - 1)(_rng);
+    }
+
+    bool nextIsRead() {
+        return std::uniform_int_distribution<int>(0, 99)(_rng) < _opts.readPct;
+    }
+
+private:
+    const BenchOptions& _opts;
+    const Zipfian* _zipf;
+    std::mt19937_64 _rng;
+    int64_t _seq;
+};
+
+struct ThreadResult {
+    vector<int64_t> readNanos;
+    vector<int64_t> writeNanos;
+    int64_t writeConflicts{0};
+};
+
+/**
+ * The KVDB, its kvses, and the record store or index under test.
+ */
+class BenchTarget {
+public:
+    explicit BenchTarget(const BenchOptions& opts)
+        : _opts(opts), _order(Ordering::make(BSONObj())) {
+        if (_opts.kvdb == "mock") {
+            _db = stdx::make_unique<hse::KVDBMock>();
+        } else {
+            invariantHseSt(hse::init(vector<string>{"rest.enabled=false"}));
+            _db = stdx::make_unique<hse::KVDBImpl>();
+        }
+
+        vector<string> params;
+        auto st = _db->kvdb_make(_opts.home.c_str(), params);
+        if (!st.ok() && st.getErrno() != EEXIST)
+            invariantHseSt(st);
+        invariantHseSt(_db->kvdb_open(_opts.home.c_str(), params));
+
+        // Left by a run that did not finish.
+        _dropBenchKvs(true);
+
+        _counterManager = stdx::make_unique<KVDBCounterManager>(true);
+        _durabilityManager = stdx::make_unique<KVDBDurabilityManager>(*_db, false, 0);
+
+        const bool oplog = _opts.target == "oplog";
+        const int pfxLen = oplog ? hse::OPLOG_PFX_LEN : hse::DEFAULT_PFX_LEN;
+        vector<string> rParams{"transactions.enabled=true"};
+
+        _openKvs(kMetaKvsName, hse::DEFAULT_PFX_LEN, rParams, _metaKvs);
+        _openKvs(kMainKvsName, pfxLen, rParams, _mainKvs);
+        _openKvs(kLargeKvsName, pfxLen, rParams, _largeKvs);
+
+        if (_opts.target == "stdidx")
+            rParams.push_back("kvs_sfx_len=" + std::to_string(hse::STDIDX_SFX_LEN));
+        _openKvs(kIdxKvsName, hse::DEFAULT_PFX_LEN, rParams, _idxKvs);
+    }
+
+    ~BenchTarget() {
+        _rs.reset();
+        _idx.reset();
+
+        for (auto kvs : {_metaKvs, _mainKvs, _largeKvs, _idxKvs})
+            invariantHseSt(_db->kvdb_kvs_close(kvs));
+        _dropBenchKvs(false);
+
+        invariantHseSt(_db->kvdb_close());
+        if (_opts.kvdb != "mock")
+            hse::fini();
+    }
+
+    ServiceContext::UniqueOperationContext newOperationContext(Client* client) {
+        auto opCtx = client->makeOperationContext();
+        opCtx->setRecoveryUnit(
+            new KVDBRecoveryUnit(*_db, *_counterManager.get(), *_durabilityManager.get()),
+            OperationContext::kNotInUnitOfWork);
+        return opCtx;
+    }
+
+    void create(OperationContext* opCtx) {
+        const string idxPrefix{"\0\0\0\1", 4};
+        const string ident{"benchIdent"};
+
+        if (_opts.target == "rs") {
+            BSONObjBuilder config;
+            invariantHse(KVDBRecordStore::parseOptions(collectionOptions(_opts), &config).isOK());
+
+            _rs = stdx::make_unique<KVDBRecordStore>(opCtx,
+                                                     "bench.rs",
+                                                     ident,
+                                                     *_db,
+                                                     _metaKvs,
+                                                     _mainKvs,
+                                                     _largeKvs,
+                                                     1U,
+                                                     *_durabilityManager.get(),
+                                                     *_counterManager.get(),
+                                                     config.obj());
+        } else if (_opts.target == "oplog") {
+            _rs = stdx::make_unique<KVDBOplogStore>(opCtx,
+                                                    "local.oplog.rs",
+                                                    ident,
+                                                    *_db,
+                                                    _metaKvs,
+                                                    _mainKvs,
+                                                    _largeKvs,
+                                                    1U,
+                                                    *_durabilityManager.get(),
+                                                    *_counterManager.get(),
+                                                    std::numeric_limits<int64_t>::max() / 2);
+        } else if (_opts.target == "uniqidx") {
+            _idx = stdx::make_unique<KVDBUniqIdx>(*_db,
+                                                  _idxKvs,
+                                                  *_counterManager.get(),
+                                                  idxPrefix,
+                                                  ident,
+                                                  _order,
+                                                  BSONObj(),
+                                                  false,
+                                                  1,
+                                                  KVDB_prefix + "indexsize-" + ident);
+        } else {
+            _idx = stdx::make_unique<KVDBStdIdx>(*_db,
+                                                 _idxKvs,
+                                                 *_counterManager.get(),
+                                                 idxPrefix,
+                                                 ident,
+                                                 _order,
+                                                 BSONObj(),
+                                                 1,
+                                                 KVDB_prefix + "indexsize-" + ident);
+        }
+    }
+
+    void load(OperationContext* opCtx) {
+        const int64_t kBatch = 100;
+
+        _locs.resize(_opts.records);
+        for (int64_t k = 0; k < _opts.records; k += kBatch) {
+            WriteUnitOfWork wuow(opCtx);
+            for (int64_t i = k; i < std::min(k + kBatch, _opts.records); ++i)
+                _insert(opCtx, i);
+            wuow.commit();
+        }
+        _nextOplogKey.store(_opts.records);
+    }
+
+    void read(OperationContext* opCtx, int64_t k) {
+        if (_rs) {
+            RecordData data;
+            invariant(_rs->findRecord(opCtx, _locs[k], &data));
+        } else {
+            auto cursor = _idx->newCursor(opCtx);
+            invariant(cursor->seekExact(_key(k)));
+        }
+        opCtx->recoveryUnit()->abandonSnapshot();
+    }
+
+    void write(OperationContext* opCtx, int64_t k) {
+        WriteUnitOfWork wuow(opCtx);
+
+        if (_opts.target == "oplog") {
+            _insert(opCtx, _nextOplogKey.fetch_add(1));
+        } else if (_rs) {
+            BSONObj doc = _doc(k);
+            Status st =
+                _rs->updateRecord(opCtx, _locs[k], doc.objdata(), doc.objsize(), false, nullptr);
+            invariant(st.isOK());
+        } else {
+            _idx->unindex(opCtx, _key(k), RecordId(k + 1), true);
+            invariant(_idx->insert(opCtx, _key(k), RecordId(k + 1), true).isOK());
+        }
+
+        wuow.commit();
+    }
+
+    void appendCustomStats(OperationContext* opCtx, BSONObjBuilder* bob) {
+        if (_rs)
+            _rs->appendCustomStats(opCtx, bob, 1);
+        else
+            _idx->appendCustomStats(opCtx, bob, 1);
+    }
+
+private:
+    BSONObj _doc(int64_t k) const {
+        const int pad = std::max(_opts.docSize - 48, 0);
+
+        if (_opts.target == "oplog")
+            return BSON("ts" << Timestamp(1, k + 1) << "pad" << string(pad, 'x'));
+        return BSON("_id" << k << "pad" << string(pad, 'x'));
+    }
+
+    static BSONObj _key(int64_t k) {
+        return BSON("" << k);
+    }
+
+    void _insert(OperationContext* opCtx, int64_t k) {
+        if (_rs) {
+            BSONObj doc = _doc(k);
+            auto loc = _rs->insertRecord(opCtx, doc.objdata(), doc.objsize(), false);
+            invariant(loc.isOK());
+            if (k < _opts.records)
+                _locs[k] = loc.getValue();
+        } else {
+            invariant(_idx->insert(opCtx, _key(k), RecordId(k + 1), true).isOK());
+        }
+    }
+
+    void _openKvs(const string& name, int pfxLen, const vector<string>& rParams, KVSHandle& h) {
+        vector<string> cParams{"prefix.length=" + std::to_string(pfxLen)};
+
+        invariantHseSt(_db->kvdb_kvs_make(name.c_str(), cParams));
+        invariantHseSt(_db->kvdb_kvs_open(name.c_str(), rParams, h));
+    }
+
+    // Drops the KVSes of the bench only, --home may name a KVDB that holds other data.
+    void _dropBenchKvs(bool warnOthers) {
+        char** kvsList = nullptr;
+        size_t count = 0;
+
+        invariantHseSt(_db->kvdb_get_names(&count, &kvsList));
+        for (size_t i = 0; i < count; i++) {
+            const string name{kvsList[i]};
+            if (name == kMetaKvsName || name == kMainKvsName || name == kLargeKvsName ||
+                name == kIdxKvsName) {
+                invariantHseSt(_db->kvdb_kvs_drop(name.c_str()));
+            } else if (warnOthers) {
+                std::cerr << "warning: KVDB " << _opts.home << " holds KVS " << name
+                          << ", left as is, results may be skewed by its data" << std::endl;
+            }
+        }
+        _db->kvdb_free_names(kvsList);
+    }
+
+    // Apart from the names of a mongod KVDB.
+    static const string kMetaKvsName;
+    static const string kMainKvsName;
+    static const string kLargeKvsName;
+    static const string kIdxKvsName;
+
+    const BenchOptions& _opts;
+    Ordering _order;
+
+    std::unique_ptr<hse::KVDB> _db;
+    KVSHandle _metaKvs;
+    KVSHandle _mainKvs;
+    KVSHandle _largeKvs;
+    KVSHandle _idxKvs;
+
+    std::unique_ptr<KVDBCounterManager> _counterManager;
+    std::unique_ptr<KVDBDurabilityManager> _durabilityManager;
+
+    std::unique_ptr<RecordStore> _rs;
+    std::unique_ptr<SortedDataInterface> _idx;
+
+    vector<RecordId> _locs;
+    std::atomic<int64_t> _nextOplogKey{0};
+};
+
+const string BenchTarget::kMetaKvsName = "BenchMetaKvs";
+const string BenchTarget::kMainKvsName = "BenchMainKvs";
+const string BenchTarget::kLargeKvsName = "BenchLargeKvs";
+const string BenchTarget::kIdxKvsName = "BenchIdxKvs";
+
+void runThread(BenchTarget& target,
+               const BenchOptions& opts,
+               const Zipfian* zipf,
+               int thread,
+               const std::atomic<bool>& stop,
+               ThreadResult* result) {
+    auto client = getGlobalServiceContext()->makeClient("bench" + std::to_string(thread));
+    auto opCtx = target.newOperationContext(client.get());
+    KeyChooser chooser(opts, zipf, thread);
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        const int64_t k = chooser.next();
+        const bool isRead = chooser.nextIsRead();
+        const auto start = Clock::now();
+
+        if (isRead) {
+            target.read(opCtx.get(), k);
+        } else {
+            while (true) {
+                try {
+                    target.write(opCtx.get(), k);
+                    break;
+                } catch (const WriteConflictException&) {
+                    result->writeConflicts++;
+                }
+            }
+        }
+
+        const int64_t nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        (isRead ? result->readNanos : result->writeNanos).push_back(nanos);
+    }
+}
+
+void appendLatencies(BSONObjBuilder& bob, const char* name, vector<int64_t>& nanos) {
+    BSONObjBuilder lBob(bob.subobjStart(name));
+
+    lBob.append("count", static_cast<long long>(nanos.size()));
+    if (nanos.empty())
+        return;
+
+    std::sort(nanos.begin(), nanos.end());
+    auto pct = [&nanos](double p) {
+        return static_cast<long long>(nanos[static_cast<size_t>(p * (nanos.size() - 1))] / 1000);
+    };
+    lBob.append("p50Micros", pct(0.50));
+    lBob.append("p95Micros", pct(0.95));
+    lBob.append("p99Micros", pct(0.99));
+    lBob.append("maxMicros", static_cast<long long>(nanos.back() / 1000));
+}
+
+int benchMain(const BenchOptions& opts) {
+    if (opts.metrics)
+        hse_stat::KVDBStat::enableStatsGlobally(true);
+
+    BenchTarget target(opts);
+    auto client = getGlobalServiceContext()->makeClient("bench");
+    auto opCtx = target.newOperationContext(client.get());
+
+    target.create(opCtx.get());
+
+    const auto loadStart = Clock::now();
+    target.load(opCtx.get());
+    const double loadSecs = std::chrono::duration<double>(Clock::now() - loadStart).count();
+
+    std::unique_ptr<Zipfian> zipf;
+    if (opts.dist == "zipfian")
+        zipf = stdx::make_unique<Zipfian>(opts.records);
+
+    std::atomic<bool> stop{false};
+    vector<ThreadResult> results(opts.threads);
+    vector<stdx::thread> threads;
+
+    const auto runStart = Clock::now();
+    for (int i = 0; i < opts.threads; ++i)
+        threads.emplace_back(runThread,
+                             std::ref(target),
+                             std::cref(opts),
+                             zipf.get(),
+                             i,
+                             std::cref(stop),
+                             &results[i]);
+
+    stdx::this_thread::sleep_for(Seconds(opts.seconds).toSystemDuration());
+    stop.store(true);
+    for (auto& t : threads)
+        t.join();
+    const double runSecs = std::chrono::duration<double>(Clock::now() - runStart).count();
+
+    vector<int64_t> readNanos;
+    vector<int64_t> writeNanos;
+    long long writeConflicts = 0;
+    for (auto& r : results) {
+        readNanos.insert(readNanos.end(), r.readNanos.begin(), r.readNanos.end());
+        writeNanos.insert(writeNanos.end(), r.writeNanos.begin(), r.writeNanos.end());
+        writeConflicts += r.writeConflicts;
+    }
+
+    BSONObjBuilder bob;
+    bob.append("kvdb", opts.kvdb);
+    bob.append("target", opts.target);
+    bob.append("dist", opts.dist);
+    bob.append("threads", opts.threads);
+    bob.append("records", static_cast<long long>(opts.records));
+    bob.append("docSize", opts.docSize);
+    bob.append("readPct", opts.readPct);
+    bob.append("collectionOptions", collectionOptions(opts));
+    bob.append("loadPerSec", static_cast<long long>(opts.records / loadSecs));
+    bob.append("opsPerSec",
+               static_cast<long long>((readNanos.size() + writeNanos.size()) / runSecs));
+    bob.append("writeConflicts", writeConflicts);
+    appendLatencies(bob, "reads", readNanos);
+    appendLatencies(bob, "writes", writeNanos);
+    if (opts.metrics)
+        target.appendCustomStats(opCtx.get(), &bob);
+
+    std::cout << bob.obj().jsonString() << std::endl;
+    return EXIT_SUCCESS;
+}
+
+}  // namespace
+}  // namespace mongo
+
+int main(int argc, char** argv, char** envp) {
+    mongo::BenchOptions opts;
+
+    if (!mongo::parseOptions(argc, argv, &opts)) {
+        std::cerr << mongo::kUsage;
+        return EXIT_FAILURE;
+    }
+
+    mongo::runGlobalInitializersOrDie(argc, argv, envp);
+    return mongo::benchMain(opts);
+}
@@ -0,0 +1,211 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <memory>
+#include <vector>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/client.h"
+#include "mongo/util/log.h"
+
+#include "hse_catalog_snapshot.h"
+#include "hse_clienttxn.h"
+#include "hse_util.h"
+
+using hse::KVDB_prefix;
+using hse::KVDBData;
+
+namespace mongo {
+
+namespace {
+const std::string kHeaderKey = KVDB_prefix + "catalogsnapshot";
+
+std::string chunkKey(int chunk) {
+    return kHeaderKey + "-" + std::to_string(chunk);
+}
+
+// Room for the array index and type byte of each entry in a chunk.
+const int kEntryOverhead = 16;
+}  // namespace
+
+/* Start KVDBCatalogSnapshot */
+
+const int KVDBCatalogSnapshot::kVersion = 1;
+
+const std::string& KVDBCatalogSnapshot::headerKey() {
+    return kHeaderKey;
+}
+
+hse::Status KVDBCatalogSnapshot::write(hse::KVDB& db,
+                                       KVSHandle metaKvs,
+                                       hse::ClientTxn* txn,
+                                       uint32_t maxPrefix,
+                                       const Idents& idents) {
+    // Values are bounded in size, so the ident configs are spread over chunks.
+    std::vector<BSONObj> chunks;
+    std::unique_ptr<BSONArrayBuilder> chunk(new BSONArrayBuilder());
+    for (auto& entry : idents) {
+        BSONObj rec = BSON("ident" << entry.first << "config" << entry.second);
+        if (chunk->arrSize() > 0 &&
+            chunk->len() + rec.objsize() + kEntryOverhead > HSE_KVS_VALUE_LEN_MAX) {
+            chunks.push_back(chunk->arr());
+            chunk.reset(new BSONArrayBuilder());
+        }
+        chunk->append(rec);
+    }
+    chunks.push_back(chunk->arr());
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        string keyStr = chunkKey(i);
+        KVDBData val{(uint8_t*)chunks[i].objdata(), (unsigned long)chunks[i].objsize()};
+        auto st = db.kvs_put(metaKvs, txn, KVDBData{keyStr}, val, 0);
+        if (!st.ok())
+            return st;
+    }
+
+    // The header goes last, it is what makes the chunks count.
+    BSONObj header = BSON("version" << kVersion << "maxPrefix" << static_cast<long long>(maxPrefix)
+                                    << "chunks" << static_cast<int>(chunks.size()));
+    KVDBData val{(uint8_t*)header.objdata(), (unsigned long)header.objsize()};
+    return db.kvs_put(metaKvs, txn, KVDBData{kHeaderKey}, val, 0);
+}
+
+bool KVDBCatalogSnapshot::load(hse::KVDB& db,
+                               KVSHandle metaKvs,
+                               uint32_t* maxPrefix,
+                               Idents* idents) {
+    bool found = false;
+    KVDBData val{};
+    val.createOwned(HSE_KVS_VALUE_LEN_MAX);
+
+    auto st = db.kvs_get(metaKvs, 0, KVDBData{kHeaderKey}, val, found);
+    invariantHseSt(st);
+    if (!found)
+        return false;
+
+    BSONObj header = BSONObj((const char*)val.data()).getOwned();
+    if (header.getIntField("version") != kVersion) {
+        log() << "HSE: ignoring catalog snapshot of version " << header.getIntField("version");
+        return false;
+    }
+
+    Idents loaded;
+    int nChunks = header.getIntField("chunks");
+    for (int i = 0; i < nChunks; i++) {
+        string keyStr = chunkKey(i);
+        KVDBData chunkVal{};
+        chunkVal.createOwned(HSE_KVS_VALUE_LEN_MAX);
+
+        st = db.kvs_get(metaKvs, 0, KVDBData{keyStr}, chunkVal, found);
+        invariantHseSt(st);
+        if (!found) {
+            warning() << "HSE: catalog snapshot chunk " << i << " is missing, ignoring snapshot";
+            return false;
+        }
+
+        BSONObj chunk((const char*)chunkVal.data());
+        for (auto elem : chunk) {
+            BSONObj rec = elem.Obj();
+            loaded[rec.getStringField("ident")] = rec.getObjectField("config").getOwned();
+        }
+    }
+
+    *maxPrefix = static_cast<uint32_t>(header.getField("maxPrefix").numberLong());
+    idents->swap(loaded);
+    return true;
+}
+
+/* End KVDBCatalogSnapshot */
+
+/* Start KVDBCatalogSnapshotWriter */
+
+KVDBCatalogSnapshotWriter::KVDBCatalogSnapshotWriter(stdx::function<void()> write, int periodSecs)
+    : BackgroundJob(false /* deleteSelf */), _write(write), _periodSecs(periodSecs) {}
+
+std::string KVDBCatalogSnapshotWriter::name() const {
+    return "KVDBCatalogSnapshotWriter";
+}
+
+void KVDBCatalogSnapshotWriter::run() {
+    Client::initThread(name().c_str());
+
+    LOG(1) << "starting " << name() << " thread";
+
+    while (true) {
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _writing = false;
+            _cv.notify_all();
+
+            _cv.wait_for(
+                lk, stdx::chrono::seconds(_periodSecs), [&] { return _shuttingDown; });
+            if (_shuttingDown)
+                break;
+            if (_paused)
+                continue;
+            _writing = true;
+        }
+
+        _write();
+    }
+
+    LOG(1) << "stopping " << name() << " thread";
+}
+
+void KVDBCatalogSnapshotWriter::shutdown() {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _shuttingDown = true;
+    }
+    _cv.notify_all();
+    wait();
+}
+
+void KVDBCatalogSnapshotWriter::pause() {
+    stdx::unique_lock<stdx::mutex> lk(_mutex);
+    _paused = true;
+    _cv.wait(lk, [&] { return !_writing; });
+}
+
+void KVDBCatalogSnapshotWriter::resume() {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _paused = false;
+}
+
+/* End KVDBCatalogSnapshotWriter */
+}  // namespace mongo
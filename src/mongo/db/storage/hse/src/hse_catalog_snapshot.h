@@ -0,0 +1,113 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/util/background.h"
+
+#include "hse.h"
+
+using hse::KVSHandle;
+
+namespace mongo {
+
+/**
+ * Persisted copy of the engine's ident map and highest prefix, kept in MetaKvs so that
+ * startup neither scans MainKvs for the ident metadata nor opens a reverse cursor on every
+ * KVS for the highest prefix in use. The snapshot is a header key plus as many chunk keys
+ * as the ident configs need. Creating an ident deletes the header in the transaction that
+ * writes its metadata. Dropping one deletes the header in a sub-txn of its own, committed
+ * before the sub-txn that deletes the metadata. Either way the header is gone once the
+ * metadata changes, so a header that is found matches the metadata.
+ */
+class KVDBCatalogSnapshot {
+public:
+    typedef std::map<std::string, BSONObj> Idents;
+
+    static const int kVersion;
+
+    /**
+     * Writes the snapshot in 'txn'. Fails with ECANCELED if an ident was created or dropped
+     * since 'txn' began.
+     */
+    static hse::Status write(hse::KVDB& db,
+                             KVSHandle metaKvs,
+                             hse::ClientTxn* txn,
+                             uint32_t maxPrefix,
+                             const Idents& idents);
+
+    // Returns false, leaving the outputs untouched, if there is no usable snapshot.
+    static bool load(hse::KVDB& db, KVSHandle metaKvs, uint32_t* maxPrefix, Idents* idents);
+
+    // Key to delete in or before the transaction that changes the ident metadata.
+    static const std::string& headerKey();
+};
+
+/**
+ * Calls 'write' every 'periodSecs' seconds until shutdown.
+ */
+class KVDBCatalogSnapshotWriter : public BackgroundJob {
+    MONGO_DISALLOW_COPYING(KVDBCatalogSnapshotWriter);
+
+public:
+    KVDBCatalogSnapshotWriter(stdx::function<void()> write, int periodSecs);
+
+    virtual std::string name() const;
+
+    virtual void run();
+
+    void shutdown();
+
+    // Skips the periodic writes until resume(), returns once a write under way is done.
+    void pause();
+    void resume();
+
+private:
+    const stdx::function<void()> _write;
+    const int _periodSecs;
+
+    stdx::mutex _mutex;
+    stdx::condition_variable _cv;
+    bool _shuttingDown{false};
+    bool _paused{false};
+    bool _writing{false};
+};
+}  // namespace mongo
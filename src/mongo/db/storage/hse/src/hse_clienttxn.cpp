@@ -37,3 +37,10 @@
 #include "mongo/util/log.h"
 
 #include "hse_clienttxn.h"
+
+namespace hse {
+
+std::atomic<bool> ClientTxn::_countCommits{false};
+std::atomic<uint64_t> ClientTxn::_commitsStarted{0};
+std::atomic<uint64_t> ClientTxn::_commitsDone{0};
+}  // namespace hse
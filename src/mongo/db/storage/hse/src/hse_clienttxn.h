@@ -36,6 +36,7 @@
 #include "hse.h"
 #include "hse_util.h"
 
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <vector>
@@ -44,7 +45,6 @@ using namespace std;
 
 extern "C" {
 
-struct hse_kvdb;
 struct hse_kvdb_txn;
 }
 
@@ -53,34 +53,58 @@ namespace hse {
 
 class ClientTxn {
 public:
-    ClientTxn(struct hse_kvdb* kvdb) : _kvdb(kvdb) {
-        _txn = ::hse_kvdb_txn_alloc(_kvdb);
+    ClientTxn(KVDB& kvdb) : _kvdb(kvdb) {
+        _txn = _kvdb.kvdb_txn_alloc();
 
         invariantHse(_txn);
     }
 
     virtual ~ClientTxn() {
-        ::hse_kvdb_txn_free(_kvdb, _txn);
+        _kvdb.kvdb_txn_free(_txn);
     }
 
     Status begin() {
-        return Status(::hse_kvdb_txn_begin(_kvdb, _txn));
+        return _kvdb.kvdb_txn_begin(_txn);
     }
 
     Status commit() {
-        return Status(::hse_kvdb_txn_commit(_kvdb, _txn));
+        if (!_countCommits.load(std::memory_order_relaxed))
+            return _kvdb.kvdb_txn_commit(_txn);
+
+        _commitsStarted.fetch_add(1);
+        Status st = _kvdb.kvdb_txn_commit(_txn);
+        _commitsDone.fetch_add(1);
+        return st;
     }
 
     Status abort() {
-        return Status(::hse_kvdb_txn_abort(_kvdb, _txn));
+        return _kvdb.kvdb_txn_abort(_txn);
     }
 
     struct hse_kvdb_txn* get_kvdb_txn() {
         return _txn;
     }
 
+    // Counts every commit from now on, those of the sub_txn ops included, so that a view
+    // can tell whether anything committed since it began. See KVDBSnapshotManager.
+    static void enableCommitCounting() {
+        _countCommits.store(true);
+    }
+
+    static uint64_t commitsStarted() {
+        return _commitsStarted.load();
+    }
+
+    static uint64_t commitsDone() {
+        return _commitsDone.load();
+    }
+
 private:
-    struct hse_kvdb* _kvdb;
+    KVDB& _kvdb;
     struct hse_kvdb_txn* _txn;
+
+    static std::atomic<bool> _countCommits;
+    static std::atomic<uint64_t> _commitsStarted;
+    static std::atomic<uint64_t> _commitsDone;
 };
 }
@@ -0,0 +1,220 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/auth/action_set.h"
+#include "mongo/db/auth/action_type.h"
+#include "mongo/db/auth/privilege.h"
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/commands.h"
+#include "mongo/db/concurrency/d_concurrency.h"
+#include "mongo/db/db_raii.h"
+#include "mongo/db/namespace_string.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/service_context.h"
+#include "mongo/db/storage/kv/kv_storage_engine.h"
+#include "mongo/util/log.h"
+#include "mongo/util/scopeguard.h"
+#include "mongo/util/timer.h"
+
+#include "hse_engine.h"
+
+namespace mongo {
+namespace {
+
+// The running KVDB engine, null under another storage engine.
+KVDBEngine* getKVDBEngine() {
+    auto kvStorageEngine =
+        dynamic_cast<KVStorageEngine*>(getGlobalServiceContext()->getGlobalStorageEngine());
+    return kvStorageEngine ? dynamic_cast<KVDBEngine*>(kvStorageEngine->getEngine()) : nullptr;
+}
+
+/**
+ * Streams the raw contents of the KVDB, as of one snapshot, to a file on the server.
+ * Start a new mongod with storage.hse.restoreFrom set to the file to load it.
+ *
+ *   {hseExport: "/path/to/file"}
+ *
+ * The file may be any path the mongod user can write, and is truncated if it exists. The
+ * command needs only the fsync action on the cluster, as fsyncLock does for a file copy
+ * backup, so grant it as carefully as write access to the server's file system.
+ */
+class KVDBExportCommand : public Command {
+public:
+    KVDBExportCommand() : Command("hseExport") {}
+
+    virtual bool supportsWriteConcern(const BSONObj& cmd) const override {
+        return false;
+    }
+    virtual bool slaveOk() const {
+        return true;
+    }
+    virtual bool adminOnly() const {
+        return true;
+    }
+    virtual void help(std::stringstream& h) const {
+        h << "{hseExport: <path>} writes a raw export of the HSE KVDB to a file on the server, "
+             "overwriting any file the mongod user can write at that path";
+    }
+    virtual void addRequiredPrivileges(const std::string& dbname,
+                                       const BSONObj& cmdObj,
+                                       std::vector<Privilege>* out) {
+        ActionSet actions;
+        actions.addAction(ActionType::fsync);
+        out->push_back(Privilege(ResourcePattern::forClusterResource(), actions));
+    }
+    virtual bool run(OperationContext* txn,
+                     const std::string& dbname,
+                     BSONObj& cmdObj,
+                     int,
+                     std::string& errmsg,
+                     BSONObjBuilder& result) {
+        BSONElement path = cmdObj.firstElement();
+        if (path.type() != String || path.valueStringData().empty()) {
+            errmsg = "hseExport takes the path of the file to write";
+            return false;
+        }
+
+        // The global lock is held only to pin the engine, the pin keeps it open until the
+        // export is done. Shutdown interrupts the export, as does killOp.
+        KVDBEngine* engine = nullptr;
+        {
+            Lock::GlobalLock global(txn->lockState(), MODE_IS, UINT_MAX);
+            engine = getKVDBEngine();
+            if (!engine) {
+                errmsg = "hseExport requires the hse storage engine";
+                return false;
+            }
+            if (!engine->pinForExport())
+                return appendCommandStatus(
+                    result, {ErrorCodes::ShutdownInProgress, "the HSE engine is shutting down"});
+        }
+        ON_BLOCK_EXIT([engine] { engine->unpinForExport(); });
+
+        Timer timer;
+        BSONObjBuilder kvses(result.subobjStart("kvses"));
+        Status s = engine->exportData(txn, path.String(), &kvses);
+        kvses.doneFast();
+        if (!s.isOK())
+            return appendCommandStatus(result, s);
+
+        result.append("millis", timer.millis());
+        return true;
+    }
+} kvdbExportCommand;
+
+/**
+ * Moves a collection between the shared KVSes and KVSes of its own, e.g. once its stats
+ * show it is hot enough to be kept apart. The collection is locked exclusively while its
+ * documents are copied. Only the node the command is sent to is changed.
+ *
+ *   {hseMoveCollection: "<db>.<collection>", placement: "dedicated" | "shared"}
+ */
+class KVDBMoveCollectionCommand : public Command {
+public:
+    KVDBMoveCollectionCommand() : Command("hseMoveCollection") {}
+
+    virtual bool supportsWriteConcern(const BSONObj& cmd) const override {
+        return false;
+    }
+    virtual bool slaveOk() const {
+        return true;
+    }
+    virtual bool adminOnly() const {
+        return true;
+    }
+    virtual void help(std::stringstream& h) const {
+        h << "{hseMoveCollection: <ns>, placement: \"dedicated\" | \"shared\"} moves the "
+             "collection into KVSes of its own or back into the shared KVSes";
+    }
+    virtual void addRequiredPrivileges(const std::string& dbname,
+                                       const BSONObj& cmdObj,
+                                       std::vector<Privilege>* out) {
+        ActionSet actions;
+        actions.addAction(ActionType::compact);
+        out->push_back(Privilege(
+            ResourcePattern::forExactNamespace(NamespaceString(cmdObj.firstElement().str())),
+            actions));
+    }
+    virtual bool run(OperationContext* txn,
+                     const std::string& dbname,
+                     BSONObj& cmdObj,
+                     int,
+                     std::string& errmsg,
+                     BSONObjBuilder& result) {
+        const NamespaceString nss(cmdObj.firstElement().str());
+        if (!nss.isValid() || nss.isOplog()) {
+            errmsg = "hseMoveCollection takes the namespace of a collection other than the oplog";
+            return false;
+        }
+
+        StringData placement = cmdObj.getStringField("placement");
+        if (placement != "dedicated" && placement != "shared") {
+            errmsg = "hseMoveCollection placement must be \"dedicated\" or \"shared\"";
+            return false;
+        }
+
+        KVDBEngine* engine = getKVDBEngine();
+        if (!engine) {
+            errmsg = "hseMoveCollection requires the hse storage engine";
+            return false;
+        }
+
+        // No operation reads or writes the collection while it moves, and cursors of yielded
+        // operations move along on restore.
+        AutoGetCollection autoColl(txn, nss, MODE_IX, MODE_X);
+        Collection* collection = autoColl.getCollection();
+        if (!collection) {
+            errmsg = "collection not found";
+            return false;
+        }
+
+        auto recordStore = dynamic_cast<KVDBRecordStore*>(collection->getRecordStore());
+        invariant(recordStore);
+
+        Timer timer;
+        Status s =
+            engine->moveCollection(txn, recordStore->getIdent(), placement == "dedicated");
+        if (!s.isOK())
+            return appendCommandStatus(result, s);
+
+        result.append("millis", timer.millis());
+        return true;
+    }
+} kvdbMoveCollectionCommand;
+
+}  // namespace
+}  // namespace mongo
@@ -56,31 +56,53 @@ KVDBCounterManager::KVDBCounterManager(bool crashSafe) : _crashSafe(crashSafe),
 
 void KVDBCounterManager::registerRecordStore(KVDBRecordStore* rs) {
     stdx::lock_guard<stdx::mutex> lk(_setLock);
-    _recordStores.insert(rs);
+    _recordStores.emplace(rs->getIdent(), rs);
 }
 
 void KVDBCounterManager::deregisterRecordStore(KVDBRecordStore* rs) {
     stdx::lock_guard<stdx::mutex> lk(_setLock);
-    _recordStores.erase(rs);
+    auto range = _recordStores.equal_range(rs->getIdent());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == rs) {
+            _recordStores.erase(it);
+            break;
+        }
+    }
+    _forget(rs);
 }
 
-void KVDBCounterManager::registerIndex(KVDBIdxBase* idx) {
+void KVDBCounterManager::deregisterIndex(KVDBIdxBase* idx) {
     stdx::lock_guard<stdx::mutex> lk(_setLock);
-    _indexes.insert(idx);
+    _forget(idx);
 }
 
-void KVDBCounterManager::deregisterIndex(KVDBIdxBase* idx) {
-    stdx::lock_guard<stdx::mutex> lk(_setLock);
-    _indexes.erase(idx);
+void KVDBCounterManager::_forget(KVDBCounterOwner* owner) {
+    stdx::lock_guard<stdx::mutex> lk(_dirtyLock);
+    _dirty.erase(owner);
+}
+
+void KVDBCounterManager::markDirty(KVDBCounterOwner* owner) {
+    // Only the first change since the last sync takes the lock.
+    if (owner->_countersDirty.load() || owner->_countersDirty.exchange(true))
+        return;
+
+    stdx::lock_guard<stdx::mutex> lk(_dirtyLock);
+    _dirty.insert(owner);
 }
 
 void KVDBCounterManager::_syncAllCounters(void) {
     stdx::lock_guard<stdx::mutex> lk(_setLock);
-    for (auto& rs : _recordStores) {
-        rs->updateCounters();
+
+    std::unordered_set<KVDBCounterOwner*> dirty;
+    {
+        stdx::lock_guard<stdx::mutex> dlk(_dirtyLock);
+        dirty.swap(_dirty);
     }
-    for (auto& idx : _indexes) {
-        idx->updateCounter();
+
+    // Cleared before the write, so that a change committed meanwhile queues the owner again.
+    for (auto owner : dirty) {
+        owner->_countersDirty.store(false);
+        owner->syncCounters();
     }
 }
 
@@ -108,20 +130,20 @@ void KVDBCounterManager::sync(void) {
 
 void KVDBCounterManager::sync_for_rename(std::string& ident) {
     stdx::lock_guard<stdx::mutex> lk(_setLock);
-    for (auto& rs : _recordStores) {
-        if (ident.compare(rs->getIdent()) == 0) {
-            // We are in the context of a collection rename.
-            // We are in the context of the new/second instance of RecordStore
-            // (the caller) starting.
-            // "rs" is the old instance for the same collection.
-            // "rs" is idle and is going to be destroyed by mongo shortly.
-            // The new instance takes ownership of the counters.
-            // Here, we force the old instance to flush them to media.
-            // The caller (second instance) will fetch them from media shortly.
-            rs->updateCounters();
-            rs->overTake();
-            break;
-        }
+    auto range = _recordStores.equal_range(ident);
+    if (range.first != range.second) {
+        // We are in the context of a collection rename.
+        // We are in the context of the new/second instance of RecordStore
+        // (the caller) starting.
+        // "rs" is the old instance for the same collection.
+        // "rs" is idle and is going to be destroyed by mongo shortly.
+        // The new instance takes ownership of the counters.
+        // Here, we force the old instance to flush them to media.
+        // The caller (second instance) will fetch them from media shortly.
+        KVDBRecordStore* rs = range.first->second;
+        rs->updateCounters();
+        rs->overTake();
+        _forget(rs);
     }
 }
 }
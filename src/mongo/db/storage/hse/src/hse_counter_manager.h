@@ -39,6 +39,7 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "mongo/base/string_data.h"
 #include "mongo/stdx/mutex.h"
@@ -51,33 +52,63 @@ namespace mongo {
 class KVDBIdxBase;
 class KVDBRecordStore;
 
+/**
+ * A record store or index whose counters the manager writes to media. Committing a change to
+ * one of its counters marks it dirty, and a sync writes the counters of dirty owners only.
+ */
+class KVDBCounterOwner {
+public:
+    virtual ~KVDBCounterOwner() {}
+
+    // Writes the counters to media.
+    virtual void syncCounters() = 0;
+
+    // True if a counter changed since the last sync.
+    bool countersDirty() const {
+        return _countersDirty.load();
+    }
+
+private:
+    friend class KVDBCounterManager;
+
+    std::atomic<bool> _countersDirty{false};
+};
+
 class KVDBCounterManager {
 public:
     KVDBCounterManager(bool crashSafe);
 
     void registerRecordStore(KVDBRecordStore* rs);
     void deregisterRecordStore(KVDBRecordStore* rs);
-    void registerIndex(KVDBIdxBase* idx);
     void deregisterIndex(KVDBIdxBase* idx);
 
+    // Called once a counter of 'owner' changed, queues it for the next sync.
+    void markDirty(KVDBCounterOwner* owner);
+
     void syncPeriodic();
     void sync();
     void sync_for_rename(std::string& ident);
 
 private:
     void _syncAllCounters();
+    void _forget(KVDBCounterOwner* owner);
 
     // HSE_REVISIT Implement a crash safe semantic
     bool _crashSafe = false;
     std::chrono::time_point<std::chrono::steady_clock> _updatetime;
 
-    std::set<KVDBRecordStore*> _recordStores;
-    std::set<KVDBIdxBase*> _indexes;
+    // Record stores by ident, for renames. Protected by _setLock, which is held across a
+    // sync so that an owner is not destroyed while its counters are written.
+    std::unordered_multimap<std::string, KVDBRecordStore*> _recordStores;
 
     char _pad[128];
 
     std::atomic<bool> _syncing{false};
 
     std::mutex _setLock;
+
+    // Owners marked dirty since the last sync. Taken after _setLock when both are held.
+    std::mutex _dirtyLock;
+    std::unordered_set<KVDBCounterOwner*> _dirty;
 };
 }
@@ -0,0 +1,523 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mongo/base/data_view.h"
+#include "mongo/db/client.h"
+#include "mongo/util/log.h"
+
+#include "hse_doc_dict.h"
+#include "hse_exceptions.h"
+#include "hse_kvscursor.h"
+#include "hse_util.h"
+
+#include "lz4.h"
+
+using hse::KVDB_prefix;
+using hse::KVDBData;
+using hse::KvsCursor;
+
+namespace mongo {
+
+namespace {
+const uint8_t kRaw = 0;
+const uint8_t kLZ4Dict = 1;
+
+// LZ4 matches reach back 64KB, a longer dictionary would not be used.
+const size_t kMaxDictLen = 64 * 1024;
+
+// Field names and the values of leading fields are near the start of a document, so a
+// sample is the start of one.
+const size_t kMaxSampleLen = 8 * 1024;
+const size_t kMaxSamples = 128;
+const size_t kMinSamples = 32;
+const uint64_t kSampleEvery = 16;
+
+// A sample the dictionary built so far shrinks to less than half is covered by it.
+const uint32_t kCoveredPermille = 500;
+
+// A first dictionary must save at least a tenth of the sampled bytes.
+const uint32_t kMaxUsefulPermille = 900;
+
+// Retrain once this much was compressed with a version and came out this much larger,
+// relative to its samples, than when it was trained.
+const uint64_t kRetrainMinBytes = 16 * 1024 * 1024;
+const uint32_t kRetrainSlackPermille = 1150;
+
+// Every version stays in memory for the values that use it.
+const size_t kMaxVersions = 32;
+
+uint32_t readBE32(const char* data) {
+    return ConstDataView(data).read<BigEndian<uint32_t>>();
+}
+
+void writeBE32(char* data, uint32_t value) {
+    DataView(data).write<BigEndian<uint32_t>>(value);
+}
+
+uint32_t permille(uint64_t part, uint64_t whole) {
+    return whole ? static_cast<uint32_t>(part * 1000 / whole) : 1000;
+}
+
+// The dictionaries open in this process by ident. A collection renamed has two record
+// stores for a while, which must not train versions of their own.
+stdx::mutex registryMutex;
+std::map<std::string, std::weak_ptr<KVDBDocDict>> registry;
+}  // namespace
+
+/**
+ * A dictionary version with an LZ4 stream it is loaded into. Compression starts from a
+ * copy of that stream rather than loading the dictionary again for every document.
+ */
+struct KVDBDocDict::Dict {
+    MONGO_DISALLOW_COPYING(Dict);
+
+    Dict(uint32_t version, std::string bytes, uint32_t trainedPermille)
+        : version(version),
+          bytes(std::move(bytes)),
+          trainedPermille(trainedPermille),
+          stream(LZ4_createStream()) {
+        invariantHse(stream);
+        LZ4_loadDict(stream, this->bytes.data(), this->bytes.size());
+    }
+
+    ~Dict() {
+        LZ4_freeStream(stream);
+    }
+
+    // Returns the length of the LZ4 block of len bytes written to dst, 0 if it did not fit.
+    int compress(const char* src, int len, char* dst, int dstCapacity) const {
+        static thread_local std::unique_ptr<LZ4_stream_t, decltype(&LZ4_freeStream)> work{
+            LZ4_createStream(), &LZ4_freeStream};
+
+        memcpy(work.get(), stream, sizeof(LZ4_stream_t));
+        return LZ4_compress_fast_continue(work.get(), src, dst, len, dstCapacity, 1);
+    }
+
+    const uint32_t version;
+    const std::string bytes;
+    const uint32_t trainedPermille;  // stored size of the samples it was trained on
+    LZ4_stream_t* const stream;
+};
+
+const char* const KVDBDocDict::kCompressionName = "dict";
+
+KVDBDocDict::KVDBDocDict(KVDB& db, KVSHandle& metaKvs, const std::string& ident)
+    : _db(db),
+      _metaKvs(metaKvs),
+      _ident(ident),
+      _prefix(KVDB_prefix + "docdict-" + ident + std::string(1, '\0')) {
+    _load();
+}
+
+std::shared_ptr<KVDBDocDict> KVDBDocDict::open(KVDB& db,
+                                               KVSHandle& metaKvs,
+                                               const std::string& ident) {
+    stdx::lock_guard<stdx::mutex> lk(registryMutex);
+    for (auto it = registry.begin(); it != registry.end();) {
+        if (it->second.expired())
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+
+    auto& entry = registry[ident];
+    if (auto dict = entry.lock())
+        return dict;
+
+    auto dict = std::make_shared<KVDBDocDict>(db, metaKvs, ident);
+    entry = dict;
+    return dict;
+}
+
+unsigned int KVDBDocDict::compress(const char* data, unsigned int len, std::string* out) {
+    if (_writes.fetch_add(1, std::memory_order_relaxed) % kSampleEvery == 0)
+        _sample(data, len);
+
+    auto snap = std::atomic_load(&_snap);
+    const Dict* dict = snap->current.get();
+
+    if (dict) {
+        // A block no smaller than the document is not worth its header.
+        out->resize(kMaxHeaderLen + len);
+        int blockLen = dict->compress(data, len, &(*out)[kMaxHeaderLen], len);
+        if (blockLen > 0 && static_cast<unsigned int>(blockLen) + kMaxHeaderLen < len + 1) {
+            (*out)[0] = kLZ4Dict;
+            writeBE32(&(*out)[1], dict->version);
+            writeBE32(&(*out)[5], len);
+            out->resize(kMaxHeaderLen + blockLen);
+
+            _bytesIn.fetch_add(len, std::memory_order_relaxed);
+            _bytesOut.fetch_add(out->size(), std::memory_order_relaxed);
+            return blockLen;
+        }
+    }
+
+    out->assign(1, kRaw);
+    out->append(data, len);
+    if (dict) {
+        _bytesIn.fetch_add(len, std::memory_order_relaxed);
+        _bytesOut.fetch_add(out->size(), std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+unsigned int KVDBDocDict::rawLength(const char* stored, unsigned int storedLen) {
+    invariantHse(storedLen >= 1);
+    if (stored[0] == kRaw)
+        return storedLen - 1;
+
+    invariantHse(stored[0] == kLZ4Dict && storedLen > kMaxHeaderLen);
+    return readBE32(stored + 5);
+}
+
+void KVDBDocDict::decompress(const char* stored, unsigned int storedLen, char* out) const {
+    const unsigned int rawLen = rawLength(stored, storedLen);
+    if (stored[0] == kRaw) {
+        memcpy(out, stored + 1, rawLen);
+        return;
+    }
+
+    auto snap = std::atomic_load(&_snap);
+    auto it = snap->dicts.find(readBE32(stored + 1));
+    invariantHse(it != snap->dicts.end());
+    const Dict& dict = *it->second;
+
+    int n = LZ4_decompress_safe_usingDict(stored + kMaxHeaderLen,
+                                          out,
+                                          storedLen - kMaxHeaderLen,
+                                          rawLen,
+                                          dict.bytes.data(),
+                                          dict.bytes.size());
+    invariantHse(n == static_cast<int>(rawLen));
+}
+
+void KVDBDocDict::_sample(const char* data, unsigned int len) {
+    std::string sample(data, std::min<size_t>(len, kMaxSampleLen));
+
+    stdx::lock_guard<stdx::mutex> lk(_sampleMutex);
+    if (_samples.size() < kMaxSamples)
+        _samples.push_back(std::move(sample));
+    else
+        _samples[_samplesTaken % kMaxSamples] = std::move(sample);
+    _samplesTaken++;
+}
+
+bool KVDBDocDict::needsTraining() const {
+    auto snap = std::atomic_load(&_snap);
+    const Dict* dict = snap->current.get();
+
+    if (snap->dicts.size() >= kMaxVersions)
+        return false;
+
+    {
+        // After an attempt, wait for the ring to be refilled with new samples.
+        stdx::lock_guard<stdx::mutex> lk(_sampleMutex);
+        const uint64_t fresh = _samplesTaken - _samplesAtTrain;
+        if (fresh < (_samplesAtTrain ? kMaxSamples : kMinSamples))
+            return false;
+    }
+
+    if (!dict)
+        return true;
+
+    const uint64_t in = _bytesIn.load(std::memory_order_relaxed);
+    const uint64_t out = _bytesOut.load(std::memory_order_relaxed);
+    return in >= kRetrainMinBytes &&
+        permille(out, in) * 1000 > dict->trainedPermille * kRetrainSlackPermille;
+}
+
+bool KVDBDocDict::train() {
+    stdx::lock_guard<stdx::mutex> trainLk(_trainMutex);
+    if (_retired)
+        return false;
+
+    std::vector<std::string> samples;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_sampleMutex);
+        samples = _samples;
+        _samplesAtTrain = _samplesTaken;
+    }
+    if (samples.empty())
+        return false;
+
+    std::vector<char> block(LZ4_compressBound(kMaxSampleLen));
+    auto storedLen = [&](const Dict* dict, const std::string& sample) -> uint64_t {
+        int n = dict
+            ? dict->compress(sample.data(), sample.size(), block.data(), block.size())
+            : LZ4_compress_default(sample.data(), block.data(), sample.size(), block.size());
+        invariantHse(n > 0);
+        return std::min<uint64_t>(n + kMaxHeaderLen, sample.size() + 1);
+    };
+
+    // Greedily add the samples the dictionary does not cover yet, newest first, so that
+    // it spans the different shapes of documents rather than repeating a common one.
+    std::string bytes;
+    for (auto it = samples.rbegin(); it != samples.rend() && bytes.size() < kMaxDictLen; ++it) {
+        if (!bytes.empty()) {
+            Dict partial(0, bytes, 0);
+            if (permille(storedLen(&partial, *it), it->size()) < kCoveredPermille)
+                continue;
+        }
+        bytes.append(*it, 0, std::min(it->size(), kMaxDictLen - bytes.size()));
+    }
+
+    auto snap = std::atomic_load(&_snap);
+    const uint32_t version = snap->current ? snap->current->version + 1 : 1;
+    Dict candidate(version, bytes, 0);
+
+    uint64_t rawBytes = 0, newBytes = 0, oldBytes = 0;
+    for (const auto& sample : samples) {
+        rawBytes += sample.size();
+        newBytes += storedLen(&candidate, sample);
+        oldBytes += snap->current ? storedLen(snap->current.get(), sample) : sample.size() + 1;
+    }
+
+    const uint32_t newPermille = permille(newBytes, rawBytes);
+    if (newPermille >= kMaxUsefulPermille || newBytes >= oldBytes) {
+        LOG(1) << "HSE: kept document dictionary version " << version - 1 << " of " << _ident
+               << ", a new one would store " << newPermille << " per mille of the samples";
+        return false;
+    }
+
+    auto dict = std::make_shared<const Dict>(version, std::move(bytes), newPermille);
+    _persist(*dict);
+
+    auto next = std::make_shared<Snapshot>(*snap);
+    next->dicts[version] = dict;
+    next->current = dict;
+    std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(next)));
+
+    _bytesIn.store(0, std::memory_order_relaxed);
+    _bytesOut.store(0, std::memory_order_relaxed);
+
+    LOG(1) << "HSE: trained document dictionary version " << version << " of " << _ident
+           << ", " << dict->bytes.size() << " bytes storing " << newPermille
+           << " per mille of the samples";
+    return true;
+}
+
+void KVDBDocDict::_retire() {
+    stdx::lock_guard<stdx::mutex> lk(_trainMutex);
+    _retired = true;
+}
+
+uint32_t KVDBDocDict::version() const {
+    auto snap = std::atomic_load(&_snap);
+    return snap->current ? snap->current->version : 0;
+}
+
+void KVDBDocDict::appendStats(BSONObjBuilder* bob) const {
+    auto snap = std::atomic_load(&_snap);
+    const uint64_t in = _bytesIn.load(std::memory_order_relaxed);
+    const uint64_t out = _bytesOut.load(std::memory_order_relaxed);
+
+    bob->append("version", static_cast<int>(version()));
+    bob->append("versions", static_cast<int>(snap->dicts.size()));
+    if (snap->current) {
+        bob->append("dictBytes", static_cast<int>(snap->current->bytes.size()));
+        bob->append("trainedRatio", snap->current->trainedPermille / 1000.0);
+    }
+    if (in)
+        bob->append("ratio", static_cast<double>(out) / in);
+
+    stdx::lock_guard<stdx::mutex> lk(_sampleMutex);
+    bob->append("samples", static_cast<int>(_samples.size()));
+}
+
+void KVDBDocDict::_persist(const Dict& dict) {
+    std::string key(_prefix);
+    key.resize(key.size() + sizeof(uint32_t));
+    writeBE32(&key[_prefix.size()], dict.version);
+
+    std::string val(sizeof(uint32_t), '\0');
+    writeBE32(&val[0], dict.trainedPermille);
+    val.append(dict.bytes);
+
+    auto st = _db.kvs_sub_txn_put(_metaKvs, KVDBData{key}, KVDBData{val});
+    invariantHseSt(st);
+}
+
+void KVDBDocDict::_load() {
+    auto snap = std::make_shared<Snapshot>();
+
+    // Keys end in their big endian version, so they come back in version order.
+    KVDBData pKey{(const uint8_t*)_prefix.data(), _prefix.size()};
+    std::unique_ptr<KvsCursor> cursor(_db.kvs_cursor_create(_metaKvs, pKey, true, nullptr));
+
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+    while (true) {
+        auto st = cursor->read(key, val, eof);
+        invariantHseSt(st);
+        if (eof)
+            break;
+
+        invariantHse(key.len() == _prefix.size() + sizeof(uint32_t));
+        invariantHse(val.len() > sizeof(uint32_t));
+        const char* v = (const char*)val.data();
+        auto dict = std::make_shared<const Dict>(
+            readBE32((const char*)key.data() + _prefix.size()),
+            std::string(v + sizeof(uint32_t), val.len() - sizeof(uint32_t)),
+            readBE32(v));
+        snap->dicts[dict->version] = dict;
+        snap->current = dict;
+    }
+
+    std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(snap)));
+}
+
+void KVDBDocDict::trainAll() {
+    std::vector<std::shared_ptr<KVDBDocDict>> dicts;
+    {
+        stdx::lock_guard<stdx::mutex> lk(registryMutex);
+        for (const auto& entry : registry) {
+            if (auto dict = entry.second.lock())
+                dicts.push_back(std::move(dict));
+        }
+    }
+
+    for (const auto& dict : dicts) {
+        if (dict->needsTraining())
+            dict->train();
+    }
+}
+
+hse::Status KVDBDocDict::drop(KVDB& db, KVSHandle& metaKvs, const std::string& ident) {
+    std::shared_ptr<KVDBDocDict> live;
+    {
+        stdx::lock_guard<stdx::mutex> lk(registryMutex);
+        auto it = registry.find(ident);
+        if (it != registry.end()) {
+            live = it->second.lock();
+            registry.erase(it);
+        }
+    }
+
+    // Waits out a training in progress, so that no version is persisted after the scan.
+    if (live)
+        live->_retire();
+
+    const std::string prefix(KVDB_prefix + "docdict-" + ident + std::string(1, '\0'));
+    std::vector<std::string> keys;
+
+    KVDBData pKey{(const uint8_t*)prefix.data(), prefix.size()};
+    std::unique_ptr<KvsCursor> cursor(db.kvs_cursor_create(metaKvs, pKey, true, nullptr));
+
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+    while (true) {
+        auto st = cursor->read(key, val, eof);
+        if (!st.ok())
+            return st;
+        if (eof)
+            break;
+
+        keys.emplace_back((const char*)key.data(), key.len());
+    }
+    cursor.reset();
+
+    for (const auto& k : keys) {
+        auto st = db.kvs_sub_txn_delete(metaKvs, KVDBData{k});
+        if (!st.ok())
+            return st;
+    }
+
+    return hse::Status{};
+}
+
+/* Start KVDBDocDictTrainer */
+
+const int KVDBDocDictTrainer::kPeriodSecs = 1;
+
+KVDBDocDictTrainer::KVDBDocDictTrainer() : BackgroundJob(false /* deleteSelf */) {}
+
+std::string KVDBDocDictTrainer::name() const {
+    return "KVDBDocDictTrainer";
+}
+
+void KVDBDocDictTrainer::run() {
+    Client::initThread(name().c_str());
+
+    LOG(1) << "starting " << name() << " thread";
+
+    while (true) {
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _training = false;
+            _cv.notify_all();
+
+            _cv.wait_for(lk, stdx::chrono::seconds(kPeriodSecs), [&] { return _shuttingDown; });
+            if (_shuttingDown)
+                break;
+            if (_paused)
+                continue;
+            _training = true;
+        }
+
+        KVDBDocDict::trainAll();
+    }
+
+    LOG(1) << "stopping " << name() << " thread";
+}
+
+void KVDBDocDictTrainer::shutdown() {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _shuttingDown = true;
+    }
+    _cv.notify_all();
+    wait();
+}
+
+void KVDBDocDictTrainer::pause() {
+    stdx::unique_lock<stdx::mutex> lk(_mutex);
+    _paused = true;
+    _cv.wait(lk, [&] { return !_training; });
+}
+
+void KVDBDocDictTrainer::resume() {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _paused = false;
+}
+
+/* End KVDBDocDictTrainer */
+}  // namespace mongo
@@ -0,0 +1,180 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/util/background.h"
+
+#include "hse.h"
+
+using hse::KVDB;
+using hse::KVSHandle;
+
+namespace mongo {
+
+/**
+ * Connector side compression of a collection's documents with LZ4 and a dictionary built
+ * from its own documents.
+ *
+ * Documents of a collection mostly share their field names and many of their values, which
+ * LZ4 compressing one document or chunk at a time finds little of. A dictionary of sampled
+ * documents gives every document that shared context. A stored value starts with a kind
+ * byte: kRaw is followed by the document as is, kLZ4Dict by the 4 byte big endian
+ * dictionary version and document length, then the LZ4 block.
+ *
+ * Writers sample every kSampleEvery-th document. train() builds a new dictionary version
+ * from the samples when there is none yet, or when documents compressed since the last one
+ * came out noticeably larger than its samples did, and keeps it only if it compresses the
+ * samples better. KVDBDocDictTrainer calls it in the background for every open dictionary.
+ *
+ * Versions are persisted outside of transactions in MetaKvs before any value uses them and
+ * are kept while the collection exists, as values are never rewritten to a newer one.
+ */
+class KVDBDocDict {
+    MONGO_DISALLOW_COPYING(KVDBDocDict);
+
+public:
+    static const char* const kCompressionName;
+
+    // Longest header, enough to find the document length of any stored value.
+    static const unsigned int kMaxHeaderLen = 9;
+
+    KVDBDocDict(KVDB& db, KVSHandle& metaKvs, const std::string& ident);
+
+    // Returns the dictionary of a collection, shared by all of its open record stores, and
+    // makes it known to the trainer.
+    static std::shared_ptr<KVDBDocDict> open(KVDB& db,
+                                             KVSHandle& metaKvs,
+                                             const std::string& ident);
+
+    // Sets out to the stored form of a document. Returns the length of the LZ4 block, or 0
+    // if the document is stored raw.
+    unsigned int compress(const char* data, unsigned int len, std::string* out);
+
+    // Returns the document length of a stored value, given at least its first
+    // min(storedLen, kMaxHeaderLen) bytes.
+    static unsigned int rawLength(const char* stored, unsigned int storedLen);
+
+    // Writes the rawLength() bytes of the document of a stored value to out.
+    void decompress(const char* stored, unsigned int storedLen, char* out) const;
+
+    bool needsTraining() const;
+
+    // Trains a new version from the samples. Returns true if it was kept.
+    bool train();
+
+    uint32_t version() const;
+
+    void appendStats(BSONObjBuilder* bob) const;
+
+    // Trains every open dictionary that needs it, see KVDBDocDictTrainer.
+    static void trainAll();
+
+    // Stops training the dictionary of a collection that is being dropped and removes its
+    // persisted versions.
+    static hse::Status drop(KVDB& db, KVSHandle& metaKvs, const std::string& ident);
+
+private:
+    struct Dict;
+
+    struct Snapshot {
+        std::map<uint32_t, std::shared_ptr<const Dict>> dicts;
+        std::shared_ptr<const Dict> current;  // the highest version, null if none
+    };
+
+    void _sample(const char* data, unsigned int len);
+    void _retire();
+    void _persist(const Dict& dict);
+    void _load();
+
+    KVDB& _db;
+    KVSHandle& _metaKvs;  // not owned
+    const std::string _ident;
+    const std::string _prefix;
+
+    // Accessed with std::atomic_load/atomic_store, replaced as a whole by train().
+    std::shared_ptr<const Snapshot> _snap;
+
+    // Bytes compressed with the current version, the input to needsTraining().
+    std::atomic<uint64_t> _bytesIn{0};
+    std::atomic<uint64_t> _bytesOut{0};
+    std::atomic<uint64_t> _writes{0};
+
+    mutable stdx::mutex _sampleMutex;
+    std::vector<std::string> _samples;  // ring of the last kMaxSamples samples
+    uint64_t _samplesTaken{0};
+    uint64_t _samplesAtTrain{0};
+
+    stdx::mutex _trainMutex;  // held through train(), ordered before _sampleMutex
+    bool _retired{false};
+};
+
+/**
+ * Calls KVDBDocDict::trainAll() every kPeriodSecs seconds until shutdown.
+ */
+class KVDBDocDictTrainer : public BackgroundJob {
+    MONGO_DISALLOW_COPYING(KVDBDocDictTrainer);
+
+public:
+    static const int kPeriodSecs;
+
+    KVDBDocDictTrainer();
+
+    virtual std::string name() const;
+
+    virtual void run();
+
+    void shutdown();
+
+    // Stops retraining until resume(), returns once a round under way is done.
+    void pause();
+    void resume();
+
+private:
+    stdx::mutex _mutex;
+    stdx::condition_variable _cv;
+    bool _shuttingDown{false};
+    bool _paused{false};
+    bool _training{false};
+};
+}  // namespace mongo
@@ -38,19 +38,27 @@
 #include <boost/tokenizer.hpp>
 #include <chrono>
 #include <iostream>
+#include <set>
 #include <vector>
 
 #include "mongo/platform/basic.h"
 
+#include "mongo/base/data_view.h"
 #include "mongo/db/client.h"
+#include "mongo/db/operation_context.h"
 #include "mongo/db/server_parameters.h"
 #include "mongo/db/storage/storage_options.h"
 #include "mongo/stdx/memory.h"
+#include "mongo/util/scopeguard.h"
 
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/timer.h"
 
 #include "hse_engine.h"
+#include "hse_export.h"
 #include "hse_global_options.h"
+#include "hse_idx_filter.h"
 #include "hse_kvscursor.h"
 #include "hse_recovery_unit.h"
 #include "hse_stats.h"
@@ -59,10 +67,13 @@
 using namespace std;
 using namespace std::chrono;
 
+using hse::ClientTxn;
 using hse::DEFAULT_PFX_LEN;
 using hse::DUR_LAG;
+using hse::encodePrefix;
 using hse::KVDB_prefix;
 using hse::KVDBData;
+using hse::KvsCursorBatch;
 using hse::OPLOG_PFX_LEN;
 using hse::STDIDX_SFX_LEN;
 
@@ -72,16 +83,28 @@ namespace mongo {
 
 namespace {
 
-std::string encodePrefix(uint32_t prefix) {
-    uint32_t bigEndianPrefix = endian::nativeToBig(prefix);
-    return std::string(reinterpret_cast<const char*>(&bigEndianPrefix), sizeof(uint32_t));
-}
-
 uint32_t decodePrefix(const uint8_t* prefixPtr) {
     const uint32_t* bigEndianPrefix = reinterpret_cast<const uint32_t*>(prefixPtr);
     return endian::bigToNative(*bigEndianPrefix);
 }
 
+// Calls 'done' with true once the unit of work commits, or with false if it rolls back.
+class IdentCreateChange : public RecoveryUnit::Change {
+public:
+    explicit IdentCreateChange(stdx::function<void(bool)> done) : _done(done) {}
+
+    virtual void commit() {
+        _done(true);
+    }
+
+    virtual void rollback() {
+        _done(false);
+    }
+
+private:
+    const stdx::function<void(bool)> _done;
+};
+
 }  // namespace
 
 /* Start KVDBEngine */
@@ -92,6 +115,8 @@ const string KVDBEngine::kStdIdxKvsName = "StdIdxKvs";
 const string KVDBEngine::kLargeKvsName = "LargeKvs";
 const string KVDBEngine::kOplogKvsName = "OplogKvs";
 const string KVDBEngine::kOplogLargeKvsName = "OplogLargeKvs";
+const string KVDBEngine::kDedicatedKvsPrefix = "CollKvs";
+const string KVDBEngine::kDedicatedLargeKvsPrefix = "CollLargeKvs";
 const string KVDBEngine::kMetadataPrefix = KVDB_prefix + "meta-";
 
 
@@ -99,11 +124,46 @@ KVDBEngine::KVDBEngine(const std::string& path, bool durable, int formatVersion,
     : _dbHome(path), _durable(durable), _formatVersion(formatVersion), _maxPrefix(0) {
     _setupDb();
 
+    if (!kvdbGlobalOptions.getRestoreFromStr().empty())
+        _restoreFrom(kvdbGlobalOptions.getRestoreFromStr());
+
     _loadMaxPrefix();
+    _dropOrphanDedicatedKvs();
+
+    // The prefixes of idents whose data is still being deleted must not be reused.
+    _identReaper.reset(new KVDBIdentReaper(_db,
+                                           _metaKvs,
+                                           {{kMetaKvsName, _metaKvs},
+                                            {kMainKvsName, _mainKvs},
+                                            {kLargeKvsName, _largeKvs},
+                                            {kUniqIdxKvsName, _uniqIdxKvs},
+                                            {kStdIdxKvsName, _stdIdxKvs}}));
+    _maxPrefix = std::max(_maxPrefix, _identReaper->loadPending());
+    _identReaper->go();
+
+    int catalogSnapshotSecs = kvdbGlobalOptions.getCatalogSnapshotSecs();
+    if (catalogSnapshotSecs > 0) {
+        _catalogSnapshotWriter.reset(new KVDBCatalogSnapshotWriter(
+            [this]() { _writeCatalogSnapshot(); }, catalogSnapshotSecs));
+        _catalogSnapshotWriter->go();
+    }
+
+    _docDictTrainer.reset(new KVDBDocDictTrainer());
+    _docDictTrainer->go();
 
     _counterManager.reset(new KVDBCounterManager(kvdbGlobalOptions.getCrashSafeCounters()));
     _durabilityManager.reset(
         new KVDBDurabilityManager(_db, _durable, kvdbGlobalOptions.getForceLag()));
+    _snapshotManager.reset(
+        new KVDBSnapshotManager(_db, kvdbGlobalOptions.getSharedReadViews()));
+
+    // Must precede opening any index, filters are enabled at index construction.
+    KVDBIdxFilter::setMemBudget(static_cast<size_t>(kvdbGlobalOptions.getIndexFilterMaxMB())
+                                << 20);
+    if (KVDBIdxFilter::getMemBudget() > 0) {
+        _idxFilterBuilder.reset(new KVDBIdxFilterBuilder());
+        _idxFilterBuilder->go();
+    }
 
     // init thread for rate calc
     KVDBStatRate::init();
@@ -114,7 +174,8 @@ KVDBEngine::~KVDBEngine() {
 }
 
 RecoveryUnit* KVDBEngine::newRecoveryUnit() {
-    return new KVDBRecoveryUnit(_db, *(_counterManager.get()), *(_durabilityManager.get()));
+    return new KVDBRecoveryUnit(
+        _db, *(_counterManager.get()), *(_durabilityManager.get()), _snapshotManager.get());
 }
 
 Status KVDBEngine::createRecordStore(OperationContext* opCtx,
@@ -124,12 +185,20 @@ Status KVDBEngine::createRecordStore(OperationContext* opCtx,
     BSONObjBuilder configBuilder;
     KVDBIdentType iType = NamespaceString::oplog(ns) ? KVDBIdentType::OPLOG : KVDBIdentType::COLL;
 
-    // The options are in a BSON whose name is "hse".
+    // The options are in a BSON whose name is "hse". They were validated when the
+    // collection was created, and are kept in the ident config so every open applies them.
     BSONObj engine = options.storageEngine.getObjectField("hse");
-
-
     if (!engine.isEmpty()) {
-        // HSE_REVIST: TBD when we have put options for compression.
+        Status s = KVDBRecordStore::parseOptions(engine, &configBuilder);
+        if (!s.isOK())
+            return s;
+    }
+
+    // Capped collections delete by the stored length, which must be the document length.
+    if (options.capped &&
+        engine.getStringField("valueCompression") == StringData(KVDBDocDict::kCompressionName)) {
+        return {ErrorCodes::InvalidOptions,
+                "hse valueCompression \"dict\" is not supported for capped collections"};
     }
 
     return _createIdent(opCtx, ident, iType, &configBuilder);
@@ -148,9 +217,26 @@ std::unique_ptr<RecordStore> KVDBEngine::getRecordStore(OperationContext* opCtx,
     KVDBCounterManager& counterRef = *(_counterManager.get());
 
 
+    KVSHandle* colKvs = &_mainKvs;
+    KVSHandle* largeKvs = &_largeKvs;
+    if (iType == KVDBIdentType::COLL) {
+        CollKvs& kvs = _bindCollKvs(prefix, KVDBRecordStore::usesDedicatedKvs(config));
+        colKvs = &kvs.main;
+        largeKvs = &kvs.large;
+    }
+
     if (!colOpts.capped) {
-        recordStore = stdx::make_unique<KVDBRecordStore>(
-            opCtx, ns, ident, _db, _metaKvs, _mainKvs, _largeKvs, prefix, durRef, counterRef);
+        recordStore = stdx::make_unique<KVDBRecordStore>(opCtx,
+                                                         ns,
+                                                         ident,
+                                                         _db,
+                                                         _metaKvs,
+                                                         *colKvs,
+                                                         *largeKvs,
+                                                         prefix,
+                                                         durRef,
+                                                         counterRef,
+                                                         config);
     } else {
         int64_t cappedMaxSize = colOpts.cappedSize ? colOpts.cappedSize : 4096;
         int64_t cappedMaxDocs = colOpts.cappedMaxDocs ? colOpts.cappedMaxDocs : -1;
@@ -161,13 +247,14 @@ std::unique_ptr<RecordStore> KVDBEngine::getRecordStore(OperationContext* opCtx,
                                                                    ident,
                                                                    _db,
                                                                    _metaKvs,
-                                                                   _mainKvs,
-                                                                   _largeKvs,
+                                                                   *colKvs,
+                                                                   *largeKvs,
                                                                    prefix,
                                                                    durRef,
                                                                    counterRef,
                                                                    cappedMaxSize,
-                                                                   cappedMaxDocs);
+                                                                   cappedMaxDocs,
+                                                                   config);
         } else {
             invariantHse(colOpts.capped);
             std::unique_ptr<KVDBOplogStore> oplogRs =
@@ -203,7 +290,7 @@ Status KVDBEngine::createSortedDataInterface(OperationContext* opCtx,
     KVDBIdentType iType = desc->unique() ? KVDBIdentType::UNIQINDEX : KVDBIdentType::STDINDEX;
 
     // let index add its own config things
-    KVDBIdxBase::generateConfig(&configBuilder, _formatVersion, desc->version());
+    KVDBIdxBase::generateConfig(&configBuilder, _formatVersion, desc);
     return _createIdent(opCtx, ident, iType, &configBuilder);
 }
 
@@ -246,20 +333,43 @@ SortedDataInterface* KVDBEngine::getSortedDataInterface(OperationContext* opCtx,
 }
 
 Status KVDBEngine::dropIdent(OperationContext* opCtx, StringData ident) {
+    bool deleteSnapshot = false;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identChangesInFlight++;
+        _catalogGen++;
+        deleteSnapshot = _catalogSnapshotPresent || _catalogSnapshotWriting;
+    }
+    ON_BLOCK_EXIT([this]() {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identChangesInFlight--;
+    });
+
+    hse::Status s{};
+
+    // The catalog snapshot no longer matches once the metadata is deleted.
+    if (deleteSnapshot) {
+        s = _db.kvs_sub_txn_delete(_metaKvs, KVDBData{KVDBCatalogSnapshot::headerKey()});
+        if (!s.ok()) {
+            return hseToMongoStatus(s);
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _catalogSnapshotPresent = false;
+    }
 
     string delKeyStr = kMetadataPrefix + ident.toString();
     KVDBData keyToDel{delKeyStr};
 
     // delete metadata
-    auto s = _db.kvs_sub_txn_delete(_metaKvs, keyToDel);
+    s = _db.kvs_sub_txn_delete(_metaKvs, keyToDel);
     if (!s.ok()) {
         return hseToMongoStatus(s);
     }
 
-    KVDBIdentType type = _extractType(_getIdentConfig(ident));
-    uint32_t prefixVal = _extractPrefix(_getIdentConfig(ident));
-    string prefixStr = encodePrefix(prefixVal);
-    KVDBData pKeyToDel{prefixStr};
+    BSONObj config = _getIdentConfig(ident);
+    KVDBIdentType type = _extractType(config);
+    uint32_t prefixVal = _extractPrefix(config);
 
     if (KVDBIdentType::COLL == type) {
         string dataSizeKeyStr = KVDB_prefix + "datasize-" + ident.toString();
@@ -270,17 +380,29 @@ Status KVDBEngine::dropIdent(OperationContext* opCtx, StringData ident) {
         KVDBData storageSizeKey{storageSizeKeyStr};
         KVDBData numRecordsKey{numRecordsKeyStr};
 
-        s = _db.kvs_sub_txn_prefix_delete(_metaKvs, pKeyToDel);
-        if (!s.ok()) {
-            return hseToMongoStatus(s);
-        }
-        s = _db.kvs_sub_txn_prefix_delete(_mainKvs, pKeyToDel);
-        if (!s.ok()) {
-            return hseToMongoStatus(s);
-        }
-        s = _db.kvs_sub_txn_prefix_delete(_largeKvs, pKeyToDel);
-        if (!s.ok()) {
-            return hseToMongoStatus(s);
+        if (KVDBRecordStore::usesDedicatedKvs(config)) {
+            // Dropping the KVSes releases their space at once, no tombstones to compact.
+            s = _dropDedicatedKvs(prefixVal);
+            if (!s.ok()) {
+                return hseToMongoStatus(s);
+            }
+
+            Status status = _identReaper->addDrop(ident.toString(), prefixVal, {kMetaKvsName});
+            if (!status.isOK()) {
+                return status;
+            }
+        } else {
+            // A collection moved out of dedicated KVSes keeps them until it is dropped.
+            s = _dropDedicatedKvs(prefixVal);
+            if (!s.ok()) {
+                return hseToMongoStatus(s);
+            }
+
+            Status status = _identReaper->addDrop(
+                ident.toString(), prefixVal, {kMetaKvsName, kMainKvsName, kLargeKvsName});
+            if (!status.isOK()) {
+                return status;
+            }
         }
 
         s = _db.kvs_sub_txn_delete(_metaKvs, dataSizeKey);
@@ -298,7 +420,15 @@ Status KVDBEngine::dropIdent(OperationContext* opCtx, StringData ident) {
             return hseToMongoStatus(s);
         }
 
+        s = KVDBDocDict::drop(_db, _metaKvs, ident.toString());
+        if (!s.ok()) {
+            return hseToMongoStatus(s);
+        }
+
         _identCollectionMap.erase(ident);
+
+        stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+        _collKvs.erase(prefixVal);
     } else if (KVDBIdentType::OPLOG == type) {
         _oplogBlkMgr->dropAllBlocks(opCtx, prefixVal);
         _identCollectionMap.erase(ident);
@@ -307,20 +437,25 @@ Status KVDBEngine::dropIdent(OperationContext* opCtx, StringData ident) {
         KVDBData indexSizeKey{indexSizeKeyStr};
 
         if (KVDBIdentType::STDINDEX == type) {
-            s = _db.kvs_sub_txn_prefix_delete(_stdIdxKvs, pKeyToDel);
+            Status status = _identReaper->addDrop(ident.toString(), prefixVal, {kStdIdxKvsName});
+            if (!status.isOK()) {
+                return status;
+            }
+
+            s = _db.kvs_sub_txn_delete(_stdIdxKvs, indexSizeKey);
             if (!s.ok()) {
                 return hseToMongoStatus(s);
             }
 
-            s = _db.kvs_sub_txn_delete(_stdIdxKvs, indexSizeKey);
+            s = KVDBIdxKeyDict::drop(_db, _stdIdxKvs, ident.toString());
             if (!s.ok()) {
                 return hseToMongoStatus(s);
             }
         } else {
             invariantHse(type == KVDBIdentType::UNIQINDEX);
-            s = _db.kvs_sub_txn_prefix_delete(_uniqIdxKvs, pKeyToDel);
-            if (!s.ok()) {
-                return hseToMongoStatus(s);
+            Status status = _identReaper->addDrop(ident.toString(), prefixVal, {kUniqIdxKvsName});
+            if (!status.isOK()) {
+                return status;
             }
 
             s = _db.kvs_sub_txn_delete(_uniqIdxKvs, indexSizeKey);
@@ -369,11 +504,382 @@ int KVDBEngine::flushAllFiles(bool sync) {
 }
 
 Status KVDBEngine::beginBackup(OperationContext* txn) {
-    // HSE_REVISIT: nothing to do here yet.
+    stdx::lock_guard<stdx::mutex> lk(_backupMutex);
+    if (_backupInProgress)
+        return Status(ErrorCodes::IllegalOperation, "an HSE backup is already in progress");
+
+    // The caller holds the global lock in MODE_X, which holds off client writes, index dict
+    // extensions and oplog truncation. The connector's own background writers take no lock,
+    // they are paused until endBackup(). HSE's maintenance of its media files goes on, see
+    // the README on how to copy them.
+    _pauseBackgroundWriters();
+
+    // Persist the counters and everything committed, even without a journal, so the media
+    // holds a crash-consistent image of the KVDB that a restore recovers like a restart
+    // after a crash.
+    _counterManager->sync();
+    _durabilityManager->sync();
+    auto st = _db.kvdb_sync();
+    if (!st.ok()) {
+        _resumeBackgroundWriters();
+        return hseToMongoStatus(st);
+    }
+
+    _backupInProgress = true;
+
+    log() << "HSE: backup started, copy " << boost::algorithm::join(_backupPaths(), ", ");
+    return Status::OK();
+}
+
+void KVDBEngine::endBackup(OperationContext* txn) {
+    stdx::lock_guard<stdx::mutex> lk(_backupMutex);
+    if (_backupInProgress)
+        _resumeBackgroundWriters();
+    _backupInProgress = false;
+
+    log() << "HSE: backup ended";
+}
+
+bool KVDBEngine::pinForExport() {
+    stdx::lock_guard<stdx::mutex> lk(_exportMutex);
+    if (_exportsStopped)
+        return false;
+    _exportPins++;
+    return true;
+}
+
+void KVDBEngine::unpinForExport() {
+    stdx::lock_guard<stdx::mutex> lk(_exportMutex);
+    _exportPins--;
+    _exportsUnpinned.notify_all();
+}
+
+Status KVDBEngine::exportData(OperationContext* opCtx,
+                              const std::string& path,
+                              BSONObjBuilder* stats) {
+    stdx::lock_guard<stdx::mutex> moveLk(_moveMutex);
+
+    // Collection keys start with the prefix of the ident, and are loaded with the put flags
+    // of its config.
+    std::map<uint32_t, unsigned int> putFlagsByPrefix;
+    std::vector<uint32_t> dedicated;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        for (auto& entry : _identMap) {
+            uint32_t prefix = _extractPrefix(entry.second);
+            unsigned int flags = KVDBRecordStore::putFlagsFromConfig(entry.second);
+            if (flags)
+                putFlagsByPrefix[prefix] = flags;
+            if (KVDBRecordStore::usesDedicatedKvs(entry.second))
+                dedicated.push_back(prefix);
+        }
+    }
+    auto putFlags = [&putFlagsByPrefix](const KVDBData& key) -> unsigned int {
+        if (key.len() < sizeof(uint32_t))
+            return 0;
+        uint32_t prefix = ConstDataView((const char*)key.data()).read<BigEndian<uint32_t>>();
+        auto it = putFlagsByPrefix.find(prefix);
+        return it == putFlagsByPrefix.end() ? 0 : it->second;
+    };
+
+    std::vector<KVDBExport::Kvs> kvses;
+    for (auto& kvs : _sharedKvses()) {
+        kvses.push_back({kvs.first, *kvs.second});
+        if (kvs.first == kMainKvsName || kvs.first == kLargeKvsName ||
+            kvs.first == kOplogKvsName || kvs.first == kOplogLargeKvsName)
+            kvses.back().putFlags = putFlags;
+    }
+
+    // Pins rather than holds _dedicatedKvsMutex, so collections keep opening while the
+    // export runs. KVSes no record store has opened yet are opened for the export.
+    std::vector<uint32_t> pinned;
+    ON_BLOCK_EXIT([&] { _unpinDedicatedKvs(pinned); });
+    for (uint32_t prefix : dedicated) {
+        DedicatedKvs kvs;
+        if (!_pinDedicatedKvs(prefix, &kvs))
+            continue;
+        pinned.push_back(prefix);
+        kvses.push_back({_dedicatedKvsName(prefix, false), kvs.main, putFlags});
+        kvses.push_back({_dedicatedKvsName(prefix, true), kvs.large, putFlags});
+    }
+
+    auto checkForInterrupt = [this, opCtx]() -> Status {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_exportMutex);
+            if (_exportsStopped)
+                return {ErrorCodes::ShutdownInProgress, "HSE export interrupted by shutdown"};
+        }
+        return opCtx->checkForInterruptNoAssert();
+    };
+
+    log() << "HSE: exporting " << kvses.size() << " KVSes to " << path;
+    return KVDBExport::write(_db, kvses, path, checkForInterrupt, stats);
+}
+
+Status KVDBEngine::moveCollection(OperationContext* opCtx, StringData ident, bool dedicated) {
+    stdx::unique_lock<stdx::mutex> moveLk(_moveMutex, stdx::try_to_lock);
+    if (!moveLk.owns_lock())
+        return {ErrorCodes::ConflictingOperationInProgress,
+                "an HSE collection move or export is in progress"};
+
+    BSONObj config;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        auto it = _identMap.find(ident);
+        if (it == _identMap.end())
+            return {ErrorCodes::NamespaceNotFound, str::stream() << "no ident " << ident};
+        config = it->second.copy();
+    }
+
+    if (_extractType(config) != KVDBIdentType::COLL)
+        return {ErrorCodes::IllegalOperation, "only collections other than the oplog move"};
+    if (KVDBRecordStore::usesDedicatedKvs(config) == dedicated)
+        return Status::OK();
+
+    const uint32_t prefix = _extractPrefix(config);
+    const string identStr = ident.toString();
+    const std::vector<string> sharedNames{kMainKvsName, kLargeKvsName};
+
+    // The keys an earlier move left behind are not deleted yet.
+    if (_identReaper->isPending(prefix))
+        return {ErrorCodes::ConflictingOperationInProgress,
+                str::stream() << "the keys of an earlier move of " << ident
+                              << " are still being deleted"};
+
+    DedicatedKvs& own = _openDedicatedKvs(prefix);
+    CollKvs from{_mainKvs, _largeKvs};
+    CollKvs to{own.main, own.large};
+    if (!dedicated)
+        std::swap(from, to);
+
+    const string prefixStr = encodePrefix(prefix);
+    if (dedicated) {
+        // Left from a move back to the shared KVSes or a failed move, e.g. at a shutdown.
+        for (KVSHandle h : {to.main, to.large}) {
+            auto st = _db.kvs_sub_txn_prefix_delete(h, KVDBData{prefixStr});
+            if (!st.ok())
+                return hseToMongoStatus(st);
+        }
+    } else {
+        // Recorded before the copy, so a crash midway does not leave a partial copy behind.
+        Status status = _identReaper->recordMove(nullptr, identStr, prefix, sharedNames);
+        if (!status.isOK())
+            return status;
+    }
+
+    // A failed move keeps the collection where it was. A partial dedicated copy is dropped
+    // with the orphan KVSes at startup, or cleared by the next move.
+    ScopeGuard failGuard = MakeGuard([&] {
+        if (!dedicated)
+            _identReaper->queueMove(identStr, prefix, sharedNames);
+    });
+
+    log() << "HSE: moving " << ident << " to " << (dedicated ? "dedicated" : "shared")
+          << " KVSes";
+    Timer timer;
+    const unsigned int putFlags = KVDBRecordStore::putFlagsFromConfig(config);
+    long long keys = 0;
+    Status status = _copyPrefix(opCtx, from.main, to.main, prefix, putFlags, &keys);
+    if (status.isOK())
+        status = _copyPrefix(opCtx, from.large, to.large, prefix, putFlags, &keys);
+    if (!status.isOK())
+        return status;
+
+    BSONObj newConfig = KVDBRecordStore::configWithPlacement(config, dedicated);
+    bool deleteSnapshot = false;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identChangesInFlight++;
+        _catalogGen++;
+        deleteSnapshot = _catalogSnapshotPresent || _catalogSnapshotWriting;
+    }
+    ON_BLOCK_EXIT([this]() {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identChangesInFlight--;
+    });
+
+    // The config, and what becomes of the keys left behind, change in one transaction.
+    ClientTxn txn(_db);
+    auto st = txn.begin();
+    if (!st.ok())
+        return hseToMongoStatus(st);
+
+    if (deleteSnapshot)
+        st = _db.kvs_delete(_metaKvs, &txn, KVDBData{KVDBCatalogSnapshot::headerKey()});
+
+    const string keyStr = kMetadataPrefix + identStr;
+    if (st.ok()) {
+        KVDBData val{(uint8_t*)newConfig.objdata(), (unsigned long)newConfig.objsize()};
+        st = _db.kvs_put(_mainKvs, &txn, KVDBData{keyStr}, val, 0);
+    }
+    if (!st.ok()) {
+        txn.abort();
+        return hseToMongoStatus(st);
+    }
+
+    status = dedicated ? _identReaper->recordMove(&txn, identStr, prefix, sharedNames)
+                       : _identReaper->clearMove(&txn, prefix);
+    if (!status.isOK()) {
+        txn.abort();
+        return status;
+    }
+
+    st = txn.commit();
+    if (!st.ok())
+        return hseToMongoStatus(st);
+    failGuard.Dismiss();
+
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identMap[ident] = newConfig;
+        if (deleteSnapshot)
+            _catalogSnapshotPresent = false;
+    }
+
+    // Cursors saved on the old KVSes notice the rebind on restore and are re-created.
+    {
+        stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+        auto it = _collKvs.find(prefix);
+        if (it != _collKvs.end())
+            it->second = to;
+    }
+
+    if (dedicated) {
+        _identReaper->queueMove(identStr, prefix, sharedNames);
+    } else {
+        // The dedicated KVSes stay open for saved cursors, and are dropped with the
+        // collection or, being orphans, at startup.
+        for (KVSHandle h : {from.main, from.large}) {
+            st = _db.kvs_sub_txn_prefix_delete(h, KVDBData{prefixStr});
+            if (!st.ok())
+                warning() << "HSE: deleting the keys " << ident
+                          << " left in its dedicated KVSes failed: " << st.toString();
+        }
+    }
+
+    log() << "HSE: moved " << keys << " keys of " << ident << " in " << timer.millis() << "ms";
+    return Status::OK();
+}
+
+Status KVDBEngine::_copyPrefix(OperationContext* opCtx,
+                               KVSHandle from,
+                               KVSHandle to,
+                               uint32_t prefix,
+                               unsigned int putFlags,
+                               long long* keys) {
+    // One transaction per batch, of about the size of an export block.
+    const size_t kBatchBytes = 4 << 20;
+
+    const string prefixStr = encodePrefix(prefix);
+    KVDBData prefixKey{prefixStr};
+    std::unique_ptr<KvsCursor> cursor(_db.kvs_cursor_create(from, prefixKey, true, 0));
+    invariantHse(cursor);
+
+    KvsCursorBatch batch;
+    bool eof = false;
+    while (!eof) {
+        Status status = opCtx->checkForInterruptNoAssert();
+        if (!status.isOK())
+            return status;
+
+        ClientTxn txn(_db);
+        auto st = txn.begin();
+        if (!st.ok())
+            return hseToMongoStatus(st);
+
+        size_t bytes = 0;
+        while (!eof && bytes < kBatchBytes) {
+            st = cursor->readBatch(batch, 256, eof);
+
+            KVDBData key;
+            KVDBData val;
+            while (st.ok() && !batch.empty()) {
+                batch.pop(key, val);
+                st = _db.kvs_put(to, &txn, key, val, putFlags);
+                bytes += key.len() + val.len();
+                (*keys)++;
+            }
+            if (!st.ok()) {
+                txn.abort();
+                return hseToMongoStatus(st);
+            }
+        }
+
+        st = txn.commit();
+        if (!st.ok())
+            return hseToMongoStatus(st);
+    }
+
     return Status::OK();
 }
 
-void KVDBEngine::endBackup(OperationContext* txn) {}
+BSONObj KVDBEngine::getIdentDropStats() {
+    return _identReaper->getStats();
+}
+
+BSONObj KVDBEngine::getCompactStatus() {
+    struct hse_kvdb_compact_status status;
+    BSONObjBuilder bob;
+
+    // Zeros rather than no fields on error, so the shape of FTDC samples does not change.
+    memset(&status, 0, sizeof(status));
+    auto st = _db.kvdb_compact_status(status);
+    if (!st.ok()) {
+        LOG(1) << "Failed to get the compaction status: " << st.toString();
+    }
+
+    bob.append("spaceAmpLowWatermarkPct", static_cast<int>(status.kvcs_samp_lwm));
+    bob.append("spaceAmpHighWatermarkPct", static_cast<int>(status.kvcs_samp_hwm));
+    bob.append("spaceAmpPct", static_cast<int>(status.kvcs_samp_curr));
+    bob.append("active", static_cast<int>(status.kvcs_active));
+    bob.append("canceled", static_cast<int>(status.kvcs_canceled));
+    return bob.obj();
+}
+
+BSONObj KVDBEngine::getBackupStatus() {
+    stdx::lock_guard<stdx::mutex> lk(_backupMutex);
+    BSONObjBuilder bob;
+
+    bob.append("inProgress", _backupInProgress);
+    bob.append("paths", _backupPaths());
+    return bob.obj();
+}
+
+void KVDBEngine::_pauseBackgroundWriters() {
+    _identReaper->pause();
+    if (_catalogSnapshotWriter)
+        _catalogSnapshotWriter->pause();
+    _docDictTrainer->pause();
+}
+
+void KVDBEngine::_resumeBackgroundWriters() {
+    _identReaper->resume();
+    if (_catalogSnapshotWriter)
+        _catalogSnapshotWriter->resume();
+    _docDictTrainer->resume();
+}
+
+std::vector<std::string> KVDBEngine::_backupPaths() {
+    namespace fs = boost::filesystem;
+    std::vector<std::string> paths{_dbHome};
+
+    // Media classes outside the KVDB home, e.g. a staging device, must be copied as well.
+    const string home = fs::canonical(_dbHome).string() + "/";
+    for (int i = 0; i < HSE_MCLASS_COUNT; i++) {
+        struct hse_mclass_info info;
+        bool configured;
+
+        auto st = _db.kvdb_mclass_info(static_cast<enum hse_mclass>(i), configured, info);
+        if (!st.ok() || !configured)
+            continue;
+
+        const string path = fs::canonical(info.mi_path).string();
+        if (!StringData(path + "/").startsWith(home))
+            paths.push_back(path);
+    }
+
+    return paths;
+}
 
 bool KVDBEngine::isDurable() const {
     return _durable;
@@ -408,12 +914,28 @@ void KVDBEngine::cleanShutdown() {
     _cleanShutdown();
 }
 
-// Not supported
 SnapshotManager* KVDBEngine::getSnapshotManager() const {
-    return nullptr;
+    return _snapshotManager.get();
 }
 
 
+void KVDBEngine::appendMclassStats(BSONObjBuilder* bob) {
+    for (int i = 0; i < HSE_MCLASS_COUNT; i++) {
+        enum hse_mclass mclass = static_cast<enum hse_mclass>(i);
+        struct hse_mclass_info info;
+        bool configured;
+
+        auto st = _db.kvdb_mclass_info(mclass, configured, info);
+        if (!st.ok() || !configured)
+            continue;
+
+        BSONObjBuilder sub(bob->subobjStart(::hse_mclass_name_get(mclass)));
+        sub.append("path", info.mi_path);
+        sub.append("allocatedBytes", static_cast<long long>(info.mi_allocated_bytes));
+        sub.append("usedBytes", static_cast<long long>(info.mi_used_bytes));
+    }
+}
+
 void KVDBEngine::setJournalListener(JournalListener* jl) {
     _durabilityManager->setJournalListener(jl);
 }
@@ -505,6 +1027,33 @@ void KVDBEngine::_prepareConfig() {
     _stdIdxKvsRParams.push_back("transactions.enabled=true");
     _stdIdxKvsRParams.push_back("value.compression.default=" + vComprDefault);
     _stdIdxKvsRParams.push_back("kvs_sfx_len=" + std::to_string(STDIDX_SFX_LEN));
+
+    // Media class policies, e.g. to keep the oplog and unique indexes on the fastest media.
+    const std::pair<const string&, vector<string>&> policyRParams[] = {
+        {kMetaKvsName, _metaKvsRParams},
+        {kMainKvsName, _mainKvsRParams},
+        {kLargeKvsName, _largeKvsRParams},
+        {kOplogKvsName, _oplogKvsRParams},
+        {kOplogLargeKvsName, _oplogLargeKvsRParams},
+        {kUniqIdxKvsName, _uniqIdxKvsRParams},
+        {kStdIdxKvsName, _stdIdxKvsRParams}};
+
+    for (auto& p : policyRParams) {
+        const string policy = kvdbGlobalOptions.getMclassPolicy(p.first);
+        if (!policy.empty())
+            p.second.push_back("mclass.policy=" + policy);
+    }
+}
+
+const std::vector<std::string>& KVDBEngine::mclassPolicyKvsNames() {
+    static const std::vector<std::string> names{kMetaKvsName,
+                                                kMainKvsName,
+                                                kLargeKvsName,
+                                                kOplogKvsName,
+                                                kOplogLargeKvsName,
+                                                kUniqIdxKvsName,
+                                                kStdIdxKvsName};
+    return names;
 }
 
 void KVDBEngine::_setupDb() {
@@ -539,6 +1088,192 @@ void KVDBEngine::_setupDb() {
     _open_kvs(kStdIdxKvsName, _stdIdxKvs, _stdIdxKvsCParams, _stdIdxKvsRParams);
 }
 
+std::vector<std::pair<string, KVSHandle*>> KVDBEngine::_sharedKvses() {
+    return {{kMetaKvsName, &_metaKvs},
+            {kMainKvsName, &_mainKvs},
+            {kLargeKvsName, &_largeKvs},
+            {kOplogKvsName, &_oplogKvs},
+            {kOplogLargeKvsName, &_oplogLargeKvs},
+            {kUniqIdxKvsName, &_uniqIdxKvs},
+            {kStdIdxKvsName, &_stdIdxKvs}};
+}
+
+void KVDBEngine::_restoreFrom(const string& path) {
+    // Only into a new KVDB, loading over existing data would mix two catalogs.
+    KVDBData kPrefix{(uint8_t*)kMetadataPrefix.c_str(), kMetadataPrefix.size()};
+    std::unique_ptr<KvsCursor> cursor(_db.kvs_cursor_create(_mainKvs, kPrefix, true, 0));
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+    invariantHseSt(cursor->read(key, val, eof));
+    cursor.reset();
+    uassert(ErrorCodes::IllegalOperation,
+            str::stream() << "cannot restore " << path << " into " << _dbHome
+                          << ", which already holds data",
+            eof);
+
+    auto shared = _sharedKvses();
+    auto openKvs = [&](const std::string& name) -> StatusWith<KVSHandle> {
+        for (auto& kvs : shared) {
+            if (kvs.first == name)
+                return *kvs.second;
+        }
+
+        for (bool large : {false, true}) {
+            const string& kvsPrefix = large ? kDedicatedLargeKvsPrefix : kDedicatedKvsPrefix;
+            if (StringData(name).startsWith(kvsPrefix)) {
+                DedicatedKvs& kvs =
+                    _openDedicatedKvs(std::stoul(name.substr(kvsPrefix.size())));
+                return large ? kvs.large : kvs.main;
+            }
+        }
+
+        return Status(ErrorCodes::FailedToParse,
+                      str::stream() << "export file " << path << " holds unknown KVS " << name);
+    };
+
+    log() << "HSE: restoring " << path << " into " << _dbHome;
+    BSONObjBuilder stats;
+    uassertStatusOK(KVDBExport::load(_db, path, openKvs, &stats));
+    log() << "HSE: restore complete " << stats.obj();
+}
+
+string KVDBEngine::_dedicatedKvsName(uint32_t prefix, bool large) {
+    return (large ? kDedicatedLargeKvsPrefix : kDedicatedKvsPrefix) + std::to_string(prefix);
+}
+
+KVDBEngine::DedicatedKvs& KVDBEngine::_openDedicatedKvs(uint32_t prefix) {
+    stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+
+    // Opened already by an earlier instance of the record store, e.g. before a rename.
+    DedicatedKvs& kvs = _dedicatedKvs[prefix];
+    if (!kvs.main) {
+        LOG(1) << "HSE: opening dedicated KVSes for prefix " << prefix;
+        _open_kvs(_dedicatedKvsName(prefix, false), kvs.main, _mainKvsCParams, _mainKvsRParams);
+        _open_kvs(
+            _dedicatedKvsName(prefix, true), kvs.large, _largeKvsCParams, _largeKvsRParams);
+    }
+
+    return kvs;
+}
+
+KVDBEngine::CollKvs& KVDBEngine::_bindCollKvs(uint32_t prefix, bool dedicated) {
+    CollKvs kvs{_mainKvs, _largeKvs};
+    if (dedicated) {
+        DedicatedKvs& own = _openDedicatedKvs(prefix);
+        kvs = {own.main, own.large};
+    }
+
+    // Bound already if the collection was opened before, e.g. before a rename.
+    stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+    CollKvs& bound = _collKvs[prefix];
+    if (bound.main != kvs.main)
+        bound = kvs;
+
+    return bound;
+}
+
+bool KVDBEngine::_pinDedicatedKvs(uint32_t prefix, DedicatedKvs* kvs) {
+    stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+
+    auto it = _dedicatedKvs.find(prefix);
+    if (it == _dedicatedKvs.end()) {
+        // Opened without making them, the collection may have been dropped since.
+        DedicatedKvs opened;
+        auto st = _db.kvdb_kvs_open(
+            _dedicatedKvsName(prefix, false).c_str(), _mainKvsRParams, opened.main);
+        if (st.getErrno() == ENOENT)
+            return false;
+        invariantHseSt(st);
+
+        st = _db.kvdb_kvs_open(
+            _dedicatedKvsName(prefix, true).c_str(), _largeKvsRParams, opened.large);
+        if (st.getErrno() == ENOENT) {
+            invariantHseSt(_db.kvdb_kvs_close(opened.main));
+            return false;
+        }
+        invariantHseSt(st);
+
+        LOG(1) << "HSE: opened dedicated KVSes for prefix " << prefix << " to export them";
+        it = _dedicatedKvs.emplace(prefix, opened).first;
+    }
+
+    it->second.exportPins++;
+    *kvs = it->second;
+    return true;
+}
+
+void KVDBEngine::_unpinDedicatedKvs(const std::vector<uint32_t>& prefixes) {
+    stdx::lock_guard<stdx::mutex> lk(_dedicatedKvsMutex);
+
+    for (uint32_t prefix : prefixes)
+        _dedicatedKvs[prefix].exportPins--;
+    _dedicatedKvsUnpinned.notify_all();
+}
+
+hse::Status KVDBEngine::_dropDedicatedKvs(uint32_t prefix) {
+    stdx::unique_lock<stdx::mutex> lk(_dedicatedKvsMutex);
+
+    auto it = _dedicatedKvs.find(prefix);
+    if (it != _dedicatedKvs.end()) {
+        // An export reading the KVSes finishes first, closing them would pull its cursors out
+        // from under it.
+        _dedicatedKvsUnpinned.wait(lk, [&] { return it->second.exportPins == 0; });
+        for (KVSHandle h : {it->second.main, it->second.large}) {
+            if (!h)
+                continue;
+            auto st = _db.kvdb_kvs_close(h);
+            if (!st.ok())
+                return st;
+        }
+        _dedicatedKvs.erase(it);
+    }
+
+    for (bool large : {false, true}) {
+        auto st = _db.kvdb_kvs_drop(_dedicatedKvsName(prefix, large).c_str());
+        if (!st.ok() && st.getErrno() != ENOENT)
+            return st;
+    }
+
+    return hse::Status{};
+}
+
+void KVDBEngine::_dropOrphanDedicatedKvs() {
+    // A crash between dropping the ident metadata and its KVSes leaves the KVSes behind.
+    std::set<uint32_t> placed;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        for (auto& entry : _identMap) {
+            if (KVDBRecordStore::usesDedicatedKvs(entry.second))
+                placed.insert(_extractPrefix(entry.second));
+        }
+    }
+
+    char** kvsList = nullptr;
+    size_t count = 0;
+    auto st = _db.kvdb_get_names(&count, &kvsList);
+    invariantHseSt(st);
+
+    std::set<uint32_t> orphans;
+    for (size_t i = 0; i < count; i++) {
+        StringData name{kvsList[i]};
+        for (auto& kvsPrefix : {kDedicatedKvsPrefix, kDedicatedLargeKvsPrefix}) {
+            if (!name.startsWith(kvsPrefix))
+                continue;
+
+            uint32_t prefix = std::stoul(name.substr(kvsPrefix.size()).toString());
+            if (!placed.count(prefix))
+                orphans.insert(prefix);
+        }
+    }
+    _db.kvdb_free_names(kvsList);
+
+    for (uint32_t prefix : orphans) {
+        log() << "HSE: dropping orphan dedicated KVSes for prefix " << prefix;
+        invariantHseSt(_dropDedicatedKvs(prefix));
+    }
+}
+
 uint32_t KVDBEngine::_getMaxPrefixInKvs(KVSHandle& kvs) {
 
     uint32_t retPrefix = 0;
@@ -546,7 +1281,7 @@ uint32_t KVDBEngine::_getMaxPrefixInKvs(KVSHandle& kvs) {
     // create a reverse cursor
     KvsCursor* cursor;
     KVDBData kPrefix{(uint8_t*)"", 0};  // no prefix
-    cursor = new KvsCursor(kvs, kPrefix, false, 0);
+    cursor = _db.kvs_cursor_create(kvs, kPrefix, false, 0);
     invariantHse(cursor != 0);
 
     KVDBData key{};
@@ -607,10 +1342,25 @@ void KVDBEngine::_loadMaxPrefix() {
     // load ident to prefix map. also update _maxPrefix if there's any prefix bigger than
     // current _maxPrefix
     stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+
+    // A catalog snapshot holds both, and saves the scans below.
+    KVDBCatalogSnapshot::Idents idents;
+    uint32_t snapshotMaxPrefix = 0;
+    if (KVDBCatalogSnapshot::load(_db, _metaKvs, &snapshotMaxPrefix, &idents)) {
+        for (auto& entry : idents) {
+            _identMap[entry.first] = entry.second;
+        }
+        _maxPrefix = std::max(_maxPrefix, snapshotMaxPrefix);
+        _catalogSnapshotGen = _catalogGen;
+
+        log() << "HSE: loaded " << idents.size() << " idents from the catalog snapshot";
+        return;
+    }
+
     KVDBData kPrefix{(uint8_t*)kMetadataPrefix.c_str(), kMetadataPrefix.size()};
     KvsCursor* cursor;
 
-    cursor = new KvsCursor(_mainKvs, kPrefix, true, 0);
+    cursor = _db.kvs_cursor_create(_mainKvs, kPrefix, true, 0);
     invariantHse(cursor != 0);
 
     KVDBData key{};
@@ -650,7 +1400,81 @@ void KVDBEngine::_loadMaxPrefix() {
     _checkMaxPrefix();
 }
 
+void KVDBEngine::_writeCatalogSnapshot() {
+    // The transaction begins before the ident map is copied. An ident change that commits
+    // after that deletes the snapshot header, so the put of the header conflicts.
+    ClientTxn txn(_db);
+    invariantHseSt(txn.begin());
+
+    KVDBCatalogSnapshot::Idents idents;
+    uint32_t maxPrefix = 0;
+    uint64_t gen = 0;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        if (_identChangesInFlight > 0 || _catalogSnapshotGen == _catalogGen) {
+            invariantHseSt(txn.abort());
+            return;
+        }
+
+        for (auto& entry : _identMap) {
+            idents[entry.first] = entry.second;
+        }
+        maxPrefix = _maxPrefix;
+        gen = _catalogGen;
+        _catalogSnapshotWriting = true;
+    }
+
+    auto st = KVDBCatalogSnapshot::write(_db, _metaKvs, &txn, maxPrefix, idents);
+    if (st.ok())
+        st = txn.commit();
+    if (!st.ok())
+        txn.abort();
+
+    {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _catalogSnapshotWriting = false;
+        if (st.ok()) {
+            _catalogSnapshotPresent = true;
+            if (_catalogGen == gen)
+                _catalogSnapshotGen = gen;
+        }
+    }
+
+    if (st.ok()) {
+        LOG(1) << "HSE: wrote catalog snapshot of " << idents.size() << " idents";
+    } else if (st.getErrno() != ECANCELED) {
+        warning() << "HSE: writing the catalog snapshot failed: " << st.toString();
+    }
+}
+
 void KVDBEngine::_cleanShutdown() {
+    // Exports run without the global lock, the KVDB stays open until they stop.
+    {
+        stdx::unique_lock<stdx::mutex> lk(_exportMutex);
+        _exportsStopped = true;
+        _exportsUnpinned.wait(lk, [this] { return _exportPins == 0; });
+    }
+
+    if (_idxFilterBuilder) {
+        _idxFilterBuilder->shutdown();
+        _idxFilterBuilder.reset();
+    }
+
+    _docDictTrainer->shutdown();
+    _docDictTrainer.reset();
+
+    if (_catalogSnapshotWriter) {
+        _catalogSnapshotWriter->shutdown();
+        _catalogSnapshotWriter.reset();
+    }
+
+    // Drops not yet reaped stay recorded and resume at the next startup.
+    _identReaper->shutdown();
+    _identReaper.reset();
+
+    // Saves the next startup from scanning for the idents and the highest prefix.
+    _writeCatalogSnapshot();
+
     _durabilityManager->prepareForShutdown();
     _durabilityManager.reset();
 
@@ -659,6 +1483,9 @@ void KVDBEngine::_cleanShutdown() {
 
     KVDBStatRate::finish();
 
+    // Views are open transactions, they must be aborted before the kvdb is closed.
+    _snapshotManager->dropAllSnapshots();
+
     _db.kvdb_close();
     hse::fini();
 }
@@ -670,6 +1497,7 @@ Status KVDBEngine::_createIdent(OperationContext* opCtx,
                                 BSONObjBuilder* configBuilder) {
     BSONObj config;
     uint32_t prefix = 0;
+    bool deleteSnapshot = false;
     {
         stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
         if (_identMap.find(ident) != _identMap.end()) {
@@ -682,6 +1510,31 @@ Status KVDBEngine::_createIdent(OperationContext* opCtx,
         configBuilder->append("type", static_cast<int32_t>(type));
 
         config = std::move(configBuilder->obj());
+
+        _identChangesInFlight++;
+        _catalogGen++;
+        deleteSnapshot = _catalogSnapshotPresent || _catalogSnapshotWriting;
+    }
+
+    auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opCtx);
+    string identStr = ident.toString();
+    ru->registerChange(new IdentCreateChange([this, identStr, deleteSnapshot](bool committed) {
+        stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
+        _identChangesInFlight--;
+        if (committed && deleteSnapshot)
+            _catalogSnapshotPresent = false;
+        if (!committed)
+            _identMap.erase(identStr);
+    }));
+
+    hse::Status s{};
+
+    // The catalog snapshot no longer matches once the metadata is recorded.
+    if (deleteSnapshot) {
+        s = ru->del(_metaKvs, KVDBData{KVDBCatalogSnapshot::headerKey()});
+        if (!s.ok()) {
+            return hseToMongoStatus(s);
+        }
     }
 
     string keyStr = kMetadataPrefix + ident.toString();
@@ -689,8 +1542,7 @@ Status KVDBEngine::_createIdent(OperationContext* opCtx,
     KVDBData val{(uint8_t*)config.objdata(), (unsigned long)config.objsize()};
 
     LOG(1) << "HSE: recording ident to kvs : " << ident.toString();
-    auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opCtx);
-    auto s = ru->put(_mainKvs, key, val);
+    s = ru->put(_mainKvs, key, val);
 
     {
         stdx::lock_guard<stdx::mutex> lk(_identMapMutex);
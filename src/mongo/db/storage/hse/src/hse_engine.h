@@ -38,6 +38,7 @@
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -45,15 +46,20 @@
 #include "mongo/base/disallow_copying.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/storage/kv/kv_engine.h"
+#include "mongo/stdx/condition_variable.h"
 #include "mongo/util/string_map.h"
 
 
+#include "hse_catalog_snapshot.h"
 #include "hse_counter_manager.h"
+#include "hse_doc_dict.h"
 #include "hse_durability_manager.h"
 #include "hse_exceptions.h"
+#include "hse_ident_reaper.h"
 #include "hse_impl.h"
 #include "hse_index.h"
 #include "hse_record_store.h"
+#include "hse_snapshot_manager.h"
 
 using std::string;
 
@@ -132,9 +138,48 @@ public:
      */
     static bool initOplogStoreThread(StringData ns);
 
+    // KVSes that accept a media class policy. Dedicated collection KVSes follow MainKvs and
+    // LargeKvs.
+    static const std::vector<std::string>& mclassPolicyKvsNames();
+
 
     virtual void setJournalListener(JournalListener* jl);
 
+    // Appends the allocated and used bytes of each configured media class.
+    void appendMclassStats(BSONObjBuilder* bob);
+
+    // Number of dropped idents whose data is pending deletion and reaped since startup.
+    BSONObj getIdentDropStats();
+
+    // Space amplification of the KVDB and whether a compaction is underway.
+    BSONObj getCompactStatus();
+
+    // Whether a backup is in progress and the directories it must copy.
+    BSONObj getBackupStatus();
+
+    // How often units of work shared a view of the latest committed state.
+    BSONObj getSharedReadViewStats() const {
+        return _snapshotManager->getSharedReadViewStats();
+    }
+
+    // Keeps the engine open for an export that runs without the global lock. Taken under
+    // the global lock, false once the engine is shutting down. Shutdown interrupts pinned
+    // exports and waits for them to be unpinned.
+    bool pinForExport();
+    void unpinForExport();
+
+    // Writes the contents of every connector KVS, as of one snapshot, to a file that
+    // storage.hse.restoreFrom loads into a new KVDB. The caller holds an export pin.
+    Status exportData(OperationContext* opCtx, const std::string& path, BSONObjBuilder* stats);
+
+    /**
+     * Moves the documents of a collection into KVSes of its own, or back into the shared
+     * main and large KVSes, and rebinds its record store to them. The caller holds the
+     * collection in MODE_X for the whole move, so that no write or live cursor sees the
+     * copy half done.
+     */
+    Status moveCollection(OperationContext* opCtx, StringData ident, bool dedicated);
+
 
 private:
     void _prepareConfig();
@@ -147,9 +192,46 @@ private:
                    const vector<string>& cParams,
                    const vector<string>& rParams);
     void _cleanShutdown();
+    std::vector<std::string> _backupPaths();
+
+    // Pauses the background jobs that write to the KVDB without taking a lock, for a backup:
+    // the ident reaper, with the compaction it asks for, the catalog snapshot writer and
+    // the document dictionary trainer.
+    void _pauseBackgroundWriters();
+    void _resumeBackgroundWriters();
+
+    // KVSes of a collection stored apart from the shared main and large KVSes.
+    struct DedicatedKvs {
+        KVSHandle main{nullptr};
+        KVSHandle large{nullptr};
+        int exportPins{0};  // exports reading the KVSes, a drop waits for none
+    };
+    static string _dedicatedKvsName(uint32_t prefix, bool large);
+    DedicatedKvs& _openDedicatedKvs(uint32_t prefix);
+    bool _pinDedicatedKvs(uint32_t prefix, DedicatedKvs* kvs);
+    void _unpinDedicatedKvs(const std::vector<uint32_t>& prefixes);
+    hse::Status _dropDedicatedKvs(uint32_t prefix);
+    void _dropOrphanDedicatedKvs();
+
+    // KVSes a collection record store reads and writes through, rebound by a move.
+    struct CollKvs {
+        KVSHandle main;
+        KVSHandle large;
+    };
+    CollKvs& _bindCollKvs(uint32_t prefix, bool dedicated);
+    Status _copyPrefix(OperationContext* opCtx,
+                       KVSHandle from,
+                       KVSHandle to,
+                       uint32_t prefix,
+                       unsigned int putFlags,
+                       long long* keys);
+    std::vector<std::pair<string, KVSHandle*>> _sharedKvses();
+    void _restoreFrom(const string& path);
+
     uint32_t _getMaxPrefixInKvs(KVSHandle& kvs);
     void _checkMaxPrefix();
     void _loadMaxPrefix();
+    void _writeCatalogSnapshot();
     Status _createIdent(OperationContext* opCtx,
                         StringData ident,
                         KVDBIdentType type,
@@ -174,6 +256,8 @@ private:
     static const string kLargeKvsName;
     static const string kOplogKvsName;
     static const string kOplogLargeKvsName;
+    static const string kDedicatedKvsPrefix;
+    static const string kDedicatedLargeKvsPrefix;
 
     // Special prefixes
     static const string kMetadataPrefix;
@@ -205,6 +289,22 @@ private:
     KVSHandle _oplogKvs;
     KVSHandle _oplogLargeKvs;
 
+    // Dedicated KVSes by collection prefix, created or opened on first use. Entries stay
+    // put until the collection is dropped, also after it moves back to the shared KVSes, as
+    // saved cursors may still read them.
+    stdx::mutex _dedicatedKvsMutex;
+    stdx::condition_variable _dedicatedKvsUnpinned;
+    std::map<uint32_t, DedicatedKvs> _dedicatedKvs;
+
+    // Also protected by _dedicatedKvsMutex. The KVSes of each collection by prefix. Record
+    // stores keep references to the handles, which a move rewrites under the collection
+    // lock.
+    std::map<uint32_t, CollKvs> _collKvs;
+
+    // Held by a collection move, and by an export so that it sees every collection in the
+    // KVSes its ident config names.
+    stdx::mutex _moveMutex;
+
     // ident map stores mapping from ident to a BSON config
     mutable stdx::mutex _identMapMutex;
     typedef StringMap<BSONObj> IdentMap;
@@ -213,6 +313,17 @@ private:
     // protected by _identMapMutex
     uint32_t _maxPrefix;
 
+    // Also protected by _identMapMutex. Idents being created or dropped, the catalog
+    // snapshot is not written while there are any. _catalogGen counts ident changes, and
+    // _catalogSnapshotGen is the count the catalog snapshot in MetaKvs matches. An ident
+    // change deletes the snapshot header only if it may be present or is being written,
+    // so that concurrent creates do not all conflict on it.
+    int _identChangesInFlight{0};
+    uint64_t _catalogGen{1};
+    uint64_t _catalogSnapshotGen{0};
+    bool _catalogSnapshotPresent{true};
+    bool _catalogSnapshotWriting{false};
+
     // _identObjectMapMutex protects both _identIndexMap and _identCollectionMap. It should
     // never be locked together with _identMapMutex
     mutable stdx::mutex _identObjectMapMutex;
@@ -226,6 +337,31 @@ private:
     // CounterManages manages counters like numRecords and dataSize for record stores
     std::unique_ptr<KVDBCounterManager> _counterManager;
 
+    std::unique_ptr<KVDBSnapshotManager> _snapshotManager;
+
     std::shared_ptr<KVDBOplogBlockManager> _oplogBlkMgr{};
+
+    // Deletes the data of dropped idents in the background.
+    std::unique_ptr<KVDBIdentReaper> _identReaper;
+
+    // Rewrites the catalog snapshot periodically, null if only written at clean shutdown.
+    std::unique_ptr<KVDBCatalogSnapshotWriter> _catalogSnapshotWriter;
+
+    // Builds index filters off the query path, null if they are disabled.
+    std::unique_ptr<KVDBIdxFilterBuilder> _idxFilterBuilder;
+
+    // Retrains the dictionaries of collections compressed by the connector.
+    std::unique_ptr<KVDBDocDictTrainer> _docDictTrainer;
+
+    // Exports pinning the engine, and whether shutdown has begun.
+    stdx::mutex _exportMutex;
+    stdx::condition_variable _exportsUnpinned;
+    int _exportPins{0};
+    bool _exportsStopped{false};
+
+    // Set between beginBackup() and endBackup(), i.e. while fsyncLock holds writes off and
+    // the background writers are paused.
+    stdx::mutex _backupMutex;
+    bool _backupInProgress{false};
 };
 }  // namespace mongo
@@ -36,9 +36,16 @@
 #include <boost/filesystem/operations.hpp>
 #include <memory>
 
+#include "mongo/base/checked_cast.h"
+#include "mongo/db/catalog/collection_options.h"
+#include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/kv/kv_engine.h"
 #include "mongo/db/storage/kv/kv_engine_test_harness.h"
 #include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/options_parser/environment.h"
+#include "mongo/util/scopeguard.h"
+#include "mongo/util/time_support.h"
 
 #include "hse_engine.h"
 #include "hse_global_options.h"
@@ -84,4 +91,216 @@ private:
 KVHarnessHelper* KVHarnessHelper::create() {
     return new KVDBEngineHarnessHelper();
 }
+
+TEST(KVDBEngineTest, DroppedIdentIsReaped) {
+    std::unique_ptr<KVHarnessHelper> helper(KVHarnessHelper::create());
+    KVDBEngine* engine = checked_cast<KVDBEngine*>(helper->getEngine());
+
+    std::string ns = "a.b";
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        ASSERT_OK(engine->createRecordStore(&opCtx, ns, ns, CollectionOptions()));
+        std::unique_ptr<RecordStore> rs =
+            engine->getRecordStore(&opCtx, ns, ns, CollectionOptions());
+
+        WriteUnitOfWork uow(&opCtx);
+        ASSERT_OK(rs->insertRecord(&opCtx, "abc", 4, false).getStatus());
+        uow.commit();
+    }
+
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        ASSERT_OK(engine->dropIdent(&opCtx, ns));
+        ASSERT_FALSE(engine->hasIdent(&opCtx, ns));
+    }
+
+    // The data of the ident is deleted in the background.
+    for (int i = 0; i < 1000; i++) {
+        if (engine->getIdentDropStats()["pending"].numberLong() == 0)
+            break;
+        sleepmillis(10);
+    }
+
+    BSONObj stats = engine->getIdentDropStats();
+    ASSERT_EQUALS(0, stats["pending"].numberLong());
+    ASSERT_EQUALS(1, stats["reaped"].numberLong());
+}
+
+TEST(KVDBEngineTest, BackupPausesReaper) {
+    std::unique_ptr<KVHarnessHelper> helper(KVHarnessHelper::create());
+    KVDBEngine* engine = checked_cast<KVDBEngine*>(helper->getEngine());
+
+    std::string ns = "a.b";
+    OperationContextNoop opCtx(engine->newRecoveryUnit());
+    ASSERT_OK(engine->createRecordStore(&opCtx, ns, ns, CollectionOptions()));
+
+    // A drop during a backup is recorded, its data is deleted once the backup ends.
+    ASSERT_OK(engine->beginBackup(&opCtx));
+    ASSERT_NOT_OK(engine->beginBackup(&opCtx));
+    ASSERT_OK(engine->dropIdent(&opCtx, ns));
+    sleepmillis(10 * KVDBIdentReaper::kPauseMillis);
+    ASSERT_EQUALS(1, engine->getIdentDropStats()["pending"].numberLong());
+
+    engine->endBackup(&opCtx);
+    for (int i = 0; i < 1000; i++) {
+        if (engine->getIdentDropStats()["pending"].numberLong() == 0)
+            break;
+        sleepmillis(10);
+    }
+    ASSERT_EQUALS(0, engine->getIdentDropStats()["pending"].numberLong());
+}
+
+TEST(KVDBEngineTest, MoveCollection) {
+    std::unique_ptr<KVHarnessHelper> helper(KVHarnessHelper::create());
+    KVDBEngine* engine = checked_cast<KVDBEngine*>(helper->getEngine());
+
+    auto waitForReaper = [&] {
+        for (int i = 0; i < 1000; i++) {
+            if (engine->getIdentDropStats()["pending"].numberLong() == 0)
+                break;
+            sleepmillis(10);
+        }
+        ASSERT_EQUALS(0, engine->getIdentDropStats()["pending"].numberLong());
+    };
+
+    std::string ns = "a.b";
+    std::vector<RecordId> ids;
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        ASSERT_OK(engine->createRecordStore(&opCtx, ns, ns, CollectionOptions()));
+        std::unique_ptr<RecordStore> rs =
+            engine->getRecordStore(&opCtx, ns, ns, CollectionOptions());
+
+        {
+            WriteUnitOfWork uow(&opCtx);
+            for (int i = 0; i < 10; i++) {
+                std::string doc = "doc" + std::to_string(i);
+                StatusWith<RecordId> res =
+                    rs->insertRecord(&opCtx, doc.c_str(), doc.size() + 1, false);
+                ASSERT_OK(res.getStatus());
+                ids.push_back(res.getValue());
+            }
+            uow.commit();
+        }
+
+        // A cursor saved across the move resumes in the dedicated KVSes.
+        auto cursor = rs->getCursor(&opCtx);
+        ASSERT_EQ(ids[0], cursor->next()->id);
+        cursor->save();
+        opCtx.recoveryUnit()->abandonSnapshot();
+        ASSERT_OK(engine->moveCollection(&opCtx, ns, true));
+        ASSERT_OK(engine->moveCollection(&opCtx, ns, true));
+        ASSERT_TRUE(cursor->restore());
+        for (int i = 1; i < 10; i++)
+            ASSERT_EQ(ids[i], cursor->next()->id);
+        ASSERT_FALSE(cursor->next());
+        cursor.reset();
+
+        // The keys left in the shared KVSes are deleted in the background.
+        waitForReaper();
+        ASSERT_EQUALS(1, engine->getIdentDropStats()["reaped"].numberLong());
+
+        {
+            WriteUnitOfWork uow(&opCtx);
+            StatusWith<RecordId> res = rs->insertRecord(&opCtx, "moved", 6, false);
+            ASSERT_OK(res.getStatus());
+            ids.push_back(res.getValue());
+            uow.commit();
+        }
+
+        opCtx.recoveryUnit()->abandonSnapshot();
+        ASSERT_OK(engine->moveCollection(&opCtx, ns, false));
+        ASSERT_EQUALS(std::string("moved"), rs->dataFor(&opCtx, ids.back()).data());
+        ASSERT_EQUALS(11, rs->numRecords(&opCtx));
+    }
+
+    // The placement is kept in the ident config.
+    engine = checked_cast<KVDBEngine*>(helper->restartEngine());
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        std::unique_ptr<RecordStore> rs =
+            engine->getRecordStore(&opCtx, ns, ns, CollectionOptions());
+
+        auto cursor = rs->getCursor(&opCtx);
+        for (auto& id : ids)
+            ASSERT_EQ(id, cursor->next()->id);
+        ASSERT_FALSE(cursor->next());
+
+        ASSERT_NOT_OK(engine->moveCollection(&opCtx, "a.missing", true));
+    }
+}
+
+TEST(KVDBEngineTest, CatalogSnapshotSurvivesRestart) {
+    std::unique_ptr<KVHarnessHelper> helper(KVHarnessHelper::create());
+    KVEngine* engine = helper->getEngine();
+
+    std::string ns = "a.b";
+    RecordId firstId;
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        {
+            WriteUnitOfWork uow(&opCtx);
+            ASSERT_OK(engine->createRecordStore(&opCtx, ns, ns, CollectionOptions()));
+            uow.commit();
+        }
+
+        std::unique_ptr<RecordStore> rs =
+            engine->getRecordStore(&opCtx, ns, ns, CollectionOptions());
+        WriteUnitOfWork uow(&opCtx);
+        StatusWith<RecordId> res = rs->insertRecord(&opCtx, "abc", 4, false);
+        ASSERT_OK(res.getStatus());
+        firstId = res.getValue();
+        uow.commit();
+    }
+
+    // The clean shutdown writes the catalog snapshot that the restart loads.
+    engine = helper->restartEngine();
+
+    {
+        OperationContextNoop opCtx(engine->newRecoveryUnit());
+        ASSERT_TRUE(engine->hasIdent(&opCtx, ns));
+
+        std::unique_ptr<RecordStore> rs =
+            engine->getRecordStore(&opCtx, ns, ns, CollectionOptions());
+        WriteUnitOfWork uow(&opCtx);
+        StatusWith<RecordId> res = rs->insertRecord(&opCtx, "def", 4, false);
+        ASSERT_OK(res.getStatus());
+        ASSERT_GT(res.getValue(), firstId);
+        uow.commit();
+    }
+}
+
+TEST(KVDBEngineTest, MclassPolicies) {
+    namespace moe = mongo::optionenvironment;
+    ON_BLOCK_EXIT([] { kvdbGlobalOptions = KVDBGlobalOptions(); });
+
+    moe::Environment unknown;
+    ASSERT_OK(unknown.set(moe::Key("storage.hse.mclassPolicies"),
+                          moe::Value(std::string("IdxKvs=capacity_only"))));
+    ASSERT_NOT_OK(kvdbGlobalOptions.store(unknown, {}));
+
+    // Every KVS the engine opens accepts a policy.
+    for (const auto& name : KVDBEngine::mclassPolicyKvsNames()) {
+        moe::Environment one;
+        ASSERT_OK(one.set(moe::Key("storage.hse.mclassPolicies"),
+                          moe::Value(name + "=capacity_only")));
+        ASSERT_OK(kvdbGlobalOptions.store(one, {}));
+        ASSERT_EQ("capacity_only", kvdbGlobalOptions.getMclassPolicy(name));
+    }
+
+    kvdbGlobalOptions = KVDBGlobalOptions();
+    moe::Environment valid;
+    ASSERT_OK(valid.set(moe::Key("storage.hse.mclassPolicies"),
+                        moe::Value(std::string("StdIdxKvs=capacity_only"))));
+    ASSERT_OK(kvdbGlobalOptions.store(valid, {}));
+    ASSERT_EQ("capacity_only", kvdbGlobalOptions.getMclassPolicy("StdIdxKvs"));
+    ASSERT_EQ("", kvdbGlobalOptions.getMclassPolicy("MainKvs"));
+
+    // The engine opens its KVSes with the policy applied.
+    std::unique_ptr<KVHarnessHelper> helper(KVHarnessHelper::create());
+    KVDBEngine* engine = checked_cast<KVDBEngine*>(helper->getEngine());
+
+    OperationContextNoop opCtx(engine->newRecoveryUnit());
+    ASSERT_OK(engine->createRecordStore(&opCtx, "a.b", "a.b", CollectionOptions()));
+}
 }
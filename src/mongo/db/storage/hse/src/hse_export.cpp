@@ -0,0 +1,287 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <fstream>
+#include <memory>
+
+#include "mongo/base/data_view.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/scopeguard.h"
+
+#include "hse_clienttxn.h"
+#include "hse_export.h"
+#include "hse_kvscursor.h"
+#include "hse_util.h"
+
+using hse::ClientTxn;
+using hse::KVDBData;
+using hse::KvsCursor;
+using hse::KvsCursorBatch;
+
+namespace mongo {
+
+namespace {
+const char kMagic[8] = {'H', 'S', 'E', 'E', 'X', 'P', 'R', 'T'};
+const uint32_t kVersion = 2;
+const uint8_t kSectionTag = 1;
+const uint8_t kEndTag = 0;
+
+// Large enough that the file is written and read at media bandwidth. A restore loads one
+// block per transaction.
+const size_t kBlockBytes = 4 << 20;
+const size_t kReadBatchKeys = 256;
+
+void appendU32(std::string* buf, uint32_t v) {
+    char b[sizeof(v)];
+    DataView(b).write<BigEndian<uint32_t>>(v);
+    buf->append(b, sizeof(b));
+}
+
+void writeU32(std::ostream& out, uint32_t v) {
+    char b[sizeof(v)];
+    DataView(b).write<BigEndian<uint32_t>>(v);
+    out.write(b, sizeof(b));
+}
+
+bool readU32(std::istream& in, uint32_t* v) {
+    char b[sizeof(*v)];
+    if (!in.read(b, sizeof(b)))
+        return false;
+    *v = ConstDataView(b).read<BigEndian<uint32_t>>();
+    return true;
+}
+
+void writeBlock(std::ostream& out, const std::string& pairs, uint32_t count) {
+    writeU32(out, sizeof(count) + pairs.size());
+    writeU32(out, count);
+    out.write(pairs.data(), pairs.size());
+}
+
+Status corrupt(const std::string& path, StringData what) {
+    return {ErrorCodes::FailedToParse,
+            str::stream() << "export file " << path << " is not valid: " << what};
+}
+}  // namespace
+
+Status KVDBExport::write(KVDB& db,
+                         const std::vector<Kvs>& kvses,
+                         const std::string& path,
+                         const std::function<Status()>& checkForInterrupt,
+                         BSONObjBuilder* stats) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return {ErrorCodes::FileOpenFailed, str::stream() << "cannot create " << path};
+
+    out.write(kMagic, sizeof(kMagic));
+    writeU32(out, kVersion);
+
+    // Cursors bound to one transaction all read the same snapshot of the KVDB.
+    ClientTxn txn(db);
+    auto st = txn.begin();
+    if (!st.ok())
+        return hseToMongoStatus(st);
+    ON_BLOCK_EXIT([&] { txn.abort(); });
+
+    KvsCursorBatch batch;
+    std::string pairs;
+    pairs.reserve(kBlockBytes + HSE_KVS_KEY_LEN_MAX + HSE_KVS_VALUE_LEN_MAX);
+
+    for (auto& kvs : kvses) {
+        const uint16_t nameLen = kvs.name.size();
+        char b[sizeof(nameLen)];
+        DataView(b).write<BigEndian<uint16_t>>(nameLen);
+        out.put(kSectionTag);
+        out.write(b, sizeof(b));
+        out.write(kvs.name.data(), nameLen);
+
+        KVDBData prefix{(uint8_t*)"", 0};
+        std::unique_ptr<KvsCursor> cursor(db.kvs_cursor_create(kvs.handle, prefix, true, &txn));
+
+        long long keys = 0;
+        long long bytes = 0;
+        uint32_t count = 0;
+        bool eof = false;
+
+        pairs.clear();
+        while (!eof) {
+            st = cursor->readBatch(batch, kReadBatchKeys, eof);
+            if (!st.ok())
+                return hseToMongoStatus(st);
+
+            KVDBData key;
+            KVDBData val;
+            while (!batch.empty()) {
+                batch.pop(key, val);
+                const unsigned int flags = kvs.putFlags ? kvs.putFlags(key) : 0;
+                invariant(flags <= UINT8_MAX);
+                appendU32(&pairs, key.len());
+                appendU32(&pairs, val.len());
+                pairs.push_back(static_cast<char>(flags));
+                pairs.append((const char*)key.data(), key.len());
+                pairs.append((const char*)val.data(), val.len());
+                count++;
+                keys++;
+                bytes += key.len() + val.len();
+
+                if (pairs.size() >= kBlockBytes) {
+                    writeBlock(out, pairs, count);
+                    pairs.clear();
+                    count = 0;
+
+                    Status status = checkForInterrupt();
+                    if (!status.isOK())
+                        return status;
+                }
+            }
+        }
+
+        if (count)
+            writeBlock(out, pairs, count);
+        writeU32(out, 0);
+
+        if (!out)
+            return {ErrorCodes::FileStreamFailed, str::stream() << "cannot write " << path};
+
+        stats->append(kvs.name, BSON("keys" << keys << "bytes" << bytes));
+        LOG(1) << "HSE: exported " << keys << " keys from " << kvs.name;
+    }
+
+    out.put(kEndTag);
+    out.close();
+    if (!out)
+        return {ErrorCodes::FileStreamFailed, str::stream() << "cannot write " << path};
+
+    return Status::OK();
+}
+
+Status KVDBExport::load(KVDB& db,
+                        const std::string& path,
+                        const std::function<StatusWith<KVSHandle>(const std::string&)>& openKvs,
+                        BSONObjBuilder* stats) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return {ErrorCodes::FileOpenFailed, str::stream() << "cannot open " << path};
+
+    char magic[sizeof(kMagic)];
+    uint32_t version;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) ||
+        !readU32(in, &version))
+        return corrupt(path, "bad header");
+    if (version != kVersion)
+        return corrupt(path, str::stream() << "unsupported version " << version);
+
+    std::vector<uint8_t> block;
+
+    for (;;) {
+        int tag = in.get();
+        if (tag == kEndTag)
+            break;
+        if (tag != kSectionTag)
+            return corrupt(path, "bad section");
+
+        char b[sizeof(uint16_t)];
+        if (!in.read(b, sizeof(b)))
+            return corrupt(path, "truncated");
+        std::string name(ConstDataView(b).read<BigEndian<uint16_t>>(), '\0');
+        if (!in.read(&name[0], name.size()))
+            return corrupt(path, "truncated");
+
+        auto handle = openKvs(name);
+        if (!handle.isOK())
+            return handle.getStatus();
+
+        long long keys = 0;
+        long long bytes = 0;
+        uint32_t len;
+
+        while (readU32(in, &len) && len) {
+            uint32_t count;
+            if (len < sizeof(count) || !readU32(in, &count))
+                return corrupt(path, "bad block");
+
+            block.resize(len - sizeof(count));
+            if (!in.read((char*)block.data(), block.size()))
+                return corrupt(path, "truncated");
+
+            ClientTxn txn(db);
+            auto st = txn.begin();
+            if (!st.ok())
+                return hseToMongoStatus(st);
+
+            const uint8_t* p = block.data();
+            const uint8_t* end = p + block.size();
+            for (uint32_t i = 0; i < count; i++) {
+                if (end - p < 9) {
+                    txn.abort();
+                    return corrupt(path, "bad block");
+                }
+                uint32_t klen = ConstDataView((const char*)p).read<BigEndian<uint32_t>>();
+                uint32_t vlen = ConstDataView((const char*)p + 4).read<BigEndian<uint32_t>>();
+                unsigned int flags = p[8];
+                p += 9;
+                if ((size_t)(end - p) < (size_t)klen + vlen) {
+                    txn.abort();
+                    return corrupt(path, "bad block");
+                }
+
+                KVDBData key{p, klen};
+                KVDBData val{p + klen, vlen};
+                st = db.kvs_put(handle.getValue(), &txn, key, val, flags);
+                if (!st.ok()) {
+                    txn.abort();
+                    return hseToMongoStatus(st);
+                }
+                p += klen + vlen;
+                bytes += klen + vlen;
+            }
+            keys += count;
+
+            st = txn.commit();
+            if (!st.ok())
+                return hseToMongoStatus(st);
+        }
+        if (!in)
+            return corrupt(path, "truncated");
+
+        stats->append(name, BSON("keys" << keys << "bytes" << bytes));
+        log() << "HSE: restored " << keys << " keys into " << name;
+    }
+
+    return hseToMongoStatus(db.kvdb_sync());
+}
+}  // namespace mongo
@@ -0,0 +1,90 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/base/status_with.h"
+#include "mongo/bson/bsonobjbuilder.h"
+
+#include "hse.h"
+
+using hse::KVDB;
+using hse::KVDBData;
+using hse::KVSHandle;
+
+namespace mongo {
+
+/**
+ * Raw export of connector KVSes to a local file, and the matching bulk load.
+ *
+ * The file is a header followed by one section per KVS. A section is a run of blocks
+ * of length-prefixed key/value pairs, ended by an empty block:
+ *
+ *   file    := "HSEEXPRT" version:u32 section* 0:u8
+ *   section := 1:u8 nameLen:u16 name block* 0:u32
+ *   block   := len:u32 count:u32 (klen:u32 vlen:u32 flags:u8 key val){count}
+ *
+ * Integers are big endian, len counts the bytes after itself. flags are the HSE_KVS_PUT_*
+ * flags the pair is loaded with, so that values are compressed as the collection asked.
+ */
+class KVDBExport {
+public:
+    struct Kvs {
+        std::string name;
+        KVSHandle handle;
+        // Put flags of a key, none if empty.
+        std::function<unsigned int(const KVDBData& key)> putFlags;
+    };
+
+    // Writes the KVSes as seen by a single transaction snapshot. Appends per KVS key and
+    // byte counts to stats. checkForInterrupt is called between blocks, the write stops
+    // with its error.
+    static Status write(KVDB& db,
+                        const std::vector<Kvs>& kvses,
+                        const std::string& path,
+                        const std::function<Status()>& checkForInterrupt,
+                        BSONObjBuilder* stats);
+
+    // Loads a file written by write(). openKvs returns the handle of a KVS by name, making
+    // the KVS if needed. Keys are put as they come, without reading the KVSes first.
+    static Status load(KVDB& db,
+                       const std::string& path,
+                       const std::function<StatusWith<KVSHandle>(const std::string&)>& openKvs,
+                       BSONObjBuilder* stats);
+};
+}  // namespace mongo
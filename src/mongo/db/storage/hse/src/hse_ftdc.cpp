@@ -0,0 +1,91 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "hse_ftdc.h"
+
+#include "mongo/bson/bsonobjbuilder.h"
+
+#include "hse_engine.h"
+#include "hse_idx_filter.h"
+#include "hse_stats.h"
+
+namespace mongo {
+
+using hse_stat::KVDBStat;
+using hse_stat::gHseStatAppBytesList;
+using hse_stat::gHseStatCounterList;
+using hse_stat::gHseStatLatencyList;
+using hse_stat::gHseStatRateList;
+
+namespace {
+
+void appendSummaries(BSONObjBuilder& bob, StringData name, const vector<KVDBStat*>& statList) {
+    BSONObjBuilder subBob(bob.subobjStart(name));
+
+    for (auto st : statList) {
+        st->appendSummaryTo(subBob);
+    }
+}
+
+}  // namespace
+
+KVDBFTDCCollector::KVDBFTDCCollector(KVDBEngine& engine) : _engine(engine) {}
+
+void KVDBFTDCCollector::collect(OperationContext* txn, BSONObjBuilder& builder) {
+    appendSummaries(builder, "appBytes", gHseStatAppBytesList);
+    builder.append("indexFilter", KVDBIdxFilter::getGlobalStats());
+    {
+        BSONObjBuilder mclassBob(builder.subobjStart("mediaClasses"));
+        _engine.appendMclassStats(&mclassBob);
+    }
+    builder.append("identDrops", _engine.getIdentDropStats());
+    builder.append("compaction", _engine.getCompactStatus());
+    builder.append("sharedReadViews", _engine.getSharedReadViewStats());
+
+    // hseEnableMetrics is only read at startup, so this does not change the schema either.
+    if (KVDBStat::isStatsEnabledGlobally()) {
+        appendSummaries(builder, "counters", gHseStatCounterList);
+        appendSummaries(builder, "latencies", gHseStatLatencyList);
+        appendSummaries(builder, "rates", gHseStatRateList);
+    }
+}
+
+std::string KVDBFTDCCollector::name() const {
+    return "hse";
+}
+
+}  // namespace mongo
@@ -0,0 +1,61 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include "mongo/db/ftdc/collector.h"
+
+namespace mongo {
+
+class KVDBEngine;
+
+/**
+ * Samples the hse connector and KVDB statistics into FTDC once per collection period.
+ *
+ * Unlike the "hse" serverStatus section the set of fields is fixed for the life of mongod,
+ * so the samples compress well. Cumulative counters are stored as they are and FTDC deltas
+ * them between samples.
+ */
+class KVDBFTDCCollector : public FTDCCollectorInterface {
+public:
+    KVDBFTDCCollector(KVDBEngine& engine);
+
+    void collect(OperationContext* txn, BSONObjBuilder& builder) override;
+
+    std::string name() const override;
+
+private:
+    KVDBEngine& _engine;
+};
+
+}  // namespace mongo
@@ -35,10 +35,15 @@
 
 #include "mongo/platform/basic.h"
 
+#include <algorithm>
+#include <sstream>
+
 #include "mongo/base/status.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/options_parser/constraints.h"
 
+#include "hse_engine.h"
 #include "hse_global_options.h"
 
 
@@ -63,6 +68,21 @@ const std::string KVDBGlobalOptions::kDefaultPmemPathStr{};
 // Default config path is empty.
 const std::string KVDBGlobalOptions::kDefaultConfigPathStr{};
 
+// Standard index existence filters are disabled by default.
+const int KVDBGlobalOptions::kDefaultIndexFilterMaxMB = 0;
+
+// Every KVS uses the KVDB default media class policy.
+const std::string KVDBGlobalOptions::kDefaultMclassPoliciesStr{};
+
+// Default is not to restore an export file.
+const std::string KVDBGlobalOptions::kDefaultRestoreFromStr{};
+
+// Every unit of work begins its own transaction by default.
+const bool KVDBGlobalOptions::kDefaultSharedReadViews = false;
+
+// The catalog snapshot is rewritten every minute, and at clean shutdown.
+const int KVDBGlobalOptions::kDefaultCatalogSnapshotSecs = 60;
+
 
 KVDBGlobalOptions kvdbGlobalOptions;
 
@@ -99,6 +119,53 @@ const std::string pmemPathOptStr = modName + "PmemPath";
 const std::string configPathCfgStr = cfgStrPrefix + "configPath";
 const std::string configPathOptStr = modName + "ConfigPath";
 
+// Memory budget shared by all standard index existence filters
+const std::string indexFilterMaxMBCfgStr = cfgStrPrefix + "indexFilterMaxMB";
+const std::string indexFilterMaxMBOptStr = modName + "IndexFilterMaxMB";
+
+// Per-KVS media class policies
+const std::string mclassPoliciesCfgStr = cfgStrPrefix + "mclassPolicies";
+const std::string mclassPoliciesOptStr = modName + "MclassPolicies";
+
+// hseExport file loaded into a new KVDB at startup
+const std::string restoreFromCfgStr = cfgStrPrefix + "restoreFrom";
+const std::string restoreFromOptStr = modName + "RestoreFrom";
+
+// Units of work read through a shared view until they write
+const std::string sharedReadViewsCfgStr = cfgStrPrefix + "sharedReadViews";
+const std::string sharedReadViewsOptStr = modName + "SharedReadViews";
+
+// Period of the catalog snapshot that saves startup from scanning every KVS
+const std::string catalogSnapshotSecsCfgStr = cfgStrPrefix + "catalogSnapshotSecs";
+const std::string catalogSnapshotSecsOptStr = modName + "CatalogSnapshotSecs";
+
+// Parses "<kvs>=<policy>[,<kvs>=<policy>...]".
+Status parseMclassPolicies(const std::string& str, std::map<std::string, std::string>* policies) {
+    std::stringstream ss(str);
+    std::string item;
+
+    while (std::getline(ss, item, ',')) {
+        auto eq = item.find('=');
+        std::string kvs = item.substr(0, eq);
+        if (eq == std::string::npos || eq + 1 == item.size()) {
+            return {ErrorCodes::BadValue,
+                    str::stream() << mclassPoliciesCfgStr << " entry '" << item
+                                  << "' is not of the form <kvs>=<policy>"};
+        }
+        const auto& names = KVDBEngine::mclassPolicyKvsNames();
+        if (std::find(names.begin(), names.end(), kvs) == names.end()) {
+            return {ErrorCodes::BadValue,
+                    str::stream() << mclassPoliciesCfgStr << " names unknown KVS '" << kvs
+                                  << "'"};
+        }
+
+        (*policies)[kvs] = item.substr(eq + 1);
+    }
+
+    return Status::OK();
+}
+
+
 }  // namespace
 
 Status KVDBGlobalOptions::add(moe::OptionSection* options) {
@@ -140,6 +207,43 @@ Status KVDBGlobalOptions::add(moe::OptionSection* options) {
         .addOptionChaining(configPathCfgStr, configPathOptStr, moe::String, "path for config file")
         .setDefault(moe::Value(kDefaultConfigPathStr));
 
+    kvdbOptions
+        .addOptionChaining(indexFilterMaxMBCfgStr,
+                           indexFilterMaxMBOptStr,
+                           moe::Int,
+                           "memory budget in MB for standard index existence filters, 0 disables")
+        .validRange(0, 1024 * 1024)
+        .setDefault(moe::Value(kDefaultIndexFilterMaxMB));
+
+    kvdbOptions
+        .addOptionChaining(mclassPoliciesCfgStr,
+                           mclassPoliciesOptStr,
+                           moe::String,
+                           "media class policy per KVS, e.g. OplogKvs=staging_only,"
+                           "LargeKvs=capacity_only")
+        .setDefault(moe::Value(kDefaultMclassPoliciesStr));
+
+    kvdbOptions
+        .addOptionChaining(restoreFromCfgStr,
+                           restoreFromOptStr,
+                           moe::String,
+                           "hseExport file to load into a new KVDB at startup")
+        .setDefault(moe::Value(kDefaultRestoreFromStr));
+
+    kvdbOptions.addOptionChaining(sharedReadViewsCfgStr,
+                                  sharedReadViewsOptStr,
+                                  moe::Switch,
+                                  "read through a shared view of the latest committed state "
+                                  "until the first write");
+
+    kvdbOptions
+        .addOptionChaining(catalogSnapshotSecsCfgStr,
+                           catalogSnapshotSecsOptStr,
+                           moe::Int,
+                           "seconds between catalog snapshots, 0 writes one at clean shutdown only")
+        .validRange(0, 24 * 60 * 60)
+        .setDefault(moe::Value(kDefaultCatalogSnapshotSecs));
+
     return options->addSection(kvdbOptions);
 }
 
@@ -188,6 +292,35 @@ Status KVDBGlobalOptions::store(const moe::Environment& params,
         log() << "Config path str: " << kvdbGlobalOptions._configPathStr;
     }
 
+    if (params.count(indexFilterMaxMBCfgStr)) {
+        kvdbGlobalOptions._indexFilterMaxMB = params[indexFilterMaxMBCfgStr].as<int>();
+        log() << "Index filter max MB: " << kvdbGlobalOptions._indexFilterMaxMB;
+    }
+
+    if (params.count(mclassPoliciesCfgStr)) {
+        kvdbGlobalOptions._mclassPoliciesStr = params[mclassPoliciesCfgStr].as<std::string>();
+        Status s = parseMclassPolicies(kvdbGlobalOptions._mclassPoliciesStr,
+                                       &kvdbGlobalOptions._mclassPolicies);
+        if (!s.isOK())
+            return s;
+        log() << "Media class policies: " << kvdbGlobalOptions._mclassPoliciesStr;
+    }
+
+    if (params.count(restoreFromCfgStr)) {
+        kvdbGlobalOptions._restoreFromStr = params[restoreFromCfgStr].as<std::string>();
+        log() << "Restore from: " << kvdbGlobalOptions._restoreFromStr;
+    }
+
+    if (params.count(sharedReadViewsCfgStr)) {
+        kvdbGlobalOptions._sharedReadViews = params[sharedReadViewsCfgStr].as<bool>();
+        log() << "Shared read views: " << kvdbGlobalOptions._sharedReadViews;
+    }
+
+    if (params.count(catalogSnapshotSecsCfgStr)) {
+        kvdbGlobalOptions._catalogSnapshotSecs = params[catalogSnapshotSecsCfgStr].as<int>();
+        log() << "Catalog snapshot secs: " << kvdbGlobalOptions._catalogSnapshotSecs;
+    }
+
     return Status::OK();
 }
 
@@ -223,5 +356,30 @@ std::string KVDBGlobalOptions::getConfigPathStr() const {
     return _configPathStr;
 }
 
+int KVDBGlobalOptions::getIndexFilterMaxMB() const {
+    return _indexFilterMaxMB;
+}
+
+std::string KVDBGlobalOptions::getMclassPoliciesStr() const {
+    return _mclassPoliciesStr;
+}
+
+std::string KVDBGlobalOptions::getRestoreFromStr() const {
+    return _restoreFromStr;
+}
+
+bool KVDBGlobalOptions::getSharedReadViews() const {
+    return _sharedReadViews;
+}
+
+int KVDBGlobalOptions::getCatalogSnapshotSecs() const {
+    return _catalogSnapshotSecs;
+}
+
+std::string KVDBGlobalOptions::getMclassPolicy(const std::string& kvsName) const {
+    auto it = _mclassPolicies.find(kvsName);
+    return it == _mclassPolicies.end() ? std::string() : it->second;
+}
+
 
 }  // namespace mongo
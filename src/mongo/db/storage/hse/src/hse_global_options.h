@@ -33,6 +33,9 @@
  */
 #pragma once
 
+#include <map>
+#include <string>
+
 #include "mongo/util/options_parser/startup_option_init.h"
 #include "mongo/util/options_parser/startup_options.h"
 
@@ -50,7 +53,12 @@ public:
           _crashSafeCounters{false},
           _stagingPathStr{kDefaultStagingPathStr},
           _pmemPathStr{kDefaultPmemPathStr},
-          _configPathStr{kDefaultConfigPathStr} {}
+          _configPathStr{kDefaultConfigPathStr},
+          _indexFilterMaxMB{kDefaultIndexFilterMaxMB},
+          _mclassPoliciesStr{kDefaultMclassPoliciesStr},
+          _restoreFromStr{kDefaultRestoreFromStr},
+          _sharedReadViews{kDefaultSharedReadViews},
+          _catalogSnapshotSecs{kDefaultCatalogSnapshotSecs} {}
 
     Status add(moe::OptionSection* options);
     Status store(const moe::Environment& params, const std::vector<std::string>& args);
@@ -63,6 +71,13 @@ public:
     std::string getStagingPathStr() const;
     std::string getPmemPathStr() const;
     std::string getConfigPathStr() const;
+    int getIndexFilterMaxMB() const;
+    std::string getMclassPoliciesStr() const;
+    // Media class policy configured for the named KVS, empty if none.
+    std::string getMclassPolicy(const std::string& kvsName) const;
+    std::string getRestoreFromStr() const;
+    bool getSharedReadViews() const;
+    int getCatalogSnapshotSecs() const;
 
 private:
     static const bool kDefaultRestEnabled;
@@ -72,6 +87,11 @@ private:
     static const std::string kDefaultStagingPathStr;
     static const std::string kDefaultPmemPathStr;
     static const std::string kDefaultConfigPathStr;
+    static const int kDefaultIndexFilterMaxMB;
+    static const std::string kDefaultMclassPoliciesStr;
+    static const std::string kDefaultRestoreFromStr;
+    static const bool kDefaultSharedReadViews;
+    static const int kDefaultCatalogSnapshotSecs;
 
     int _forceLag;
 
@@ -83,6 +103,12 @@ private:
     std::string _stagingPathStr;
     std::string _pmemPathStr;
     std::string _configPathStr;
+    int _indexFilterMaxMB;
+    std::string _mclassPoliciesStr;
+    std::map<std::string, std::string> _mclassPolicies;
+    std::string _restoreFromStr;
+    bool _sharedReadViews;
+    int _catalogSnapshotSecs;
 };
 
 extern KVDBGlobalOptions kvdbGlobalOptions;
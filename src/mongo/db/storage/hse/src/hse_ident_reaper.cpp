@@ -0,0 +1,311 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/client.h"
+#include "mongo/util/log.h"
+
+#include "hse_ident_reaper.h"
+#include "hse_kvscursor.h"
+#include "hse_util.h"
+
+using hse::encodePrefix;
+using hse::KVDB_prefix;
+using hse::KVDBData;
+using hse::KvsCursor;
+
+namespace mongo {
+
+namespace {
+const std::string kPendingDropPrefix = KVDB_prefix + "pendingdrop-";
+const std::string kPendingMoveTag = "move-";
+}  // namespace
+
+/* Start KVDBIdentReaper */
+
+// Pause between prefix deletes, so that a burst of drops does not crowd out the foreground.
+const int KVDBIdentReaper::kPauseMillis = 100;
+
+KVDBIdentReaper::KVDBIdentReaper(hse::KVDB& db,
+                                 KVSHandle metaKvs,
+                                 std::map<std::string, KVSHandle> kvses)
+    : BackgroundJob(false /* deleteSelf */), _db(db), _metaKvs(metaKvs), _kvses(kvses) {}
+
+std::string KVDBIdentReaper::_recordKey(uint32_t prefix) {
+    return kPendingDropPrefix + encodePrefix(prefix);
+}
+
+std::string KVDBIdentReaper::_moveRecordKey(uint32_t prefix) {
+    return kPendingDropPrefix + kPendingMoveTag + encodePrefix(prefix);
+}
+
+uint32_t KVDBIdentReaper::loadPending() {
+    KVDBData kPrefix{(uint8_t*)kPendingDropPrefix.c_str(), kPendingDropPrefix.size()};
+    KvsCursor* cursor = _db.kvs_cursor_create(_metaKvs, kPrefix, true, 0);
+    invariantHse(cursor != 0);
+
+    uint32_t maxPrefix = 0;
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    while (true) {
+        auto st = cursor->read(key, val, eof);
+        invariantHseSt(st);
+        if (eof)
+            break;
+
+        BSONObj record(reinterpret_cast<const char*>(val.data()));
+        PendingDrop drop{record["ident"].String(),
+                         static_cast<uint32_t>(record["prefix"].numberLong()),
+                         {},
+                         std::string((const char*)key.data(), key.len())};
+        for (auto& elem : record["kvses"].Array())
+            drop.kvsNames.push_back(elem.String());
+
+        maxPrefix = std::max(maxPrefix, drop.prefix);
+        _pending.push_back(std::move(drop));
+    }
+    delete cursor;
+
+    if (!_pending.empty())
+        log() << "HSE: resuming " << _pending.size() << " pending ident drops";
+
+    return maxPrefix;
+}
+
+Status KVDBIdentReaper::_putRecord(ClientTxn* txn,
+                                   const std::string& keyStr,
+                                   const PendingDrop& drop) {
+    BSONObjBuilder bob;
+    bob.append("ident", drop.ident);
+    bob.append("prefix", static_cast<long long>(drop.prefix));
+    bob.append("kvses", drop.kvsNames);
+    BSONObj record = bob.obj();
+
+    KVDBData key{keyStr};
+    KVDBData val{(uint8_t*)record.objdata(), (unsigned long)record.objsize()};
+
+    auto st =
+        txn ? _db.kvs_put(_metaKvs, txn, key, val, 0) : _db.kvs_sub_txn_put(_metaKvs, key, val);
+    return hseToMongoStatus(st);
+}
+
+void KVDBIdentReaper::_queue(PendingDrop drop) {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _pending.push_back(std::move(drop));
+    }
+    _cv.notify_all();
+}
+
+Status KVDBIdentReaper::addDrop(const std::string& ident,
+                                uint32_t prefix,
+                                const std::vector<std::string>& kvsNames) {
+    PendingDrop drop{ident, prefix, kvsNames, _recordKey(prefix)};
+    Status status = _putRecord(nullptr, drop.key, drop);
+    if (!status.isOK())
+        return status;
+
+    LOG(1) << "HSE: queued drop of ident " << ident;
+    _queue(std::move(drop));
+
+    return Status::OK();
+}
+
+Status KVDBIdentReaper::recordMove(ClientTxn* txn,
+                                   const std::string& ident,
+                                   uint32_t prefix,
+                                   const std::vector<std::string>& kvsNames) {
+    return _putRecord(txn, _moveRecordKey(prefix), {ident, prefix, kvsNames, {}});
+}
+
+Status KVDBIdentReaper::clearMove(ClientTxn* txn, uint32_t prefix) {
+    const std::string keyStr = _moveRecordKey(prefix);
+    return hseToMongoStatus(_db.kvs_delete(_metaKvs, txn, KVDBData{keyStr}));
+}
+
+void KVDBIdentReaper::queueMove(const std::string& ident,
+                                uint32_t prefix,
+                                const std::vector<std::string>& kvsNames) {
+    LOG(1) << "HSE: queued delete of the keys ident " << ident << " moved out of";
+    _queue({ident, prefix, kvsNames, _moveRecordKey(prefix)});
+}
+
+bool KVDBIdentReaper::isPending(uint32_t prefix) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    for (auto& drop : _pending) {
+        if (drop.prefix == prefix)
+            return true;
+    }
+    return false;
+}
+
+std::string KVDBIdentReaper::name() const {
+    return "KVDBIdentReaper";
+}
+
+hse::Status KVDBIdentReaper::_reap(const PendingDrop& drop) {
+    const std::string prefixStr = encodePrefix(drop.prefix);
+    KVDBData prefix{prefixStr};
+
+    for (size_t i = 0; i < drop.kvsNames.size(); i++) {
+        auto it = _kvses.find(drop.kvsNames[i]);
+        if (it == _kvses.end()) {
+            warning() << "HSE: unknown KVS " << drop.kvsNames[i] << " in drop of ident "
+                      << drop.ident;
+            continue;
+        }
+
+        if (i > 0 && !_pause(kPauseMillis))
+            return hse::Status{ECANCELED};
+
+        auto st = _db.kvs_sub_txn_prefix_delete(it->second, prefix);
+        if (!st.ok())
+            return st;
+    }
+
+    return _db.kvs_sub_txn_delete(_metaKvs, KVDBData{drop.key});
+}
+
+bool KVDBIdentReaper::_pause(int millis) {
+    stdx::unique_lock<stdx::mutex> lk(_mutex);
+    _cv.wait_for(lk, stdx::chrono::milliseconds(millis), [&] { return _shuttingDown; });
+    return !_shuttingDown;
+}
+
+void KVDBIdentReaper::run() {
+    Client::initThread(name().c_str());
+
+    LOG(1) << "starting " << name() << " thread";
+
+    bool compactPending = false;
+
+    while (true) {
+        PendingDrop drop;
+
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _busy = false;
+            _cv.notify_all();
+
+            _cv.wait(lk, [&] {
+                return _shuttingDown || (!_paused && (compactPending || !_pending.empty()));
+            });
+            if (_shuttingDown)
+                break;
+            _busy = true;
+
+            if (_pending.empty()) {
+                lk.unlock();
+
+                // Prefix deletes leave tombstones, compaction gives the space back.
+                auto st = _db.kvdb_compact();
+                if (!st.ok())
+                    warning() << "HSE: compaction after ident drops failed: " << st.toString();
+                compactPending = false;
+                continue;
+            }
+
+            drop = _pending.front();
+        }
+
+        auto st = _reap(drop);
+        if (st.getErrno() == ECANCELED)
+            break;
+
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _pending.pop_front();
+            _busy = false;
+            _cv.notify_all();
+            if (st.ok()) {
+                _reaped++;
+            } else {
+                // Left recorded, so a restart retries it.
+                warning() << "HSE: drop of ident " << drop.ident << " failed: " << st.toString();
+            }
+        }
+
+        compactPending = true;
+        if (!_pause(kPauseMillis))
+            break;
+    }
+
+    LOG(1) << "stopping " << name() << " thread";
+}
+
+void KVDBIdentReaper::shutdown() {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _shuttingDown = true;
+    }
+    _cv.notify_all();
+    wait();
+}
+
+void KVDBIdentReaper::pause() {
+    stdx::unique_lock<stdx::mutex> lk(_mutex);
+    _paused = true;
+    _cv.wait(lk, [&] { return !_busy; });
+
+    auto st = _db.kvdb_compact_cancel();
+    if (!st.ok())
+        warning() << "HSE: cancelling compaction failed: " << st.toString();
+}
+
+void KVDBIdentReaper::resume() {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _paused = false;
+    }
+    _cv.notify_all();
+}
+
+BSONObj KVDBIdentReaper::getStats() const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    BSONObjBuilder bob;
+
+    bob.appendNumber("pending", static_cast<long long>(_pending.size()));
+    bob.appendNumber("reaped", _reaped);
+    return bob.obj();
+}
+
+/* End KVDBIdentReaper */
+}  // namespace mongo
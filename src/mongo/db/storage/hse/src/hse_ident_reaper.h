@@ -0,0 +1,154 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/util/background.h"
+
+#include "hse.h"
+#include "hse_clienttxn.h"
+
+using hse::ClientTxn;
+using hse::KVSHandle;
+
+namespace mongo {
+
+/**
+ * Deletes the data of dropped idents in the background. dropIdent() records each drop in
+ * MetaKvs and returns, and the reaper issues the prefix deletes one KVS at a time with a
+ * pause in between. Once no drop is left it asks HSE to compact. Drops still recorded at
+ * startup, because of a shutdown or crash, are resumed.
+ *
+ * The keys a collection leaves behind in the KVSes it moved out of are deleted the same way,
+ * under a record of their own so that the collection can still be dropped meanwhile.
+ */
+class KVDBIdentReaper : public BackgroundJob {
+    MONGO_DISALLOW_COPYING(KVDBIdentReaper);
+
+public:
+    static const int kPauseMillis;
+
+    KVDBIdentReaper(hse::KVDB& db, KVSHandle metaKvs, std::map<std::string, KVSHandle> kvses);
+
+    /**
+     * Queues the drops recorded before a restart. Returns the highest prefix among them, or
+     * 0, as those prefixes must not be handed out again until their data is gone.
+     */
+    uint32_t loadPending();
+
+    /**
+     * Records that the keys of 'prefix' in the named KVSes are to be deleted, and queues the
+     * deletes.
+     */
+    Status addDrop(const std::string& ident,
+                   uint32_t prefix,
+                   const std::vector<std::string>& kvsNames);
+
+    /**
+     * Records, in txn or on its own if txn is null, that the keys of 'prefix' in the named
+     * KVSes are to be deleted after a move of the collection. The deletes are queued by
+     * queueMove() once the record is committed.
+     */
+    Status recordMove(ClientTxn* txn,
+                      const std::string& ident,
+                      uint32_t prefix,
+                      const std::vector<std::string>& kvsNames);
+
+    // Deletes, in txn, the record of a move whose keys are to be kept after all.
+    Status clearMove(ClientTxn* txn, uint32_t prefix);
+
+    void queueMove(const std::string& ident,
+                   uint32_t prefix,
+                   const std::vector<std::string>& kvsNames);
+
+    // Whether deletes of the keys of 'prefix' are queued.
+    bool isPending(uint32_t prefix) const;
+
+    virtual std::string name() const;
+
+    virtual void run();
+
+    void shutdown();
+
+    /**
+     * Stops deleting and compacting, e.g. for a backup. Returns once the deletes of the
+     * drop under way are done and the compaction it asked for is cancelled. Drops are still
+     * recorded and queued while paused.
+     */
+    void pause();
+    void resume();
+
+    // Number of drops pending and reaped since startup.
+    BSONObj getStats() const;
+
+private:
+    struct PendingDrop {
+        std::string ident;
+        uint32_t prefix;
+        std::vector<std::string> kvsNames;
+        std::string key;  // of the record in MetaKvs
+    };
+
+    static std::string _recordKey(uint32_t prefix);
+    static std::string _moveRecordKey(uint32_t prefix);
+    Status _putRecord(ClientTxn* txn, const std::string& keyStr, const PendingDrop& drop);
+    void _queue(PendingDrop drop);
+    hse::Status _reap(const PendingDrop& drop);
+
+    // Waits for 'millis' or shutdown, returns false on shutdown.
+    bool _pause(int millis);
+
+    hse::KVDB& _db;
+    const KVSHandle _metaKvs;
+    const std::map<std::string, KVSHandle> _kvses;
+
+    // Protects the members below.
+    mutable stdx::mutex _mutex;
+    stdx::condition_variable _cv;
+    std::deque<PendingDrop> _pending;
+    bool _shuttingDown{false};
+    bool _paused{false};
+    bool _busy{false};  // deleting or asking for compaction
+    long long _reaped{0};
+};
+}  // namespace mongo
@@ -0,0 +1,334 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <algorithm>
+
+#include "mongo/base/data_view.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+
+#include "hse_exceptions.h"
+#include "hse_idx_dict.h"
+#include "hse_kvscursor.h"
+#include "hse_util.h"
+
+using hse::KVDB_prefix;
+using hse::KVDBData;
+using hse::KvsCursor;
+
+namespace mongo {
+
+namespace {
+const size_t kCodeLen = sizeof(uint32_t);
+
+// First entry lands mid-range so that values sorting before and after it both have
+// room. Appends step well clear of the previous entry, since indexes are mostly built
+// in key order, anything else takes the midpoint of its gap.
+const uint32_t kFirstCode = 0x80000000u;
+const uint32_t kAppendStep = 1u << 19;
+const uint32_t kMaxCode = 0xfffffffcu;
+const size_t kMaxEntries = 4096;
+
+// The KeyString kGreater discriminator, the only byte an index bound without a leading
+// field can start with that sorts after all field values.
+const uint8_t kKeyStringGreater = 254;
+
+// The stored form of a bound past every key, larger than any allocated or escape code.
+const char kHighBound[kCodeLen] = {'\xff', '\xff', '\xff', '\xff'};
+
+void appendCode(uint32_t code, std::string* out) {
+    char buf[kCodeLen];
+    DataView(buf).write<BigEndian<uint32_t>>(code);
+    out->append(buf, kCodeLen);
+}
+
+uint32_t readCode(const char* data) {
+    return ConstDataView(data).read<BigEndian<uint32_t>>();
+}
+
+bool leadLess(const std::string& a, StringData b) {
+    return StringData(a) < b;
+}
+
+// Reads every key under pfx through an unbound cursor, which sees all committed data.
+template <typename F>
+void scanPrefix(KVDB& db, KVSHandle& kvs, const std::string& pfx, F&& fn) {
+    KVDBData pKey{(const uint8_t*)pfx.data(), pfx.size()};
+    std::unique_ptr<KvsCursor> cursor(db.kvs_cursor_create(kvs, pKey, true, nullptr));
+
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+    while (true) {
+        auto st = cursor->read(key, val, eof);
+        invariantHseSt(st);
+        if (eof)
+            break;
+
+        fn(std::string((const char*)key.data(), key.len()),
+           std::string((const char*)val.data(), val.len()));
+    }
+}
+}  // namespace
+
+const char* const KVDBIdxKeyDict::kKeyFormatName = "prefixDict";
+
+KVDBIdxKeyDict::KVDBIdxKeyDict(KVDB& db,
+                               KVSHandle& idxKvs,
+                               const std::string& ident,
+                               Ordering order,
+                               KeyString::Version keyStringVersion)
+    : _db(db),
+      _idxKvs(idxKvs),
+      _entryPrefix(KVDB_prefix + "idxdict-" + ident + std::string(1, '\0')),
+      _frozenPrefix(KVDB_prefix + "idxdictfz-" + ident + std::string(1, '\0')),
+      _leadOrder(Ordering::make(BSON("" << order.get(0)))),
+      _keyStringVersion(keyStringVersion) {
+    _load();
+}
+
+size_t KVDBIdxKeyDict::leadLength(const BSONObj& key) const {
+    BSONElement first = key.firstElement();
+    if (first.eoo())
+        return 0;
+
+    BSONObjBuilder b;
+    b.appendAs(first, "");
+
+    // A lone inclusive field is its value bytes followed by the kEnd byte.
+    KeyString lead(_keyStringVersion, b.done(), _leadOrder);
+    return lead.getSize() - 1;
+}
+
+void KVDBIdxKeyDict::encode(
+    const char* ks, size_t len, size_t leadLen, bool mayExtend, std::string* out) {
+    if (leadLen == 0) {
+        // Only bounds of whole index scans lack a leading field, they sort before or
+        // after every key.
+        if (len && static_cast<uint8_t>(ks[0]) == kKeyStringGreater)
+            out->append(kHighBound, kCodeLen);
+        return;
+    }
+
+    invariantHse(leadLen < len);
+    const StringData lead(ks, leadLen);
+    auto snap = std::atomic_load(&_snap);
+
+    auto it = std::lower_bound(snap->leads.begin(), snap->leads.end(), lead, leadLess);
+    size_t pos = it - snap->leads.begin();
+
+    uint32_t code;
+    if (it != snap->leads.end() && StringData(*it) == lead) {
+        code = snap->codes[pos];
+    } else if (!mayExtend) {
+        code = (pos ? snap->codes[pos - 1] : 0) + 1;
+    } else {
+        code = _encodeMissing(lead);
+    }
+
+    appendCode(code, out);
+    if (code & 1)
+        out->append(ks, len);
+    else
+        out->append(ks + leadLen, len - leadLen);
+}
+
+void KVDBIdxKeyDict::decode(const char* data, size_t len, std::string* out) const {
+    invariantHse(len > kCodeLen);
+    uint32_t code = readCode(data);
+
+    if (!(code & 1)) {
+        auto snap = std::atomic_load(&_snap);
+        auto it = std::lower_bound(snap->codes.begin(), snap->codes.end(), code);
+        invariantHse(it != snap->codes.end() && *it == code);
+        out->append(snap->leads[it - snap->codes.begin()]);
+    }
+
+    out->append(data + kCodeLen, len - kCodeLen);
+}
+
+size_t KVDBIdxKeyDict::numEntries() const {
+    return std::atomic_load(&_snap)->leads.size();
+}
+
+uint32_t KVDBIdxKeyDict::_encodeMissing(StringData lead) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    auto snap = std::atomic_load(&_snap);
+
+    auto it = std::lower_bound(snap->leads.begin(), snap->leads.end(), lead, leadLess);
+    size_t pos = it - snap->leads.begin();
+    if (it != snap->leads.end() && StringData(*it) == lead)
+        return snap->codes[pos];
+
+    const bool gapFrozen = pos ? snap->frozen[pos - 1] : snap->frozenFirst;
+    uint32_t code;
+
+    if (!gapFrozen && snap->leads.size() < kMaxEntries && _allocate(*snap, pos, &code)) {
+        _persistEntry(code, lead);
+
+        auto next = std::make_shared<Snapshot>(*snap);
+        next->leads.insert(next->leads.begin() + pos, lead.toString());
+        next->codes.insert(next->codes.begin() + pos, code);
+        next->frozen.insert(next->frozen.begin() + pos, false);
+        std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(next)));
+        return code;
+    }
+
+    // Escape the value. The gap is frozen before any key in it is written.
+    const uint32_t pred = pos ? snap->codes[pos - 1] : 0;
+    if (!gapFrozen) {
+        _persistFrozen(pred);
+
+        auto next = std::make_shared<Snapshot>(*snap);
+        if (pos)
+            next->frozen[pos - 1] = true;
+        else
+            next->frozenFirst = true;
+        std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(next)));
+    }
+
+    return pred + 1;
+}
+
+bool KVDBIdxKeyDict::_allocate(const Snapshot& snap, size_t pos, uint32_t* code) const {
+    const size_t n = snap.codes.size();
+    if (!n) {
+        *code = kFirstCode;
+        return true;
+    }
+
+    // Codes in (lo, hi) are free, lo + 1 is the escape code of the predecessor.
+    const uint64_t lo = pos ? snap.codes[pos - 1] : 0;
+    const uint64_t hi = pos < n ? snap.codes[pos] : uint64_t(kMaxCode) + 2;
+
+    uint64_t c;
+    if (pos == n && lo + kAppendStep <= kMaxCode)
+        c = lo + kAppendStep;
+    else
+        c = ((lo + hi) / 2) & ~uint64_t(1);
+
+    if (c < lo + 2 || c + 2 > hi)
+        return false;
+
+    *code = static_cast<uint32_t>(c);
+    return true;
+}
+
+void KVDBIdxKeyDict::_persistEntry(uint32_t code, StringData lead) {
+    std::string key(_entryPrefix);
+    appendCode(code, &key);
+
+    auto st = _db.kvs_sub_txn_put(
+        _idxKvs, KVDBData{key}, KVDBData{(const uint8_t*)lead.rawData(), lead.size()});
+    invariantHseSt(st);
+}
+
+void KVDBIdxKeyDict::_persistFrozen(uint32_t code) {
+    std::string key(_frozenPrefix);
+    appendCode(code, &key);
+
+    auto st = _db.kvs_sub_txn_put(_idxKvs, KVDBData{key}, KVDBData{});
+    invariantHseSt(st);
+}
+
+void KVDBIdxKeyDict::_load() {
+    auto snap = std::make_shared<Snapshot>();
+
+    // Entry keys end in their big endian code, so they come back in code order.
+    scanPrefix(_db, _idxKvs, _entryPrefix, [&](const std::string& key, const std::string& val) {
+        invariantHse(key.size() == _entryPrefix.size() + kCodeLen);
+        snap->leads.push_back(val);
+        snap->codes.push_back(readCode(key.data() + _entryPrefix.size()));
+        snap->frozen.push_back(false);
+    });
+
+    scanPrefix(_db, _idxKvs, _frozenPrefix, [&](const std::string& key, const std::string& val) {
+        invariantHse(key.size() == _frozenPrefix.size() + kCodeLen);
+        uint32_t code = readCode(key.data() + _frozenPrefix.size());
+        if (!code) {
+            snap->frozenFirst = true;
+            return;
+        }
+
+        auto it = std::lower_bound(snap->codes.begin(), snap->codes.end(), code);
+        invariantHse(it != snap->codes.end() && *it == code);
+        snap->frozen[it - snap->codes.begin()] = true;
+    });
+
+    std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(snap)));
+}
+
+hse::Status KVDBIdxKeyDict::drop(KVDB& db, KVSHandle& idxKvs, const std::string& ident) {
+    std::vector<std::string> keys;
+    auto collect = [&](const std::string& key, const std::string& val) { keys.push_back(key); };
+
+    scanPrefix(db, idxKvs, KVDB_prefix + "idxdict-" + ident + std::string(1, '\0'), collect);
+    scanPrefix(db, idxKvs, KVDB_prefix + "idxdictfz-" + ident + std::string(1, '\0'), collect);
+
+    for (const auto& key : keys) {
+        auto st = db.kvs_sub_txn_delete(idxKvs, KVDBData{key});
+        if (!st.ok())
+            return st;
+    }
+
+    return hse::Status{};
+}
+
+StatusWith<bool> KVDBIdxKeyDict::parseIndexOptions(const BSONObj& options) {
+    bool useDict = false;
+
+    for (auto&& elem : options) {
+        if (elem.fieldNameStringData() != "keyFormat") {
+            return {ErrorCodes::InvalidOptions,
+                    str::stream() << "'" << elem.fieldNameStringData()
+                                  << "' is not a supported hse index option"};
+        }
+
+        if (elem.type() != String ||
+            (elem.valueStringData() != kKeyFormatName && elem.valueStringData() != "default")) {
+            return {ErrorCodes::InvalidOptions,
+                    str::stream() << "hse index keyFormat must be \"default\" or \""
+                                  << kKeyFormatName << "\""};
+        }
+
+        useDict = elem.valueStringData() == kKeyFormatName;
+    }
+
+    return useDict;
+}
+}  // namespace mongo
@@ -0,0 +1,134 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status_with.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/ordering.h"
+#include "mongo/db/storage/key_string.h"
+#include "mongo/stdx/mutex.h"
+
+#include "hse.h"
+
+using hse::KVDB;
+using hse::KVSHandle;
+
+namespace mongo {
+
+/**
+ * Order preserving dictionary over the leading field of a standard compound index.
+ *
+ * The stored form of a key replaces the KeyString bytes of its leading field with a
+ * 4 byte big endian code when that field value has a dictionary entry, so indexes
+ * whose leading field has few, long values (status strings, tenant ids) store fewer
+ * bytes per key. Entry codes are even and allocated in the order of the values they
+ * stand for, so stored keys sort exactly as the KeyStrings they encode and every key
+ * still decodes on its own.
+ *
+ * A value without an entry is stored whole behind the odd code following its
+ * predecessor entry. Once that has happened the gap between the two entries is frozen
+ * and no entry is ever allocated in it, which would reorder the escaped keys.
+ *
+ * Entries and frozen gaps are persisted outside of transactions before any key uses
+ * them and are never removed while the index exists.
+ */
+class KVDBIdxKeyDict {
+    MONGO_DISALLOW_COPYING(KVDBIdxKeyDict);
+
+public:
+    static const char* const kKeyFormatName;
+
+    KVDBIdxKeyDict(KVDB& db,
+                   KVSHandle& idxKvs,
+                   const std::string& ident,
+                   Ordering order,
+                   KeyString::Version keyStringVersion);
+
+    /**
+     * Returns the length of the KeyString encoding of the leading field of key, which
+     * must have its field names stripped. Zero for an empty key.
+     */
+    size_t leadLength(const BSONObj& key) const;
+
+    /**
+     * Appends the stored form of the KeyString ks to out. Only writers may extend the
+     * dictionary, readers encode absent values relative to their predecessor entry.
+     */
+    void encode(const char* ks, size_t len, size_t leadLen, bool mayExtend, std::string* out);
+
+    // Appends the KeyString bytes of the stored key data to out.
+    void decode(const char* data, size_t len, std::string* out) const;
+
+    size_t numEntries() const;
+
+    // Removes the persisted dictionary of an index that is being dropped.
+    static hse::Status drop(KVDB& db, KVSHandle& idxKvs, const std::string& ident);
+
+    // Validates the hse section of an index's storageEngine options.
+    static StatusWith<bool> parseIndexOptions(const BSONObj& options);
+
+private:
+    struct Snapshot {
+        std::vector<std::string> leads;
+        std::vector<uint32_t> codes;
+        std::vector<bool> frozen;  // gap after the entry at the same position
+        bool frozenFirst{false};   // gap before the first entry
+    };
+
+    // Returns the code of a value that had no entry, extending or freezing under _mutex.
+    uint32_t _encodeMissing(StringData lead);
+    bool _allocate(const Snapshot& snap, size_t pos, uint32_t* code) const;
+    void _persistEntry(uint32_t code, StringData lead);
+    void _persistFrozen(uint32_t code);
+    void _load();
+
+    KVDB& _db;
+    KVSHandle& _idxKvs;  // not owned
+    const std::string _entryPrefix;
+    const std::string _frozenPrefix;
+    const Ordering _leadOrder;
+    const KeyString::Version _keyStringVersion;
+
+    // Accessed with std::atomic_load/atomic_store, replaced as a whole by writers.
+    std::shared_ptr<const Snapshot> _snap;
+    stdx::mutex _mutex;
+};
+}  // namespace mongo
@@ -0,0 +1,517 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <algorithm>
+#include <third_party/murmurhash3/MurmurHash3.h>
+#include <vector>
+
+#include "mongo/db/client.h"
+#include "mongo/util/hex.h"
+#include "mongo/util/log.h"
+
+#include "hse_idx_dict.h"
+#include "hse_idx_filter.h"
+#include "hse_kvscursor.h"
+#include "hse_stats.h"
+#include "hse_util.h"
+
+using hse::KVDBData;
+using hse::KvsCursor;
+
+using hse_stat::_hseIdxFilterNegativeCounter;
+using hse_stat::_hseIdxFilterFalsePositiveCounter;
+
+namespace mongo {
+
+namespace {
+// Each key sets kProbesPerKey bits of a single 512 bit block, so that a probe
+// touches one cache line. 10 bits per key gives roughly a 1% false positive rate.
+const uint64_t kBitsPerKey = 10;
+const uint64_t kBlockBits = 512;
+const uint64_t kWordsPerBlock = kBlockBits / 64;
+const int kProbesPerKey = 6;
+
+// Smallest std index entry is the prefix, a KeyString and an 8 byte RecordId,
+// used to over-estimate the key count from the index size.
+const long long kMinEntryBytes = 16;
+const uint64_t kMinKeys = 4096;
+
+// A filter that has absorbed this many times its capacity is rebuilt.
+const uint64_t kOverloadFactor = 2;
+
+// Point lookups an index must see before it is worth a full scan to build a filter.
+const int kBuildAfterProbes = 64;
+const uint32_t kMaxBuildBackoff = 1024;
+
+const uint32_t kHashSeed = 0x4b564442;
+
+// Filters due a build, see KVDBIdxFilterBuilder.
+stdx::mutex gQueueMutex;
+std::vector<std::weak_ptr<KVDBIdxFilter>> gQueue;
+
+std::atomic<size_t> gMemBudget{0};
+std::atomic<size_t> gMemUsed{0};
+std::atomic<long long> gFilterCount{0};
+
+bool reserveMem(size_t bytes) {
+    size_t used = gMemUsed.load();
+    do {
+        if (used + bytes > gMemBudget.load())
+            return false;
+    } while (!gMemUsed.compare_exchange_weak(used, used + bytes));
+
+    return true;
+}
+
+void releaseMem(size_t bytes) {
+    gMemUsed.fetch_sub(bytes);
+}
+
+void hashKey(const char* key, size_t len, uint64_t hash[2]) {
+    MurmurHash3_x64_128(key, static_cast<int>(len), kHashSeed, hash);
+}
+}  // namespace
+
+/* Start KVDBBloomFilter */
+class KVDBBloomFilter {
+    MONGO_DISALLOW_COPYING(KVDBBloomFilter);
+
+public:
+    KVDBBloomFilter(uint64_t nKeys, uint64_t gen)
+        : _nBlocks(blocksFor(nKeys)),
+          _capacity(_nBlocks * kBlockBits / kBitsPerKey),
+          _gen(gen),
+          _words(new std::atomic<uint64_t>[_nBlocks * kWordsPerBlock]) {
+        for (uint64_t i = 0; i < _nBlocks * kWordsPerBlock; i++)
+            _words[i].store(0, std::memory_order_relaxed);
+        gFilterCount.fetch_add(1);
+    }
+
+    ~KVDBBloomFilter() {
+        releaseMem(getMemBytes());
+        gFilterCount.fetch_sub(1);
+    }
+
+    static uint64_t blocksFor(uint64_t nKeys) {
+        return std::max<uint64_t>(1, (nKeys * kBitsPerKey + kBlockBits - 1) / kBlockBits);
+    }
+
+    static size_t memBytesFor(uint64_t nKeys) {
+        return blocksFor(nKeys) * kBlockBits / 8;
+    }
+
+    void add(const uint64_t hash[2]) {
+        std::atomic<uint64_t>* block = _block(hash[0]);
+        uint64_t h = hash[1];
+
+        for (int i = 0; i < kProbesPerKey; i++, h >>= 9)
+            block[(h & 511) >> 6].fetch_or(1ULL << (h & 63), std::memory_order_relaxed);
+
+        _keys.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool mayContain(const uint64_t hash[2]) const {
+        const std::atomic<uint64_t>* block = _block(hash[0]);
+        uint64_t h = hash[1];
+
+        for (int i = 0; i < kProbesPerKey; i++, h >>= 9) {
+            if (!(block[(h & 511) >> 6].load(std::memory_order_relaxed) & (1ULL << (h & 63))))
+                return false;
+        }
+
+        return true;
+    }
+
+    // The horizon is the snapshot ID taken once the populating scan has completed.
+    void setReady(uint64_t horizon) {
+        _horizon = horizon;
+        _ready.store(true, std::memory_order_release);
+    }
+
+    bool isReadyFor(uint64_t snapId) const {
+        return _ready.load(std::memory_order_acquire) && snapId > _horizon;
+    }
+
+    bool isOverloaded() const {
+        return _keys.load(std::memory_order_relaxed) > kOverloadFactor * _capacity;
+    }
+
+    uint64_t getGen() const {
+        return _gen;
+    }
+
+    uint64_t getKeys() const {
+        return _keys.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getCapacity() const {
+        return _capacity;
+    }
+
+    size_t getMemBytes() const {
+        return _nBlocks * kBlockBits / 8;
+    }
+
+private:
+    std::atomic<uint64_t>* _block(uint64_t h) const {
+        return &_words[(h % _nBlocks) * kWordsPerBlock];
+    }
+
+    const uint64_t _nBlocks;
+    const uint64_t _capacity;
+    const uint64_t _gen;
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;
+    std::atomic<uint64_t> _keys{0};
+    uint64_t _horizon{0};
+    std::atomic<bool> _ready{false};
+};
+/* End KVDBBloomFilter */
+
+/* Start KVDBIdxFilter */
+struct KVDBIdxFilter::InsertTracker {
+    std::atomic<uint64_t> gen{0};
+
+    // Inserts not yet committed or rolled back, by generation parity.
+    std::atomic<long long> inflight[2];
+
+    InsertTracker() {
+        inflight[0].store(0);
+        inflight[1].store(0);
+    }
+};
+
+class KVDBIdxFilter::InsertChange : public RecoveryUnit::Change {
+public:
+    InsertChange(std::shared_ptr<InsertTracker> tracker, unsigned slot)
+        : _tracker(std::move(tracker)), _slot(slot) {}
+
+    virtual void commit() {
+        _tracker->inflight[_slot].fetch_sub(1);
+    }
+
+    virtual void rollback() {
+        _tracker->inflight[_slot].fetch_sub(1);
+    }
+
+private:
+    std::shared_ptr<InsertTracker> _tracker;
+    const unsigned _slot;
+};
+
+KVDBIdxFilter::KVDBIdxFilter(KVDB& db,
+                             KVSHandle& idxKvs,
+                             const std::string& prefix,
+                             const std::atomic<long long>& indexSize,
+                             const KVDBIdxKeyDict* dict)
+    : _db(db),
+      _idxKvs(idxKvs),
+      _prefix(prefix),
+      _indexSize(indexSize),
+      _dict(dict),
+      _enabled(gMemBudget.load() > 0),
+      _tracker(std::make_shared<InsertTracker>()),
+      _buildBackoff(1),
+      _probesUntilBuild(kBuildAfterProbes) {}
+
+KVDBIdxFilter::~KVDBIdxFilter() {}
+
+void KVDBIdxFilter::noteInsert(KVDBRecoveryUnit* ru, const char* encodedKey, size_t len) {
+    if (!_enabled)
+        return;
+
+    // Count the insert against its generation before looking for a filter, a build
+    // publishes the filter before it advances the generation.
+    uint64_t gen = _tracker->gen.load();
+    unsigned slot = gen & 1;
+
+    _tracker->inflight[slot].fetch_add(1);
+    ru->registerChange(new InsertChange(_tracker, slot));
+
+    auto bloom = std::atomic_load(&_bloom);
+    if (bloom && bloom->getGen() == gen) {
+        uint64_t hash[2];
+        hashKey(encodedKey, len, hash);
+        bloom->add(hash);
+    }
+}
+
+KVDBIdxFilter::Probe KVDBIdxFilter::probe(KVDBRecoveryUnit* ru,
+                                          const char* encodedKey,
+                                          size_t len) {
+    if (!_enabled)
+        return Probe::kNotReady;
+
+    // Majority and prepared reads see a view older than their snapshot ID, in which a key
+    // deleted before the filter was built may still be present.
+    if (ru->isReadingFromMajorityCommittedSnapshot() || ru->getPreparedView())
+        return Probe::kNotReady;
+
+    auto bloom = std::atomic_load(&_bloom);
+    if (!bloom || !bloom->isReadyFor(ru->getSnapIdRaw())) {
+        _maybeQueueBuild();
+        return Probe::kNotReady;
+    }
+
+    if (MONGO_unlikely(bloom->isOverloaded())) {
+        _maybeReset(bloom.get());
+        return Probe::kNotReady;
+    }
+
+    uint64_t hash[2];
+    hashKey(encodedKey, len, hash);
+    if (bloom->mayContain(hash))
+        return Probe::kMaybePresent;
+
+    _hseIdxFilterNegativeCounter.add();
+    return Probe::kAbsent;
+}
+
+void KVDBIdxFilter::noteFalsePositive() {
+    _hseIdxFilterFalsePositiveCounter.add();
+}
+
+void KVDBIdxFilter::shutdown() {
+    _shutdown.store(true);
+
+    // Waits out a running build, it stops at the next key.
+    stdx::lock_guard<stdx::mutex> lk(_buildMutex);
+}
+
+void KVDBIdxFilter::buildQueued() {
+    std::vector<std::weak_ptr<KVDBIdxFilter>> queued;
+    {
+        stdx::lock_guard<stdx::mutex> lk(gQueueMutex);
+        queued.swap(gQueue);
+    }
+
+    std::vector<std::weak_ptr<KVDBIdxFilter>> requeue;
+    for (auto& weak : queued) {
+        auto filter = weak.lock();
+        if (filter && !filter->_build())
+            requeue.push_back(filter);
+    }
+
+    if (!requeue.empty()) {
+        stdx::lock_guard<stdx::mutex> lk(gQueueMutex);
+        gQueue.insert(gQueue.end(), requeue.begin(), requeue.end());
+    }
+}
+
+void KVDBIdxFilter::_maybeQueueBuild() {
+    // Stops counting down once due, leaving it to the lock holder to re-arm.
+    if (_probesUntilBuild.load(std::memory_order_relaxed) > 0 &&
+        _probesUntilBuild.fetch_sub(1, std::memory_order_relaxed) > 0)
+        return;
+
+    stdx::unique_lock<stdx::mutex> lk(_buildMutex, stdx::try_to_lock);
+    if (!lk.owns_lock())
+        return;
+
+    if (_state == BuildState::kIdle) {
+        if (_probesUntilBuild.load() > 0)
+            return;
+
+        uint64_t nKeys = std::max<uint64_t>(
+            {_keysHint, static_cast<uint64_t>(_indexSize.load() / kMinEntryBytes), kMinKeys});
+
+        if (!reserveMem(KVDBBloomFilter::memBytesFor(nKeys))) {
+            _buildBackoff = std::min(_buildBackoff * 2, kMaxBuildBackoff);
+            _probesUntilBuild.store(kBuildAfterProbes * _buildBackoff);
+            return;
+        }
+
+        uint64_t gen = _tracker->gen.load() + 1;
+        std::atomic_store(&_bloom, std::make_shared<KVDBBloomFilter>(nKeys, gen));
+        _tracker->gen.store(gen);
+        _state = BuildState::kDraining;
+
+        stdx::lock_guard<stdx::mutex> queueLk(gQueueMutex);
+        gQueue.push_back(shared_from_this());
+    }
+}
+
+bool KVDBIdxFilter::_build() {
+    stdx::lock_guard<stdx::mutex> lk(_buildMutex);
+    if (_shutdown.load() || _state != BuildState::kDraining)
+        return true;
+
+    // Inserts of the previous generation may be invisible to the scan and absent
+    // from the filter until they resolve.
+    uint64_t prevSlot = (_tracker->gen.load() - 1) & 1;
+    if (_tracker->inflight[prevSlot].load() > 0)
+        return false;
+
+    auto bloom = std::atomic_load(&_bloom);
+    if (!_populate(*bloom)) {
+        std::atomic_store(&_bloom, std::shared_ptr<KVDBBloomFilter>());
+        _state = BuildState::kIdle;
+        _buildBackoff = std::min(_buildBackoff * 2, kMaxBuildBackoff);
+        _probesUntilBuild.store(kBuildAfterProbes * _buildBackoff);
+        return true;
+    }
+
+    bloom->setReady(KVDBRecoveryUnit::newSnapshotIdHorizon());
+    _state = BuildState::kReady;
+    _buildBackoff = 1;
+    return true;
+}
+
+void KVDBIdxFilter::_maybeReset(KVDBBloomFilter* bloom) {
+    stdx::unique_lock<stdx::mutex> lk(_buildMutex, stdx::try_to_lock);
+    if (!lk.owns_lock() || _state != BuildState::kReady || _bloom.get() != bloom)
+        return;
+
+    _keysHint = bloom->getKeys() * kOverloadFactor;
+    std::atomic_store(&_bloom, std::shared_ptr<KVDBBloomFilter>());
+    _state = BuildState::kIdle;
+    _probesUntilBuild.store(kBuildAfterProbes);
+}
+
+bool KVDBIdxFilter::_populate(KVDBBloomFilter& bloom) {
+    KVDBData pfx{(const uint8_t*)_prefix.c_str(), _prefix.size()};
+    std::unique_ptr<KvsCursor> cursor;
+
+    // Unbound cursor, sees everything committed so far.
+    try {
+        cursor.reset(_db.kvs_cursor_create(_idxKvs, pfx, true, nullptr));
+    } catch (...) {
+        return false;
+    }
+
+    KVDBData key{};
+    KVDBData val{};
+    bool eof = false;
+    uint64_t nKeys = 0;
+    uint64_t hash[2];
+    std::string decoded;
+
+    while (true) {
+        if (_shutdown.load())
+            return false;
+
+        auto st = cursor->read(key, val, eof);
+        if (!st.ok()) {
+            log() << "hse index filter build for prefix " << toHex(_prefix.data(), _prefix.size())
+                  << " failed: " << st.toString();
+            return false;
+        }
+
+        if (eof)
+            break;
+
+        if (key.len() <= _prefix.size() + sizeof(int64_t))
+            continue;
+
+        const char* data = (const char*)key.data() + _prefix.size();
+        size_t len = key.len() - _prefix.size();
+        if (_dict) {
+            decoded.clear();
+            _dict->decode(data, len, &decoded);
+            data = decoded.data();
+            len = decoded.size();
+        }
+
+        hashKey(data, len - sizeof(int64_t), hash);
+        bloom.add(hash);
+
+        if (++nKeys > bloom.getCapacity()) {
+            _keysHint = nKeys * kOverloadFactor;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void KVDBIdxFilter::setMemBudget(size_t bytes) {
+    gMemBudget.store(bytes);
+}
+
+size_t KVDBIdxFilter::getMemBudget() {
+    return gMemBudget.load();
+}
+
+BSONObj KVDBIdxFilter::getGlobalStats() {
+    BSONObjBuilder bob;
+
+    bob.append("memBudget", static_cast<long long>(gMemBudget.load()));
+    bob.append("memUsed", static_cast<long long>(gMemUsed.load()));
+    bob.append("filters", gFilterCount.load());
+
+    return bob.obj();
+}
+/* End KVDBIdxFilter */
+
+/* Start KVDBIdxFilterBuilder */
+const int KVDBIdxFilterBuilder::kPeriodMillis = 100;
+
+KVDBIdxFilterBuilder::KVDBIdxFilterBuilder() : BackgroundJob(false /* deleteSelf */) {}
+
+std::string KVDBIdxFilterBuilder::name() const {
+    return "KVDBIdxFilterBuilder";
+}
+
+void KVDBIdxFilterBuilder::run() {
+    Client::initThread(name().c_str());
+
+    LOG(1) << "starting " << name() << " thread";
+
+    while (true) {
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _cv.wait_for(
+                lk, stdx::chrono::milliseconds(kPeriodMillis), [&] { return _shuttingDown; });
+            if (_shuttingDown)
+                break;
+        }
+
+        KVDBIdxFilter::buildQueued();
+    }
+
+    LOG(1) << "stopping " << name() << " thread";
+}
+
+void KVDBIdxFilterBuilder::shutdown() {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _shuttingDown = true;
+    }
+    _cv.notify_all();
+    wait();
+}
+/* End KVDBIdxFilterBuilder */
+}  // namespace mongo
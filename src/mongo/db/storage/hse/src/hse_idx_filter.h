@@ -0,0 +1,160 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/util/background.h"
+
+#include "hse.h"
+#include "hse_recovery_unit.h"
+
+using hse::KVSHandle;
+
+namespace mongo {
+
+class KVDBBloomFilter;
+class KVDBIdxKeyDict;
+
+/**
+ * In-memory existence filter over the KeyStrings of a standard index, consulted by
+ * point gets before they probe the index kvs.
+ *
+ * Once an index sees point lookups, the filter is queued for KVDBIdxFilterBuilder to
+ * build by a full prefix scan in the background, and point gets bypass it until it is
+ * ready. It is maintained on insert afterwards. It is never cleared on unindex, so it only
+ * ever answers "absent" for keys that are absent; deletes raise the false-positive
+ * rate until the filter overflows and is rebuilt.
+ *
+ * Inserts are grouped in generations. A build starts a new generation and only
+ * scans once every insert of the previous generation has committed or rolled back,
+ * so no insert can be missed by both the scan and the filter. A reader only trusts
+ * a filter if its snapshot is younger than the one the scan ran against.
+ *
+ * All filters share a process wide memory budget set by the engine at startup; a
+ * budget of zero disables filtering.
+ */
+class KVDBIdxFilter : public std::enable_shared_from_this<KVDBIdxFilter> {
+    MONGO_DISALLOW_COPYING(KVDBIdxFilter);
+
+public:
+    enum class Probe { kNotReady, kAbsent, kMaybePresent };
+
+    // dict decodes the stored keys of a dictionary form index, nullptr otherwise.
+    KVDBIdxFilter(KVDB& db,
+                  KVSHandle& idxKvs,
+                  const std::string& prefix,
+                  const std::atomic<long long>& indexSize,
+                  const KVDBIdxKeyDict* dict);
+    ~KVDBIdxFilter();
+
+    // Records an index key, encodedKey excludes the prefix and the RecordId suffix.
+    void noteInsert(KVDBRecoveryUnit* ru, const char* encodedKey, size_t len);
+
+    Probe probe(KVDBRecoveryUnit* ru, const char* encodedKey, size_t len);
+
+    void noteFalsePositive();
+
+    // Abandons any queued or running build. Called by the index before it goes away, as
+    // the builder may still hold the filter.
+    void shutdown();
+
+    // Runs the builds queued so far. Builds still waiting on inserts are queued again.
+    static void buildQueued();
+
+    static void setMemBudget(size_t bytes);
+    static size_t getMemBudget();
+    static BSONObj getGlobalStats();
+
+private:
+    class InsertChange;
+    struct InsertTracker;
+
+    enum class BuildState { kIdle, kDraining, kReady };
+
+    void _maybeQueueBuild();
+    bool _build();
+    void _maybeReset(KVDBBloomFilter* bloom);
+    bool _populate(KVDBBloomFilter& bloom);
+
+    KVDB& _db;           // not owned
+    KVSHandle& _idxKvs;  // not owned
+    const std::string _prefix;
+    const std::atomic<long long>& _indexSize;  // not owned, used to size the filter
+    const KVDBIdxKeyDict* _dict;               // not owned
+    const bool _enabled;
+
+    std::shared_ptr<InsertTracker> _tracker;
+
+    // Accessed with std::atomic_load/atomic_store, inserts and readers never lock.
+    std::shared_ptr<KVDBBloomFilter> _bloom;
+
+    // Guards the build state machine. Readers only ever try_lock it.
+    stdx::mutex _buildMutex;
+    std::atomic<bool> _shutdown{false};
+    BuildState _state{BuildState::kIdle};
+    uint64_t _keysHint{0};
+    uint32_t _buildBackoff;
+    std::atomic<int> _probesUntilBuild;
+};
+
+/**
+ * Builds the index filters queued by point gets, so that no query waits on the scan.
+ */
+class KVDBIdxFilterBuilder : public BackgroundJob {
+    MONGO_DISALLOW_COPYING(KVDBIdxFilterBuilder);
+
+public:
+    static const int kPeriodMillis;
+
+    KVDBIdxFilterBuilder();
+
+    virtual std::string name() const;
+
+    virtual void run();
+
+    void shutdown();
+
+private:
+    stdx::mutex _mutex;
+    stdx::condition_variable _cv;
+    bool _shuttingDown{false};
+};
+}  // namespace mongo
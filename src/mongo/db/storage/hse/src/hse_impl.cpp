@@ -38,6 +38,7 @@
 
 #include "hse_clienttxn.h"
 #include "hse_impl.h"
+#include "hse_kvscursor.h"
 #include "hse_stats.h"
 #include "hse_util.h"
 
@@ -63,6 +64,7 @@ using hse_stat::_hseKvsProbeCounter;
 using hse_stat::_hseKvsProbeLatency;
 using hse_stat::_hseKvsPutCounter;
 using hse_stat::_hseKvsPutLatency;
+using hse_stat::_hseSubTxnRetryCounter;
 
 using hse::CStyleStrVec;
 
@@ -140,16 +142,45 @@ Status KVDBImpl::kvdb_close() {
     return Status(ret);
 }
 
+struct hse_kvdb_txn* KVDBImpl::kvdb_txn_alloc() {
+    return ::hse_kvdb_txn_alloc(_handle);
+}
+
+void KVDBImpl::kvdb_txn_free(struct hse_kvdb_txn* txn) {
+    ::hse_kvdb_txn_free(_handle, txn);
+}
+
+Status KVDBImpl::kvdb_txn_begin(struct hse_kvdb_txn* txn) {
+    return Status(::hse_kvdb_txn_begin(_handle, txn));
+}
+
+Status KVDBImpl::kvdb_txn_commit(struct hse_kvdb_txn* txn) {
+    return Status(::hse_kvdb_txn_commit(_handle, txn));
+}
+
+Status KVDBImpl::kvdb_txn_abort(struct hse_kvdb_txn* txn) {
+    return Status(::hse_kvdb_txn_abort(_handle, txn));
+}
+
+KvsCursor* KVDBImpl::kvs_cursor_create(KVSHandle handle,
+                                       KVDBData& prefix,
+                                       bool forward,
+                                       ClientTxn* txn) {
+    return new KvsCursor(handle, prefix, forward, txn);
+}
+
 Status KVDBImpl::kvs_put(KVSHandle handle,
                          ClientTxn* txn,
                          const KVDBData& key,
-                         const KVDBData& val) {
+                         const KVDBData& val,
+                         unsigned int flags) {
     struct hse_kvs* kvs = (struct hse_kvs*)handle;
     struct hse_kvdb_txn* kvdb_txn = txn ? txn->get_kvdb_txn() : nullptr;
 
     _hseKvsPutCounter.add();
     auto lt = _hseKvsPutLatency.begin();
-    Status ret{::hse_kvs_put(kvs, 0, kvdb_txn, key.data(), key.len(), val.data(), val.len())};
+    Status ret{
+        ::hse_kvs_put(kvs, flags, kvdb_txn, key.data(), key.len(), val.data(), val.len())};
     _hseKvsPutLatency.end(lt);
     return ret;
 }
@@ -341,6 +372,38 @@ Status KVDBImpl::kvdb_sync() {
     return Status{ret};
 }
 
+Status KVDBImpl::kvdb_compact() {
+    unsigned long ret = 0;
+
+    if (_handle)
+        ret = ::hse_kvdb_compact(_handle, HSE_KVDB_COMPACT_SAMP_LWM);
+
+    return Status{ret};
+}
+
+Status KVDBImpl::kvdb_compact_cancel() {
+    unsigned long ret = 0;
+
+    if (_handle)
+        ret = ::hse_kvdb_compact(_handle, HSE_KVDB_COMPACT_CANCEL);
+
+    return Status{ret};
+}
+
+Status KVDBImpl::kvdb_compact_status(struct hse_kvdb_compact_status& status) {
+    return Status{::hse_kvdb_compact_status_get(_handle, &status)};
+}
+
+Status KVDBImpl::kvdb_mclass_info(enum hse_mclass mclass,
+                                  bool& configured,
+                                  struct hse_mclass_info& info) {
+    configured = ::hse_kvdb_mclass_is_configured(_handle, mclass);
+    if (!configured)
+        return Status{};
+
+    return Status{::hse_kvdb_mclass_info_get(_handle, mclass, &info)};
+}
+
 // The sub_txn ops below are used in lieu of not-txnal ops where snapshot isolation is not
 // required. This is so since we use only transaction enabled KVSes now.
 Status KVDBImpl::kvs_sub_txn_put(KVSHandle handle, const KVDBData& key, const KVDBData& val) {
@@ -78,10 +78,26 @@ public:
 
     virtual Status kvdb_close();
 
+    virtual struct hse_kvdb_txn* kvdb_txn_alloc();
+
+    virtual void kvdb_txn_free(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_begin(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_commit(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_abort(struct hse_kvdb_txn* txn);
+
+    virtual KvsCursor* kvs_cursor_create(KVSHandle handle,
+                                         KVDBData& prefix,
+                                         bool forward,
+                                         ClientTxn* txn);
+
     virtual Status kvs_put(KVSHandle handle,
                            ClientTxn* txn,
                            const KVDBData& key,
-                           const KVDBData& val);
+                           const KVDBData& val,
+                           unsigned int flags);
 
     virtual Status kvs_sub_txn_put(KVSHandle handle, const KVDBData& key, const KVDBData& val);
 
@@ -117,6 +133,16 @@ public:
 
     virtual Status kvdb_sync();
 
+    virtual Status kvdb_compact();
+
+    virtual Status kvdb_compact_cancel();
+
+    virtual Status kvdb_compact_status(struct hse_kvdb_compact_status& status);
+
+    virtual Status kvdb_mclass_info(enum hse_mclass mclass,
+                                    bool& configured,
+                                    struct hse_mclass_info& info);
+
 private:
     struct hse_kvdb* _handle = nullptr;
 };
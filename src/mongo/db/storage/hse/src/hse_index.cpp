@@ -35,14 +35,17 @@
 
 #include "mongo/platform/basic.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "mongo/base/checked_cast.h"
 #include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/storage/index_entry_comparison.h"
 #include "mongo/stdx/memory.h"
 #include "mongo/util/log.h"
@@ -57,12 +60,16 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+using hse_stat::KVDBIdentStats;
+
 namespace {
 static const int kKeyStringV0Version = 0;
 static const int kKeyStringV1Version = 1;
 static const int kMinimumIndexVersion = kKeyStringV0Version;
 static const int kMaximumIndexVersion = kKeyStringV1Version;
 
+static const char kKeyFormatField[] = "key_format";
+
 /**
  * Strips the field names from a BSON object
  */
@@ -90,6 +97,9 @@ string dupKeyError(const BSONObj& key) {
 
 const int kTempKeyMaxSize = 1024;  // Do the same as the heap implementation
 
+// Most seeks read a handful of keys, range scans ramp up to this many per batch.
+const size_t kMaxReadAheadKeys = 64;
+
 Status checkKeySize(const BSONObj& key) {
     if (key.objsize() >= kTempKeyMaxSize) {
         string msg = mongoutils::str::stream()
@@ -100,17 +110,38 @@ Status checkKeySize(const BSONObj& key) {
     return Status::OK();
 }
 
-string stripPrefix(KVDBData& key, const string& prefix) {
-    string fullKey((const char*)key.data(), key.len());
-
-    return fullKey.substr(prefix.size(), string::npos);
-}
-
 string makePrefixedKey(const string& prefix, const KeyString& encodedKey) {
     string key(prefix);
     key.append(encodedKey.getBuffer(), encodedKey.getSize());
     return key;
 }
+
+/**
+ * Builds a standard index key, prefix + KeyString + 8-byte big endian RecordId, in a
+ * per-thread buffer that is reused across the keys of all indexes of a write. Valid
+ * until the next call on the same thread. With a dictionary the KeyString is stored
+ * in its dictionary form.
+ */
+const string& makeStdIdxKey(const string& prefix,
+                            const KeyString& encodedKey,
+                            const RecordId& loc,
+                            KVDBIdxKeyDict* dict = nullptr,
+                            size_t leadLen = 0,
+                            bool mayExtend = false) {
+    static thread_local string key;
+
+    int64_t bigLoc = endian::nativeToBig(loc.repr());
+
+    key.assign(prefix);
+    if (dict) {
+        dict->encode(encodedKey.getBuffer(), encodedKey.getSize(), leadLen, mayExtend, &key);
+    } else {
+        key.append(encodedKey.getBuffer(), encodedKey.getSize());
+    }
+    key.append(reinterpret_cast<const char*>(&bigLoc), sizeof(bigLoc));
+
+    return key;
+}
 }  // namespace
 
 /* Start KVDBIdxCursorBase */
@@ -120,7 +151,8 @@ KVDBIdxCursorBase::KVDBIdxCursorBase(OperationContext* opctx,
                                      bool forward,
                                      Ordering order,
                                      KeyString::Version keyStringVersion,
-                                     int numFields)
+                                     int numFields,
+                                     hse_stat::KVDBIdentStats& identStats)
     : _idxKvs(idxKvs),
       _prefix(prefix),
       _forward(forward),
@@ -132,7 +164,8 @@ KVDBIdxCursorBase::KVDBIdxCursorBase(OperationContext* opctx,
       _seekPosIncl(keyStringVersion),
       _endPosIncl(keyStringVersion),
       _numFields(numFields),
-      _opctx(opctx) {}
+      _opctx(opctx),
+      _identStats(identStats) {}
 
 boost::optional<IndexKeyEntry> KVDBIdxCursorBase::next(RequestedInfo parts) {
     // Advance on a cursor at the end is a no-op
@@ -231,7 +264,7 @@ boost::optional<IndexKeyEntry> KVDBIdxCursorBase::_seek(const BSONObj& key,
     _query.resetToKey(key, _order, discriminator);
 
     _ensureCursor();
-    _seekCursor(_query);
+    _seekCursor(_query, _dict ? _dict->leadLength(key) : 0);
     _updatePosition();
 
     return _curr(parts);
@@ -282,9 +315,19 @@ void KVDBIdxCursorBase::_ensureCursor() {
         _cursorValid = true;
         _needSeek = true;
         _eof = false;
+        _batch.clear();
+        _batchEof = false;
     } else if (_needUpdate) {
         auto hseSt = ru->cursorUpdate(_cursor);
         invariantHseSt(hseSt);
+
+        // The updated cursor resumes after the last key read ahead. Keys still batched
+        // belong to the old view, so drop them and reposition on the current key.
+        if (!_batch.empty()) {
+            _batch.clear();
+            _needSeek = true;
+        }
+        _batchEof = false;
     }
     _needUpdate = false;
 }
@@ -316,7 +359,49 @@ void KVDBIdxBase::updateCounter() {
 }
 
 void KVDBIdxBase::incrementCounter(KVDBRecoveryUnit* ru, int size) {
-    ru->incrementCounter(_indexSizeKeyID, &_indexSize, size);
+    ru->incrementCounter(_indexSizeKeyID, &_indexSize, size, this);
+}
+
+hse::Status KVDBIdxBase::putKey(KVDBRecoveryUnit* ru, const KVDBData& key, const KVDBData& val) {
+    hse::Status st;
+
+    try {
+        st = ru->put(_idxKvs, key, val);
+    } catch (const WriteConflictException&) {
+        _identStats.add(KVDBIdentStats::kWriteConflicts);
+        throw;
+    }
+    _identStats.add(KVDBIdentStats::kPuts);
+    _identStats.add(KVDBIdentStats::kBytesWritten, key.len() + val.len());
+
+    return st;
+}
+
+hse::Status KVDBIdxBase::delKey(KVDBRecoveryUnit* ru, const KVDBData& key) {
+    hse::Status st;
+
+    try {
+        st = ru->del(_idxKvs, key);
+    } catch (const WriteConflictException&) {
+        _identStats.add(KVDBIdentStats::kWriteConflicts);
+        throw;
+    }
+    _identStats.add(KVDBIdentStats::kDeletes);
+
+    return st;
+}
+
+hse::Status KVDBIdxBase::getKey(KVDBRecoveryUnit* ru,
+                                const KVDBData& key,
+                                KVDBData& val,
+                                bool& found) {
+    auto st = ru->getMCo(_idxKvs, key, val, found);
+
+    _identStats.add(KVDBIdentStats::kGets);
+    if (found)
+        _identStats.add(KVDBIdentStats::kBytesRead, key.len() + val.len());
+
+    return st;
 }
 
 void KVDBIdxCursorBase::_destroyMCursor() {
@@ -325,6 +410,7 @@ void KVDBIdxCursorBase::_destroyMCursor() {
         auto hseSt = ru->endScan(_cursor);
         invariantHseSt(hseSt);
         _cursorValid = false;
+        _batch.clear();
     }
 }
 
@@ -348,7 +434,16 @@ void KVDBIdxCursorBase::_advanceCursor() {
         KVDBData k, v;  // local, will be discarded
         KVDBData found;
 
-        string prefixedQuery = makePrefixedKey(_prefix, _key);
+        _batch.clear();
+        _batchEof = false;
+        _batchKeys = 1;
+
+        string prefixedQuery(_prefix);
+        if (_dict) {
+            prefixedQuery.append(_storedKey);
+        } else {
+            prefixedQuery.append(_key.getBuffer(), _key.getSize());
+        }
         KVDBData pQry{(const uint8_t*)prefixedQuery.c_str(), prefixedQuery.size()};
         auto hseSt = ru->cursorSeek(_cursor, pQry, &found);
         invariantHseSt(hseSt);
@@ -362,12 +457,28 @@ void KVDBIdxCursorBase::_advanceCursor() {
         _needSeek = false;
     }
 
-    auto hseSt = ru->cursorRead(_cursor, _mKey, _mVal, eof);
-    invariantHseSt(hseSt);
-    if (eof) {
-        _eof = true;
-        hseSt = hse::Status{};
+    _readNext(ru);
+}
+
+void KVDBIdxCursorBase::_readNext(KVDBRecoveryUnit* ru) {
+    if (_batch.empty()) {
+        if (_batchEof) {
+            _eof = true;
+            return;
+        }
+
+        auto hseSt = ru->cursorReadBatch(_cursor, _batch, _batchKeys, _batchEof);
+        invariantHseSt(hseSt);
+        _batchKeys = std::min(_batchKeys * 2, kMaxReadAheadKeys);
+
+        if (_batch.empty()) {
+            _eof = true;
+            return;
+        }
     }
+
+    _batch.pop(_mKey, _mVal);
+    _identStats.add(KVDBIdentStats::kBytesRead, _mKey.len() + _mVal.len());
 }
 
 void KVDBIdxCursorBase::_updatePosition() {
@@ -376,18 +487,27 @@ void KVDBIdxCursorBase::_updatePosition() {
         return;
     }
 
-    auto key = stripPrefix(_mKey, _prefix);
-    _key.resetFromBuffer(key.data(), key.size());
+    const char* key = (const char*)_mKey.data() + _prefix.size();
+    size_t keySize = _mKey.len() - _prefix.size();
+    if (_dict) {
+        _storedKey.assign(key, keySize);
+        _decodedKey.clear();
+        _dict->decode(_storedKey.data(), _storedKey.size(), &_decodedKey);
+        key = _decodedKey.data();
+        keySize = _decodedKey.size();
+    }
 
-    // _endPosition doesn't contain a loc.
+    // _endPosition doesn't contain a loc. The key is compared where it was read, so the
+    // key that ends a scan is never copied.
     if (_endPosition) {
-        int cmp = _key.compare(*_endPosition);
+        int cmp = -_endPosition->compare(key, keySize);
         if (_forward ? cmp > 0 : cmp < 0) {
             _eof = true;
             return;
         }
     }
 
+    _key.resetFromBuffer(key, keySize);
     _updateLocAndTypeBits();
 }
 
@@ -406,23 +526,28 @@ boost::optional<IndexKeyEntry> KVDBIdxCursorBase::_curr(RequestedInfo parts) con
     return {{std::move(bson), _loc}};
 }
 
-void KVDBIdxCursorBase::_seekCursor(const KeyString& query) {
+void KVDBIdxCursorBase::_seekCursor(const KeyString& query, size_t leadLen) {
     auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(_opctx);
 
-    string prefixedQuery = makePrefixedKey(_prefix, query);
+    // The cursor view is already established, so the dictionary is at least as new.
+    string prefixedQuery(_prefix);
+    if (_dict) {
+        _dict->encode(query.getBuffer(), query.getSize(), leadLen, false, &prefixedQuery);
+    } else {
+        prefixedQuery.append(query.getBuffer(), query.getSize());
+    }
 
     KVDBData pQry{(uint8_t*)prefixedQuery.c_str(), prefixedQuery.size()};
 
     auto hseSt = ru->cursorSeek(_cursor, pQry, nullptr);
     invariantHseSt(hseSt);
 
-    bool eof = false;
+    _batch.clear();
+    _batchEof = false;
+    _batchKeys = 1;
+
     _eof = false;
-    hseSt = ru->cursorRead(_cursor, _mKey, _mVal, eof);
-    invariantHseSt(hseSt);
-    if (eof) {
-        _eof = true;
-    }
+    _readNext(ru);
 
     _needSeek = false;
 }
@@ -442,8 +567,15 @@ KVDBIdxStdCursor::KVDBIdxStdCursor(OperationContext* opctx,
                                    bool forward,
                                    Ordering order,
                                    KeyString::Version keyStringVersion,
-                                   int numFields)
-    : KVDBIdxCursorBase(opctx, idxKvs, prefix, forward, order, keyStringVersion, numFields) {}
+                                   int numFields,
+                                   hse_stat::KVDBIdentStats& identStats,
+                                   KVDBIdxFilter* filter,
+                                   KVDBIdxKeyDict* dict)
+    : KVDBIdxCursorBase(
+          opctx, idxKvs, prefix, forward, order, keyStringVersion, numFields, identStats),
+      _filter(filter) {
+    _dict = dict;
+}
 
 KVDBIdxStdCursor::~KVDBIdxStdCursor() {}
 
@@ -466,24 +598,41 @@ boost::optional<IndexKeyEntry> KVDBIdxStdCursor::_pointGet(const BSONObj& key,
                                                            bool& needCursor) {
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(_opctx);
     hse_kvs_pfx_probe_cnt found;
-    std::string pkey(_prefix);
 
     _query.resetToKey(key, _order);
-    pkey.append(_query.getBuffer(), _query.getSize());
-    KVDBData pfx{(const uint8_t*)pkey.c_str(), pkey.size()};
+
+    // Absent keys are the common case for large $in lists, skip the probe if we can.
+    auto filtered = _filter ? _filter->probe(ru, _query.getBuffer(), _query.getSize())
+                            : KVDBIdxFilter::Probe::kNotReady;
+    if (filtered == KVDBIdxFilter::Probe::kAbsent) {
+        needCursor = false;
+        _eof = true;
+        _updatePosition();
+        return boost::none;
+    }
+
+    _pointLeadLen = _dict ? _dict->leadLength(key) : 0;
+    _makePointPfx(ru);
+    KVDBData pfx{(const uint8_t*)_pointPfx.c_str(), _pointPfx.size()};
 
     _mKey.createOwned(HSE_KVS_KEY_LEN_MAX);
     _mVal.createOwned(KeyString::TypeBits::kMaxBytesNeeded + 1);
 
     auto st = ru->prefixGet(_idxKvs, pfx, _mKey, _mVal, found);
     invariantHseSt(st);
+    _identStats.add(KVDBIdentStats::kGets);
 
     if (found == HSE_KVS_PFX_FOUND_ZERO) {
+        if (filtered == KVDBIdxFilter::Probe::kMaybePresent) {
+            _filter->noteFalsePositive();
+        }
+
         needCursor = false;
         _eof = true;
         _updatePosition();
         return boost::none;
     } else if (found == HSE_KVS_PFX_FOUND_ONE) {
+        _identStats.add(KVDBIdentStats::kBytesRead, _mKey.len() + _mVal.len());
         needCursor = false;
         _updatePosition();
         return _curr(parts);
@@ -494,13 +643,25 @@ boost::optional<IndexKeyEntry> KVDBIdxStdCursor::_pointGet(const BSONObj& key,
     }
 }
 
+void KVDBIdxStdCursor::_makePointPfx(KVDBRecoveryUnit* ru) {
+    _pointPfx.assign(_prefix);
+    if (!_dict) {
+        _pointPfx.append(_query.getBuffer(), _query.getSize());
+        return;
+    }
+
+    // Begin the view the probe reads before consulting the dictionary, so that any
+    // key the probe can see is stored in the form encoded here.
+    ru->ensureSnapshot();
+    _dict->encode(_query.getBuffer(), _query.getSize(), _pointLeadLen, false, &_pointPfx);
+}
+
 bool KVDBIdxStdCursor::_needCursorAfterUpdate() {
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(_opctx);
     hse_kvs_pfx_probe_cnt found;
-    std::string pkey(_prefix);
-    pkey.append(_query.getBuffer(), _query.getSize());
 
-    KVDBData pfx{(const uint8_t*)pkey.c_str(), pkey.size()};
+    _makePointPfx(ru);
+    KVDBData pfx{(const uint8_t*)_pointPfx.c_str(), _pointPfx.size()};
     KVDBData k, v;
     k.createOwned(HSE_KVS_KEY_LEN_MAX);
 
@@ -531,8 +692,10 @@ KVDBIdxUniqCursor::KVDBIdxUniqCursor(OperationContext* opctx,
                                      bool forward,
                                      Ordering order,
                                      KeyString::Version keyStringVersion,
-                                     int numFields)
-    : KVDBIdxCursorBase(opctx, idxKvs, prefix, forward, order, keyStringVersion, numFields) {}
+                                     int numFields,
+                                     hse_stat::KVDBIdentStats& identStats)
+    : KVDBIdxCursorBase(
+          opctx, idxKvs, prefix, forward, order, keyStringVersion, numFields, identStats) {}
 
 KVDBIdxUniqCursor::~KVDBIdxUniqCursor() {}
 
@@ -551,6 +714,7 @@ boost::optional<IndexKeyEntry> KVDBIdxUniqCursor::_pointGet(const BSONObj& key,
 
     auto st = ru->getMCo(_idxKvs, _mKey, _mVal, found);
     invariantHseSt(st);
+    _identStats.add(KVDBIdentStats::kGets);
 
     if (!found) {
         _eof = true;
@@ -559,6 +723,7 @@ boost::optional<IndexKeyEntry> KVDBIdxUniqCursor::_pointGet(const BSONObj& key,
     }
 
     // _mKey + _mVal now have allocated memory
+    _identStats.add(KVDBIdentStats::kBytesRead, _mKey.len() + _mVal.len());
     _updatePosition();
     return _curr(parts);
 }
@@ -646,7 +811,6 @@ KVDBIdxBase::KVDBIdxBase(KVDB& db,
     _keyStringVersion =
         indexFormatVersion >= kKeyStringV1Version ? KeyString::Version::V1 : KeyString::Version::V0;
     loadCounter();
-    _counterManager.registerIndex(this);
 }
 
 void KVDBIdxBase::fullValidate(OperationContext* opctx,
@@ -682,17 +846,28 @@ bool KVDBIdxBase::isEmpty(OperationContext* opctx) {
 
 void KVDBIdxBase::generateConfig(BSONObjBuilder* configBuilder,
                                  int formatVersion,
-                                 IndexDescriptor::IndexVersion descVersion) {
-    if (formatVersion >= 0 && descVersion >= IndexDescriptor::IndexVersion::kV2) {
+                                 const IndexDescriptor* desc) {
+    if (formatVersion >= 0 && desc->version() >= IndexDescriptor::IndexVersion::kV2) {
         configBuilder->append("index_format_version", static_cast<int32_t>(kMaximumIndexVersion));
     } else {
         // keep it backwards compatible
         configBuilder->append("index_format_version", static_cast<int32_t>(kMinimumIndexVersion));
     }
+
+    // The options were validated when the index was created. Only the leading field of
+    // a standard compound index repeats across enough keys to be worth a dictionary.
+    auto options = desc->infoObj()
+                       .getObjectField(IndexDescriptor::kStorageEngineFieldName)
+                       .getObjectField("hse");
+    auto useDict = KVDBIdxKeyDict::parseIndexOptions(options);
+    if (useDict.isOK() && useDict.getValue() && !desc->unique() && desc->getNumFields() > 1) {
+        configBuilder->append(kKeyFormatField, KVDBIdxKeyDict::kKeyFormatName);
+    }
 }
 
 KVDBIdxBase::~KVDBIdxBase() {
-    updateCounter();
+    if (countersDirty())
+        updateCounter();
     _counterManager.deregisterIndex(this);
 }
 /* End KVDBIdxBase */
@@ -742,7 +917,7 @@ Status KVDBUniqIdx::insert(OperationContext* opctx,
             value.appendTypeBits(encodedKey.getTypeBits());
         }
         iVal = KVDBData{(uint8_t*)value.getBuffer(), value.getSize()};
-        hseSt = ru->put(_idxKvs, pKey, iVal);
+        hseSt = putKey(ru, pKey, iVal);
 
         if (hseSt.ok()) {
             incrementCounter(ru, prefixedKey.size());
@@ -758,7 +933,7 @@ Status KVDBUniqIdx::insert(OperationContext* opctx,
 
 
     // need to read the value first
-    hseSt = ru->getMCo(_idxKvs, pKey, iVal, found);
+    hseSt = getKey(ru, pKey, iVal, found);
     if (!hseSt.ok()) {
         return hseToMongoStatus(hseSt);
     }
@@ -795,7 +970,7 @@ Status KVDBUniqIdx::insert(OperationContext* opctx,
     }
 
     iVal = KVDBData((uint8_t*)valueVector.getBuffer(), valueVector.getSize());
-    hseSt = ru->put(_idxKvs, pKey, iVal);
+    hseSt = putKey(ru, pKey, iVal);
     return hseToMongoStatus(hseSt);
 }
 
@@ -827,7 +1002,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
     // are allowed in unique indexes, confirm that the recordid matches the element
     // we are removing.
     if (!dupsAllowed && !_partial) {
-        hseSt = ru->del(_idxKvs, pKey);
+        hseSt = delKey(ru, pKey);
         invariantHseSt(hseSt);
         incrementCounter(ru, -prefixedKey.size());
         return;
@@ -839,7 +1014,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
     if (!dupsAllowed && _partial) {
         // Check that the record id matches. We may be called to unindex records that are not
         // present in the index due to the partial filter expression.
-        hseSt = ru->getMCo(_idxKvs, pKey, iVal, found);
+        hseSt = getKey(ru, pKey, iVal, found);
         invariantHseSt(hseSt);
         if (found) {
             BufReader br(iVal.data(), iVal.len());
@@ -849,7 +1024,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
             invariantHse(!br.remaining());
 
             if (locInIndex == loc) {
-                hseSt = ru->del(_idxKvs, pKey);
+                hseSt = delKey(ru, pKey);
                 invariantHseSt(hseSt);
                 incrementCounter(ru, -prefixedKey.size());
             }
@@ -858,7 +1033,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
     }
 
     // dups are allowed, so we have to deal with a vector of RecordIds.
-    hseSt = ru->getMCo(_idxKvs, pKey, iVal, found);
+    hseSt = getKey(ru, pKey, iVal, found);
     invariantHseSt(hseSt);
     if (!found) {
         // nothing here. just return
@@ -878,7 +1053,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
                 // This is the common case: we are removing the only loc for this
                 // key.
                 // Remove the whole entry.
-                hseSt = ru->del(_idxKvs, pKey);
+                hseSt = delKey(ru, pKey);
                 invariantHseSt(hseSt);
                 incrementCounter(ru, -prefixedKey.size());
                 return;
@@ -910,7 +1085,7 @@ void KVDBUniqIdx::unindex(OperationContext* opctx,
     }
 
     iVal = KVDBData{(uint8_t*)newValue.getBuffer(), newValue.getSize()};
-    hseSt = ru->put(_idxKvs, pKey, iVal);
+    hseSt = putKey(ru, pKey, iVal);
     invariantHseSt(hseSt);
 }
 
@@ -922,7 +1097,7 @@ Status KVDBUniqIdx::dupKeyCheck(OperationContext* opctx, const BSONObj& key, con
     auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
     KVDBData iVal{};
     bool found = false;
-    auto hseSt = ru->getMCo(_idxKvs, pKey, iVal, found);
+    auto hseSt = getKey(ru, pKey, iVal, found);
     if (!hseSt.ok()) {
         return hseToMongoStatus(hseSt);
     } else if (!found) {
@@ -947,8 +1122,9 @@ Status KVDBUniqIdx::dupKeyCheck(OperationContext* opctx, const BSONObj& key, con
 
 std::unique_ptr<SortedDataInterface::Cursor> KVDBUniqIdx::newCursor(OperationContext* opctx,
                                                                     bool forward) const {
+    _identStats.add(KVDBIdentStats::kCursorCreates);
     return stdx::make_unique<KVDBIdxUniqCursor>(
-        opctx, _idxKvs, _prefix, forward, _order, _keyStringVersion, _numFields);
+        opctx, _idxKvs, _prefix, forward, _order, _keyStringVersion, _numFields, _identStats);
 }
 
 SortedDataBuilderInterface* KVDBUniqIdx::getBulkBuilder(OperationContext* opctx, bool dupsAllowed) {
@@ -968,7 +1144,25 @@ KVDBStdIdx::KVDBStdIdx(KVDB& db,
                        const BSONObj& config,
                        int numFields,
                        const string indexKey)
-    : KVDBIdxBase(db, idxKvs, counterManager, prefix, ident, order, config, numFields, indexKey) {}
+    : KVDBIdxBase(db, idxKvs, counterManager, prefix, ident, order, config, numFields, indexKey) {
+    if (config.getStringField(kKeyFormatField) == StringData(KVDBIdxKeyDict::kKeyFormatName)) {
+        _dict = stdx::make_unique<KVDBIdxKeyDict>(_db, _idxKvs, _ident, _order, _keyStringVersion);
+    }
+    _filter = std::make_shared<KVDBIdxFilter>(_db, _idxKvs, _prefix, _indexSize, _dict.get());
+}
+
+KVDBStdIdx::~KVDBStdIdx() {
+    // The filter refers to the index size and dictionary.
+    _filter->shutdown();
+}
+
+const std::string& KVDBStdIdx::_makeKey(const KeyString& encodedKey,
+                                        const BSONObj& key,
+                                        const RecordId& loc,
+                                        bool mayExtend) {
+    return makeStdIdxKey(
+        _prefix, encodedKey, loc, _dict.get(), _dict ? _dict->leadLength(key) : 0, mayExtend);
+}
 
 Status KVDBStdIdx::insert(OperationContext* opctx,
                           const BSONObj& key,
@@ -981,11 +1175,7 @@ Status KVDBStdIdx::insert(OperationContext* opctx,
     }
 
     KeyString encodedKey(_keyStringVersion, key, _order);
-    std::string prefixedKey(makePrefixedKey(_prefix, encodedKey));
-
-    // Append the 8-byte record ID.
-    int64_t bigLoc = endian::nativeToBig(loc.repr());
-    prefixedKey.append(reinterpret_cast<const char*>(&bigLoc), sizeof(bigLoc));
+    const std::string& prefixedKey = _makeKey(encodedKey, key, loc, true);
 
     KVDBData pKey{(uint8_t*)prefixedKey.c_str(), prefixedKey.size()};
 
@@ -997,9 +1187,10 @@ Status KVDBStdIdx::insert(OperationContext* opctx,
                         encodedKey.getTypeBits().getSize());
     }
 
-    auto hseSt = ru->put(_idxKvs, pKey, iVal);
+    auto hseSt = putKey(ru, pKey, iVal);
     if (hseSt.ok()) {
         incrementCounter(ru, prefixedKey.size());
+        _filter->noteInsert(ru, encodedKey.getBuffer(), encodedKey.getSize());
     }
 
     return hseToMongoStatus(hseSt);
@@ -1012,11 +1203,7 @@ Status KVDBStdIdx::bulkInsert(OperationContext* opctx, const BSONObj& key, const
     }
 
     KeyString encodedKey(_keyStringVersion, key, _order);
-    std::string prefixedKey(makePrefixedKey(_prefix, encodedKey));
-
-    // Append the 8-byte record ID.
-    int64_t bigLoc = endian::nativeToBig(loc.repr());
-    prefixedKey.append(reinterpret_cast<const char*>(&bigLoc), sizeof(bigLoc));
+    const std::string& prefixedKey = _makeKey(encodedKey, key, loc, true);
 
     KVDBData pKey{(uint8_t*)prefixedKey.c_str(), prefixedKey.size()};
     auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
@@ -1027,10 +1214,11 @@ Status KVDBStdIdx::bulkInsert(OperationContext* opctx, const BSONObj& key, const
                         encodedKey.getTypeBits().getSize());
     }
 
-    auto hseSt = ru->put(_idxKvs, pKey, iVal);
+    auto hseSt = putKey(ru, pKey, iVal);
     invariantHseSt(hseSt);
 
     incrementCounter(ru, prefixedKey.size());
+    _filter->noteInsert(ru, encodedKey.getBuffer(), encodedKey.getSize());
 
     return hseToMongoStatus(hseSt);
 }
@@ -1054,17 +1242,13 @@ void KVDBStdIdx::unindex(OperationContext* opctx,
     }
 
     KeyString encodedKey(_keyStringVersion, key, _order);
-    std::string prefixedKey(makePrefixedKey(_prefix, encodedKey));
-
-    // Append the 8-byte record ID.
-    int64_t bigLoc = endian::nativeToBig(loc.repr());
-    prefixedKey.append(reinterpret_cast<const char*>(&bigLoc), sizeof(bigLoc));
+    const std::string& prefixedKey = _makeKey(encodedKey, key, loc, false);
 
     KVDBData pKey{(uint8_t*)prefixedKey.c_str(), prefixedKey.size()};
 
     auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
-    auto hseSt = ru->del(_idxKvs, pKey);
+    auto hseSt = delKey(ru, pKey);
     invariantHseSt(hseSt);
 
     incrementCounter(ru, -prefixedKey.size());
@@ -1077,8 +1261,17 @@ Status KVDBStdIdx::dupKeyCheck(OperationContext* opctx, const BSONObj& key, cons
 
 std::unique_ptr<SortedDataInterface::Cursor> KVDBStdIdx::newCursor(OperationContext* opctx,
                                                                    bool forward) const {
-    return stdx::make_unique<KVDBIdxStdCursor>(
-        opctx, _idxKvs, _prefix, forward, _order, _keyStringVersion, _numFields);
+    _identStats.add(KVDBIdentStats::kCursorCreates);
+    return stdx::make_unique<KVDBIdxStdCursor>(opctx,
+                                               _idxKvs,
+                                               _prefix,
+                                               forward,
+                                               _order,
+                                               _keyStringVersion,
+                                               _numFields,
+                                               _identStats,
+                                               _filter.get(),
+                                               _dict.get());
 }
 
 SortedDataBuilderInterface* KVDBStdIdx::getBulkBuilder(OperationContext* opctx, bool dupsAllowed) {
@@ -1119,7 +1312,10 @@ KVDBUniqBulkBuilder::KVDBUniqBulkBuilder(KVDBUniqIdx& index,
       _keyStringVersion(keyStringVersion),
       _opctx(opctx),
       _dupsAllowed(dupsAllowed),
-      _keyString(keyStringVersion) {}
+      _keyStringA(keyStringVersion),
+      _keyStringB(keyStringVersion),
+      _keyString(&_keyStringA),
+      _nextKeyString(&_keyStringB) {}
 
 Status KVDBUniqBulkBuilder::addKey(const BSONObj& newKey, const RecordId& loc) {
     Status s = checkKeySize(newKey);
@@ -1127,9 +1323,13 @@ Status KVDBUniqBulkBuilder::addKey(const BSONObj& newKey, const RecordId& loc) {
         return s;
     }
 
-    const int cmp = newKey.woCompare(_key, _ordering);
+    // Keys arrive sorted, so comparing each encoded key with the previous one proves
+    // uniqueness without an index lookup, and no BSON copy of the key is kept.
+    _nextKeyString->resetToKey(newKey, _ordering);
+
+    const int cmp = _nextKeyString->compare(*_keyString);
     if (cmp != 0) {
-        if (!_key.isEmpty()) {      // _key.isEmpty() is only true on the first call to addKey().
+        if (!_records.empty()) {    // _records is only empty on the first call to addKey().
             invariantHse(cmp > 0);  // newKey must be > the last key
             // We are done with dups of the last key so we can insert it now.
             _doInsert();
@@ -1143,12 +1343,11 @@ Status KVDBUniqBulkBuilder::addKey(const BSONObj& newKey, const RecordId& loc) {
 
         // If we get here, we are in the weird mode where dups are allowed on a unique
         // index, so add ourselves to the list of duplicate locs. This also replaces the
-        // _key which is correct since any dups seen later are likely to be newer.
+        // _keyString which is correct since any dups seen later are likely to be newer.
     }
 
-    _key = newKey.getOwned();
-    _keyString.resetToKey(_key, _ordering);
-    _records.push_back(std::make_pair(loc, _keyString.getTypeBits()));
+    std::swap(_keyString, _nextKeyString);
+    _records.push_back(std::make_pair(loc, _keyString->getTypeBits()));
 
     return Status::OK();
 }
@@ -1174,12 +1373,14 @@ void KVDBUniqBulkBuilder::_doInsert() {
         }
     }
 
-    std::string prefixedKey(makePrefixedKey(_prefix, _keyString));
+    std::string prefixedKey(makePrefixedKey(_prefix, *_keyString));
     KVDBData iKey{(uint8_t*)prefixedKey.c_str(), prefixedKey.size()};
     KVDBData iVal{(uint8_t*)value.getBuffer(), value.getSize()};
 
+    // The index is empty during a bulk build and sorted input rules out duplicates, so
+    // the put needs no read.
     auto ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(_opctx);
-    auto hseSt = ru->put(_idxKvs, iKey, iVal);
+    auto hseSt = _index.putKey(ru, iKey, iVal);
     invariantHseSt(hseSt);
 
     _index.incrementCounter(ru, prefixedKey.size());
@@ -49,7 +49,10 @@
 #include "hse.h"
 #include "hse_counter_manager.h"
 #include "hse_exceptions.h"
+#include "hse_idx_dict.h"
+#include "hse_idx_filter.h"
 #include "hse_recovery_unit.h"
+#include "hse_stats.h"
 #include "hse_util.h"
 
 using hse::KVSHandle;
@@ -64,7 +67,8 @@ public:
                       bool forward,
                       Ordering order,
                       KeyString::Version keyStringVersion,
-                      int numFields);
+                      int numFields,
+                      hse_stat::KVDBIdentStats& identStats);
     virtual ~KVDBIdxCursorBase();
 
     virtual void setEndPosition(const BSONObj& key, bool inclusive) override;
@@ -91,9 +95,10 @@ protected:
     void _destroyMCursor();
 
     void _advanceCursor();
+    void _readNext(KVDBRecoveryUnit* ru);
     void _updatePosition();
     boost::optional<IndexKeyEntry> _curr(RequestedInfo parts) const;
-    void _seekCursor(const KeyString& query);
+    void _seekCursor(const KeyString& query, size_t leadLen);
     boost::optional<IndexKeyEntry> _seek(const BSONObj& key,
                                          int cnt,
                                          bool inclusive,
@@ -134,6 +139,7 @@ protected:
     bool _lastPointGet = false;
     bool _eof = false;
     OperationContext* _opctx;
+    hse_stat::KVDBIdentStats& _identStats;  // owned by the index
 
     // stores the value associated with the latest call to seekExact()
     // std::string _value;
@@ -141,6 +147,19 @@ protected:
 
     KVDBData _mKey{};
     KVDBData _mVal{};
+
+    // Keys read ahead of the current position, _mKey and _mVal point into it. Scans
+    // read further ahead the longer they run, starting over at every seek.
+    hse::KvsCursorBatch _batch;
+    size_t _batchKeys = 1;
+    bool _batchEof = false;
+
+    // Set when the index stores keys in dictionary form, not owned.
+    KVDBIdxKeyDict* _dict = nullptr;
+
+    // Stored form of _key without the prefix, used to reposition on it.
+    std::string _storedKey;
+    std::string _decodedKey;  // reused by _updatePosition() to decode _storedKey
 };
 
 class KVDBIdxStdCursor : public KVDBIdxCursorBase {
@@ -152,7 +171,10 @@ public:
                      bool forward,
                      Ordering order,
                      KeyString::Version keyStringVersion,
-                     int numFields);
+                     int numFields,
+                     hse_stat::KVDBIdentStats& identStats,
+                     KVDBIdxFilter* filter,
+                     KVDBIdxKeyDict* dict);
     virtual ~KVDBIdxStdCursor();
 
 protected:
@@ -161,6 +183,14 @@ protected:
                                                      bool& needCursor);
     virtual void _updateLocAndTypeBits();
     virtual bool _needCursorAfterUpdate();
+
+    void _makePointPfx(KVDBRecoveryUnit* ru);
+
+    KVDBIdxFilter* _filter;  // not owned
+
+    // Prefixed stored form of the last point get, probed again after an update.
+    std::string _pointPfx;
+    size_t _pointLeadLen = 0;
 };
 
 class KVDBIdxUniqCursor : public KVDBIdxCursorBase {
@@ -172,7 +202,8 @@ public:
                       bool forward,
                       Ordering order,
                       KeyString::Version keyStringVersion,
-                      int numFields);
+                      int numFields,
+                      hse_stat::KVDBIdentStats& identStats);
     virtual ~KVDBIdxUniqCursor();
 
     boost::optional<IndexKeyEntry> seekExact(const BSONObj& key, RequestedInfo parts) override;
@@ -186,7 +217,7 @@ protected:
 };
 
 
-class KVDBIdxBase : public SortedDataInterface {
+class KVDBIdxBase : public SortedDataInterface, public KVDBCounterOwner {
     MONGO_DISALLOW_COPYING(KVDBIdxBase);
 
 public:
@@ -211,8 +242,7 @@ public:
     virtual bool appendCustomStats(OperationContext* opctx,
                                    BSONObjBuilder* output,
                                    double scale) const {
-        // nothing to say here, really
-        return false;
+        return _identStats.appendTo(*output, "hse");
     }
 
     virtual bool isEmpty(OperationContext* opctx);
@@ -226,12 +256,21 @@ public:
 
     static void generateConfig(BSONObjBuilder* configBuilder,
                                int formatVersion,
-                               IndexDescriptor::IndexVersion descVersion);
+                               const IndexDescriptor* desc);
 
     void loadCounter();
     void updateCounter();
     void incrementCounter(KVDBRecoveryUnit* ru, int size);
 
+    // Operations on the index KVS, counted in the index's collStats.
+    hse::Status putKey(KVDBRecoveryUnit* ru, const KVDBData& key, const KVDBData& val);
+    hse::Status delKey(KVDBRecoveryUnit* ru, const KVDBData& key);
+    hse::Status getKey(KVDBRecoveryUnit* ru, const KVDBData& key, KVDBData& val, bool& found);
+
+    virtual void syncCounters() {
+        updateCounter();
+    }
+
 protected:
     KVDB& _db;
     KVSHandle& _idxKvs;                   // not owned
@@ -248,6 +287,9 @@ protected:
     const std::string _indexSizeKeyKvs;
     unsigned long _indexSizeKeyID;
 
+    // Operation counts reported by collStats while stats are enabled.
+    mutable hse_stat::KVDBIdentStats _identStats;
+
     char _pad[128];
 
     std::atomic<long long> _indexSize;
@@ -301,6 +343,8 @@ public:
                int numFields,
                const string indexSizeKey);
 
+    virtual ~KVDBStdIdx();
+
     virtual Status insert(OperationContext* opctx,
                           const BSONObj& key,
                           const RecordId& loc,
@@ -320,6 +364,15 @@ public:
 
     virtual SortedDataBuilderInterface* getBulkBuilder(OperationContext* opctx,
                                                        bool dupsAllowed) override;
+
+private:
+    const std::string& _makeKey(const KeyString& encodedKey,
+                                const BSONObj& key,
+                                const RecordId& loc,
+                                bool mayExtend);
+
+    std::unique_ptr<KVDBIdxKeyDict> _dict;
+    std::shared_ptr<KVDBIdxFilter> _filter;  // shared with the filter builder
 };
 
 /**
@@ -369,8 +422,12 @@ private:
     const KeyString::Version _keyStringVersion;
     OperationContext* _opctx;
     const bool _dupsAllowed;
-    BSONObj _key;
-    KeyString _keyString;
+
+    // The last key added and the scratch the next one is encoded into, swapped per key.
+    KeyString _keyStringA;
+    KeyString _keyStringB;
+    KeyString* _keyString;
+    KeyString* _nextKeyString;
     std::vector<std::pair<RecordId, KeyString::TypeBits>> _records;
 };
 }  // namespace mongo
@@ -41,12 +41,15 @@
 #include "mongo/stdx/memory.h"
 #include "mongo/unittest/temp_dir.h"
 #include "mongo/unittest/unittest.h"
+#include "mongo/util/scopeguard.h"
 
 #include "hse_counter_manager.h"
 #include "hse_durability_manager.h"
+#include "hse_idx_filter.h"
 #include "hse_impl.h"
 #include "hse_index.h"
 #include "hse_recovery_unit.h"
+#include "hse_snapshot_manager.h"
 #include "hse_ut_common.h"
 
 using hse::KVDB_prefix;
@@ -157,11 +160,29 @@ public:
         }
     }
 
+    std::unique_ptr<SortedDataInterface> newStdIdx(const BSONObj& config,
+                                                   const string& prefix,
+                                                   const string& ident) {
+        return stdx::make_unique<KVDBStdIdx>(_db,
+                                             _stdIdxKvs,
+                                             *_counterManager.get(),
+                                             prefix,
+                                             ident,
+                                             _order,
+                                             config,
+                                             0,
+                                             KVDB_prefix + "indexsize-" + ident);
+    }
+
     std::unique_ptr<RecoveryUnit> newRecoveryUnit() {
         // return stdx::make_unique<KVDBRecoveryUnit>(_db.get(), _counterManager.get(), nullptr,
         // _durabilityManager.get(), true);
         return stdx::make_unique<KVDBRecoveryUnit>(
-            _db, *_counterManager.get(), *_durabilityManager.get());
+            _db, *_counterManager.get(), *_durabilityManager.get(), &_snapshotManager);
+    }
+
+    KVDBSnapshotManager& getSnapshotManager() {
+        return _snapshotManager;
     }
 
 private:
@@ -181,6 +202,7 @@ private:
 
     hse::KVDBTestSuiteFixture& _dbFixture = KVDBTestSuiteFixture::getFixture();
     hse::KVDB& _db = _dbFixture.getDb();
+    KVDBSnapshotManager _snapshotManager{_db, false};
     std::unique_ptr<KVDBDurabilityManager> _durabilityManager;
     std::unique_ptr<KVDBCounterManager> _counterManager;
     string _prefix;
@@ -285,4 +307,187 @@ TEST(KVDBIndexTest, SeekExactRemoveNext_Reverse_Unique) {
 TEST(KVDBIndexTest, SeekExactRemoveNext_Reverse_Standard) {
     testSeekExactRemoveNext(false, false);
 }
+
+TEST(KVDBIndexTest, StdIdxFilterPointGet) {
+    KVDBIdxFilter::setMemBudget(1 << 20);
+    ON_BLOCK_EXIT([] { KVDBIdxFilter::setMemBudget(0); });
+
+    auto harnessHelper = newHarnessHelper();
+    auto sorted = harnessHelper->newSortedDataInterface(false, {{key1, loc1}, {key3, loc1}});
+
+    // Enough point gets to queue a build, which runs in the background. Answers must not
+    // change before or after it.
+    auto pointGets = [&] {
+        for (int i = 0; i < 256; i++) {
+            auto opCtx = harnessHelper->newOperationContext();
+            auto cursor = sorted->newCursor(opCtx.get());
+            ASSERT_EQ(cursor->seekExact(key1), IndexKeyEntry(key1, loc1));
+            ASSERT_EQ(cursor->seekExact(key2), boost::none);
+            ASSERT_EQ(cursor->seekExact(key3), IndexKeyEntry(key3, loc1));
+        }
+    };
+
+    pointGets();
+    ASSERT_EQ(KVDBIdxFilter::getGlobalStats()["filters"].numberLong(), 1);
+
+    KVDBIdxFilter::buildQueued();
+    pointGets();
+
+    // Keys inserted once the filter is built must be found, including by the inserter.
+    {
+        auto opCtx = harnessHelper->newOperationContext();
+        WriteUnitOfWork uow(opCtx.get());
+        ASSERT_OK(sorted->insert(opCtx.get(), key2, loc2, true));
+
+        auto cursor = sorted->newCursor(opCtx.get());
+        ASSERT_EQ(cursor->seekExact(key2), IndexKeyEntry(key2, loc2));
+        uow.commit();
+    }
+
+    {
+        auto opCtx = harnessHelper->newOperationContext();
+        auto cursor = sorted->newCursor(opCtx.get());
+        ASSERT_EQ(cursor->seekExact(key2), IndexKeyEntry(key2, loc2));
+        ASSERT_EQ(cursor->seekExact(key4), boost::none);
+    }
+}
+
+TEST(KVDBIndexTest, StdIdxFilterMajorityRead) {
+    KVDBIdxFilter::setMemBudget(1 << 20);
+    ON_BLOCK_EXIT([] { KVDBIdxFilter::setMemBudget(0); });
+
+    HSEKVDBIndexHarness harness;
+    HarnessHelper& helper = harness;
+    auto sorted = helper.newSortedDataInterface(false, {{key1, loc1}, {key2, loc1}});
+
+    // The majority snapshot still holds key2, deleted before the filter is built.
+    auto& snapshotManager = harness.getSnapshotManager();
+    {
+        auto opCtx = helper.newOperationContext();
+        ASSERT_OK(snapshotManager.prepareForCreateSnapshot(opCtx.get()));
+        ASSERT_OK(snapshotManager.createSnapshot(opCtx.get(), SnapshotName(1)));
+        snapshotManager.setCommittedSnapshot(SnapshotName(1));
+    }
+    ON_BLOCK_EXIT([&] { snapshotManager.dropAllSnapshots(); });
+
+    removeFromIndex(&helper, sorted, {{key2, loc1}});
+
+    for (int i = 0; i < 256; i++) {
+        auto opCtx = helper.newOperationContext();
+        auto cursor = sorted->newCursor(opCtx.get());
+        ASSERT_EQ(cursor->seekExact(key1), IndexKeyEntry(key1, loc1));
+        ASSERT_EQ(cursor->seekExact(key2), boost::none);
+    }
+    KVDBIdxFilter::buildQueued();
+    ASSERT_GT(KVDBIdxFilter::getGlobalStats()["memUsed"].numberLong(), 0);
+
+    {
+        auto opCtx = helper.newOperationContext();
+        auto cursor = sorted->newCursor(opCtx.get());
+        ASSERT_EQ(cursor->seekExact(key2), boost::none);
+    }
+
+    {
+        auto opCtx = helper.newOperationContext();
+        ASSERT_OK(opCtx->recoveryUnit()->setReadFromMajorityCommittedSnapshot());
+        auto cursor = sorted->newCursor(opCtx.get());
+        ASSERT_EQ(cursor->seekExact(key1), IndexKeyEntry(key1, loc1));
+        ASSERT_EQ(cursor->seekExact(key2), IndexKeyEntry(key2, loc1));
+    }
+}
+
+TEST(KVDBIndexTest, StdIdxPrefixDict) {
+    HSEKVDBIndexHarness harness;
+    const string dictPrefix{"\0\0\0\2", 4};
+    const string plainPrefix{"\0\0\0\3", 4};
+    const BSONObj dictConfig = BSON("key_format" << KVDBIdxKeyDict::kKeyFormatName);
+
+    auto dict = harness.newStdIdx(dictConfig, dictPrefix, "DictIdent");
+    auto plain = harness.newStdIdx(BSONObj(), plainPrefix, "PlainIdent");
+
+    // Leading values arrive out of order, so entries land both between and around
+    // existing ones. The expected index order is the order of leads below.
+    const std::vector<string> leads{"tenant-0000-aardvark",
+                                    "tenant-0001-alpha",
+                                    "tenant-0002-beta",
+                                    "tenant-0003-gamma"};
+    const std::vector<int> insertOrder{3, 1, 2, 0};
+    const int kPerLead = 10;
+
+    auto makeKey = [&](int lead, int i) { return BSON("" << leads[lead] << "" << i); };
+    auto makeLoc = [&](int lead, int i) { return RecordId(lead * 100 + i + 1); };
+
+    {
+        auto opCtx = harness.newOperationContext();
+        WriteUnitOfWork uow(opCtx.get());
+        for (int lead : insertOrder) {
+            for (int i = 0; i < kPerLead; i++) {
+                ASSERT_OK(dict->insert(opCtx.get(), makeKey(lead, i), makeLoc(lead, i), true));
+                ASSERT_OK(plain->insert(opCtx.get(), makeKey(lead, i), makeLoc(lead, i), true));
+            }
+        }
+        uow.commit();
+    }
+
+    {
+        auto opCtx = harness.newOperationContext();
+        ASSERT_LT(dict->getSpaceUsedBytes(opCtx.get()), plain->getSpaceUsedBytes(opCtx.get()));
+    }
+
+    auto checkScans = [&](SortedDataInterface* sorted, int removedLead, int removedI) {
+        auto opCtx = harness.newOperationContext();
+
+        auto fwd = sorted->newCursor(opCtx.get());
+        auto entry = fwd->seek(BSONObj(), true);
+        for (int lead = 0; lead < int(leads.size()); lead++) {
+            for (int i = 0; i < kPerLead; i++) {
+                if (lead == removedLead && i == removedI)
+                    continue;
+                ASSERT_EQ(entry, IndexKeyEntry(makeKey(lead, i), makeLoc(lead, i)));
+                entry = fwd->next();
+            }
+        }
+        ASSERT_EQ(entry, boost::none);
+
+        auto rev = sorted->newCursor(opCtx.get(), false);
+        entry = rev->seek(BSONObj(), true);
+        for (int lead = leads.size() - 1; lead >= 0; lead--) {
+            for (int i = kPerLead - 1; i >= 0; i--) {
+                if (lead == removedLead && i == removedI)
+                    continue;
+                ASSERT_EQ(entry, IndexKeyEntry(makeKey(lead, i), makeLoc(lead, i)));
+                entry = rev->next();
+            }
+        }
+        ASSERT_EQ(entry, boost::none);
+
+        // Seeks inside an entry, to an absent lead between entries and past the end.
+        ASSERT_EQ(fwd->seek(makeKey(2, 5), true), IndexKeyEntry(makeKey(2, 5), makeLoc(2, 5)));
+        ASSERT_EQ(fwd->seek(BSON("" << "tenant-0002-c" << "" << 0), true),
+                  IndexKeyEntry(makeKey(3, 0), makeLoc(3, 0)));
+        ASSERT_EQ(fwd->seek(BSON("" << "tenant-0004" << "" << 0), true), boost::none);
+        ASSERT_EQ(rev->seek(BSON("" << "tenant-0002-c" << "" << 0), true),
+                  IndexKeyEntry(makeKey(2, kPerLead - 1), makeLoc(2, kPerLead - 1)));
+
+        ASSERT_EQ(fwd->seekExact(makeKey(1, 3)), IndexKeyEntry(makeKey(1, 3), makeLoc(1, 3)));
+        ASSERT_EQ(fwd->seekExact(BSON("" << "tenant-0001-alpha" << "" << kPerLead)), boost::none);
+        ASSERT_EQ(fwd->seekExact(BSON("" << "tenant-0002-c" << "" << 0)), boost::none);
+    };
+
+    checkScans(dict.get(), -1, -1);
+    checkScans(plain.get(), -1, -1);
+
+    {
+        auto opCtx = harness.newOperationContext();
+        WriteUnitOfWork uow(opCtx.get());
+        dict->unindex(opCtx.get(), makeKey(0, 4), makeLoc(0, 4), true);
+        uow.commit();
+    }
+    checkScans(dict.get(), 0, 4);
+
+    // A reopened index decodes its keys from the persisted dictionary.
+    dict.reset();
+    dict = harness.newStdIdx(dictConfig, dictPrefix, "DictIdent");
+    checkScans(dict.get(), 0, 4);
+}
 }  // namespace mongo
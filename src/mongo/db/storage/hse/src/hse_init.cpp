@@ -34,14 +34,19 @@
 #include "mongo/platform/basic.h"
 
 #include "mongo/base/init.h"
+#include "mongo/db/ftdc/ftdc_mongod.h"
 #include "mongo/db/service_context.h"
 #include "mongo/db/storage/kv/kv_storage_engine.h"
 #include "mongo/db/storage/storage_engine_metadata.h"
 #include "mongo/db/storage/storage_options.h"
+#include "mongo/stdx/memory.h"
 #include "mongo/util/mongoutils/str.h"
 
 #include "hse_engine.h"
+#include "hse_ftdc.h"
 #include "hse_global_options.h"
+#include "hse_idx_dict.h"
+#include "hse_record_store.h"
 #include "hse_server_status.h"
 #include "hse_stats.h"
 
@@ -77,6 +82,10 @@ public:
         // Intentionally leaked.
         auto leaked __attribute__((unused)) = new KVDBServerStatusSection(*engine);
 
+        addMongoDFTDCCollectors([engine](FTDCController* controller) {
+            controller->addPeriodicCollector(stdx::make_unique<KVDBFTDCCollector>(*engine));
+        });
+
         return new KVStorageEngine(engine, options);
     }
 
@@ -85,7 +94,11 @@ public:
     }
 
     virtual Status validateCollectionStorageOptions(const BSONObj& options) const {
-        return Status::OK();
+        return KVDBRecordStore::parseOptions(options, nullptr);
+    }
+
+    virtual Status validateIndexStorageOptions(const BSONObj& options) const {
+        return KVDBIdxKeyDict::parseIndexOptions(options).getStatus();
     }
 
     virtual Status validateMetadata(const StorageEngineMetadata& metadata,
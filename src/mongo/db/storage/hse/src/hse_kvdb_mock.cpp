@@ -0,0 +1,803 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "hse_clienttxn.h"
+#include "hse_kvdb_mock.h"
+#include "hse_kvscursor.h"
+#include "hse_stats.h"
+#include "hse_util.h"
+
+#include <boost/optional.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+using hse_stat::_hseSubTxnRetryCounter;
+
+// KVDB interface
+namespace hse {
+
+struct MockKvs;
+
+struct MockVersion {
+    uint64_t seq;
+    bool deleted;
+    string val;
+};
+
+struct MockTxn {
+    bool active{false};
+    uint64_t view{0};
+
+    // Uncommitted writes, none for a delete.
+    map<pair<MockKvs*, string>, boost::optional<string>> writes;
+};
+
+struct MockKvs {
+    string name;
+    int opens{0};
+
+    // Committed versions of each key, oldest first.
+    map<string, vector<MockVersion>> keys;
+
+    // Transaction holding an uncommitted write of each key.
+    map<string, MockTxn*> writers;
+};
+
+struct MockStore {
+    std::mutex mutex;
+    bool open{false};
+
+    // Sequence number of the last commit.
+    uint64_t seq{0};
+
+    map<string, unique_ptr<MockKvs>> kvses;
+
+    // Views of the active transactions and of the cursors, versions they may read are kept.
+    multiset<uint64_t> views;
+
+    set<MockTxn*> txns;
+};
+
+namespace {
+
+std::mutex registryMutex;
+
+map<string, shared_ptr<MockStore>>& registry() {
+    static auto* stores = new map<string, shared_ptr<MockStore>>();
+    return *stores;
+}
+
+MockKvs* kvsOf(KVSHandle handle) {
+    return static_cast<MockKvs*>(handle);
+}
+
+MockTxn* txnOf(ClientTxn* txn) {
+    return txn ? reinterpret_cast<MockTxn*>(txn->get_kvdb_txn()) : nullptr;
+}
+
+string keyOf(const KVDBData& data) {
+    return string((const char*)data.data(), data.len());
+}
+
+bool startsWith(const string& key, const string& prefix) {
+    return key.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Newest version committed at or before view, null if there is none or it is a delete.
+const MockVersion* visibleVersion(const vector<MockVersion>& versions, uint64_t view) {
+    for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+        if (it->seq <= view)
+            return it->deleted ? nullptr : &*it;
+    }
+
+    return nullptr;
+}
+
+// Value of key as seen by txn, or at view outside a transaction. Null if not found.
+const string* lookup(MockKvs& kvs, MockTxn* txn, uint64_t view, const string& key) {
+    if (txn) {
+        auto w = txn->writes.find({&kvs, key});
+        if (w != txn->writes.end())
+            return w->second ? &*w->second : nullptr;
+    }
+
+    auto it = kvs.keys.find(key);
+    if (it == kvs.keys.end())
+        return nullptr;
+
+    const MockVersion* v = visibleVersion(it->second, view);
+    return v ? &v->val : nullptr;
+}
+
+// Keys with the prefix seen by txn, or at view outside a transaction, in no particular order.
+vector<string> visibleKeys(MockKvs& kvs, MockTxn* txn, uint64_t view, const string& prefix) {
+    vector<string> found;
+
+    for (auto it = kvs.keys.lower_bound(prefix);
+         it != kvs.keys.end() && startsWith(it->first, prefix);
+         ++it) {
+        if (lookup(kvs, txn, view, it->first))
+            found.push_back(it->first);
+    }
+
+    if (txn) {
+        for (auto w = txn->writes.lower_bound({&kvs, prefix});
+             w != txn->writes.end() && w->first.first == &kvs &&
+             startsWith(w->first.second, prefix);
+             ++w) {
+            if (w->second && !kvs.keys.count(w->first.second))
+                found.push_back(w->first.second);
+        }
+    }
+
+    return found;
+}
+
+// Drops the versions no view can read, and the key once only an unreadable delete is left.
+void prune(MockStore& store, MockKvs& kvs, const string& key) {
+    uint64_t horizon = store.views.empty() ? store.seq : *store.views.begin();
+    auto it = kvs.keys.find(key);
+    auto& versions = it->second;
+    size_t oldest = 0;
+
+    for (size_t i = 0; i < versions.size(); i++) {
+        if (versions[i].seq <= horizon)
+            oldest = i;
+    }
+    versions.erase(versions.begin(), versions.begin() + oldest);
+
+    if (versions.size() == 1 && versions[0].deleted && versions[0].seq <= horizon)
+        kvs.keys.erase(it);
+}
+
+void apply(MockStore& store,
+           MockKvs& kvs,
+           const string& key,
+           const boost::optional<string>& val,
+           uint64_t seq) {
+    kvs.keys[key].push_back({seq, !val, val ? *val : string()});
+    prune(store, kvs, key);
+}
+
+hse_err_t write(MockStore& store,
+                MockKvs& kvs,
+                MockTxn* txn,
+                const string& key,
+                boost::optional<string> val) {
+    if (!txn) {
+        apply(store, kvs, key, val, ++store.seq);
+        return 0;
+    }
+
+    if (!txn->active)
+        return EINVAL;
+
+    auto w = kvs.writers.find(key);
+    if (w != kvs.writers.end() && w->second != txn)
+        return ECANCELED;
+
+    auto it = kvs.keys.find(key);
+    if (it != kvs.keys.end() && it->second.back().seq > txn->view)
+        return ECANCELED;
+
+    kvs.writers[key] = txn;
+    txn->writes[{&kvs, key}] = std::move(val);
+    return 0;
+}
+
+// Drops the uncommitted writes of txn and ends it.
+void endTxn(MockStore& store, MockTxn& txn) {
+    for (auto& w : txn.writes)
+        w.first.first->writers.erase(w.first.second);
+    txn.writes.clear();
+
+    if (txn.active)
+        store.views.erase(store.views.find(txn.view));
+    txn.active = false;
+}
+
+string prefixSuccessor(string prefix) {
+    while (!prefix.empty() && (unsigned char)prefix.back() == 0xff)
+        prefix.pop_back();
+    if (!prefix.empty())
+        prefix.back()++;
+
+    return prefix;
+}
+
+/**
+ * Cursor over the view of a transaction, or over the commits made before it was created,
+ * as of creation or the last update(). Holds that view so its versions are not pruned.
+ */
+class MockKvsCursor : public KvsCursor {
+public:
+    MockKvsCursor(shared_ptr<MockStore> store,
+                  MockKvs& kvs,
+                  KVDBData& prefix,
+                  bool forward,
+                  ClientTxn* txn)
+        : KvsCursor(prefix, forward),
+          _store(std::move(store)),
+          _kvs(kvs),
+          _prefix(keyOf(prefix)),
+          _prefixEnd(prefixSuccessor(_prefix)) {
+        lock_guard<std::mutex> lk(_store->mutex);
+        _bind(txnOf(txn));
+    }
+
+    virtual ~MockKvsCursor() {
+        lock_guard<std::mutex> lk(_store->mutex);
+        _unbind();
+    }
+
+    virtual Status update(ClientTxn* txn) {
+        lock_guard<std::mutex> lk(_store->mutex);
+        _unbind();
+        _bind(txnOf(txn));
+        return Status{};
+    }
+
+    virtual Status seek(const KVDBData& key, const KVDBData* kmax, KVDBData* pos) {
+        lock_guard<std::mutex> lk(_store->mutex);
+        _pos = keyOf(key);
+        _positioned = true;
+        _inclusive = true;
+
+        // Empty at eof.
+        _seekKey.clear();
+        _peek(_seekKey, nullptr);
+        if (pos)
+            *pos = KVDBData((const uint8_t*)_seekKey.data(), _seekKey.size());
+
+        return Status{};
+    }
+
+    virtual Status read(KVDBData& key, KVDBData& val, bool& eof) {
+        lock_guard<std::mutex> lk(_store->mutex);
+        eof = !_next();
+        if (!eof) {
+            key = KVDBData((const uint8_t*)_key.data(), _key.size());
+            val = KVDBData((const uint8_t*)_val.data(), _val.size());
+        }
+
+        return Status{};
+    }
+
+    virtual Status readBatch(KvsCursorBatch& batch, size_t maxKeys, bool& eof) {
+        lock_guard<std::mutex> lk(_store->mutex);
+        batch.clear();
+        eof = false;
+        while (batch.size() < maxKeys) {
+            eof = !_next();
+            if (eof)
+                break;
+            batch.push(_key.data(), _key.size(), _val.data(), _val.size());
+        }
+
+        return Status{};
+    }
+
+private:
+    using OwnWrites = map<string, boost::optional<string>>;
+
+    void _bind(MockTxn* txn) {
+        _own.clear();
+        if (txn) {
+            _view = txn->view;
+            for (auto w = txn->writes.lower_bound({&_kvs, _prefix});
+                 w != txn->writes.end() && w->first.first == &_kvs &&
+                 startsWith(w->first.second, _prefix);
+                 ++w)
+                _own[w->first.second] = w->second;
+        } else {
+            _view = _store->seq;
+        }
+        _store->views.insert(_view);
+    }
+
+    void _unbind() {
+        _store->views.erase(_store->views.find(_view));
+    }
+
+    // First key of m past the position in cursor order, m.end() if none has the prefix.
+    template <typename Map>
+    typename Map::const_iterator _first(const Map& m) const {
+        typename Map::const_iterator it;
+
+        if (_forward) {
+            if (!_positioned || _pos < _prefix)
+                it = m.lower_bound(_prefix);
+            else
+                it = _inclusive ? m.lower_bound(_pos) : m.upper_bound(_pos);
+            return it != m.end() && startsWith(it->first, _prefix) ? it : m.end();
+        }
+
+        if (!_positioned || (!_prefixEnd.empty() && _pos >= _prefixEnd))
+            it = _prefixEnd.empty() ? m.end() : m.lower_bound(_prefixEnd);
+        else
+            it = _inclusive ? m.upper_bound(_pos) : m.lower_bound(_pos);
+        if (it == m.begin())
+            return m.end();
+        --it;
+        return startsWith(it->first, _prefix) ? it : m.end();
+    }
+
+    template <typename Map>
+    typename Map::const_iterator _step(const Map& m, typename Map::const_iterator it) const {
+        if (_forward) {
+            ++it;
+        } else if (it == m.begin()) {
+            return m.end();
+        } else {
+            --it;
+        }
+
+        return it != m.end() && startsWith(it->first, _prefix) ? it : m.end();
+    }
+
+    // Next pair past the position, from the commits or the transaction's writes, without
+    // moving. False at eof.
+    bool _peek(string& key, const string** val) const {
+        const auto& keys = _kvs.keys;
+        auto c = _first(keys);
+        while (c != keys.end() && (_own.count(c->first) || !visibleVersion(c->second, _view)))
+            c = _step(keys, c);
+
+        auto o = _first(_own);
+        while (o != _own.end() && !o->second)
+            o = _step(_own, o);
+
+        bool haveCommitted = c != keys.end();
+        bool haveOwn = o != _own.end();
+        if (!haveCommitted && !haveOwn)
+            return false;
+
+        if (haveOwn &&
+            (!haveCommitted || (_forward ? o->first < c->first : o->first > c->first))) {
+            key = o->first;
+            if (val)
+                *val = &*o->second;
+        } else {
+            key = c->first;
+            if (val)
+                *val = &visibleVersion(c->second, _view)->val;
+        }
+
+        return true;
+    }
+
+    bool _next() {
+        const string* val;
+
+        if (!_peek(_key, &val))
+            return false;
+
+        _val = *val;
+        _pos = _key;
+        _positioned = true;
+        _inclusive = false;
+        return true;
+    }
+
+    shared_ptr<MockStore> _store;
+    MockKvs& _kvs;
+    const string _prefix;
+
+    // Smallest key past those with the prefix, empty if there is none.
+    const string _prefixEnd;
+
+    uint64_t _view{0};
+    OwnWrites _own;
+
+    // Before any seek or read, the cursor is at the start of the prefix.
+    bool _positioned{false};
+    bool _inclusive{false};
+    string _pos;
+
+    string _seekKey;
+    string _key;
+    string _val;
+};
+
+}  // namespace
+
+KVDBMock::~KVDBMock() {
+    if (_store)
+        kvdb_close();
+}
+
+Status KVDBMock::kvdb_make(const char* kvdb_home, const vector<string>& params) {
+    lock_guard<std::mutex> lk(registryMutex);
+    auto& store = registry()[kvdb_home];
+    if (store)
+        return Status{EEXIST};
+
+    store = make_shared<MockStore>();
+    return Status{};
+}
+
+Status KVDBMock::kvdb_open(const char* kvdb_home, const vector<string>& params) {
+    lock_guard<std::mutex> lk(registryMutex);
+    auto it = registry().find(kvdb_home);
+    if (it == registry().end())
+        return Status{ENOENT};
+
+    lock_guard<std::mutex> slk(it->second->mutex);
+    if (it->second->open)
+        return Status{EBUSY};
+
+    it->second->open = true;
+    _store = it->second;
+    return Status{};
+}
+
+Status KVDBMock::kvdb_kvs_open(const char* kvs_name,
+                               const vector<string>& params,
+                               KVSHandle& kvs_out) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    auto it = _store->kvses.find(kvs_name);
+    if (it == _store->kvses.end())
+        return Status{ENOENT};
+
+    it->second->opens++;
+    kvs_out = (KVSHandle)it->second.get();
+    return Status{};
+}
+
+Status KVDBMock::kvdb_kvs_close(KVSHandle handle) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    kvsOf(handle)->opens--;
+    return Status{};
+}
+
+struct hse_kvdb* KVDBMock::kvdb_handle() {
+    return _store ? reinterpret_cast<struct hse_kvdb*>(this) : nullptr;
+}
+
+Status KVDBMock::kvdb_get_names(size_t* count, char*** kvs_list) {
+    lock_guard<std::mutex> lk(_store->mutex);
+
+    // Null terminated, for kvdb_free_names().
+    char** names = (char**)calloc(_store->kvses.size() + 1, sizeof(char*));
+    if (!names)
+        return Status{ENOMEM};
+
+    size_t i = 0;
+    for (auto& kvs : _store->kvses)
+        names[i++] = strdup(kvs.first.c_str());
+
+    *count = i;
+    *kvs_list = names;
+    return Status{};
+}
+
+Status KVDBMock::kvdb_free_names(char** kvsv) {
+    for (char** name = kvsv; name && *name; name++)
+        free(*name);
+    free(kvsv);
+    return Status{};
+}
+
+Status KVDBMock::kvdb_kvs_make(const char* kvs_name, const vector<string>& params) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    auto& kvs = _store->kvses[kvs_name];
+    if (kvs)
+        return Status{EEXIST};
+
+    kvs.reset(new MockKvs());
+    kvs->name = kvs_name;
+    return Status{};
+}
+
+Status KVDBMock::kvdb_kvs_drop(const char* kvs_name) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    auto it = _store->kvses.find(kvs_name);
+    if (it == _store->kvses.end())
+        return Status{ENOENT};
+    if (it->second->opens)
+        return Status{EBUSY};
+
+    _store->kvses.erase(it);
+    return Status{};
+}
+
+Status KVDBMock::kvdb_close() {
+    {
+        lock_guard<std::mutex> lk(_store->mutex);
+        for (MockTxn* txn : _store->txns) {
+            endTxn(*_store, *txn);
+            delete txn;
+        }
+        _store->txns.clear();
+        _store->open = false;
+    }
+
+    _store.reset();
+    return Status{};
+}
+
+struct hse_kvdb_txn* KVDBMock::kvdb_txn_alloc() {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* txn = new MockTxn();
+    _store->txns.insert(txn);
+    return reinterpret_cast<struct hse_kvdb_txn*>(txn);
+}
+
+void KVDBMock::kvdb_txn_free(struct hse_kvdb_txn* txn) {
+    // kvdb_close() has already freed it.
+    if (!_store)
+        return;
+
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = reinterpret_cast<MockTxn*>(txn);
+    endTxn(*_store, *mTxn);
+    _store->txns.erase(mTxn);
+    delete mTxn;
+}
+
+Status KVDBMock::kvdb_txn_begin(struct hse_kvdb_txn* txn) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = reinterpret_cast<MockTxn*>(txn);
+    if (mTxn->active)
+        return Status{EINVAL};
+
+    mTxn->active = true;
+    mTxn->view = _store->seq;
+    _store->views.insert(mTxn->view);
+    return Status{};
+}
+
+Status KVDBMock::kvdb_txn_commit(struct hse_kvdb_txn* txn) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = reinterpret_cast<MockTxn*>(txn);
+    if (!mTxn->active)
+        return Status{EINVAL};
+
+    // All writes become visible at once, at a single sequence number.
+    auto writes = std::move(mTxn->writes);
+    endTxn(*_store, *mTxn);
+
+    uint64_t seq = ++_store->seq;
+    for (auto& w : writes) {
+        w.first.first->writers.erase(w.first.second);
+        apply(*_store, *w.first.first, w.first.second, w.second, seq);
+    }
+
+    return Status{};
+}
+
+Status KVDBMock::kvdb_txn_abort(struct hse_kvdb_txn* txn) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    endTxn(*_store, *reinterpret_cast<MockTxn*>(txn));
+    return Status{};
+}
+
+KvsCursor* KVDBMock::kvs_cursor_create(KVSHandle handle,
+                                       KVDBData& prefix,
+                                       bool forward,
+                                       ClientTxn* txn) {
+    return new MockKvsCursor(_store, *kvsOf(handle), prefix, forward, txn);
+}
+
+Status KVDBMock::kvs_put(KVSHandle handle,
+                         ClientTxn* txn,
+                         const KVDBData& key,
+                         const KVDBData& val,
+                         unsigned int flags) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    return Status{write(*_store, *kvsOf(handle), txnOf(txn), keyOf(key), keyOf(val))};
+}
+
+Status KVDBMock::kvs_put(KVSHandle handle, const KVDBData& key, const KVDBData& val) {
+    return kvs_put(handle, nullptr, key, val, 0);
+}
+
+Status KVDBMock::kvs_get(
+    KVSHandle handle, ClientTxn* txn, const KVDBData& key, KVDBData& val, bool& found) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = txnOf(txn);
+    if (mTxn && !mTxn->active)
+        return Status{EINVAL};
+
+    const string* v =
+        lookup(*kvsOf(handle), mTxn, mTxn ? mTxn->view : _store->seq, keyOf(key));
+    found = v != nullptr;
+    if (found) {
+        // As with hse_kvs_get(), a value too big for the buffer is cut short.
+        size_t copied = std::min((size_t)(val.getAllocLen() - val.len()), v->size());
+        memcpy(val.data() + val.len(), v->data(), copied);
+        val.adjustLen(copied);
+    }
+
+    return Status{};
+}
+
+Status KVDBMock::kvs_probe_len(
+    KVSHandle handle, ClientTxn* txn, const KVDBData& key, KVDBData& val, bool& found) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = txnOf(txn);
+    if (mTxn && !mTxn->active)
+        return Status{EINVAL};
+
+    const string* v =
+        lookup(*kvsOf(handle), mTxn, mTxn ? mTxn->view : _store->seq, keyOf(key));
+    found = v != nullptr;
+    if (found) {
+        // Copies what fits but reports the full length, as KVDBImpl does.
+        memcpy(val.data(), v->data(), std::min((size_t)val.getAllocLen(), v->size()));
+        val.adjustLen(v->size());
+    }
+
+    return Status{};
+}
+
+Status KVDBMock::kvs_probe_key(KVSHandle handle,
+                               ClientTxn* txn,
+                               const KVDBData& key,
+                               bool& found) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = txnOf(txn);
+    if (mTxn && !mTxn->active)
+        return Status{EINVAL};
+
+    found = lookup(*kvsOf(handle), mTxn, mTxn ? mTxn->view : _store->seq, keyOf(key));
+    return Status{};
+}
+
+Status KVDBMock::kvs_prefix_probe(KVSHandle handle,
+                                  ClientTxn* txn,
+                                  const KVDBData& prefix,
+                                  KVDBData& key,
+                                  KVDBData& val,
+                                  hse_kvs_pfx_probe_cnt& found) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockTxn* mTxn = txnOf(txn);
+    if (mTxn && !mTxn->active)
+        return Status{EINVAL};
+
+    MockKvs& kvs = *kvsOf(handle);
+    uint64_t view = mTxn ? mTxn->view : _store->seq;
+    vector<string> keys = visibleKeys(kvs, mTxn, view, keyOf(prefix));
+    if (keys.empty()) {
+        found = HSE_KVS_PFX_FOUND_ZERO;
+    } else if (keys.size() > 1) {
+        found = HSE_KVS_PFX_FOUND_MUL;
+    } else {
+        const string* v = lookup(kvs, mTxn, view, keys[0]);
+
+        found = HSE_KVS_PFX_FOUND_ONE;
+        invariantHse(keys[0].size() <= key.getAllocLen());
+        memcpy(key.data(), keys[0].data(), keys[0].size());
+        key.adjustLen(keys[0].size());
+
+        size_t copied = std::min((size_t)val.getAllocLen(), v->size());
+        memcpy(val.data(), v->data(), copied);
+        val.adjustLen(copied);
+    }
+
+    return Status{};
+}
+
+Status KVDBMock::kvs_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& key) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    return Status{write(*_store, *kvsOf(handle), txnOf(txn), keyOf(key), boost::none)};
+}
+
+Status KVDBMock::kvs_prefix_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& prefix) {
+    lock_guard<std::mutex> lk(_store->mutex);
+    MockKvs& kvs = *kvsOf(handle);
+    MockTxn* mTxn = txnOf(txn);
+    if (mTxn && !mTxn->active)
+        return Status{EINVAL};
+
+    for (auto& key : visibleKeys(kvs, mTxn, mTxn ? mTxn->view : _store->seq, keyOf(prefix))) {
+        hse_err_t ret = write(*_store, kvs, mTxn, key, boost::none);
+        if (ret)
+            return Status{ret};
+    }
+
+    return Status{};
+}
+
+Status KVDBMock::kvs_iter_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& prefix) {
+    return kvs_prefix_delete(handle, txn, prefix);
+}
+
+Status KVDBMock::kvdb_sync() {
+    return Status{};
+}
+
+Status KVDBMock::kvdb_compact() {
+    return Status{};
+}
+
+Status KVDBMock::kvdb_compact_cancel() {
+    return Status{};
+}
+
+Status KVDBMock::kvdb_compact_status(struct hse_kvdb_compact_status& status) {
+    memset(&status, 0, sizeof(status));
+    return Status{};
+}
+
+Status KVDBMock::kvdb_mclass_info(enum hse_mclass mclass,
+                                  bool& configured,
+                                  struct hse_mclass_info& info) {
+    configured = false;
+    return Status{};
+}
+
+// As in KVDBImpl, sub transactions retry the writes that conflict with a transaction.
+Status KVDBMock::kvs_sub_txn_put(KVSHandle handle, const KVDBData& key, const KVDBData& val) {
+    Status ret{};
+
+    SUB_TXN_OP_RETRY_LOOP_BEGIN {
+        ret = kvs_put(handle, &cTxn, key, val, 0);
+    }
+    SUB_TXN_OP_RETRY_LOOP_END(ret)
+
+    return ret;
+}
+
+Status KVDBMock::kvs_sub_txn_delete(KVSHandle handle, const KVDBData& key) {
+    Status ret{};
+
+    SUB_TXN_OP_RETRY_LOOP_BEGIN {
+        ret = kvs_delete(handle, &cTxn, key);
+    }
+    SUB_TXN_OP_RETRY_LOOP_END(ret)
+
+    return ret;
+}
+
+Status KVDBMock::kvs_sub_txn_prefix_delete(KVSHandle handle, const KVDBData& prefix) {
+    Status ret{};
+
+    SUB_TXN_OP_RETRY_LOOP_BEGIN {
+        ret = kvs_prefix_delete(handle, &cTxn, prefix);
+    }
+    SUB_TXN_OP_RETRY_LOOP_END(ret)
+
+    return ret;
+}
+}  // namespace hse
@@ -0,0 +1,155 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "hse.h"
+
+// KVDB interface
+namespace hse {
+
+struct MockStore;
+
+/**
+ * In-memory KVDB, for unit tests and for profiling the connector without HSE media.
+ *
+ * Each kvs is an ordered map from a key to its versions. A transaction reads what was
+ * committed when it began, plus its own writes. As in HSE, its put or delete fails with
+ * ECANCELED if the key was committed after the transaction began or has an uncommitted
+ * write from another transaction. Writes outside a transaction commit at once.
+ *
+ * Contents live as long as the process: closing the KVDB keeps them for the next
+ * kvdb_open() of the same home, and kvdb_close() frees the transactions still allocated.
+ * A single mutex serializes all operations.
+ */
+class KVDBMock : public KVDB {
+public:
+    virtual ~KVDBMock();
+
+    virtual Status kvdb_make(const char* kvdb_home, const vector<string>& params);
+
+    virtual Status kvdb_open(const char* kvdb_home, const vector<string>& params);
+
+    virtual Status kvdb_kvs_open(const char* kvs_name,
+                                 const vector<string>& params,
+                                 KVSHandle& kvs_out);
+
+    virtual Status kvdb_kvs_close(KVSHandle handle);
+
+    // Not an HSE handle, only non-null while the KVDB is open.
+    virtual struct hse_kvdb* kvdb_handle();
+
+    virtual Status kvdb_get_names(size_t* count, char*** kvs_list);
+
+    virtual Status kvdb_free_names(char** kvsv);
+
+    virtual Status kvdb_kvs_make(const char* kvs_name, const vector<string>& params);
+
+    virtual Status kvdb_kvs_drop(const char* kvs_name);
+
+    virtual Status kvdb_close();
+
+    virtual struct hse_kvdb_txn* kvdb_txn_alloc();
+
+    virtual void kvdb_txn_free(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_begin(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_commit(struct hse_kvdb_txn* txn);
+
+    virtual Status kvdb_txn_abort(struct hse_kvdb_txn* txn);
+
+    virtual KvsCursor* kvs_cursor_create(KVSHandle handle,
+                                         KVDBData& prefix,
+                                         bool forward,
+                                         ClientTxn* txn);
+
+    virtual Status kvs_put(KVSHandle handle,
+                           ClientTxn* txn,
+                           const KVDBData& key,
+                           const KVDBData& val,
+                           unsigned int flags);
+
+    virtual Status kvs_sub_txn_put(KVSHandle handle, const KVDBData& key, const KVDBData& val);
+
+    virtual Status kvs_put(KVSHandle handle, const KVDBData& key, const KVDBData& val);
+
+    virtual Status kvs_get(
+        KVSHandle handle, ClientTxn* txn, const KVDBData& key, KVDBData& val, bool& found);
+
+    virtual Status kvs_probe_key(KVSHandle handle,
+                                 ClientTxn* txn,
+                                 const KVDBData& key,
+                                 bool& found);
+
+    virtual Status kvs_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& key);
+
+    virtual Status kvs_sub_txn_delete(KVSHandle handle, const KVDBData& key);
+
+    virtual Status kvs_prefix_probe(KVSHandle handle,
+                                    ClientTxn* txn,
+                                    const KVDBData& prefix,
+                                    KVDBData& key,
+                                    KVDBData& val,
+                                    hse_kvs_pfx_probe_cnt& found);
+
+    virtual Status kvs_probe_len(
+        KVSHandle handle, ClientTxn* txn, const KVDBData& key, KVDBData& val, bool& found);
+
+    virtual Status kvs_prefix_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& prefix);
+
+    virtual Status kvs_sub_txn_prefix_delete(KVSHandle handle, const KVDBData& prefix);
+
+    virtual Status kvs_iter_delete(KVSHandle handle, ClientTxn* txn, const KVDBData& prefix);
+
+    virtual Status kvdb_sync();
+
+    virtual Status kvdb_compact();
+
+    virtual Status kvdb_compact_cancel();
+
+    virtual Status kvdb_compact_status(struct hse_kvdb_compact_status& status);
+
+    virtual Status kvdb_mclass_info(enum hse_mclass mclass,
+                                    bool& configured,
+                                    struct hse_mclass_info& info);
+
+private:
+    // Null while closed.
+    std::shared_ptr<MockStore> _store;
+};
+
+}  // namespace hse
@@ -51,27 +51,20 @@ using mongo::warning;
 
 using hse_stat::_hseKvsCursorCreateCounter;
 using hse_stat::_hseKvsCursorCreateLatency;
+using hse_stat::_hseKvsCursorCreateRetryCounter;
 using hse_stat::_hseKvsCursorDestroyCounter;
 using hse_stat::_hseKvsCursorDestroyLatency;
+using hse_stat::_hseKvsCursorReadBatchCounter;
+using hse_stat::_hseKvsCursorReadBatchLatency;
 using hse_stat::_hseKvsCursorReadCounter;
 using hse_stat::_hseKvsCursorReadLatency;
 
-namespace {
-int RETRY_FIB_SEQ_EAGAIN[] = {1, 2, 3, 5, 8, 13};
-int FIB_LEN = 6;
-}  // namespace
-
 // KVDB interface
 namespace hse {
 
-KvsCursor* create_cursor(KVSHandle kvs, KVDBData& prefix, bool forward, ClientTxn* lnkd_txn) {
-    return new KvsCursor(kvs, prefix, forward, lnkd_txn);
-}
-
 void KvsCursor::_kvs_cursor_create(ClientTxn* lnkd_txn) {
     int retries = 0;
     int flags = 0;
-    unsigned long long sleepTime = 0;
     struct hse_kvdb_txn* kvdb_txn = nullptr;
 
     if (lnkd_txn)
@@ -82,14 +75,9 @@ void KvsCursor::_kvs_cursor_create(ClientTxn* lnkd_txn) {
 
     /* [HSE_REVISIT] This loop retries indefinitely on an EAGAIN. */
     while (true) {
-        if (retries < FIB_LEN) {
-            sleepTime = RETRY_FIB_SEQ_EAGAIN[retries % FIB_LEN];
-        } else {
-            sleepTime = RETRY_FIB_SEQ_EAGAIN[FIB_LEN - 1];
-            if (retries % 20 == 0)
-                warning() << "HSE: kvs_cursor_create returning EAGAIN after " << retries
-                          << " retries";
-        }
+        if (retries && retries % 20 == 0)
+            warning() << "HSE: kvs_cursor_create returning EAGAIN after " << retries
+                      << " retries";
 
         _hseKvsCursorCreateCounter.add();
         auto lt = _hseKvsCursorCreateLatency.begin();
@@ -102,7 +90,8 @@ void KvsCursor::_kvs_cursor_create(ClientTxn* lnkd_txn) {
         if (st.getErrno() != EAGAIN)
             throw KVDBException("non EAGAIN failure from hse_kvs_cursor_create()");
 
-        this_thread::sleep_for(chrono::milliseconds(sleepTime));
+        _hseKvsCursorCreateRetryCounter.add();
+        KVDBBackoff::pause(retries);
 
         retries++;
     }
@@ -125,7 +114,25 @@ KvsCursor::KvsCursor(KVSHandle handle, KVDBData& prefix, bool forward, ClientTxn
     _kvs_cursor_create(lnkd_txn);
 }
 
+KvsCursor::KvsCursor(KVDBData& prefix, bool forward)
+    : _kvs(nullptr),
+      _pfx(prefix),
+      _forward(forward),
+      _cursor(0),
+      _start(0),
+      _end(0),
+      _curr(0),
+      _kvs_key(0),
+      _kvs_klen(0),
+      _kvs_seek_key(0),
+      _kvs_seek_klen(0),
+      _kvs_val(0),
+      _kvs_vlen(0) {}
+
 KvsCursor::~KvsCursor() {
+    if (!_cursor)
+        return;
+
     _hseKvsCursorDestroyCounter.add();
     auto lt = _hseKvsCursorDestroyLatency.begin();
     ::hse_kvs_cursor_destroy(_cursor);
@@ -192,6 +199,32 @@ Status KvsCursor::read(KVDBData& key, KVDBData& val, bool& eof) {
     return 0;
 }
 
+Status KvsCursor::readBatch(KvsCursorBatch& batch, size_t maxKeys, bool& eof) {
+    Status st{};
+    bool _eof = false;
+
+    batch.clear();
+    _kvs_seek_key = 0;
+    _kvs_seek_klen = 0;
+
+    // One stats update for the whole batch, reads are counted per key.
+    auto lt = _hseKvsCursorReadBatchLatency.begin();
+    while (batch.size() < maxKeys) {
+        st = Status{::hse_kvs_cursor_read(
+            _cursor, 0, &_kvs_key, &_kvs_klen, &_kvs_val, &_kvs_vlen, &_eof)};
+        if (!st.ok() || _eof)
+            break;
+
+        batch.push(_kvs_key, _kvs_klen, _kvs_val, _kvs_vlen);
+    }
+    _hseKvsCursorReadBatchLatency.end(lt);
+    _hseKvsCursorReadBatchCounter.add();
+    _hseKvsCursorReadCounter.add(batch.size());
+
+    eof = _eof;
+    return st;
+}
+
 int KvsCursor::_read_kvs(bool& eof) {
     Status st{};
     bool _eof;
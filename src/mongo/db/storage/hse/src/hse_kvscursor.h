@@ -38,6 +38,7 @@
 
 #include <mutex>
 #include <set>
+#include <vector>
 
 using namespace std;
 
@@ -57,7 +58,52 @@ namespace hse {
 
 class KvsCursor;
 
-KvsCursor* create_cursor(KVSHandle kvs, KVDBData& prefix, bool forward, ClientTxn* lnkd_txn = 0);
+/**
+ * Key/value pairs read ahead of a cursor position, copied back to back into one
+ * buffer. Pairs handed out by pop() stay valid until the batch is refilled or cleared.
+ */
+class KvsCursorBatch {
+public:
+    bool empty() const {
+        return _next == _entries.size();
+    }
+
+    void clear() {
+        _buf.clear();
+        _entries.clear();
+        _next = 0;
+    }
+
+    void pop(KVDBData& key, KVDBData& val) {
+        const Entry& e = _entries[_next++];
+        key = KVDBData(_buf.data() + e.offset, e.klen);
+        val = KVDBData(_buf.data() + e.offset + e.klen, e.vlen);
+    }
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+    // Copies a pair into the batch.
+    void push(const void* key, size_t klen, const void* val, size_t vlen) {
+        size_t offset = _buf.size();
+
+        _buf.insert(_buf.end(), (const uint8_t*)key, (const uint8_t*)key + klen);
+        _buf.insert(_buf.end(), (const uint8_t*)val, (const uint8_t*)val + vlen);
+        _entries.push_back({offset, klen, vlen});
+    }
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t klen;
+        size_t vlen;
+    };
+
+    std::vector<uint8_t> _buf;
+    std::vector<Entry> _entries;
+    size_t _next{0};
+};
 
 class KvsCursor {
 public:
@@ -71,11 +117,17 @@ public:
 
     virtual Status read(KVDBData& key, KVDBData& val, bool& eof);
 
+    // Replaces the contents of batch with up to maxKeys pairs, fewer at eof.
+    virtual Status readBatch(KvsCursorBatch& batch, size_t maxKeys, bool& eof);
+
     virtual Status save();
 
     virtual Status restore();
 
 protected:
+    // For cursors over other KVDB implementations, creates no HSE cursor.
+    KvsCursor(KVDBData& prefix, bool forward);
+
     void _kvs_cursor_create(ClientTxn* lnkd_txn);
     int _read_kvs(bool& eof);
 
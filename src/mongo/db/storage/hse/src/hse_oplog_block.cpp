@@ -50,8 +50,7 @@ using hse::OPLOG_CURR_BLK_KEY;
 
 using hse::KVDBRecordStoreKey;
 using hse::KVDBOplogBlockKey;
-using hse::_getNumChunks;
-using hse::_getValueLength;
+using hse::KVDBValueLayout;
 using hse::_makeChunkKey;
 
 namespace mongo {
@@ -718,6 +717,8 @@ hse::Status KVDBOplogBlockManager::_deleteBlockByScan(KVDBRecoveryUnit* ru,
     bool eof = false;
     int64_t sizeDel = 0;
     int64_t recsDel = 0;
+    // The oplog keeps the default layout of large values.
+    const KVDBValueLayout layout;
 
     st = ru->cursorSeek(cursor, compatKey, &foundKey);
     if (!st.ok()) {
@@ -735,13 +736,13 @@ hse::Status KVDBOplogBlockManager::_deleteBlockByScan(KVDBRecoveryUnit* ru,
 
     if (inclusive) {
         invariantHse(!eof);
-        st = _delKeyHelper(ru, elKey, _getNumChunks(_getValueLength(elVal)));
+        st = _delKeyHelper(ru, elKey, layout.numChunks(layout.valueLength(elVal)));
         if (!st.ok()) {
             ru->endScan(cursor);
             return st;
         }
 
-        sizeDel += _getValueLength(elVal);
+        sizeDel += layout.valueLength(elVal);
         recsDel++;
     }
 
@@ -755,13 +756,13 @@ hse::Status KVDBOplogBlockManager::_deleteBlockByScan(KVDBRecoveryUnit* ru,
         if (eof)
             break;
 
-        st = _delKeyHelper(ru, elKey, _getNumChunks(_getValueLength(elVal)));
+        st = _delKeyHelper(ru, elKey, layout.numChunks(layout.valueLength(elVal)));
         if (!st.ok()) {
             ru->endScan(cursor);
             return st;
         }
 
-        sizeDel += _getValueLength(elVal);
+        sizeDel += layout.valueLength(elVal);
         recsDel++;
     }
 
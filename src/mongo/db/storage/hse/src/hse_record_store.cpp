@@ -39,6 +39,7 @@
 #include "mongo/db/storage/oplog_hack.h"
 #include "mongo/stdx/memory.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 
 #include <boost/thread/locks.hpp>
 
@@ -56,18 +57,17 @@ using hse::KVDBData;
 using hse::KVDBRecordStoreKey;
 
 using hse::_cursorRead;
-using hse::_getNumChunks;
-using hse::_getValueLength;
-using hse::_getValueOffset;
 using hse::arrayToHexStr;
 using hse::DEFAULT_PFX_LEN;
+using hse::KVDBValueLayout;
 using hse::VALUE_META_SIZE;
-using hse::VALUE_META_THRESHOLD_LEN;
 
 using hse_stat::_hseAppBytesReadCounter;
 using hse_stat::_hseAppBytesWrittenCounter;
 using hse_stat::_hseOplogCursorCreateCounter;
 using hse_stat::_hseOplogCursorReadRate;
+using hse_stat::KVDBIdentStats;
+using hse_stat::KVDBStat;
 
 using mongo::BSONElement;
 using mongo::BSONObjBuilder;
@@ -79,17 +79,55 @@ namespace mongo {
 namespace {
 static const int RS_RETRIES_ON_CANCELED = 5;
 
+// Ident config field holding a collection's value compression override, "on" or "off".
+const char kValueCompressionField[] = "value_compression";
+
+// Ident config field set to "dedicated" for a collection stored in KVSes of its own.
+const char kKvsPlacementField[] = "kvs_placement";
+
+// Ident config fields holding a collection's large value layout, see KVDBValueLayout.
+const char kLargeValueThresholdField[] = "large_value_threshold";
+const char kLargeValueChunkLenField[] = "large_value_chunk_len";
+
+// Adds the microseconds of its lifetime to an ident stat, if stats are enabled.
+class IdentStatTimer {
+public:
+    IdentStatTimer(KVDBIdentStats& stats, KVDBIdentStats::Op op)
+        : _stats(stats), _op(op), _enabled(KVDBStat::isStatsEnabledGlobally()) {
+        if (_enabled)
+            _start = std::chrono::steady_clock::now();
+    }
+
+    ~IdentStatTimer() {
+        if (_enabled)
+            _stats.add(_op,
+                       std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - _start)
+                           .count());
+    }
+
+private:
+    KVDBIdentStats& _stats;
+    const KVDBIdentStats::Op _op;
+    const bool _enabled;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Reads the value of loc, assembling it from its chunks if it is large. On return, the
+// record data starts at *offset in value.
 bool _getKey(OperationContext* opctx,
              struct KVDBRecordStoreKey* key,
              const KVSHandle& baseKvs,
              const KVSHandle& chunkKvs,
+             const KVDBValueLayout& layout,
              const RecordId& loc,
              KVDBData& value,
+             unsigned int* offset,
              bool use_txn) {
     __attribute__((aligned(16))) struct KVDBRecordStoreKey chunkKey;
     hse::Status st;
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
-    unsigned int val_len;
+    unsigned int val_len, num_chunks;
     bool found;
 
     // read compressed first chunk
@@ -102,20 +140,21 @@ bool _getKey(OperationContext* opctx,
     if (!found)
         return false;
 
-    val_len = _getValueLength(value);
+    val_len = layout.valueLength(value);
+    num_chunks = layout.numChunks(val_len);
+    *offset = layout.valueOffset(value);
 
-    if (val_len > VALUE_META_THRESHOLD_LEN) {
+    if (num_chunks) {
         // The value spans multiple chunks so we will read it all into a large buffer
         // If compressed, largevalue will contain the 4bytes length +
         // algo byte + leb128 bytes + compressed user value.
         hse::Status st;
         KVDBData largeValue{};
 
-        // Allocate space and copy the first chunk just read into the larger buffer.
+        // Allocate space and copy the header and head just read into the larger buffer.
         largeValue.createOwned(val_len + VALUE_META_SIZE);
-        st = largeValue.copy(value.data(), HSE_KVS_VALUE_LEN_MAX);
+        st = largeValue.copy(value.data(), value.len());
         invariantHse(st.ok());
-        invariantHse(largeValue.len() == HSE_KVS_VALUE_LEN_MAX);
 
         uint32_t chunk = 0;
 
@@ -127,7 +166,7 @@ bool _getKey(OperationContext* opctx,
 
             KVDBData compatKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
 
-            st = ru->getMCo(chunkKvs, compatKey, largeValue, found, use_txn);
+            st = ru->getChunk(chunkKvs, compatKey, largeValue, found, use_txn);
             invariantHseSt(st);
             if (!found) {
                 log() << "_getKey: key "
@@ -140,7 +179,7 @@ bool _getKey(OperationContext* opctx,
         }
 
         invariantHse(largeValue.len() == val_len + VALUE_META_SIZE);
-        invariantHse(_getNumChunks(val_len) == chunk);
+        invariantHse(num_chunks == chunk);
 
         value = largeValue;
     }
@@ -171,13 +210,16 @@ KVDBRecordStore::KVDBRecordStore(OperationContext* ctx,
                                  KVSHandle& largeKvs,
                                  uint32_t prefix,
                                  KVDBDurabilityManager& durabilityManager,
-                                 KVDBCounterManager& counterManager)
+                                 KVDBCounterManager& counterManager,
+                                 const BSONObj& config)
     : RecordStore(ns),
       _db(db),
       _metaKvs(metaKvs),
       _colKvs(colKvs),
       _largeKvs(largeKvs),
       _prefixVal(prefix),
+      _putFlags(putFlagsFromConfig(config)),
+      _layout(_layoutFromConfig(config)),
       _durabilityManager(durabilityManager),
       _counterManager(counterManager),
       _ident(id.toString()),
@@ -189,36 +231,116 @@ KVDBRecordStore::KVDBRecordStore(OperationContext* ctx,
 
     LOG(1) << "opening collection " << ns;
 
+    if (config.getStringField(kValueCompressionField) == StringData(KVDBDocDict::kCompressionName))
+        _docDict = KVDBDocDict::open(_db, _metaKvs, _ident);
+
     _dataSizeKeyID = KVDBCounterMapUniqID.fetch_add(1);
     _storageSizeKeyID = KVDBCounterMapUniqID.fetch_add(1);
     _numRecordsKeyID = KVDBCounterMapUniqID.fetch_add(1);
+}
 
-    // When Mongodb rename a collection, it creates a second RecordStore (with a new namespace and
-    // same
-    // ident) before destroying the old one. The counters in the old recorstore needs to be flushed
-    // to
-    // media before loadCounters() below read them from media.
+KVDBRecordStore::~KVDBRecordStore() {
+    if (_countersActive.load()) {
+        if (!_overTaken && countersDirty()) {
+            // Main code path
+            updateCounters();
+        }
+        _counterManager.deregisterRecordStore(this);
+    }
 
-    _counterManager.sync_for_rename(_ident);
-    loadCounters();
+    _shuttingDown = true;
+}
 
-    _counterManager.registerRecordStore(this);
+Status KVDBRecordStore::parseOptions(const BSONObj& options, BSONObjBuilder* configBuilder) {
+    for (auto&& elem : options) {
+        StringData name = elem.fieldNameStringData();
+        StringData value = elem.type() == String ? elem.valueStringData() : StringData();
 
-    RecordId lastSeenId = this->_getLastId();
+        if (name == "valueCompression") {
+            // HSE compresses values with lz4 only, so the choice is whether to compress, or
+            // to leave it to the connector and its dictionaries.
+            if (value != "on" && value != "off" && value != "default" &&
+                value != KVDBDocDict::kCompressionName) {
+                return {ErrorCodes::InvalidOptions,
+                        "hse collection valueCompression must be \"on\", \"off\", \"dict\" "
+                        "or \"default\""};
+            }
 
-    _nextIdNum.store(lastSeenId.repr() + 1);
-}
+            if (configBuilder && value != "default")
+                configBuilder->append(kValueCompressionField, value);
+        } else if (name == "placement") {
+            if (value != "shared" && value != "dedicated") {
+                return {ErrorCodes::InvalidOptions,
+                        "hse collection placement must be \"shared\" or \"dedicated\""};
+            }
 
-KVDBRecordStore::~KVDBRecordStore() {
+            if (configBuilder && value == "dedicated")
+                configBuilder->append(kKvsPlacementField, value);
+        } else if (name == "largeValueThreshold") {
+            if (!elem.isNumber() || elem.numberLong() < 0 ||
+                elem.numberLong() > HSE_KVS_VALUE_LEN_MAX) {
+                return {ErrorCodes::InvalidOptions,
+                        str::stream() << "hse collection largeValueThreshold must be a number "
+                                      << "from 0 to " << HSE_KVS_VALUE_LEN_MAX};
+            }
 
+            if (configBuilder)
+                configBuilder->append(kLargeValueThresholdField, elem.numberInt());
+        } else if (name == "largeValueChunkSize") {
+            if (!elem.isNumber() || elem.numberLong() < KVDBValueLayout::kMinChunkLen ||
+                elem.numberLong() > HSE_KVS_VALUE_LEN_MAX) {
+                return {ErrorCodes::InvalidOptions,
+                        str::stream() << "hse collection largeValueChunkSize must be a number "
+                                      << "from " << KVDBValueLayout::kMinChunkLen << " to "
+                                      << HSE_KVS_VALUE_LEN_MAX};
+            }
 
-    if (!_overTaken) {
-        // Main code path
-        updateCounters();
+            if (configBuilder)
+                configBuilder->append(kLargeValueChunkLenField, elem.numberInt());
+        } else {
+            return {ErrorCodes::InvalidOptions,
+                    str::stream() << "'" << name << "' is not a supported hse collection option"};
+        }
     }
-    _counterManager.deregisterRecordStore(this);
 
-    _shuttingDown = true;
+    return Status::OK();
+}
+
+bool KVDBRecordStore::usesDedicatedKvs(const BSONObj& config) {
+    return config.getStringField(kKvsPlacementField) == StringData("dedicated");
+}
+
+BSONObj KVDBRecordStore::configWithPlacement(const BSONObj& config, bool dedicated) {
+    BSONObjBuilder bob;
+    bob.appendElements(config.removeField(kKvsPlacementField));
+    if (dedicated)
+        bob.append(kKvsPlacementField, "dedicated");
+    return bob.obj();
+}
+
+unsigned int KVDBRecordStore::putFlagsFromConfig(const BSONObj& config) {
+    StringData mode = config.getStringField(kValueCompressionField);
+
+    if (mode == "on")
+        return HSE_KVS_PUT_VCOMP_ON;
+    if (mode == "off" || mode == KVDBDocDict::kCompressionName)
+        return HSE_KVS_PUT_VCOMP_OFF;
+
+    // Follow the value.compression.default of the KVS.
+    return 0;
+}
+
+KVDBValueLayout KVDBRecordStore::_layoutFromConfig(const BSONObj& config) {
+    KVDBValueLayout layout;
+    BSONElement threshold = config[kLargeValueThresholdField];
+    BSONElement chunkLen = config[kLargeValueChunkLenField];
+
+    if (threshold.isNumber())
+        layout = KVDBValueLayout::withThreshold(threshold.numberInt(), layout.chunkLen);
+    if (chunkLen.isNumber())
+        layout.chunkLen = chunkLen.numberInt();
+
+    return layout;
 }
 
 // KVDBRecordStore - Metadata Methods
@@ -264,11 +386,40 @@ void KVDBRecordStore::updateCounters() {
     _encodeAndWriteCounter(_storageSizeKeyKvs, _storageSize);
 }
 
+void KVDBRecordStore::syncCounters() {
+    // An overtaken instance handed its counters over to the renamed one.
+    if (!_overTaken)
+        updateCounters();
+}
+
+void KVDBRecordStore::_ensureCounters() {
+    if (MONGO_likely(_countersActive.load()))
+        return;
+
+    stdx::lock_guard<stdx::mutex> lk(_countersMutex);
+    if (_countersActive.load())
+        return;
+
+    // When Mongodb rename a collection, it creates a second RecordStore (with a new namespace and
+    // same
+    // ident) before destroying the old one. The counters in the old recorstore needs to be flushed
+    // to
+    // media before loadCounters() below read them from media.
+
+    _counterManager.sync_for_rename(_ident);
+    loadCounters();
+
+    _counterManager.registerRecordStore(this);
+    _countersActive.store(true);
+}
+
 const char* KVDBRecordStore::name() const {
     return "HSE";
 };
 
 long long KVDBRecordStore::dataSize(OperationContext* opctx) const {
+    // Loading the counters on first use does not change what the record store holds.
+    const_cast<KVDBRecordStore*>(this)->_ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
     return _dataSize.load(std::memory_order::memory_order_relaxed) +
@@ -276,6 +427,7 @@ long long KVDBRecordStore::dataSize(OperationContext* opctx) const {
 }
 
 long long KVDBRecordStore::numRecords(OperationContext* opctx) const {
+    const_cast<KVDBRecordStore*>(this)->_ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
     return _numRecords.load(std::memory_order::memory_order_relaxed) +
@@ -285,6 +437,8 @@ long long KVDBRecordStore::numRecords(OperationContext* opctx) const {
 int64_t KVDBRecordStore::storageSize(OperationContext* opctx,
                                      BSONObjBuilder* extraInfo,
                                      int infoLevel) const {
+    const_cast<KVDBRecordStore*>(this)->_ensureCounters();
+
     // We need to make it multiple of 256 to make
     // jstests/concurrency/fsm_workloads/convert_to_capped_collection.js happy
     return static_cast<int64_t>(
@@ -312,21 +466,35 @@ bool KVDBRecordStore::_baseFindRecord(OperationContext* opctx,
     bool found;
     unsigned int offset;
 
-    found = _getKey(opctx, key, _colKvs, _largeKvs, loc, val, true);
+    found = _getKey(opctx, key, _colKvs, _largeKvs, _layout, loc, val, &offset, true);
+    _identStats.add(KVDBIdentStats::kGets);
 
     if (!found)
         return false;
 
-    offset = _getValueOffset(val);
     uint64_t dataLen = val.len() - offset;
+    unsigned int num_chunks = _layout.numChunks(dataLen);
 
-    // [HSE_REVISIT] The value is copied from KVDBData to RecordData.
-    // Avoid the copy by reading into a pre-allocated SharedBuffer.
-    RecordData rd((const char*)val.data() + offset, dataLen);
-    rd.makeOwned();
-    *out = std::move(rd);
+    if (_docDict) {
+        IdentStatTimer timer(_identStats, KVDBIdentStats::kDecompressMicros);
+        const char* stored = (const char*)val.data() + offset;
+        unsigned int rawLen = KVDBDocDict::rawLength(stored, dataLen);
+
+        SharedBuffer buf = SharedBuffer::allocate(rawLen);
+        _docDict->decompress(stored, dataLen, buf.get());
+        *out = RecordData(std::move(buf), rawLen);
+    } else {
+        // [HSE_REVISIT] The value is copied from KVDBData to RecordData.
+        // Avoid the copy by reading into a pre-allocated SharedBuffer.
+        RecordData rd((const char*)val.data() + offset, dataLen);
+        rd.makeOwned();
+        *out = std::move(rd);
+    }
 
     _hseAppBytesReadCounter.add(dataLen);
+    _identStats.add(KVDBIdentStats::kBytesRead, dataLen);
+    if (num_chunks)
+        _identStats.add(KVDBIdentStats::kLargeChunksRead, num_chunks);
 
     return true;
 }
@@ -350,7 +518,7 @@ void KVDBRecordStore::_baseDeleteRecord(OperationContext* opctx,
 
     KVDBData oldValue{};
     bool found = false;
-    unsigned long _lenBytes = VALUE_META_SIZE;
+    unsigned long _lenBytes = VALUE_META_SIZE + (_docDict ? KVDBDocDict::kMaxHeaderLen : 0);
 
     hse::Status st = ru->probeVlen(_colKvs, compatKey, oldValue, _lenBytes, found);
     invariantHseSt(st);
@@ -364,26 +532,33 @@ void KVDBRecordStore::_baseDeleteRecord(OperationContext* opctx,
         invariantHse(found);
     }
 
-    int val_len = _getValueLength(oldValue);
-    int chunk, num_chunks = _getNumChunks(val_len);
-    st = ru->del(_colKvs, compatKey);
-    invariantHseSt(st);
+    int val_len = _layout.valueLength(oldValue);
+    int chunk, num_chunks = _layout.numChunks(val_len);
+    int raw_len = _rawValueLength(ru, key, oldValue);
+    try {
+        st = ru->del(_colKvs, compatKey);
+        invariantHseSt(st);
 
-    if (num_chunks > 0) {
-        KRSK_CLEAR(chunkKey);
-        KRSK_CHUNK_COPY_MASTER(*key, chunkKey);
+        if (num_chunks > 0) {
+            KRSK_CLEAR(chunkKey);
+            KRSK_CHUNK_COPY_MASTER(*key, chunkKey);
 
-        // Delete constituent chunks, if any.
-        for (chunk = 0; chunk < num_chunks; ++chunk) {
-            KRSK_SET_CHUNK(chunkKey, chunk);
-            KVDBData cKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
-            st = ru->del(_largeKvs, cKey);
-            invariantHseSt(st);
+            // Delete constituent chunks, if any.
+            for (chunk = 0; chunk < num_chunks; ++chunk) {
+                KRSK_SET_CHUNK(chunkKey, chunk);
+                KVDBData cKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
+                st = ru->del(_largeKvs, cKey);
+                invariantHseSt(st);
+            }
         }
+    } catch (const WriteConflictException&) {
+        _identStats.add(KVDBIdentStats::kWriteConflicts);
+        throw;
     }
+    _identStats.add(KVDBIdentStats::kDeletes);
 
     _changeNumRecords(opctx, -1);
-    _increaseDataStorageSizes(opctx, -val_len, -val_len);
+    _increaseDataStorageSizes(opctx, -raw_len, -val_len);
 }
 
 StatusWith<RecordId> KVDBRecordStore::insertRecord(OperationContext* opctx,
@@ -404,16 +579,18 @@ StatusWith<RecordId> KVDBRecordStore::_baseInsertRecord(OperationContext* opctx,
                                                         const char* data,
                                                         int len) {
     uint32_t num_chunks;
+    StringData value = _encodeValue(data, len);
 
-    hse::Status st = _putKey(opctx, key, loc, data, len, &num_chunks);
+    hse::Status st = _putKey(opctx, key, loc, value.rawData(), value.size(), &num_chunks);
     if (st.ok()) {
         _changeNumRecords(opctx, 1);
-        _increaseDataStorageSizes(opctx, len, len);
+        _increaseDataStorageSizes(opctx, len, value.size());
     } else {
         return hseToMongoStatus(st);
     }
 
     _hseAppBytesWrittenCounter.add(len);
+    _countPut(value.size(), num_chunks);
 
     return StatusWith<RecordId>(loc);
 }
@@ -486,7 +663,7 @@ hse::Status KVDBRecordStore::_baseUpdateRecord(OperationContext* opctx,
 
     KVDBData oldValue{};
     bool found = false;
-    unsigned long _lenBytes = VALUE_META_SIZE;
+    unsigned long _lenBytes = VALUE_META_SIZE + (_docDict ? KVDBDocDict::kMaxHeaderLen : 0);
 
     // getMCo() reads the first chunk and does no de-compress it (if it was
     // compressed). In the case the value required several chunks, the
@@ -495,7 +672,7 @@ hse::Status KVDBRecordStore::_baseUpdateRecord(OperationContext* opctx,
     // first chunk.
     st = ru->probeVlen(_colKvs, compatKey, oldValue, _lenBytes, found);
     invariantHseSt(st);
-    int oldLen;
+    int oldLen, oldRawLen;
     uint32_t chunk;
     unsigned int old_nchunks, new_nchunks;
 
@@ -508,15 +685,17 @@ hse::Status KVDBRecordStore::_baseUpdateRecord(OperationContext* opctx,
         invariantHse(found);
     }
 
-    oldLen = _getValueLength(oldValue);
+    oldLen = _layout.valueLength(oldValue);
+    old_nchunks = _layout.numChunks(oldLen);
+    oldRawLen = _rawValueLength(ru, key, oldValue);
 
-    if (noLenChange && (len != oldLen)) {
+    if (noLenChange && (len != oldRawLen)) {
         *lenChangeFailure = true;
         return hse::Status{EINVAL};
     }
-    old_nchunks = _getNumChunks(oldLen);
 
-    st = _putKey(opctx, key, loc, data, len, &new_nchunks);
+    StringData value = _encodeValue(data, len);
+    st = _putKey(opctx, key, loc, value.rawData(), value.size(), &new_nchunks);
     if (!st.ok())
         return st;
 
@@ -533,10 +712,11 @@ hse::Status KVDBRecordStore::_baseUpdateRecord(OperationContext* opctx,
         invariantHseSt(st);
     }
 
-    _increaseDataStorageSizes(opctx, len - oldLen, len - oldLen);
+    _increaseDataStorageSizes(opctx, len - oldRawLen, value.size() - oldLen);
 
     // HSE_REVISIT - updateRecord currently treated as a whole app write for accounting.
     _hseAppBytesWrittenCounter.add(len);
+    _countPut(value.size(), new_nchunks);
 
     return st;
 }
@@ -558,8 +738,9 @@ StatusWith<RecordData> KVDBRecordStore::updateWithDamages(
 
 std::unique_ptr<SeekableRecordCursor> KVDBRecordStore::getCursor(OperationContext* opctx,
                                                                  bool forward) const {
+    _identStats.add(KVDBIdentStats::kCursorCreates);
     return stdx::make_unique<KVDBRecordStoreCursor>(
-        opctx, _db, _colKvs, _largeKvs, _prefixVal, forward);
+        opctx, _db, _colKvs, _largeKvs, _layout, _prefixVal, forward, _identStats, _docDict.get());
 };
 
 void KVDBRecordStore::waitForAllEarlierOplogWritesToBeVisible(OperationContext* txn) const {
@@ -646,11 +827,19 @@ void KVDBRecordStore::appendCustomStats(OperationContext* opctx,
                                         double scale) const {
     if (!result->hasField("capped"))
         result->appendBool("capped", false);
+
+    _identStats.appendTo(*result, "hse");
+
+    if (_docDict) {
+        BSONObjBuilder dictBob(result->subobjStart("hseDocDict"));
+        _docDict->appendStats(&dictBob);
+    }
 }
 
 void KVDBRecordStore::updateStatsAfterRepair(OperationContext* opctx,
                                              long long numRecords,
                                              long long dataSize) {
+    _ensureCounters();
     _numRecords.store(numRecords);
     _dataSize.store(dataSize);
     updateCounters();
@@ -660,31 +849,35 @@ void KVDBRecordStore::updateStatsAfterRepair(OperationContext* opctx,
 // KVDBRecordStore - Protected Methods
 
 void KVDBRecordStore::_changeNumRecords(OperationContext* opctx, int64_t amount) {
+    _ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
-    ru->incrementCounter(_numRecordsKeyID, &_numRecords, amount);
+    ru->incrementCounter(_numRecordsKeyID, &_numRecords, amount, this);
 }
 
 void KVDBRecordStore::_increaseDataStorageSizes(OperationContext* opctx,
                                                 int64_t damount,
                                                 int64_t samount) {
+    _ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
-    ru->incrementCounter(_dataSizeKeyID, &_dataSize, damount);
-    ru->incrementCounter(_storageSizeKeyID, &_storageSize, samount);
+    ru->incrementCounter(_dataSizeKeyID, &_dataSize, damount, this);
+    ru->incrementCounter(_storageSizeKeyID, &_storageSize, samount, this);
 }
 
 void KVDBRecordStore::_resetNumRecords(OperationContext* opctx) {
+    _ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
-    ru->resetCounter(_numRecordsKeyID, &_numRecords);
+    ru->resetCounter(_numRecordsKeyID, &_numRecords, this);
 }
 
 void KVDBRecordStore::_resetDataStorageSizes(OperationContext* opctx) {
+    _ensureCounters();
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
-    ru->resetCounter(_dataSizeKeyID, &_dataSize);
-    ru->resetCounter(_storageSizeKeyID, &_storageSize);
+    ru->resetCounter(_dataSizeKeyID, &_dataSize, this);
+    ru->resetCounter(_storageSizeKeyID, &_storageSize, this);
 }
 
 hse::Status KVDBRecordStore::_putKey(OperationContext* opctx,
@@ -693,6 +886,71 @@ hse::Status KVDBRecordStore::_putKey(OperationContext* opctx,
                                      const char* data,
                                      const int len,
                                      unsigned int* num_chunks) {
+    try {
+        return _putChunks(opctx, key, loc, data, len, num_chunks);
+    } catch (const WriteConflictException&) {
+        _identStats.add(KVDBIdentStats::kWriteConflicts);
+        throw;
+    }
+}
+
+void KVDBRecordStore::_countPut(int len, unsigned int num_chunks) {
+    _identStats.add(KVDBIdentStats::kPuts);
+    _identStats.add(KVDBIdentStats::kBytesWritten, len);
+    if (num_chunks)
+        _identStats.add(KVDBIdentStats::kLargeChunksWritten, num_chunks);
+}
+
+StringData KVDBRecordStore::_encodeValue(const char* data, int len) {
+    if (!_docDict)
+        return StringData(data, len);
+
+    // Compressed ahead of chunking, so a large document is compressed as a whole.
+    static thread_local std::string buf;
+    {
+        IdentStatTimer timer(_identStats, KVDBIdentStats::kCompressMicros);
+        _docDict->compress(data, len, &buf);
+    }
+
+    _identStats.add(KVDBIdentStats::kCompressBytesIn, len);
+    _identStats.add(KVDBIdentStats::kCompressBytesOut, buf.size());
+    return StringData(buf);
+}
+
+int KVDBRecordStore::_rawValueLength(KVDBRecoveryUnit* ru,
+                                     struct KVDBRecordStoreKey* key,
+                                     const KVDBData& value) const {
+    unsigned int storedLen = _layout.valueLength(value);
+
+    if (!_docDict)
+        return storedLen;
+    if (!_layout.hasHeader(value) || _layout.headLen)
+        return KVDBDocDict::rawLength((const char*)value.data() + _layout.valueOffset(value),
+                                      storedLen);
+
+    // Only the length is in the collection kvs, the document starts in the first chunk.
+    __attribute__((aligned(16))) struct KVDBRecordStoreKey chunkKey;
+    KVDBData head{};
+    bool found = false;
+
+    KRSK_CLEAR(chunkKey);
+    KRSK_CHUNK_COPY_MASTER(*key, chunkKey);
+    KRSK_SET_CHUNK(chunkKey, 0);
+    KVDBData cKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
+
+    hse::Status st = ru->probeVlen(_largeKvs, cKey, head, KVDBDocDict::kMaxHeaderLen, found);
+    invariantHseSt(st);
+    invariantHse(found);
+
+    return KVDBDocDict::rawLength((const char*)head.data(), storedLen);
+}
+
+hse::Status KVDBRecordStore::_putChunks(OperationContext* opctx,
+                                        struct KVDBRecordStoreKey* key,
+                                        const RecordId& loc,
+                                        const char* data,
+                                        const int len,
+                                        unsigned int* num_chunks) {
     __attribute__((aligned(16))) struct KVDBRecordStoreKey chunkKey;
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
 
@@ -700,45 +958,47 @@ hse::Status KVDBRecordStore::_putKey(OperationContext* opctx,
 
     KVDBData compatKey{key->data, KRSK_KEY_LEN(*key)};
 
-    if (len < VALUE_META_THRESHOLD_LEN) {
+    if (!_layout.isLarge(len)) {
         KVDBData val{(uint8_t*)data, (unsigned long)len};
         *num_chunks = 0;
 
-        return ru->put(_colKvs, compatKey, val);
+        return ru->put(_colKvs, compatKey, val, _putFlags);
     }
 
     // This value may span multiple chunks. Encode the total value length in
-    // the first four bytes of the value as metadata.
-    int written;
+    // the first four bytes of the value as metadata, followed by its head.
+    // HSE copies a value on put, so the head is staged in a per-thread buffer.
+    static thread_local std::unique_ptr<uint8_t[]> headBuf;
+    int written = _layout.headLen;
     uint32_t bigLen = endian::nativeToBig(len);
-    *num_chunks = _getNumChunks(len);  // may be 0
+    *num_chunks = _layout.numChunks(len);  // may be 0
     invariantHse(*num_chunks <= 256);
 
     KRSK_CLEAR(chunkKey);
     KRSK_CHUNK_COPY_MASTER(*key, chunkKey);
 
-    string value = std::string(reinterpret_cast<const char*>(&bigLen), sizeof(uint32_t)) +
-        std::string((const char*)data, VALUE_META_THRESHOLD_LEN);
-    KVDBData val{value};
+    if (!headBuf)
+        headBuf.reset(new uint8_t[HSE_KVS_VALUE_LEN_MAX]);
+    memcpy(headBuf.get(), &bigLen, VALUE_META_SIZE);
+    memcpy(headBuf.get() + VALUE_META_SIZE, data, written);
+    KVDBData val{headBuf.get(), (unsigned long)VALUE_META_SIZE + written};
 
-    hse::Status st = ru->put(_colKvs, compatKey, val);
+    hse::Status st = ru->put(_colKvs, compatKey, val, _putFlags);
     if (!st.ok())
         return st;
 
-    written = VALUE_META_THRESHOLD_LEN;
-
     // Insert additional chunks into the large KVS. Any failure aborts the inserting transaction.
     for (uint32_t chunk = 0; chunk < *num_chunks; ++chunk) {
         KRSK_SET_CHUNK(chunkKey, chunk);
 
         unsigned int chunk_len = (unsigned int)len - written;
-        if (chunk_len > HSE_KVS_VALUE_LEN_MAX)
-            chunk_len = HSE_KVS_VALUE_LEN_MAX;
+        if (chunk_len > _layout.chunkLen)
+            chunk_len = _layout.chunkLen;
 
         KVDBData compatKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
         KVDBData val{(uint8_t*)data + written, chunk_len};
 
-        st = ru->put(_largeKvs, compatKey, val);
+        st = ru->put(_largeKvs, compatKey, val, _putFlags);
         if (!st.ok())
             break;
 
@@ -757,7 +1017,7 @@ RecordId KVDBRecordStore::_getLastId() {
     KVDBData compatKey{(uint8_t*)&_prefixValBE, sizeof(_prefixValBE)};
 
     // create a reverse cursor
-    KvsCursor* cursor = new KvsCursor(_colKvs, compatKey, false, 0);
+    KvsCursor* cursor = _db.kvs_cursor_create(_colKvs, compatKey, false, 0);
 
     // get the last element, whatever it is
     KVDBData elKey{};
@@ -778,9 +1038,20 @@ RecordId KVDBRecordStore::_getLastId() {
 }
 
 RecordId KVDBRecordStore::_nextId() {
+    if (MONGO_unlikely(!_nextIdLoaded.load()))
+        _loadNextId();
     return RecordId(_nextIdNum.fetchAndAdd(1));
 }
 
+void KVDBRecordStore::_loadNextId() {
+    stdx::lock_guard<stdx::mutex> lk(_nextIdMutex);
+    if (_nextIdLoaded.load())
+        return;
+
+    _nextIdNum.store(_getLastId().repr() + 1);
+    _nextIdLoaded.store(true);
+}
+
 //
 // End Implementation of KVDBRecordStore
 //
@@ -802,9 +1073,19 @@ KVDBCappedRecordStore::KVDBCappedRecordStore(OperationContext* ctx,
                                              KVDBDurabilityManager& durabilityManager,
                                              KVDBCounterManager& counterManager,
                                              int64_t cappedMaxSize,
-                                             int64_t cappedMaxDocs)
-    : KVDBRecordStore(
-          ctx, ns, id, db, metaKvs, colKvs, largeKvs, prefix, durabilityManager, counterManager),
+                                             int64_t cappedMaxDocs,
+                                             const BSONObj& config)
+    : KVDBRecordStore(ctx,
+                      ns,
+                      id,
+                      db,
+                      metaKvs,
+                      colKvs,
+                      largeKvs,
+                      prefix,
+                      durabilityManager,
+                      counterManager,
+                      config),
       _cappedMaxSize(cappedMaxSize),
       _cappedMaxSizeSlack(std::min(cappedMaxSize / 10, int64_t(16 * 1024 * 1024))),
       _cappedMaxDocs(cappedMaxDocs),
@@ -815,6 +1096,9 @@ KVDBCappedRecordStore::KVDBCappedRecordStore(OperationContext* ctx,
     invariantHse(_cappedMaxSize > 0);
     invariantHse(_cappedMaxDocs == -1 || _cappedMaxDocs > 0);
 
+    // Capped deletes read the counters directly.
+    _ensureCounters();
+
     _cappedVisMgr->updateHighestSeen(this->_getLastId());
 }
 
@@ -868,8 +1152,16 @@ Status KVDBCappedRecordStore::updateRecord(OperationContext* opctx,
 
 std::unique_ptr<SeekableRecordCursor> KVDBCappedRecordStore::getCursor(OperationContext* opctx,
                                                                        bool forward) const {
-    return stdx::make_unique<KVDBCappedRecordStoreCursor>(
-        opctx, _db, _colKvs, _largeKvs, _prefixVal, forward, *_cappedVisMgr.get());
+    _identStats.add(KVDBIdentStats::kCursorCreates);
+    return stdx::make_unique<KVDBCappedRecordStoreCursor>(opctx,
+                                                          _db,
+                                                          _colKvs,
+                                                          _largeKvs,
+                                                          _layout,
+                                                          _prefixVal,
+                                                          forward,
+                                                          _identStats,
+                                                          *_cappedVisMgr.get());
 };
 
 void KVDBCappedRecordStore::temp_cappedTruncateAfter(OperationContext* opctx,
@@ -923,26 +1215,25 @@ Status KVDBCappedRecordStore::_cappedDeleteCallbackHelper(OperationContext* opct
                                                           KVDBData& oldValue,
                                                           RecordId& newestOld) {
     __attribute__((aligned(16))) struct KVDBRecordStoreKey key;
-    int offset = 0;
+    unsigned int offset;
 
     stdx::lock_guard<stdx::mutex> lk(_cappedCallbackMutex);
 
     if (!_cappedCallback)
         return Status::OK();
 
-    int oldValLen = _getValueLength(oldValue);
-    if (_getNumChunks(oldValLen)) {
+    offset = _layout.valueOffset(oldValue);
+    if (_layout.numChunks(_layout.valueLength(oldValue))) {
         // Read all chunks.
 
         KRSK_CLEAR(key);
         _setPrefix(&key, newestOld);
 
-        bool found = _getKey(opctx, &key, _colKvs, _largeKvs, newestOld, oldValue, true);
+        bool found =
+            _getKey(opctx, &key, _colKvs, _largeKvs, _layout, newestOld, oldValue, &offset, true);
         invariantHse(found);
     }
 
-    offset = _getValueOffset(oldValue);
-
     uassertStatusOK(_cappedCallback->aboutToDeleteCapped(
         opctx,
         newestOld,
@@ -965,8 +1256,13 @@ Status KVDBCappedRecordStore::_baseCappedDeleteAsNeeded(OperationContext* opctx,
         checked_cast<KVDBRecoveryUnit*>(opctx->releaseRecoveryUnit());
     invariantHse(realRecoveryUnit);
 
-    OperationContext::RecoveryUnitState const realRUstate = opctx->setRecoveryUnit(
-        realRecoveryUnit->newKVDBRecoveryUnit(), OperationContext::kNotInUnitOfWork);
+    // The pass deletes what it reads. Its conflicts are ignored, so reading from a shared
+    // view, which conflicts on upgrade once anything commits, would keep it from trimming.
+    KVDBRecoveryUnit* cappedRecoveryUnit = realRecoveryUnit->newKVDBRecoveryUnit();
+    cappedRecoveryUnit->setOwnTxnReads();
+
+    OperationContext::RecoveryUnitState const realRUstate =
+        opctx->setRecoveryUnit(cappedRecoveryUnit, OperationContext::kNotInUnitOfWork);
 
     int64_t dataSize = _dataSize.load() + realRecoveryUnit->getDeltaCounter(_dataSizeKeyID);
     int64_t numRecords = _numRecords.load() + realRecoveryUnit->getDeltaCounter(_numRecordsKeyID);
@@ -979,24 +1275,41 @@ Status KVDBCappedRecordStore::_baseCappedDeleteAsNeeded(OperationContext* opctx,
     if (_cappedMaxDocs != -1 && numRecords > _cappedMaxDocs)
         docsOverCap = numRecords - _cappedMaxDocs;
 
+    // Every record below the boundary committed before the scan below begins, so the scan
+    // sees all of them and the hint may move past them once they are deleted.
+    int64_t commitBoundary = _cappedVisMgr->getCommitBoundary();
+    RecordId newestOld;
+
     try {
         WriteUnitOfWork wuow(opctx);
         KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(opctx);
         KvsCursor* cursor;
         hse::Status st;
-        RecordId newestOld;
-
-        // [HSE_REVISIT] - Why is this a map? We only ever iterate over it. It even has a capped
-        //                size of 20000 elements - shouldn't it just be a vector.
-        //
-        //                Even worse, we're making a heap-allocated copy of every key that we are
-        //                going to delete in the second loop.
-        map<KVDBData, unsigned int> keysToDelete;
+
+        // Only the record ids are kept, the keys are rebuilt from them.
+        struct OldRecord {
+            RecordId id;
+            unsigned int numChunks;
+        };
+        std::vector<OldRecord> toDelete;
         KVDBData prefixKey{(uint8_t*)&_prefixValBE, sizeof(_prefixValBE)};
 
         st = ru->beginScan(_colKvs, prefixKey, true, &cursor);
         invariantHseSt(st);
 
+        // Earlier passes deleted the records below the hint. Seeking past their tombstones
+        // keeps the cost of a pass from growing with the number of records ever deleted.
+        int64_t hint = _cappedOldestKeyHint.load();
+        if (hint > 0) {
+            KRSK_CLEAR(key);
+            KRSK_SET_PREFIX(key, KRSK_RS_PREFIX(_prefixVal));
+            KRSK_SET_SUFFIX(key, hint);
+            KVDBData seekKey{key.data, KRSK_KEY_LEN(key)};
+
+            st = ru->oplogCursorSeek(cursor, seekKey, nullptr, nullptr);
+            invariantHseSt(st);
+        }
+
         while ((sizeSaved < sizeOverCap || docsRemoved < docsOverCap) && (docsRemoved < 20000)) {
             KVDBData elKey{};
             KVDBData elVal{};
@@ -1007,51 +1320,48 @@ Status KVDBCappedRecordStore::_baseCappedDeleteAsNeeded(OperationContext* opctx,
             if (eof)
                 break;
 
-            newestOld = _recordIdFromKey(elKey);
+            RecordId oldId = _recordIdFromKey(elKey);
 
             if (_cappedVisMgr->isCappedHidden(
-                    newestOld))  // This means we have an older record that
-                break;           // hasn't been committed yet. Let's wait
-                                 // until it gets committed before deleting
+                    oldId))  // This means we have an older record that
+                break;       // hasn't been committed yet. Let's wait
+                             // until it gets committed before deleting
 
-            if (newestOld >= justInserted)  // don't go past the record we just inserted
+            if (oldId >= justInserted)  // don't go past the record we just inserted
                 break;
 
             if (_shuttingDown)
                 break;
 
             ++docsRemoved;
+            newestOld = oldId;
             KVDBData oldValue = elVal;
 
-            sizeSaved += _getValueLength(elVal);
+            sizeSaved += _layout.valueLength(elVal);
             _cappedDeleteCallbackHelper(opctx, oldValue, newestOld);
-            keysToDelete[elKey.clone()] = _getNumChunks(_getValueLength(elVal));
+            toDelete.push_back({newestOld, _layout.numChunks(_layout.valueLength(elVal))});
         }
 
         st = ru->endScan(cursor);
         invariantHseSt(st);
 
-        for (auto& p : keysToDelete) {
-            KVDBData k = p.first;
-            unsigned int num_chunks = p.second;
+        for (auto& old : toDelete) {
+            KRSK_CLEAR(key);
+            KRSK_SET_PREFIX(key, KRSK_RS_PREFIX(_prefixVal));
+            KRSK_SET_SUFFIX(key, old.id.repr());
+            KVDBData k{key.data, KRSK_KEY_LEN(key)};
 
             st = ru->del(_colKvs, k);
             invariantHseSt(st);
 
             unsigned int chunk;
 
-            if (num_chunks > 0) {
-                RecordId loc = _recordIdFromKey(k);
-
-                KRSK_CLEAR(key);
-                KRSK_SET_PREFIX(key, KRSK_RS_PREFIX(_prefixVal));
-                KRSK_SET_SUFFIX(key, loc.repr());
-
+            if (old.numChunks > 0) {
                 KRSK_CLEAR(chunkKey);
                 KRSK_CHUNK_COPY_MASTER(key, chunkKey);
 
                 // Delete constituent chunks
-                for (chunk = 0; chunk < num_chunks; ++chunk) {
+                for (chunk = 0; chunk < old.numChunks; ++chunk) {
                     KRSK_SET_CHUNK(chunkKey, chunk);
                     KVDBData compatKey{chunkKey.data, KRSK_KEY_LEN(chunkKey)};
                     st = ru->del(_largeKvs, compatKey);
@@ -1079,6 +1389,17 @@ Status KVDBCappedRecordStore::_baseCappedDeleteAsNeeded(OperationContext* opctx,
     delete opctx->releaseRecoveryUnit();
     opctx->setRecoveryUnit(realRecoveryUnit, realRUstate);
 
+    if (docsRemoved > 0) {
+        int64_t newHint = std::min(newestOld.repr() + 1, commitBoundary);
+        int64_t hint = _cappedOldestKeyHint.load();
+        while (hint < newHint) {
+            int64_t seen = _cappedOldestKeyHint.compareAndSwap(hint, newHint);
+            if (seen == hint)
+                break;
+            hint = seen;
+        }
+    }
+
     *removed = docsRemoved;
 
     return Status::OK();
@@ -1267,8 +1588,17 @@ Status KVDBOplogStore::updateRecord(OperationContext* opctx,
 
 std::unique_ptr<SeekableRecordCursor> KVDBOplogStore::getCursor(OperationContext* opctx,
                                                                 bool forward) const {
-    return stdx::make_unique<KVDBOplogStoreCursor>(
-        opctx, _db, _colKvs, _largeKvs, _prefixVal, forward, *_cappedVisMgr.get(), _opBlkMgr);
+    _identStats.add(KVDBIdentStats::kCursorCreates);
+    return stdx::make_unique<KVDBOplogStoreCursor>(opctx,
+                                                   _db,
+                                                   _colKvs,
+                                                   _largeKvs,
+                                                   _layout,
+                                                   _prefixVal,
+                                                   forward,
+                                                   _identStats,
+                                                   *_cappedVisMgr.get(),
+                                                   _opBlkMgr);
 };
 
 void KVDBOplogStore::waitForAllEarlierOplogWritesToBeVisible(OperationContext* opctx) const {
@@ -1474,14 +1804,20 @@ KVDBRecordStoreCursor::KVDBRecordStoreCursor(OperationContext* opctx,
                                              KVDB& db,
                                              KVSHandle& colKvs,
                                              KVSHandle& largeKvs,
+                                             const KVDBValueLayout& layout,
                                              uint32_t prefix,
-                                             bool forward)
+                                             bool forward,
+                                             KVDBIdentStats& identStats,
+                                             KVDBDocDict* docDict)
     : _opctx(opctx),
       _db(db),
       _colKvs(colKvs),
       _largeKvs(largeKvs),
+      _layout(layout),
       _prefixVal(prefix),
-      _forward(forward) {
+      _forward(forward),
+      _identStats(identStats),
+      _docDict(docDict) {
     _prefixValBE = htobe32(_prefixVal);
     if (_forward)
         _lastPos = RecordId(0);
@@ -1541,11 +1877,10 @@ boost::optional<Record> KVDBRecordStoreCursor::seekExact(const RecordId& id) {
     bool found = false;
     unsigned int offset;
 
-    found = _getKey(_opctx, &key, _colKvs, _largeKvs, id, _seekVal, true);
+    found = _getKey(_opctx, &key, _colKvs, _largeKvs, _layout, id, _seekVal, &offset, true);
     if (!found)
         return {};
 
-    offset = _getValueOffset(_seekVal);
     unsigned int dataLen = _seekVal.len() - offset;
 
     _eof = false;
@@ -1553,8 +1888,10 @@ boost::optional<Record> KVDBRecordStoreCursor::seekExact(const RecordId& id) {
     _needSeek = true;
 
     KVDBStatCounterRollup(_hseAppBytesReadCounter, dataLen, 8);
+    _identStats.add(KVDBIdentStats::kGets);
+    _identStats.add(KVDBIdentStats::kBytesRead, dataLen);
 
-    return {{id, {(const char*)_seekVal.data() + offset, static_cast<int>(dataLen)}}};
+    return {{id, _recordData(_seekVal.data() + offset, dataLen)}};
 }
 
 void KVDBRecordStoreCursor::save() {}
@@ -1616,36 +1953,56 @@ boost::optional<Record> KVDBRecordStoreCursor::_curr(bool use_txn) {
     }
 
     _lastPos = loc;
-    int valLen = _getValueLength(elVal);
-    if (_getNumChunks(valLen)) {
+    unsigned int valLen = _layout.valueLength(elVal);
+    unsigned int numChunks = _layout.numChunks(valLen);
+    offset = _layout.valueOffset(elVal);
+    if (numChunks) {
         // The value is "large", so we switch to the get interface to read its contents
         KRSK_CLEAR(key);
         _krskSetPrefixFromKey(key, elKey);
-        found = _getKey(_opctx, &key, _colKvs, _largeKvs, loc, _largeVal, use_txn);
+        found =
+            _getKey(_opctx, &key, _colKvs, _largeKvs, _layout, loc, _largeVal, &offset, use_txn);
         invariantHse(found);
         elVal = _largeVal;
+        _identStats.add(KVDBIdentStats::kLargeChunksRead, numChunks);
     }
 
-    offset = _getValueOffset(elVal);
-
     int dataLen = elVal.len() - offset;
 
-    invariantHse(_getValueLength(elVal) == static_cast<unsigned int>(dataLen));
+    invariantHse(valLen == static_cast<unsigned int>(dataLen));
 
     _hseAppBytesReadCounter.add(dataLen);
+    _identStats.add(KVDBIdentStats::kBytesRead, dataLen);
+
+    return {{loc, _recordData(elVal.data() + offset, dataLen)}};
+}
 
-    return {{loc, {(const char*)elVal.data() + offset, dataLen}}};
+RecordData KVDBRecordStoreCursor::_recordData(const uint8_t* data, int len) {
+    if (!_docDict)
+        return {(const char*)data, len};
+
+    IdentStatTimer timer(_identStats, KVDBIdentStats::kDecompressMicros);
+    _rawVal.resize(KVDBDocDict::rawLength((const char*)data, len));
+    _docDict->decompress((const char*)data, len, &_rawVal[0]);
+
+    return {_rawVal.data(), static_cast<int>(_rawVal.size())};
 }
 
 KvsCursor* KVDBRecordStoreCursor::_getMCursor() {
     KVDBRecoveryUnit* ru = KVDBRecoveryUnit::getKVDBRecoveryUnit(_opctx);
     hse::Status st;
 
+    // The collection moved to other KVSes while the cursor was saved, it resumes from
+    // _lastPos in the new ones.
+    if (_cursorValid && _mCursorKvs != _colKvs)
+        _destroyMCursor();
+
     if (!_cursorValid) {
         KVDBData compatKey{(uint8_t*)&_prefixValBE, sizeof(_prefixValBE)};
 
         st = ru->beginScan(_colKvs, compatKey, _forward, &_mCursor);
         invariantHseSt(st);
+        _mCursorKvs = _colKvs;
         _cursorValid = true;
         _needSeek =
             (_forward && (_lastPos != RecordId())) || (!_forward && (_lastPos != RecordId::max()));
@@ -1685,10 +2042,12 @@ KVDBCappedRecordStoreCursor::KVDBCappedRecordStoreCursor(OperationContext* opctx
                                                          KVDB& db,
                                                          KVSHandle& colKvs,
                                                          KVSHandle& largeKvs,
+                                                         const KVDBValueLayout& layout,
                                                          uint32_t prefix,
                                                          bool forward,
+                                                         KVDBIdentStats& identStats,
                                                          KVDBCappedVisibilityManager& cappedVisMgr)
-    : KVDBRecordStoreCursor(opctx, db, colKvs, largeKvs, prefix, forward),
+    : KVDBRecordStoreCursor(opctx, db, colKvs, largeKvs, layout, prefix, forward, identStats),
       _cappedVisMgr(cappedVisMgr) {}
 
 KVDBCappedRecordStoreCursor::~KVDBCappedRecordStoreCursor() {}
@@ -1771,11 +2130,14 @@ KVDBOplogStoreCursor::KVDBOplogStoreCursor(OperationContext* opctx,
                                            KVDB& db,
                                            KVSHandle& colKvs,
                                            KVSHandle& largeKvs,
+                                           const KVDBValueLayout& layout,
                                            uint32_t prefix,
                                            bool forward,
+                                           KVDBIdentStats& identStats,
                                            KVDBCappedVisibilityManager& cappedVisMgr,
                                            shared_ptr<KVDBOplogBlockManager> opBlkMgr)
-    : KVDBCappedRecordStoreCursor(opctx, db, colKvs, largeKvs, prefix, forward, cappedVisMgr),
+    : KVDBCappedRecordStoreCursor(
+          opctx, db, colKvs, largeKvs, layout, prefix, forward, identStats, cappedVisMgr),
       _readUntilForOplog(RecordId()),
       _opBlkMgr{opBlkMgr} {
     _hseOplogCursorCreateCounter.add();
@@ -1810,13 +2172,10 @@ boost::optional<Record> KVDBOplogStoreCursor::seekExact(const RecordId& id) {
 
     // An oplog cursor must be able to see everything committed so far. Use an unbound get.
     // There may already be an active txn in this recovery unit. Do not bind to it.
-    found = _getKey(_opctx, &key, _colKvs, _largeKvs, id, _seekVal, false);
+    found = _getKey(_opctx, &key, _colKvs, _largeKvs, _layout, id, _seekVal, &offset, false);
     if (!found)
         return {};
 
-    offset = _getValueOffset(_seekVal);
-    invariantHse(_getValueLength(_seekVal) == _seekVal.len() - offset);
-
     _eof = false;
     _lastPos = id;
     _needSeek = true;
@@ -51,10 +51,12 @@
 
 #include "hse.h"
 #include "hse_counter_manager.h"
+#include "hse_doc_dict.h"
 #include "hse_durability_manager.h"
 #include "hse_exceptions.h"
 #include "hse_oplog_block.h"
 #include "hse_recovery_unit.h"
+#include "hse_stats.h"
 #include "hse_util.h"
 
 using hse::DEFAULT_PFX_LEN;
@@ -86,7 +88,7 @@ typedef std::list<RecordId> SortedRecordIds;
 // performance aggressive oplog - which is critical to performance in a replica set.
 //
 
-class KVDBRecordStore : public RecordStore {
+class KVDBRecordStore : public RecordStore, public KVDBCounterOwner {
     MONGO_DISALLOW_COPYING(KVDBRecordStore);
 
 public:
@@ -99,10 +101,25 @@ public:
                     KVSHandle& largeKvs,
                     uint32_t prefix,
                     KVDBDurabilityManager& durabilityManager,
-                    KVDBCounterManager& counterManager);
+                    KVDBCounterManager& counterManager,
+                    const BSONObj& config = BSONObj());
 
     virtual ~KVDBRecordStore();
 
+    // Checks the hse section of a collection's storageEngine options and, if configBuilder
+    // is not null, appends the settings they select to the collection's ident config.
+    static Status parseOptions(const BSONObj& options, BSONObjBuilder* configBuilder);
+
+    // Whether the ident config places the collection in KVSes of its own rather than in
+    // the shared main and large KVSes.
+    static bool usesDedicatedKvs(const BSONObj& config);
+
+    // The ident config with the placement changed, for a move of the collection.
+    static BSONObj configWithPlacement(const BSONObj& config, bool dedicated);
+
+    // The HSE_KVS_PUT_* flags every value of the collection is put with.
+    static unsigned int putFlagsFromConfig(const BSONObj& config);
+
     // metadata methods
     virtual const char* name() const;
 
@@ -207,6 +224,8 @@ public:
     void updateCounters();  // write counters to kvdb
     void loadCounters();    // read counters from kvdb
 
+    virtual void syncCounters();
+
     void overTake() {
         _overTaken = true;
     }
@@ -236,6 +255,9 @@ protected:
                                   bool noLenChange,
                                   bool* lenChangeFailure);
 
+    // Loads the counters and registers with the counter manager, on first use.
+    void _ensureCounters();
+
     void _changeNumRecords(OperationContext* txn, int64_t amount);
     void _increaseDataStorageSizes(OperationContext* txn, int64_t damount, int64_t samount);
     void _resetNumRecords(OperationContext* txn);
@@ -247,10 +269,26 @@ protected:
                         const char* data,
                         const int len,
                         unsigned int* num_chunks);
+    hse::Status _putChunks(OperationContext* txn,
+                           struct KVDBRecordStoreKey* key,
+                           const RecordId& loc,
+                           const char* data,
+                           const int len,
+                           unsigned int* num_chunks);
+    void _countPut(int len, unsigned int num_chunks);
+
+    // Returns the bytes stored for a document, which stay valid until the next call.
+    StringData _encodeValue(const char* data, int len);
+    // Returns the document length of a value, given at least its first
+    // VALUE_META_SIZE + KVDBDocDict::kMaxHeaderLen bytes as read from the collection kvs.
+    int _rawValueLength(KVDBRecoveryUnit* ru,
+                        struct KVDBRecordStoreKey* key,
+                        const KVDBData& value) const;
 
     virtual RecordId _getLastId();
 
     RecordId _nextId();
+    void _loadNextId();
 
     virtual void _setPrefix(KVDBRecordStoreKey* key, const RecordId& loc) const {
         KRSK_SET_PREFIX(*key, KRSK_RS_PREFIX(_prefixVal));
@@ -266,12 +304,17 @@ protected:
         return Status::OK();
     }
 
+    static hse::KVDBValueLayout _layoutFromConfig(const BSONObj& config);
+
     KVDB& _db;
     KVSHandle& _metaKvs;
     KVSHandle& _colKvs;
     KVSHandle& _largeKvs;
     uint32_t _prefixVal;
     uint32_t _prefixValBE;
+    const unsigned int _putFlags;  // HSE_KVS_PUT_* flags for every value of the collection
+    const hse::KVDBValueLayout _layout;
+    std::shared_ptr<KVDBDocDict> _docDict;  // null unless valueCompression is "dict"
     KVDBDurabilityManager& _durabilityManager;
     KVDBCounterManager& _counterManager;  // not owned
 
@@ -317,6 +360,19 @@ protected:
     // only after the new record store is visible to the connector.
     bool _overTaken{false};
 
+    // _nextIdNum is loaded from the last record on the first insert rather than when the
+    // collection is opened, so that startup needs no cursor per collection.
+    std::atomic<bool> _nextIdLoaded{false};
+    stdx::mutex _nextIdMutex;
+
+    // Likewise the counters are loaded when first used, so that the many idle collections
+    // of a large deployment cost neither a read at startup nor a place in the counter sync.
+    std::atomic<bool> _countersActive{false};
+    stdx::mutex _countersMutex;
+
+    // Operation counts reported by collStats while stats are enabled.
+    mutable hse_stat::KVDBIdentStats _identStats;
+
     char _pad[128];
 
     AtomicInt64 _nextIdNum;
@@ -351,7 +407,8 @@ public:
                           KVDBDurabilityManager& durabilityManager,
                           KVDBCounterManager& counterManager,
                           int64_t cappedMaxSize,
-                          int64_t cappedMaxDocs);
+                          int64_t cappedMaxDocs,
+                          const BSONObj& config = BSONObj());
 
     virtual ~KVDBCappedRecordStore();
 
@@ -418,7 +475,9 @@ protected:
     CappedCallback* _cappedCallback{nullptr};
     stdx::mutex _cappedCallbackMutex;  // guards _cappedCallback.
 
-    RecordId _cappedOldestKeyHint{0};
+    // Repr of a RecordId below which every record has been deleted, where the next capped
+    // delete pass starts its scan.
+    AtomicInt64 _cappedOldestKeyHint{0};
     unique_ptr<KVDBCappedVisibilityManager> _cappedVisMgr;
 
 
@@ -552,8 +611,11 @@ public:
                           KVDB& db,
                           KVSHandle& colKvs,
                           KVSHandle& largeKvs,
+                          const hse::KVDBValueLayout& layout,
                           uint32_t prefix,
-                          bool forward);
+                          bool forward,
+                          hse_stat::KVDBIdentStats& identStats,
+                          KVDBDocDict* docDict = nullptr);
 
     virtual ~KVDBRecordStoreCursor();
 
@@ -589,14 +651,21 @@ protected:
 
     virtual void _destroyMCursor();
 
+    // Returns the document of a stored value, decompressed into _rawVal if need be.
+    RecordData _recordData(const uint8_t* data, int len);
+
     OperationContext* _opctx;
     KVDB& _db;
     KVSHandle& _colKvs;
     KVSHandle& _largeKvs;
+    const hse::KVDBValueLayout _layout;
     uint32_t _prefixVal;
     uint32_t _prefixValBE;
     bool _forward;
+    hse_stat::KVDBIdentStats& _identStats;  // owned by the record store
+    KVDBDocDict* _docDict;                  // owned by the record store, may be null
     KvsCursor* _mCursor;
+    KVSHandle _mCursorKvs{nullptr};  // _colKvs when _mCursor was created
 
     bool _cursorValid = false;
     bool _eof = false;
@@ -606,6 +675,7 @@ protected:
 
     KVDBData _seekVal{};
     KVDBData _largeVal{};
+    std::string _rawVal;
     RecordId _lastPos{};
 };
 
@@ -615,8 +685,10 @@ public:
                                 KVDB& db,
                                 KVSHandle& colKvs,
                                 KVSHandle& largeKvs,
+                                const hse::KVDBValueLayout& layout,
                                 uint32_t prefix,
                                 bool forward,
+                                hse_stat::KVDBIdentStats& identStats,
                                 KVDBCappedVisibilityManager& cappedVisMgr);
 
     virtual ~KVDBCappedRecordStoreCursor();
@@ -647,8 +719,10 @@ public:
                          KVDB& db,
                          KVSHandle& colKvs,
                          KVSHandle& largeKvs,
+                         const hse::KVDBValueLayout& layout,
                          uint32_t prefix,
                          bool forward,
+                         hse_stat::KVDBIdentStats& identStats,
                          KVDBCappedVisibilityManager& cappedVisMgr,
                          shared_ptr<KVDBOplogBlockManager> opBlkMgr);
 
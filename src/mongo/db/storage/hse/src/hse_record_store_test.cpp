@@ -43,10 +43,13 @@
 #include "mongo/db/storage/record_store_test_harness.h"
 #include "mongo/unittest/temp_dir.h"
 #include "mongo/unittest/unittest.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/scopeguard.h"
 
 #include "hse_impl.h"
 #include "hse_record_store.h"
 #include "hse_recovery_unit.h"
+#include "hse_stats.h"
 #include "hse_ut_common.h"
 
 namespace mongo {
@@ -77,7 +80,8 @@ public:
     virtual std::unique_ptr<RecordStore> newNonCappedRecordStore() {
         return newNonCappedRecordStore("foo.bar");
     }
-    std::unique_ptr<RecordStore> newNonCappedRecordStore(const std::string& ns) {
+    std::unique_ptr<RecordStore> newNonCappedRecordStore(const std::string& ns,
+                                                         const BSONObj& config = BSONObj()) {
         auto opCtx = newOperationContext();
 
         return stdx::make_unique<KVDBRecordStore>(opCtx.get(),
@@ -89,7 +93,8 @@ public:
                                                   _largeKvs,
                                                   _prefix,
                                                   *_durabilityManager.get(),
-                                                  *_counterManager.get());
+                                                  *_counterManager.get(),
+                                                  config);
     }
 
     std::unique_ptr<RecordStore> newCappedRecordStore(int64_t cappedMaxSize,
@@ -354,20 +359,17 @@ std::string random_string(size_t length) {
     return str;
 }
 
-TEST(KVDBRecordStoreTest, Chunker) {
-    std::unique_ptr<HarnessHelper> harnessHelper(newHarnessHelper());
-    std::unique_ptr<RecordStore> rs(harnessHelper->newNonCappedRecordStore());
+// Inserts, updates, reads and deletes values of the given lengths in a collection created
+// with config, checking their contents and the collection's counts along the way.
+void testChunker(const BSONObj& config, const std::vector<unsigned int>& lengths) {
+    std::unique_ptr<KVDBRecordStoreHarnessHelper> harnessHelper(new KVDBRecordStoreHarnessHelper());
+    std::unique_ptr<RecordStore> rs(harnessHelper->newNonCappedRecordStore("foo.bar", config));
 
     int i, j, num_records, index, test;
     unsigned int length, prev;
-    const int num_values = 5;
-    unsigned int lengths[num_values] = {VALUE_META_THRESHOLD_LEN - 1,
-                                        VALUE_META_THRESHOLD_LEN,
-                                        HSE_KVS_VALUE_LEN_MAX,
-                                        HSE_KVS_VALUE_LEN_MAX * 2,
-                                        16 * 1024 * 1024};
-    string strings[num_values];
-    RecordId locs[num_values];
+    const int num_values = lengths.size();
+    std::vector<string> strings(num_values);
+    std::vector<RecordId> locs(num_values);
     RecordData record;
 
     for (i = 0; i < num_values; i++)
@@ -487,6 +489,21 @@ TEST(KVDBRecordStoreTest, Chunker) {
     } /* for */
 }
 
+TEST(KVDBRecordStoreTest, Chunker) {
+    testChunker(BSONObj(),
+                {VALUE_META_THRESHOLD_LEN - 1,
+                 VALUE_META_THRESHOLD_LEN,
+                 HSE_KVS_VALUE_LEN_MAX,
+                 HSE_KVS_VALUE_LEN_MAX * 2,
+                 16 * 1024 * 1024});
+}
+
+TEST(KVDBRecordStoreTest, ChunkerThresholdLayout) {
+    // A value as long as the length header must not be read back as one.
+    testChunker(BSON("large_value_threshold" << 16384 << "large_value_chunk_len" << 256 * 1024),
+                {4, 5, 16384, 16385, 256 * 1024 + 1, HSE_KVS_VALUE_LEN_MAX, 16 * 1024 * 1024});
+}
+
 StatusWith<RecordId> insertBSONTs(ServiceContext::UniqueOperationContext& opCtx,
                                   std::unique_ptr<RecordStore>& rs,
                                   const Timestamp& opTime) {
@@ -696,6 +713,151 @@ TEST(KVDBRecordStoreTest, OplogHackOnNonOplog) {
     ASSERT_TRUE(rs->oplogStartHack(opCtx.get(), RecordId(0, 1)) == boost::none);
 }
 
+TEST(KVDBRecordStoreTest, CollectionOptions) {
+    BSONObjBuilder configBuilder;
+    ASSERT_OK(KVDBRecordStore::parseOptions(BSON("valueCompression"
+                                                 << "off"),
+                                            &configBuilder));
+    BSONObj config = configBuilder.obj();
+    ASSERT_EQUALS(std::string("off"), config.getStringField("value_compression"));
+
+    ASSERT_OK(KVDBRecordStore::parseOptions(BSON("valueCompression"
+                                                 << "default"),
+                                            nullptr));
+    ASSERT_OK(KVDBRecordStore::parseOptions(BSON("valueCompression"
+                                                 << "dict"),
+                                            nullptr));
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("valueCompression"
+                                                     << "zstd"),
+                                                nullptr));
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("blockSize" << 4096), nullptr));
+    ASSERT_FALSE(KVDBRecordStore::usesDedicatedKvs(config));
+
+    BSONObjBuilder placedBuilder;
+    ASSERT_OK(KVDBRecordStore::parseOptions(BSON("placement"
+                                                 << "dedicated"),
+                                            &placedBuilder));
+    ASSERT_TRUE(KVDBRecordStore::usesDedicatedKvs(placedBuilder.obj()));
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("placement"
+                                                     << "auto"),
+                                                nullptr));
+
+    BSONObjBuilder layoutBuilder;
+    ASSERT_OK(KVDBRecordStore::parseOptions(
+        BSON("largeValueThreshold" << 16384 << "largeValueChunkSize" << 256 * 1024),
+        &layoutBuilder));
+    BSONObj layoutConfig = layoutBuilder.obj();
+    ASSERT_EQUALS(16384, layoutConfig["large_value_threshold"].numberInt());
+    ASSERT_EQUALS(256 * 1024, layoutConfig["large_value_chunk_len"].numberInt());
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("largeValueThreshold" << -1), nullptr));
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("largeValueThreshold"
+                                                     << "16k"),
+                                                nullptr));
+    ASSERT_NOT_OK(KVDBRecordStore::parseOptions(BSON("largeValueChunkSize" << 4096), nullptr));
+
+    // Small and chunked values both round trip with the override applied to their puts.
+    KVDBRecordStoreHarnessHelper harnessHelper;
+    std::unique_ptr<RecordStore> rs(harnessHelper.newNonCappedRecordStore("a.vcomp", config));
+    ServiceContext::UniqueOperationContext opCtx(harnessHelper.newOperationContext());
+
+    const unsigned int lengths[] = {100, HSE_KVS_VALUE_LEN_MAX * 2};
+    for (auto len : lengths) {
+        string data = random_string(len - 1);
+        RecordId loc;
+        {
+            WriteUnitOfWork uow(opCtx.get());
+            StatusWith<RecordId> res = rs->insertRecord(opCtx.get(), data.c_str(), len, false);
+            ASSERT_OK(res.getStatus());
+            loc = res.getValue();
+            uow.commit();
+        }
+
+        RecordData record = rs->dataFor(opCtx.get(), loc);
+        ASSERT_EQUALS(len, static_cast<size_t>(record.size()));
+        ASSERT_EQUALS(record.data(), data);
+    }
+}
+
+TEST(KVDBRecordStoreTest, DocDictCompression) {
+    KVDBRecordStoreHarnessHelper harnessHelper;
+    std::unique_ptr<RecordStore> rs(harnessHelper.newNonCappedRecordStore(
+        "a.docdict",
+        BSON("value_compression"
+             << "dict"
+             << "large_value_threshold" << 1024)));
+    ServiceContext::UniqueOperationContext opCtx(harnessHelper.newOperationContext());
+
+    // Documents alike enough for a dictionary, the last one above the threshold so its
+    // stored value starts in the first chunk.
+    std::vector<string> docs;
+    for (int i = 0; i < 1200; i++) {
+        str::stream doc;
+        doc << "{\"_id\": " << i << ", \"name\": \"customer" << i % 97
+            << "\", \"address\": {\"street\": \"" << i * 7 % 1000
+            << " Main Street\", \"city\": \"Springfield\", \"zip\": \"" << 10000 + i % 50
+            << "\"}, \"status\": \"active\", \"tags\": [\"retail\", \"priority\"]}";
+        docs.push_back(doc);
+    }
+    for (int i = 0; i < 40; i++)
+        docs.back() += docs[i];
+
+    std::vector<RecordId> locs;
+    long long length = 0;
+    for (size_t i = 0; i < docs.size(); i++) {
+        // The first half is stored before the dictionary is trained, the rest with it.
+        if (i == docs.size() / 2)
+            KVDBDocDict::trainAll();
+
+        WriteUnitOfWork uow(opCtx.get());
+        StatusWith<RecordId> res =
+            rs->insertRecord(opCtx.get(), docs[i].c_str(), docs[i].size() + 1, false);
+        ASSERT_OK(res.getStatus());
+        locs.push_back(res.getValue());
+        length += docs[i].size() + 1;
+        uow.commit();
+    }
+
+    ASSERT_EQUALS(length, rs->dataSize(opCtx.get()));
+    ASSERT_LESS_THAN(rs->storageSize(opCtx.get()), length);
+
+    for (size_t i = 0; i < docs.size(); i++) {
+        RecordData record = rs->dataFor(opCtx.get(), locs[i]);
+        ASSERT_EQUALS(docs[i].size() + 1, static_cast<size_t>(record.size()));
+        ASSERT_EQUALS(record.data(), docs[i]);
+    }
+
+    {
+        auto cursor = rs->getCursor(opCtx.get(), true);
+        for (size_t i = 0; i < docs.size(); i++) {
+            auto item = cursor->next();
+            ASSERT(item);
+            ASSERT_EQUALS(item->id, locs[i]);
+            ASSERT_EQUALS(item->data.data(), docs[i]);
+        }
+        ASSERT(!cursor->next());
+    }
+
+    // Updates and deletes account for the document lengths, not the stored ones.
+    {
+        WriteUnitOfWork uow(opCtx.get());
+        ASSERT_OK(rs->updateRecord(
+            opCtx.get(), locs[0], docs.back().c_str(), docs.back().size() + 1, false, NULL));
+        length += docs.back().size() - docs[0].size();
+        ASSERT_EQUALS(length, rs->dataSize(opCtx.get()));
+
+        RecordData record = rs->dataFor(opCtx.get(), locs[0]);
+        ASSERT_EQUALS(record.data(), docs.back());
+
+        for (auto loc : locs)
+            rs->deleteRecord(opCtx.get(), loc);
+        uow.commit();
+    }
+
+    ASSERT_EQUALS(0, rs->numRecords(opCtx.get()));
+    ASSERT_EQUALS(0, rs->dataSize(opCtx.get()));
+    ASSERT_EQUALS(0, rs->storageSize(opCtx.get()));
+}
+
 TEST(KVDBRecordStoreTest, CappedOrder) {
     std::unique_ptr<KVDBRecordStoreHarnessHelper> harnessHelper(new KVDBRecordStoreHarnessHelper());
     std::unique_ptr<RecordStore> rs(harnessHelper->newCappedRecordStore("a.b", 100000, 10000));
@@ -765,6 +927,70 @@ TEST(KVDBRecordStoreTest, CappedOrder) {
     }
 }
 
+TEST(KVDBRecordStoreTest, CappedDeleteKeepsNewest) {
+    std::unique_ptr<KVDBRecordStoreHarnessHelper> harnessHelper(new KVDBRecordStoreHarnessHelper());
+    std::unique_ptr<RecordStore> rs(harnessHelper->newCappedRecordStore("a.b", 100000, 10));
+
+    // Each insert past the cap deletes the oldest record, the later passes seeking past the
+    // records deleted by the earlier ones.
+    std::vector<RecordId> ids;
+    for (int i = 0; i < 1000; i++) {
+        ServiceContext::UniqueOperationContext opCtx(harnessHelper->newOperationContext());
+        WriteUnitOfWork uow(opCtx.get());
+        StatusWith<RecordId> res = rs->insertRecord(opCtx.get(), "abc", 4, false);
+        ASSERT_OK(res.getStatus());
+        ids.push_back(res.getValue());
+        uow.commit();
+    }
+
+    ServiceContext::UniqueOperationContext opCtx(harnessHelper->newOperationContext());
+    ASSERT_EQUALS(10, rs->numRecords(opCtx.get()));
+
+    auto cursor = rs->getCursor(opCtx.get());
+    for (size_t i = ids.size() - 10; i < ids.size(); i++) {
+        auto record = cursor->next();
+        ASSERT(record);
+        ASSERT_EQ(ids[i], record->id);
+    }
+    ASSERT(!cursor->next());
+}
+
+TEST(KVDBRecordStoreTest, IdentStatsInCustomStats) {
+    std::unique_ptr<KVDBRecordStoreHarnessHelper> harnessHelper(new KVDBRecordStoreHarnessHelper());
+    std::unique_ptr<RecordStore> rs(harnessHelper->newNonCappedRecordStore());
+
+    hse_stat::KVDBStat::enableStatsGlobally(true);
+    ON_BLOCK_EXIT([] { hse_stat::KVDBStat::enableStatsGlobally(false); });
+
+    // A value above VALUE_META_THRESHOLD_LEN is stored in several chunks.
+    std::string big(3 * VALUE_META_THRESHOLD_LEN, 'x');
+    RecordId small, large;
+    {
+        ServiceContext::UniqueOperationContext opCtx(harnessHelper->newOperationContext());
+        WriteUnitOfWork uow(opCtx.get());
+        small = uassertStatusOK(rs->insertRecord(opCtx.get(), "abc", 4, false));
+        large = uassertStatusOK(rs->insertRecord(opCtx.get(), big.c_str(), big.size() + 1, false));
+        uow.commit();
+    }
+
+    ServiceContext::UniqueOperationContext opCtx(harnessHelper->newOperationContext());
+    RecordData rd;
+    ASSERT(rs->findRecord(opCtx.get(), small, &rd));
+    ASSERT(rs->findRecord(opCtx.get(), large, &rd));
+
+    BSONObjBuilder bob;
+    rs->appendCustomStats(opCtx.get(), &bob, 1);
+    BSONObj stats = bob.obj()["hse"].Obj();
+
+    ASSERT_EQ(2, stats["puts"].numberLong());
+    ASSERT_EQ(2, stats["gets"].numberLong());
+    ASSERT_EQ(static_cast<long long>(4 + big.size() + 1), stats["bytesWritten"].numberLong());
+    ASSERT_EQ(stats["bytesWritten"].numberLong(), stats["bytesRead"].numberLong());
+    ASSERT_GT(stats["largeChunksWritten"].numberLong(), 0);
+    ASSERT_EQ(stats["largeChunksWritten"].numberLong(), stats["largeChunksRead"].numberLong());
+    ASSERT_EQ(0, stats["writeConflicts"].numberLong());
+}
+
 RecordId _oplogOrderInsertOplog(OperationContext* txn, std::unique_ptr<RecordStore>& rs, int inc) {
     Timestamp opTime = Timestamp(5, inc);
     KVDBRecordStore* rrs = dynamic_cast<KVDBRecordStore*>(rs.get());
@@ -37,9 +37,11 @@
 #include "mongo/platform/basic.h"
 #include "mongo/util/log.h"
 
+#include "hse_stats.h"
 #include "hse_util.h"
 
 using hse::ClientTxn;
+using hse::KVDBBackoff;
 using hse::KVDB;
 using hse::KVDBData;
 
@@ -47,6 +49,8 @@ using namespace std;
 
 using hse::VALUE_META_SIZE;
 
+using hse_stat::_hseTxnCommitConflictCounter;
+
 namespace mongo {
 
 std::atomic<unsigned long> KVDBCounterMapUniqID;
@@ -63,13 +67,15 @@ thread_local unique_ptr<uint8_t[]> tlsReadBuf{new uint8_t[HSE_KVS_VALUE_LEN_MAX]
 /* Start  KVDBRecoveryUnit */
 KVDBRecoveryUnit::KVDBRecoveryUnit(KVDB& kvdb,
                                    KVDBCounterManager& counterManager,
-                                   KVDBDurabilityManager& durabilityManager)
+                                   KVDBDurabilityManager& durabilityManager,
+                                   KVDBSnapshotManager* snapshotManager)
     : _kvdb(kvdb),
       _snapId(nextSnapshotId.fetchAndAdd(1)),
       _txn(nullptr),
       _txn_cached(nullptr),
       _counterManager(counterManager),
-      _durabilityManager(durabilityManager) {}
+      _durabilityManager(durabilityManager),
+      _snapshotManager(snapshotManager) {}
 
 KVDBRecoveryUnit::~KVDBRecoveryUnit() {
     if (!_kvdb.kvdb_handle()) {
@@ -93,8 +99,13 @@ void KVDBRecoveryUnit::commitUnitOfWork() {
     if (_txn) {
         hse::Status st(_txn->commit());
 
-        if (!st.ok())
+        if (!st.ok()) {
+            _hseTxnCommitConflictCounter.add();
+            KVDBBackoff::noteConflict();
             throw WriteConflictException();
+        }
+
+        KVDBBackoff::noteSuccess();
 
         _txn_cached = _txn;
         _txn = nullptr;
@@ -105,11 +116,14 @@ void KVDBRecoveryUnit::commitUnitOfWork() {
         _snapId = nextSnapshotId.fetchAndAdd(1);
     }
 
+    _releaseReadView();
+
     // Sync the counters
     if (!_deltaCounters.empty()) {
         for (auto& pair : _deltaCounters) {
             auto& counter = pair.second;
             counter._value->fetch_add(counter._delta, memory_order::memory_order_relaxed);
+            _counterManager.markDirty(counter._owner);
         }
 
         _counterManager.syncPeriodic();
@@ -142,6 +156,8 @@ void KVDBRecoveryUnit::abortUnitOfWork() {
         _snapId = nextSnapshotId.fetchAndAdd(1);
     }
 
+    _releaseReadView();
+
     // rollback all changes
     try {
         for (Changes::const_reverse_iterator it = _changes.rbegin(); it != _changes.rend(); it++) {
@@ -173,13 +189,48 @@ void KVDBRecoveryUnit::abandonSnapshot() {
         _snapId = nextSnapshotId.fetchAndAdd(1);
     }
 
+    _releaseReadView();
+
     _deltaCounters.clear();
 }
 
+Status KVDBRecoveryUnit::setReadFromMajorityCommittedSnapshot() {
+    if (!_snapshotManager)
+        return RecoveryUnit::setReadFromMajorityCommittedSnapshot();
+
+    auto snapshotName = _snapshotManager->getMinSnapshotForNextCommittedRead();
+    if (!snapshotName) {
+        return {ErrorCodes::ReadConcernMajorityNotAvailableYet,
+                "Read concern majority reads are currently not possible."};
+    }
+
+    _majorityCommittedSnapshot = *snapshotName;
+    _readFromMajorityCommittedSnapshot = true;
+    return Status::OK();
+}
+
+boost::optional<SnapshotName> KVDBRecoveryUnit::getMajorityCommittedSnapshot() const {
+    if (!_readFromMajorityCommittedSnapshot)
+        return {};
+    return _majorityCommittedSnapshot;
+}
+
+void KVDBRecoveryUnit::prepareForCreateSnapshot() {
+    invariantHse(_snapshotManager);
+    invariantHse(!_readFromMajorityCommittedSnapshot);
+    invariantHse(!_txn && !_readView);
+
+    _readView = _snapshotManager->beginView();
+}
+
 SnapshotId KVDBRecoveryUnit::getSnapshotId() const {
     return SnapshotId(_snapId);
 }
 
+uint64_t KVDBRecoveryUnit::newSnapshotIdHorizon() {
+    return nextSnapshotId.fetchAndAdd(1);
+}
+
 void KVDBRecoveryUnit::registerChange(Change* change) {
     _changes.push_back(change);
 }
@@ -190,9 +241,12 @@ void* KVDBRecoveryUnit::writingPtr(void* data, size_t len) {
 
 void KVDBRecoveryUnit::setRollbackWritesDisabled() {}
 
-hse::Status KVDBRecoveryUnit::put(const KVSHandle& h, const KVDBData& key, const KVDBData& val) {
-    _ensureTxn();
-    hse::Status st = _kvdb.kvs_put(h, _txn, key, val);
+hse::Status KVDBRecoveryUnit::put(const KVSHandle& h,
+                                  const KVDBData& key,
+                                  const KVDBData& val,
+                                  unsigned int flags) {
+    _ensureWriteTxn();
+    hse::Status st = _kvdb.kvs_put(h, _txn, key, val, flags);
     int errn = st.getErrno();
     if (ECANCELED == errn) {
         throw WriteConflictException();
@@ -202,17 +256,16 @@ hse::Status KVDBRecoveryUnit::put(const KVSHandle& h, const KVDBData& key, const
 
 hse::Status KVDBRecoveryUnit::probeVlen(
     const KVSHandle& h, const KVDBData& key, KVDBData& val, unsigned long len, bool& found) {
-    _ensureTxn();
+    ClientTxn* txn = _readTxn();
     invariantHse(tlsReadBuf);
     val.setReadBuf(tlsReadBuf.get(), len);
 
-    return _kvdb.kvs_probe_len(h, _txn, key, val, found);
+    return _kvdb.kvs_probe_len(h, txn, key, val, found);
 }
 
 hse::Status KVDBRecoveryUnit::_get(
     const KVSHandle& h, const KVDBData& key, KVDBData& val, bool& found, bool use_txn) {
-    if (use_txn)
-        _ensureTxn();
+    ClientTxn* txn = use_txn ? _readTxn() : nullptr;
 
     // Allocate a new buffer if none exists, or if the owned buffer
     // isn't an incomplete chunked buffer (with room to copy more).
@@ -221,7 +274,7 @@ hse::Status KVDBRecoveryUnit::_get(
         val.setReadBuf(tlsReadBuf.get(), HSE_KVS_VALUE_LEN_MAX);
     }
 
-    return _kvdb.kvs_get(h, use_txn ? _txn : nullptr, key, val, found);
+    return _kvdb.kvs_get(h, txn, key, val, found);
 }
 
 hse::Status KVDBRecoveryUnit::getMCo(
@@ -229,25 +282,32 @@ hse::Status KVDBRecoveryUnit::getMCo(
     return _get(h, key, val, found, use_txn);
 }
 
+hse::Status KVDBRecoveryUnit::getChunk(
+    const KVSHandle& h, const KVDBData& key, KVDBData& val, bool& found, bool use_txn) {
+    ClientTxn* txn = use_txn ? _readTxn() : nullptr;
+
+    return _kvdb.kvs_get(h, txn, key, val, found);
+}
+
 hse::Status KVDBRecoveryUnit::prefixGet(const KVSHandle& h,
                                         const KVDBData& prefix,
                                         KVDBData& key,
                                         KVDBData& val,
                                         hse_kvs_pfx_probe_cnt& found) {
-    _ensureTxn();
+    ClientTxn* txn = _readTxn();
 
-    return _kvdb.kvs_prefix_probe(h, _txn, prefix, key, val, found);
+    return _kvdb.kvs_prefix_probe(h, txn, prefix, key, val, found);
 }
 
 
 hse::Status KVDBRecoveryUnit::probeKey(const KVSHandle& h, const KVDBData& key, bool& found) {
-    _ensureTxn();
+    ClientTxn* txn = _readTxn();
 
-    return _kvdb.kvs_probe_key(h, _txn, key, found);
+    return _kvdb.kvs_probe_key(h, txn, key, found);
 }
 
 hse::Status KVDBRecoveryUnit::del(const KVSHandle& h, const KVDBData& key) {
-    _ensureTxn();
+    _ensureWriteTxn();
     hse::Status st = _kvdb.kvs_delete(h, _txn, key);
     int errn = st.getErrno();
     if (ECANCELED == errn) {
@@ -259,7 +319,7 @@ hse::Status KVDBRecoveryUnit::del(const KVSHandle& h, const KVDBData& key) {
 hse::Status KVDBRecoveryUnit::prefixDelete(const KVSHandle& h, const KVDBData& prefix) {
     hse::Status st;
 
-    _ensureTxn();
+    _ensureWriteTxn();
     st = _kvdb.kvs_prefix_delete(h, _txn, prefix);
     if (st.getErrno() == ECANCELED)
         throw WriteConflictException();
@@ -268,7 +328,7 @@ hse::Status KVDBRecoveryUnit::prefixDelete(const KVSHandle& h, const KVDBData& p
 }
 
 hse::Status KVDBRecoveryUnit::iterDelete(const KVSHandle& h, const KVDBData& prefix) {
-    _ensureTxn();
+    _ensureWriteTxn();
     hse::Status st = _kvdb.kvs_iter_delete(h, _txn, prefix);
     int errn = st.getErrno();
     if (ECANCELED == errn) {
@@ -283,10 +343,10 @@ hse::Status KVDBRecoveryUnit::beginScan(const KVSHandle& h,
                                         KvsCursor** cursor) {
     KvsCursor* lcursor = 0;
 
-    _ensureTxn();
+    ClientTxn* txn = _readTxn();
 
     try {
-        lcursor = create_cursor(h, pfx, forward, _txn);
+        lcursor = _kvdb.kvs_cursor_create(h, pfx, forward, txn);
     } catch (...) {
         return hse::Status(ENOMEM);
     }
@@ -297,8 +357,7 @@ hse::Status KVDBRecoveryUnit::beginScan(const KVSHandle& h,
 }
 
 hse::Status KVDBRecoveryUnit::cursorUpdate(KvsCursor* cursor) {
-    _ensureTxn();
-    auto st = cursor->update(_txn);
+    auto st = cursor->update(_readTxn());
     invariantHse(st.ok());
 
     return st;
@@ -315,6 +374,13 @@ hse::Status KVDBRecoveryUnit::cursorRead(KvsCursor* cursor,
     return cursor->read(key, val, eof);
 }
 
+hse::Status KVDBRecoveryUnit::cursorReadBatch(KvsCursor* cursor,
+                                              hse::KvsCursorBatch& batch,
+                                              size_t maxKeys,
+                                              bool& eof) {
+    return cursor->readBatch(batch, maxKeys, eof);
+}
+
 hse::Status KVDBRecoveryUnit::endScan(KvsCursor* cursor) {
     delete cursor;
 
@@ -329,7 +395,7 @@ hse::Status KVDBRecoveryUnit::beginOplogScan(const KVSHandle& h,
 
     /* Make sure this is an unbound cursor in order to be see all commits so far. */
     try {
-        lcursor = create_cursor(h, pfx, forward, nullptr);
+        lcursor = _kvdb.kvs_cursor_create(h, pfx, forward, nullptr);
     } catch (...) {
         return hse::Status(ENOMEM);
     }
@@ -356,7 +422,8 @@ hse::Status KVDBRecoveryUnit::oplogCursorSeek(KvsCursor* cursor,
 
 void KVDBRecoveryUnit::incrementCounter(unsigned long counterKey,
                                         std::atomic<long long>* counter,
-                                        long long delta) {
+                                        long long delta,
+                                        KVDBCounterOwner* owner) {
     if (delta == 0) {
         return;
     }
@@ -366,14 +433,17 @@ void KVDBRecoveryUnit::incrementCounter(unsigned long counterKey,
 
     auto pair = _deltaCounters.find(counterKey);
     if (pair == _deltaCounters.end()) {
-        _deltaCounters[counterKey] = KVDBCounter(counter, delta);
+        _deltaCounters[counterKey] = KVDBCounter(counter, delta, owner);
     } else {
         pair->second._delta += delta;
     }
 }
 
-void KVDBRecoveryUnit::resetCounter(unsigned long counterKey, std::atomic<long long>* counter) {
+void KVDBRecoveryUnit::resetCounter(unsigned long counterKey,
+                                    std::atomic<long long>* counter,
+                                    KVDBCounterOwner* owner) {
     counter->store(0);
+    _counterManager.markDirty(owner);
 }
 
 long long KVDBRecoveryUnit::getDeltaCounter(unsigned long counterKey) {
@@ -390,7 +460,7 @@ long long KVDBRecoveryUnit::getDeltaCounter(unsigned long counterKey) {
 // }
 
 KVDBRecoveryUnit* KVDBRecoveryUnit::newKVDBRecoveryUnit() {
-    return new KVDBRecoveryUnit(_kvdb, _counterManager, _durabilityManager);
+    return new KVDBRecoveryUnit(_kvdb, _counterManager, _durabilityManager, _snapshotManager);
 }
 
 // private
@@ -403,7 +473,7 @@ void KVDBRecoveryUnit::_ensureTxn() {
             _txn_cached = nullptr;
         } else {
             try {
-                _txn = new (_txn_mem) ClientTxn(_kvdb.kvdb_handle());
+                _txn = new (_txn_mem) ClientTxn(_kvdb);
             } catch (...) {
                 st = hse::Status{1};
             }
@@ -416,5 +486,47 @@ void KVDBRecoveryUnit::_ensureTxn() {
     }
 }
 
+ClientTxn* KVDBRecoveryUnit::_beginRead() {
+    if (_snapshotManager && _snapshotManager->sharedReadViewsEnabled() && !_ownTxnReads) {
+        _latestView = _snapshotManager->getLatestView(&_latestViewEpoch);
+        if (_latestView)
+            return _latestView.get();
+    }
+
+    _ensureTxn();
+    return _txn;
+}
+
+void KVDBRecoveryUnit::_upgradeLatestView() {
+    // Reads so far came from the shared view. The transaction begun here sees the same
+    // state only if nothing started to commit in between, otherwise a write based on those
+    // reads could miss a conflict. Cursors already open stay on the shared view.
+    _ensureTxn();
+
+    if (!_snapshotManager->isLatest(_latestViewEpoch)) {
+        // The retry reads through its own transaction, or a busy KVDB would fail it again.
+        _ownTxnReads = true;
+        _snapshotManager->noteUpgradeConflict();
+        throw WriteConflictException();
+    }
+}
+
+ClientTxn* KVDBRecoveryUnit::_ensureReadView() {
+    if (!_readView) {
+        invariantHse(_snapshotManager);
+        _readView = _snapshotManager->getCommittedView(&_majorityCommittedSnapshot);
+    }
+
+    return _readView.get();
+}
+
+void KVDBRecoveryUnit::_releaseReadView() {
+    if (_readView || _latestView) {
+        _readView.reset();
+        _latestView.reset();
+        _snapId = nextSnapshotId.fetchAndAdd(1);
+    }
+}
+
 /* End  KVDBRecoveryUnit */
 }  // namespace mongo
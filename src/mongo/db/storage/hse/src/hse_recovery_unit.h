@@ -55,6 +55,7 @@
 #include "hse_durability_manager.h"
 #include "hse_exceptions.h"
 #include "hse_kvscursor.h"
+#include "hse_snapshot_manager.h"
 #include "hse_util.h"
 
 using hse::KVDB;
@@ -70,9 +71,11 @@ namespace mongo {
 struct KVDBCounter {
     std::atomic<long long>* _value;
     long long _delta;
+    KVDBCounterOwner* _owner;
 
-    KVDBCounter() : KVDBCounter(nullptr, 0) {}
-    KVDBCounter(std::atomic<long long>* value, long long delta) : _value(value), _delta(delta) {}
+    KVDBCounter() : KVDBCounter(nullptr, 0, nullptr) {}
+    KVDBCounter(std::atomic<long long>* value, long long delta, KVDBCounterOwner* owner)
+        : _value(value), _delta(delta), _owner(owner) {}
 };
 
 typedef std::unordered_map<unsigned long, KVDBCounter> KVDBCounterMap;
@@ -85,7 +88,8 @@ class KVDBRecoveryUnit : public RecoveryUnit {
 public:
     KVDBRecoveryUnit(KVDB& kvdb,
                      KVDBCounterManager& counterManager,
-                     KVDBDurabilityManager& durabilityManager);
+                     KVDBDurabilityManager& durabilityManager,
+                     KVDBSnapshotManager* snapshotManager = nullptr);
 
     virtual ~KVDBRecoveryUnit();
 
@@ -99,25 +103,32 @@ public:
 
     virtual void abandonSnapshot();
 
-    // [HSE_REVISIT] - Default for now
-    // virtual Status setReadFromMajorityCommittedSnapshot() {
-    //    return {ErrorCodes::CommandNotSupported,
-    //            "Current storage engine does not support majority
-    //            readConcerns"};
-    //}
+    virtual Status setReadFromMajorityCommittedSnapshot();
 
-    // virtual bool isReadingFromMajorityCommittedSnapshot() const {
-    //    return false;
-    //}
+    virtual bool isReadingFromMajorityCommittedSnapshot() const {
+        return _readFromMajorityCommittedSnapshot;
+    }
+
+    virtual boost::optional<SnapshotName> getMajorityCommittedSnapshot() const;
+
+    // Takes the view that KVDBSnapshotManager::createSnapshot() names. Reads use it until
+    // the snapshot is abandoned.
+    void prepareForCreateSnapshot();
 
-    // virtual boost::optional<SnapshotName> getMajorityCommittedSnapshot() const
-    // {
-    //    dassert(!isReadingFromMajorityCommittedSnapshot());
-    //    return {};
-    //}
+    KVDBSnapshotManager::View getPreparedView() const {
+        return _readView;
+    }
 
     virtual SnapshotId getSnapshotId() const;
 
+    // Snapshot IDs are handed out before the transaction they name begins, so an RU
+    // whose ID is above a horizon reads a view newer than the moment it was taken.
+    uint64_t getSnapIdRaw() const {
+        return _snapId;
+    }
+
+    static uint64_t newSnapshotIdHorizon();
+
     virtual void registerChange(Change* change);
 
     virtual void* writingPtr(void* data, size_t len);
@@ -131,7 +142,10 @@ public:
         const KVSHandle& h, const KVDBData& key, KVDBData& val, bool& found, bool use_txn);
     hse::Status probeVlen(
         const KVSHandle& h, const KVDBData& key, KVDBData& val, unsigned long len, bool& found);
-    hse::Status put(const KVSHandle& h, const KVDBData& key, const KVDBData& val);
+    hse::Status put(const KVSHandle& h,
+                    const KVDBData& key,
+                    const KVDBData& val,
+                    unsigned int flags = 0);
     hse::Status getCo(const KVSHandle& h,
                       const KVDBData& key,
                       KVDBData& val,
@@ -139,6 +153,9 @@ public:
                       unsigned long& foundLen);
     hse::Status getMCo(
         const KVSHandle& h, const KVDBData& key, KVDBData& val, bool& found, bool use_txn = true);
+    // Appends the value of key to val, which must have room for it.
+    hse::Status getChunk(
+        const KVSHandle& h, const KVDBData& key, KVDBData& val, bool& found, bool use_txn);
     hse::Status probeKey(const KVSHandle& h, const KVDBData& key, bool& found);
     hse::Status del(const KVSHandle& h, const KVDBData& key);
     hse::Status prefixGet(const KVSHandle& h,
@@ -152,6 +169,10 @@ public:
     hse::Status cursorUpdate(KvsCursor* cursor);
     hse::Status cursorSeek(KvsCursor* cursor, const KVDBData& key, KVDBData* foundKey);
     hse::Status cursorRead(KvsCursor* cursor, KVDBData& key, KVDBData& val, bool& eof);
+    hse::Status cursorReadBatch(KvsCursor* cursor,
+                                hse::KvsCursorBatch& batch,
+                                size_t maxKeys,
+                                bool& eof);
     hse::Status endScan(KvsCursor* cursor);
 
     hse::Status beginOplogScan(const KVSHandle& h,
@@ -171,8 +192,11 @@ public:
 
     void incrementCounter(unsigned long counterKey,
                           std::atomic<long long>* counter,
-                          long long delta);
-    void resetCounter(unsigned long counterKey, std::atomic<long long>* counter);
+                          long long delta,
+                          KVDBCounterOwner* owner);
+    void resetCounter(unsigned long counterKey,
+                      std::atomic<long long>* counter,
+                      KVDBCounterOwner* owner);
 
     long long getDeltaCounter(unsigned long counterKey);
 
@@ -180,11 +204,51 @@ public:
         return (_txn != nullptr);
     }
 
+    // Begins the transaction ahead of the next read, so that in-memory state
+    // consulted in between is at least as new as the view that read gets.
+    void ensureSnapshot() {
+        _readTxn();
+    }
+
     KVDBRecoveryUnit* newKVDBRecoveryUnit();
 
+    // Reads go through the unit of work's own transaction rather than a shared view, for
+    // units of work that write what they read.
+    void setOwnTxnReads() {
+        _ownTxnReads = true;
+    }
+
 private:
     void _ensureTxn();
 
+    // The transaction reads go through: the snapshot view when there is one, otherwise
+    // the unit of work's own transaction, or the shared view of the latest committed state
+    // until the unit of work first writes.
+    ClientTxn* _readTxn() {
+        if (MONGO_unlikely(_readFromMajorityCommittedSnapshot || _readView))
+            return _ensureReadView();
+
+        if (_txn)
+            return _txn;
+
+        if (_latestView)
+            return _latestView.get();
+
+        return _beginRead();
+    }
+
+    void _ensureWriteTxn() {
+        if (MONGO_unlikely(!_txn && _latestView))
+            _upgradeLatestView();
+        else
+            _ensureTxn();
+    }
+
+    ClientTxn* _beginRead();
+    void _upgradeLatestView();
+    ClientTxn* _ensureReadView();
+    void _releaseReadView();
+
     KVDB& _kvdb;  // db handle
 
     uint64_t _snapId;  // read snapshot ID
@@ -199,6 +263,18 @@ private:
 
     KVDBCounterManager& _counterManager;
     KVDBDurabilityManager& _durabilityManager;
+    KVDBSnapshotManager* _snapshotManager;
+
+    bool _readFromMajorityCommittedSnapshot{false};
+    SnapshotName _majorityCommittedSnapshot{SnapshotName::min()};
+
+    // Shared, read-only view of a named snapshot, see KVDBSnapshotManager.
+    KVDBSnapshotManager::View _readView;
+
+    // Shared view of the latest committed state, read through until the first write.
+    KVDBSnapshotManager::View _latestView;
+    uint64_t _latestViewEpoch{0};
+    bool _ownTxnReads{false};
 
     KVDBCounterMap _deltaCounters;
 
@@ -45,6 +45,7 @@
 #include "mongo/util/scopeguard.h"
 
 #include "hse_engine.h"
+#include "hse_idx_filter.h"
 
 namespace mongo {
 using std::string;
@@ -71,6 +72,15 @@ BSONObj KVDBServerStatusSection::generateSection(OperationContext* txn,
 
     bob.append("versionInfo", _buildStatsBObj(gHseStatVersionList));
     bob.append("appBytes", _buildStatsBObj(gHseStatAppBytesList));
+    bob.append("indexFilter", KVDBIdxFilter::getGlobalStats());
+    {
+        BSONObjBuilder mclassBob(bob.subobjStart("mediaClasses"));
+        _engine.appendMclassStats(&mclassBob);
+    }
+    bob.append("identDrops", _engine.getIdentDropStats());
+    bob.append("compaction", _engine.getCompactStatus());
+    bob.append("backup", _engine.getBackupStatus());
+    bob.append("sharedReadViews", _engine.getSharedReadViewStats());
     if (KVDBStat::isStatsEnabledGlobally()) {
         bob.append("counters", _buildStatsBObj(gHseStatCounterList));
         bob.append("latencies", _buildStatsBObj(gHseStatLatencyList));
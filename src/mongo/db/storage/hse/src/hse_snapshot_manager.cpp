@@ -0,0 +1,233 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include <vector>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/util/log.h"
+
+#include "hse_recovery_unit.h"
+#include "hse_snapshot_manager.h"
+#include "hse_util.h"
+
+using hse::ClientTxn;
+using hse::KVDB;
+
+namespace mongo {
+
+/* Start KVDBSnapshotManager */
+
+// The replication snapshot thread stops creating snapshots at 1000 uncommitted ones. Each
+// view pins versions in HSE, so fewer are kept and the oldest uncommitted view is given up
+// first. The committed point then lags until it reaches a newer view.
+const size_t KVDBSnapshotManager::kMaxRetainedViews = 256;
+
+Status KVDBSnapshotManager::prepareForCreateSnapshot(OperationContext* txn) {
+    KVDBRecoveryUnit::getKVDBRecoveryUnit(txn)->prepareForCreateSnapshot();
+    return Status::OK();
+}
+
+Status KVDBSnapshotManager::createSnapshot(OperationContext* txn, const SnapshotName& name) {
+    View view = KVDBRecoveryUnit::getKVDBRecoveryUnit(txn)->getPreparedView();
+    invariantHse(view);
+
+    stdx::lock_guard<stdx::mutex> lock(_mutex);
+
+    invariantHse(_views.empty() || _views.rbegin()->first < name);
+    _views.emplace(name, std::move(view));
+
+    if (_views.size() > kMaxRetainedViews) {
+        auto it = _views.begin();
+        if (_committedSnapshot && it->first <= *_committedSnapshot)
+            it = _views.upper_bound(*_committedSnapshot);
+        if (it != _views.end() && it != std::prev(_views.end())) {
+            LOG(1) << "HSE: giving up uncommitted snapshot " << it->first.toString()
+                   << ", " << _views.size() << " views retained";
+            _views.erase(it);
+        }
+    }
+
+    return Status::OK();
+}
+
+void KVDBSnapshotManager::setCommittedSnapshot(const SnapshotName& name) {
+    stdx::lock_guard<stdx::mutex> lock(_mutex);
+
+    invariantHse(!_committedSnapshot || *_committedSnapshot <= name);
+
+    auto it = _views.upper_bound(name);
+    if (it == _views.begin())
+        return;  // No view at or below name, keep the current one.
+
+    --it;
+    _committedSnapshot = it->first;
+    _committedView = it->second;
+}
+
+void KVDBSnapshotManager::cleanupUnneededSnapshots() {
+    std::vector<View> unneeded;
+
+    {
+        stdx::lock_guard<stdx::mutex> lock(_mutex);
+
+        if (!_committedSnapshot)
+            return;
+
+        auto end = _views.lower_bound(*_committedSnapshot);
+        for (auto it = _views.begin(); it != end; ++it)
+            unneeded.push_back(std::move(it->second));
+        _views.erase(_views.begin(), end);
+    }
+
+    // Views no reader holds are aborted here, outside the mutex.
+}
+
+void KVDBSnapshotManager::dropAllSnapshots() {
+    std::map<SnapshotName, View> views;
+    View committedView;
+    std::vector<View> latestViews;
+
+    {
+        stdx::lock_guard<stdx::mutex> lock(_mutex);
+
+        views.swap(_views);
+        committedView.swap(_committedView);
+        _committedSnapshot = boost::none;
+    }
+
+    for (auto& slot : _latestViewSlots) {
+        stdx::lock_guard<stdx::mutex> lock(slot.mutex);
+        latestViews.push_back(std::move(slot.view));
+    }
+
+    // Released outside the mutex, as in cleanupUnneededSnapshots().
+}
+
+KVDBSnapshotManager::View KVDBSnapshotManager::beginView() {
+    KVDB* db = &_db;
+
+    View view(new ClientTxn(*db), [db](ClientTxn* txn) {
+        if (!db->kvdb_handle()) {
+            // kvdb_close() has already freed the txn, only the wrapper is left.
+            ::operator delete(txn);
+            return;
+        }
+
+        invariantHseSt(txn->abort());
+        delete txn;
+    });
+
+    invariantHseSt(view->begin());
+
+    return view;
+}
+
+boost::optional<SnapshotName> KVDBSnapshotManager::getMinSnapshotForNextCommittedRead() const {
+    stdx::lock_guard<stdx::mutex> lock(_mutex);
+    return _committedSnapshot;
+}
+
+KVDBSnapshotManager::View KVDBSnapshotManager::getCommittedView(SnapshotName* name) const {
+    stdx::lock_guard<stdx::mutex> lock(_mutex);
+
+    uassert(ErrorCodes::ReadConcernMajorityNotAvailableYet,
+            "Committed view disappeared while running operation",
+            _committedSnapshot);
+
+    *name = *_committedSnapshot;
+    return _committedView;
+}
+
+size_t KVDBSnapshotManager::numRetainedViews() const {
+    stdx::lock_guard<stdx::mutex> lock(_mutex);
+    return _views.size();
+}
+
+KVDBSnapshotManager::View KVDBSnapshotManager::getLatestView(uint64_t* epoch) {
+    static AtomicUInt32 nextSlot;
+    thread_local const size_t slotIndex = nextSlot.fetchAndAdd(1) % kLatestViewSlots;
+    LatestViewSlot& slot = _latestViewSlots[slotIndex];
+
+    const uint64_t started = ClientTxn::commitsStarted();
+
+    {
+        stdx::lock_guard<stdx::mutex> lock(slot.mutex);
+        if (slot.view && slot.epoch == started) {
+            *epoch = started;
+            return slot.view;
+        }
+    }
+
+    // A commit in progress may land before or after a view begun now, so the view would
+    // not be known to be current.
+    if (ClientTxn::commitsDone() != started)
+        return {};
+
+    View view = beginView();
+    if (!isLatest(started))
+        return {};
+
+    _latestViewsBegun.fetchAndAdd(1);
+
+    View replaced;
+
+    {
+        stdx::lock_guard<stdx::mutex> lock(slot.mutex);
+        if (!slot.view || slot.epoch < started) {
+            replaced = std::move(slot.view);
+            slot.view = view;
+            slot.epoch = started;
+        }
+    }
+
+    *epoch = started;
+    return view;
+}
+
+BSONObj KVDBSnapshotManager::getSharedReadViewStats() const {
+    BSONObjBuilder bob;
+
+    bob.appendBool("enabled", _sharedReadViews);
+    bob.appendNumber("viewsBegun", static_cast<long long>(_latestViewsBegun.load()));
+    bob.appendNumber("upgradeConflicts", static_cast<long long>(_upgradeConflicts.load()));
+
+    return bob.obj();
+}
+
+/* End KVDBSnapshotManager */
+}  // namespace mongo
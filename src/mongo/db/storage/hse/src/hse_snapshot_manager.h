@@ -0,0 +1,158 @@
+/**
+ *    SPDX-License-Identifier: AGPL-3.0-only
+ *
+ *    Copyright (C) 2017-2020 Micron Technology, Inc.
+ *
+ *    This code is derived from and modifies the mongo-rocks project.
+ *
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+
+#include <boost/optional.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/storage/snapshot_manager.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/mutex.h"
+
+#include "hse.h"
+#include "hse_clienttxn.h"
+
+namespace mongo {
+
+/**
+ * Named snapshots are HSE transactions that are begun and never written to. A transaction
+ * reads as of the moment it began, so one begun in prepareForCreateSnapshot() is a stable
+ * view of everything committed before it, and readers of the majority committed snapshot
+ * share the view taken for it.
+ *
+ * An open view holds back HSE garbage collection of the versions it can see. Views older
+ * than the committed one are dropped by cleanupUnneededSnapshots(), and at most
+ * kMaxRetainedViews views are retained at once. A view stays open while a reader holds it.
+ *
+ * With shared read views enabled, the manager also keeps a view of the latest committed
+ * state for units of work that have not written, so that concurrent queries share one
+ * transaction instead of each beginning and aborting their own. That view is current only
+ * while no transaction has started to commit since it was begun, as counted by ClientTxn.
+ * Threads share the view through one of kLatestViewSlots slots, so that readers do not all
+ * take the same mutex.
+ */
+class KVDBSnapshotManager final : public SnapshotManager {
+    MONGO_DISALLOW_COPYING(KVDBSnapshotManager);
+
+public:
+    typedef std::shared_ptr<hse::ClientTxn> View;
+
+    static const size_t kMaxRetainedViews;
+    static const size_t kLatestViewSlots = 16;
+
+    KVDBSnapshotManager(hse::KVDB& db, bool sharedReadViews)
+        : _db(db), _sharedReadViews(sharedReadViews) {
+        if (sharedReadViews)
+            hse::ClientTxn::enableCommitCounting();
+    }
+
+    Status prepareForCreateSnapshot(OperationContext* txn) final;
+    Status createSnapshot(OperationContext* txn, const SnapshotName& name) final;
+    void setCommittedSnapshot(const SnapshotName& name) final;
+    void cleanupUnneededSnapshots() final;
+    void dropAllSnapshots() final;
+
+    /**
+     * Begins a transaction that views everything committed so far.
+     */
+    View beginView();
+
+    /**
+     * Returns the name of the snapshot that the next majority committed read will use, or
+     * boost::none if there is no committed snapshot.
+     */
+    boost::optional<SnapshotName> getMinSnapshotForNextCommittedRead() const;
+
+    /**
+     * Returns the view of the committed snapshot and stores its name in 'name'. Throws
+     * ReadConcernMajorityNotAvailableYet if there is no committed snapshot.
+     */
+    View getCommittedView(SnapshotName* name) const;
+
+    size_t numRetainedViews() const;
+
+    bool sharedReadViewsEnabled() const {
+        return _sharedReadViews;
+    }
+
+    /**
+     * Returns a view of the latest committed state and stores its epoch in 'epoch', or null
+     * if a commit is in progress.
+     */
+    View getLatestView(uint64_t* epoch);
+
+    /**
+     * True if no transaction has started to commit since the view of 'epoch' was begun, i.e.
+     * a transaction begun now sees exactly what that view sees.
+     */
+    bool isLatest(uint64_t epoch) const {
+        return hse::ClientTxn::commitsStarted() == epoch;
+    }
+
+    void noteUpgradeConflict() {
+        _upgradeConflicts.fetchAndAdd(1);
+    }
+
+    BSONObj getSharedReadViewStats() const;
+
+private:
+    hse::KVDB& _db;
+
+    mutable stdx::mutex _mutex;
+
+    // Retained views by name, oldest first.
+    std::map<SnapshotName, View> _views;
+
+    // The newest retained view named at or below the committed snapshot.
+    boost::optional<SnapshotName> _committedSnapshot;
+    View _committedView;
+
+    const bool _sharedReadViews;
+
+    AtomicUInt64 _latestViewsBegun;
+    AtomicUInt64 _upgradeConflicts;
+
+    struct alignas(64) LatestViewSlot {
+        stdx::mutex mutex;  // protects view and epoch
+        View view;
+        uint64_t epoch{0};
+    };
+    std::array<LatestViewSlot, kLatestViewSlots> _latestViewSlots;
+};
+}  // namespace mongo
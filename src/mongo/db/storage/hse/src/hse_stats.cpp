@@ -82,13 +82,28 @@ bool KVDBStat::statsEnabled = false;
  * group to access.  In practice, we split the array into two equal parts and
  * use the low bit of the NUMA node ID to select the part and hence eliminate
  * or reduce cacheline thrashing between NUMA nodes.
+ *
+ * A group holds 32 counters, the retry and backoff counters took the count past 16.
  */
-#define COUNTERS_PER_GROUP (16)
+#define COUNTERS_PER_GROUP (32)
 #define COUNTER_GROUPS_MAX (16)
 
 atomic<int64_t> countersc;
 alignas(128) atomic<int64_t> countersv[COUNTERS_PER_GROUP * COUNTER_GROUPS_MAX];
 
+static_assert(KVDBStatLatency::kShards == COUNTER_GROUPS_MAX,
+              "latency shards must map one to one onto counter groups");
+
+// Returns the counter group of the calling thread's CPU.
+static unsigned int statGroup() {
+    unsigned int cpuid, nodeid;
+
+    if (syscall(SYS_getcpu, &cpuid, &nodeid))
+        cpuid = nodeid = 0;
+
+    return cpuid % (COUNTER_GROUPS_MAX / 2) + (nodeid & 1u) * (COUNTER_GROUPS_MAX / 2);
+}
+
 
 // begin KVDBStat
 KVDBStat::KVDBStat(const string name) : _name(name) {
@@ -112,11 +127,6 @@ void KVDBStat::enableStatsGlobally(bool enable) {
         st->_enabled = statsEnabled || st->_enableOverride;
 }
 
-// This does not reflect enable overrides
-bool KVDBStat::isStatsEnabledGlobally() {
-    return statsEnabled;
-}
-
 KVDBStat::~KVDBStat() {}
 // end KVDBStat
 
@@ -143,65 +153,137 @@ void KVDBStatCounter::appendTo(BSONObjBuilder& bob) const {
 }
 
 void KVDBStatCounter::add_impl(int64_t incr) {
-    unsigned int cpuid, nodeid;
-
-    if (syscall(SYS_getcpu, &cpuid, &nodeid))
-        cpuid = nodeid = 0;
-
-    cpuid = cpuid % (COUNTER_GROUPS_MAX / 2) + (nodeid & 1u) * (COUNTER_GROUPS_MAX / 2);
-
-    _counterv[cpuid * COUNTERS_PER_GROUP].fetch_add(incr, memory_order::memory_order_relaxed);
+    _counterv[statGroup() * COUNTERS_PER_GROUP].fetch_add(incr, memory_order::memory_order_relaxed);
 }
 
 KVDBStatCounter::~KVDBStatCounter() {}
 // end KVDBStatCounter
 
 // begin KVDBStatLatency
-KVDBStatLatency::KVDBStatLatency(const string name, int32_t buckets, int64_t interval)
-    : KVDBStat(name), _buckets{buckets}, _interval{interval} {
+constexpr int KVDBStatLatency::kSubBucketBits;
+constexpr int KVDBStatLatency::kSubBuckets;
+constexpr int KVDBStatLatency::kMaxBits;
+constexpr int KVDBStatLatency::kBuckets;
+constexpr int KVDBStatLatency::kShards;
+
+KVDBStatLatency::KVDBStatLatency(const string name) : KVDBStat(name) {
     gHseStatLatencyList.push_back(this);
 
-    /* Need an even number of buckets in order to simplify bucket interleaving,
-     * plus one for the latencies that fall outside the histogram bounds.
+    for (auto& shard : _shards) {
+        for (auto& hits : shard.hits)
+            hits.store(0, memory_order::memory_order_relaxed);
+        shard.total.store(0, memory_order::memory_order_relaxed);
+        shard.minLatency.store(INT64_MAX, memory_order::memory_order_relaxed);
+        shard.maxLatency.store(0, memory_order::memory_order_relaxed);
+    }
+}
+
+int KVDBStatLatency::bucketOf(int64_t ns) {
+    if (ns < 2 * kSubBuckets)
+        return (ns < 0) ? 0 : ns;
+
+    /* For a latency whose most significant bit is msb, the octave is selected
+     * by msb and the sub-bucket by the kSubBucketBits bits below it.
      */
-    _buckets = (_buckets + 1) & ~1u;
-    _histogram.resize(_buckets + 1);
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb >= kMaxBits)
+        return kBuckets - 1;
+
+    int octave = msb - kSubBucketBits + 1;
+    int sub = (ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+
+    return octave * kSubBuckets + sub;
+}
+
+int64_t KVDBStatLatency::bucketLowerBound(int bucket) {
+    if (bucket < 2 * kSubBuckets)
+        return bucket;
+
+    int octave = bucket / kSubBuckets;
+    int sub = bucket % kSubBuckets;
+
+    return static_cast<int64_t>(kSubBuckets + sub) << (octave - 1);
 }
 
 void KVDBStatLatency::appendTo(BSONObjBuilder& bob) const {
+    _append(bob, true);
+}
+
+void KVDBStatLatency::appendSummaryTo(BSONObjBuilder& bob) const {
+    _append(bob, false);
+}
+
+void KVDBStatLatency::_append(BSONObjBuilder& bob, bool withHistogram) const {
     if (!isStatEnabled()) {
         return;
     }
 
-    BSONObjBuilder lBob;
-    lBob.append("buckets", _buckets);
-    lBob.append("interval", _interval);
-    lBob.append("histogramsOverflow",
-                _histogram[_buckets].hits.load(memory_order::memory_order_relaxed));
-    lBob.append("minLatency", (_minLatency == INT64_MAX) ? 0 : _minLatency);
-    lBob.append("maxLatency", _maxLatency);
-
-    BSONArrayBuilder hitsArrBob{_buckets};
-    BSONArrayBuilder avArrBob{_buckets};
-
-    for (int i = 0; i < _buckets; i += 2) {
-        int64_t hits = _histogram[i].hits.load(memory_order::memory_order_relaxed);
-        int64_t total = _histogram[i].total.load(memory_order::memory_order_relaxed);
-
-        hitsArrBob.append(hits);
-        avArrBob.append(hits ? (total / hits) : 0);
+    vector<int64_t> hits(kBuckets, 0);
+    int64_t count = 0;
+    int64_t total = 0;
+    int64_t minLatency = INT64_MAX;
+    int64_t maxLatency = 0;
+
+    for (const auto& shard : _shards) {
+        for (int i = 0; i < kBuckets; ++i) {
+            int64_t h = shard.hits[i].load(memory_order::memory_order_relaxed);
+
+            hits[i] += h;
+            count += h;
+        }
+        total += shard.total.load(memory_order::memory_order_relaxed);
+        minLatency =
+            std::min(minLatency, shard.minLatency.load(memory_order::memory_order_relaxed));
+        maxLatency =
+            std::max(maxLatency, shard.maxLatency.load(memory_order::memory_order_relaxed));
     }
 
-    for (int i = 1; i < _buckets; i += 2) {
-        int64_t hits = _histogram[i].hits.load(memory_order::memory_order_relaxed);
-        int64_t total = _histogram[i].total.load(memory_order::memory_order_relaxed);
+    BSONObjBuilder lBob;
+    lBob.append("count", count);
+    lBob.append("avgLatency", count ? (total / count) : 0);
+    lBob.append("minLatency", count ? minLatency : 0);
+    lBob.append("maxLatency", maxLatency);
+
+    /* A percentile is reported as the upper bound of the bucket that holds it,
+     * clamped to the largest latency seen, so it errs high by at most one
+     * bucket width.
+     */
+    static const struct {
+        const char* name;
+        int64_t perMille;
+    } pcts[] = {{"p50", 500}, {"p95", 950}, {"p99", 990}, {"p999", 999}};
+
+    int64_t cum = 0;
+    int bucket = 0;
+
+    for (const auto& pct : pcts) {
+        int64_t rank = (count * pct.perMille + 999) / 1000;
+        int64_t value = 0;
 
-        hitsArrBob.append(hits);
-        avArrBob.append(hits ? (total / hits) : 0);
+        if (count) {
+            while (cum + hits[bucket] < rank)
+                cum += hits[bucket++];
+
+            value = (bucket + 1 < kBuckets) ? bucketLowerBound(bucket + 1) - 1 : maxLatency;
+            value = std::min(value, maxLatency);
+        }
+
+        lBob.append(pct.name, value);
     }
 
-    lBob.append("hits", hitsArrBob.arr());
-    lBob.append("avglat", avArrBob.arr());
+    if (withHistogram) {
+        // Only the buckets that were hit, as [ lower bound in ns, hits ] pairs.
+        BSONArrayBuilder histArrBob{lBob.subarrayStart("histogram")};
+
+        for (int i = 0; i < kBuckets; ++i) {
+            if (hits[i]) {
+                BSONArrayBuilder pairBob{histArrBob.subarrayStart()};
+                pairBob.append(static_cast<long long>(bucketLowerBound(i)));
+                pairBob.append(static_cast<long long>(hits[i]));
+            }
+        }
+        histArrBob.done();
+    }
 
     bob.append(_name, lBob.obj());
 }
@@ -210,38 +292,20 @@ void KVDBStatLatency::end_impl(LatencyToken bTime) {
     auto eTime = chrono::steady_clock::now();
     int64_t latency = (chrono::duration_cast<chrono::nanoseconds>(eTime - bTime)).count();
 
-    // HSE_REVISIT - need faster approach?
-    int32_t bucket = latency / _interval;
+    Shard& shard = _shards[statGroup()];
+    shard.hits[bucketOf(latency)].fetch_add(1, memory_order::memory_order_relaxed);
+    shard.total.fetch_add(latency, memory_order::memory_order_relaxed);
 
-    if (bucket >= _buckets) {
-        _histogram[_buckets].hits.fetch_add(1, memory_order::memory_order_relaxed);
-        return;
-    }
+    // The extremes rarely change once warmed up, so these loops seldom iterate.
+    auto relaxed = memory_order::memory_order_relaxed;
 
-    /* Latency measurements tend to clump together in adjacent "hot" buckets,
-     * so we interleave the buckets to eliminate false-sharing between them.
-     * For example, given 16 buckets (from 0 to 15) we address them linearly
-     * in memory as follows:  0 8 1 9 2 10 3 11 4 12 5 13 6 14 7 15 (16)
-     * where latencies that fall outside the maximum bucket interval range
-     * accumulate in the last bucket (bucket 16 in this example).
-     */
-    if (bucket < _buckets / 2)
-        bucket = bucket * 2;
-    else
-        bucket = bucket - (_buckets / 2) + 1;
-
-    HistogramBucket& bRef = _histogram[bucket];
-    bRef.hits.fetch_add(1, memory_order::memory_order_relaxed);
-    bRef.total.fetch_add(latency, memory_order::memory_order_relaxed);
-
-    // update min and max (not atomic)
-    if (latency < _minLatency) {
-        _minLatency = latency;
-    }
+    int64_t cur = shard.minLatency.load(relaxed);
+    while (latency < cur && !shard.minLatency.compare_exchange_weak(cur, latency, relaxed))
+        ;
 
-    if (latency > _maxLatency) {
-        _maxLatency = latency;
-    }
+    cur = shard.maxLatency.load(relaxed);
+    while (latency > cur && !shard.maxLatency.compare_exchange_weak(cur, latency, relaxed))
+        ;
 }
 
 KVDBStatLatency::~KVDBStatLatency() {}
@@ -285,14 +349,7 @@ void KVDBStatAppBytes::appendTo(BSONObjBuilder& bob) const {
 }
 
 void KVDBStatAppBytes::add(int64_t incr) {
-    unsigned int cpuid, nodeid;
-
-    if (syscall(SYS_getcpu, &cpuid, &nodeid))
-        cpuid = nodeid = 0;
-
-    cpuid = cpuid % (COUNTER_GROUPS_MAX / 2) + (nodeid & 1u) * (COUNTER_GROUPS_MAX / 2);
-
-    _counterv[cpuid * COUNTERS_PER_GROUP].fetch_add(incr, memory_order::memory_order_relaxed);
+    _counterv[statGroup() * COUNTERS_PER_GROUP].fetch_add(incr, memory_order::memory_order_relaxed);
 }
 
 KVDBStatAppBytes::~KVDBStatAppBytes() {}
@@ -383,6 +440,40 @@ void KVDBStatRate::RateThread::shutdown() {
 }
 // end KVDBStatRate
 
+// begin KVDBIdentStats
+KVDBIdentStats::KVDBIdentStats() {
+    for (auto& count : _counts)
+        count.store(0, memory_order::memory_order_relaxed);
+}
+
+bool KVDBIdentStats::appendTo(BSONObjBuilder& bob, const string& name) const {
+    static const char* const names[kNumOps] = {"gets",
+                                               "puts",
+                                               "deletes",
+                                               "cursorCreates",
+                                               "bytesRead",
+                                               "bytesWritten",
+                                               "largeChunksRead",
+                                               "largeChunksWritten",
+                                               "writeConflicts",
+                                               "compressBytesIn",
+                                               "compressBytesOut",
+                                               "compressMicros",
+                                               "decompressMicros"};
+
+    if (!KVDBStat::isStatsEnabledGlobally())
+        return false;
+
+    BSONObjBuilder sBob{bob.subobjStart(name)};
+    for (int i = 0; i < kNumOps; ++i)
+        sBob.append(names[i],
+                    static_cast<long long>(_counts[i].load(memory_order::memory_order_relaxed)));
+    sBob.done();
+
+    return true;
+}
+// end KVDBIdentStats
+
 // Start Stats declarations
 // Versions
 KVDBStatVersion _hseVersion{"hseVersion", hse::K_HSE_VERSION};
@@ -399,23 +490,28 @@ KVDBStatCounter _hseKvdbSyncCounter{"hseKvdbSync"};
 KVDBStatCounter _hseKvsCursorCreateCounter{"hseKvsCursorCreate"};
 KVDBStatCounter _hseKvsCursorDestroyCounter{"hseKvsCursorDestroy"};
 KVDBStatCounter _hseKvsCursorReadCounter{"hseKvsCursorRead"};
+KVDBStatCounter _hseKvsCursorReadBatchCounter{"hseKvsCursorReadBatch"};
 KVDBStatCounter _hseKvsCursorUpdateCounter{"hseKvsCursorUpdate"};
 KVDBStatCounter _hseOplogCursorCreateCounter{"hseOplogCursorCreate"};
+KVDBStatCounter _hseIdxFilterNegativeCounter{"hseIdxFilterNegative"};
+KVDBStatCounter _hseIdxFilterFalsePositiveCounter{"hseIdxFilterFalsePositive"};
+KVDBStatCounter _hseTxnCommitConflictCounter{"hseTxnCommitConflict"};
+KVDBStatCounter _hseSubTxnRetryCounter{"hseSubTxnRetry"};
+KVDBStatCounter _hseKvsCursorCreateRetryCounter{"hseKvsCursorCreateRetry"};
+KVDBStatCounter _hseRetryBackoffMicrosCounter{"hseRetryBackoffMicros"};
 
 // Latencies
-
-// histogram parameters based on sysbench small db run
-
-KVDBStatLatency _hseKvsGetLatency{"hseKvsGet", 32, 1000};
-KVDBStatLatency _hseKvsPutLatency{"hseKvsPut", 32, 1000};
-KVDBStatLatency _hseKvsDeleteLatency{"hseKvsDelete", 16, 1000};
-KVDBStatLatency _hseKvsPrefixDeleteLatency{"hseKvsPrefixDelete", 16, 100 * 1000};
-KVDBStatLatency _hseKvsProbeLatency{"hseKvsProbe", 32, 1000};
-KVDBStatLatency _hseKvdbSyncLatency{"hseKvdbSync", 32, 2 * 1000 * 1000};
-KVDBStatLatency _hseKvsCursorCreateLatency{"hseKvsCursorCreate", 32, 1000};
-KVDBStatLatency _hseKvsCursorDestroyLatency{"hseKvsCursorDestroy", 32, 1000};
-KVDBStatLatency _hseKvsCursorReadLatency{"hseKvsCursorRead", 32, 1000};
-KVDBStatLatency _hseKvsCursorUpdateLatency{"hseKvsCursorUpdate", 32, 1000};
+KVDBStatLatency _hseKvsGetLatency{"hseKvsGet"};
+KVDBStatLatency _hseKvsPutLatency{"hseKvsPut"};
+KVDBStatLatency _hseKvsDeleteLatency{"hseKvsDelete"};
+KVDBStatLatency _hseKvsPrefixDeleteLatency{"hseKvsPrefixDelete"};
+KVDBStatLatency _hseKvsProbeLatency{"hseKvsProbe"};
+KVDBStatLatency _hseKvdbSyncLatency{"hseKvdbSync"};
+KVDBStatLatency _hseKvsCursorCreateLatency{"hseKvsCursorCreate"};
+KVDBStatLatency _hseKvsCursorDestroyLatency{"hseKvsCursorDestroy"};
+KVDBStatLatency _hseKvsCursorReadLatency{"hseKvsCursorRead"};
+KVDBStatLatency _hseKvsCursorReadBatchLatency{"hseKvsCursorReadBatch"};
+KVDBStatLatency _hseKvsCursorUpdateLatency{"hseKvsCursorUpdate"};
 
 // App bytes counters
 KVDBStatAppBytes _hseAppBytesReadCounter{"hseAppBytesRead"};
@@ -60,36 +60,22 @@ using mongo::BSONObjBuilder;
 using LatencyToken = std::chrono::time_point<std::chrono::steady_clock>;
 
 
-class alignas(64) HistogramBucket {
-public:
-    HistogramBucket() : total{0}, hits{0} {};
-
-    HistogramBucket(const HistogramBucket& n) {
-        this->total.store(n.total.load());
-        this->hits.store(n.hits.load());
-    }
-
-    HistogramBucket(const HistogramBucket&& n) {
-        this->total.store(n.total.load());
-        this->hits.store(n.hits.load());
-    }
-
-    HistogramBucket& operator=(const HistogramBucket& rhs) {
-        this->total.store(rhs.total.load());
-        this->hits.store(rhs.hits.load());
-        return *this;
-    }
-
-    atomic<int64_t> total{0};
-    atomic<int64_t> hits{0};
-};
-
 class KVDBStat {
 public:
     KVDBStat(const string name);
     virtual void appendTo(BSONObjBuilder& bob) const;
+
+    // Appends the stat with a set of fields that does not change while mongod runs, as FTDC
+    // compresses best when the shape of its samples stays the same.
+    virtual void appendSummaryTo(BSONObjBuilder& bob) const {
+        appendTo(bob);
+    }
     static void enableStatsGlobally(bool enable);
-    static bool isStatsEnabledGlobally();
+
+    // This does not reflect enable overrides
+    static bool isStatsEnabledGlobally() {
+        return statsEnabled;
+    }
 
     bool isStatEnabled() const {
         return _enabled;
@@ -121,13 +107,31 @@ private:
     atomic<int64_t>* _counterv;
 };
 
+/* Latencies are recorded in nanoseconds into log-linear buckets, in the manner
+ * of an HDR histogram:  each power of two is split into kSubBuckets linear
+ * sub-buckets, so a bucket is never wider than 1/kSubBuckets of its lower bound.
+ * Latencies of 2^kMaxBits ns (about 68s) or more land in the last bucket.
+ *
+ * Each CPU group records into a shard of its own, as KVDBStatCounter does, so
+ * recording a latency touches no cacheline that other CPU groups write.  The
+ * shards are summed, and the percentiles computed, only by appendTo().
+ */
 class KVDBStatLatency final : public KVDBStat {
 public:
-    KVDBStatLatency(const string name, int32_t buckets = 128, int64_t interval = 1000);
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxBits = 36;
+    static constexpr int kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+    static constexpr int kShards = 16;
+
+    KVDBStatLatency(const string name);
     virtual ~KVDBStatLatency();
 
     virtual void appendTo(BSONObjBuilder& bob) const override;
 
+    // Leaves out the histogram, whose buckets are listed only once they are hit.
+    virtual void appendSummaryTo(BSONObjBuilder& bob) const override;
+
     LatencyToken begin() const {
         if (MONGO_likely(!isStatEnabled()))
             return chrono::time_point<chrono::steady_clock>(chrono::nanoseconds(0));
@@ -141,14 +145,24 @@ public:
             end_impl(bTime);
     }
 
+    // Returns the bucket that holds a latency of ns nanoseconds.
+    static int bucketOf(int64_t ns);
+
+    // Returns the smallest latency in nanoseconds that falls in bucket.
+    static int64_t bucketLowerBound(int bucket);
+
 private:
+    struct alignas(128) Shard {
+        atomic<int64_t> hits[kBuckets];
+        atomic<int64_t> total;
+        atomic<int64_t> minLatency;
+        atomic<int64_t> maxLatency;
+    };
+
     void end_impl(LatencyToken token);
+    void _append(BSONObjBuilder& bob, bool withHistogram) const;
 
-    int32_t _buckets{128};
-    int64_t _interval{1000};  // 1000 ns
-    int64_t _minLatency{INT64_MAX};
-    int64_t _maxLatency{0};
-    vector<HistogramBucket> _histogram;
+    Shard _shards[kShards];
 };
 
 class KVDBStatVersion final : public KVDBStat {
@@ -202,6 +216,45 @@ private:
     static std::unique_ptr<RateThread> _rateThread;
 };
 
+/* Operation counts of a single collection or index, reported by collStats.
+ * They are kept only while stats are enabled, so that a disabled count costs
+ * one well predicted branch.  They are not sharded by CPU like the global
+ * counters, since a per-ident shard array would cost every ident several KB.
+ */
+class KVDBIdentStats {
+public:
+    enum Op {
+        kGets,
+        kPuts,
+        kDeletes,
+        kCursorCreates,
+        kBytesRead,
+        kBytesWritten,
+        kLargeChunksRead,
+        kLargeChunksWritten,
+        kWriteConflicts,
+        kCompressBytesIn,  // documents compressed by the connector, see KVDBDocDict
+        kCompressBytesOut,
+        kCompressMicros,
+        kDecompressMicros,
+        kNumOps
+    };
+
+    KVDBIdentStats();
+
+    void add(Op op, int64_t incr = 1) {
+        if (MONGO_unlikely(KVDBStat::isStatsEnabledGlobally()))
+            _counts[op].fetch_add(incr, memory_order::memory_order_relaxed);
+    }
+
+    // Appends the counts as a sub-object, returns false and appends nothing if stats are
+    // disabled.
+    bool appendTo(BSONObjBuilder& bob, const string& name) const;
+
+private:
+    atomic<int64_t> _counts[kNumOps];
+};
+
 // HSE_REVISIT - TODO class KVDBStatGeneral - constructor takes register list as arg
 
 // Global hse stat lists
@@ -224,6 +277,7 @@ extern KVDBStatVersion _hseConnectorGitSha;
 extern KVDBStatCounter _hseKvsGetCounter;
 extern KVDBStatCounter _hseKvsCursorCreateCounter;
 extern KVDBStatCounter _hseKvsCursorReadCounter;
+extern KVDBStatCounter _hseKvsCursorReadBatchCounter;
 extern KVDBStatCounter _hseKvsCursorUpdateCounter;
 extern KVDBStatCounter _hseKvsCursorDestroyCounter;
 extern KVDBStatCounter _hseKvsPutCounter;
@@ -232,11 +286,18 @@ extern KVDBStatCounter _hseKvdbSyncCounter;
 extern KVDBStatCounter _hseKvsDeleteCounter;
 extern KVDBStatCounter _hseKvsPrefixDeleteCounter;
 extern KVDBStatCounter _hseOplogCursorCreateCounter;
+extern KVDBStatCounter _hseIdxFilterNegativeCounter;
+extern KVDBStatCounter _hseIdxFilterFalsePositiveCounter;
+extern KVDBStatCounter _hseTxnCommitConflictCounter;
+extern KVDBStatCounter _hseSubTxnRetryCounter;
+extern KVDBStatCounter _hseKvsCursorCreateRetryCounter;
+extern KVDBStatCounter _hseRetryBackoffMicrosCounter;
 
 // Latencies
 extern KVDBStatLatency _hseKvsGetLatency;
 extern KVDBStatLatency _hseKvsCursorCreateLatency;
 extern KVDBStatLatency _hseKvsCursorReadLatency;
+extern KVDBStatLatency _hseKvsCursorReadBatchLatency;
 extern KVDBStatLatency _hseKvsCursorUpdateLatency;
 extern KVDBStatLatency _hseKvsCursorDestroyLatency;
 extern KVDBStatLatency _hseKvsPutLatency;
@@ -33,13 +33,18 @@
  */
 #include "mongo/platform/basic.h"
 
+#include "hse_backoff.h"
+#include "hse_export.h"
 #include "hse_impl.h"
+#include "hse_kvdb_mock.h"
 #include "hse_kvscursor.h"
+#include "hse_stats.h"
 #include "hse_ut_common.h"
 
 #include <iostream>
 #include <sstream>
 
+#include "mongo/unittest/temp_dir.h"
 #include "mongo/unittest/unittest.h"
 
 using namespace std;
@@ -365,7 +370,7 @@ TEST_F(KVDBREGTEST, KvdbForwardFullScanTest) {
 
     // Begin a scan
     KVDBData prefix{};
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // get
@@ -434,7 +439,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixForwardScanTest) {
         KVDBData prefix = item.first;
         int numPrefixes = item.second;
 
-        cursor = create_cursor(_kvsHandles[0], prefix, true);
+        cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
         ASSERT_FALSE(cursor == 0);
 
         int fCnt = 0;
@@ -515,7 +520,7 @@ TEST_F(KVDBREGTEST, KvdbNormalCursorSeekTest) {
 
     bool eof = false;
     KVDBData prefix{};
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // Do a seek to added element.
@@ -599,7 +604,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixCursorSeekTest) {
     // Begin a scan
     bool eof = false;
     KVDBData prefix{(const uint8_t*)"3", 1};
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // Do a seek to added element.
@@ -664,7 +669,7 @@ TEST_F(KVDBREGTEST, KvdbReverseFullScanTest) {
     // Begin a scan
     bool eof = false;
     KVDBData prefix{};
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, false);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, false, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // get
@@ -732,7 +737,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixReverseScanTest) {
         KVDBData cKey{};
         KVDBData cVal{};
 
-        hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, false);
+        hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, false, nullptr);
         ASSERT_FALSE(cursor == 0);
 
         int fCnt = 0;
@@ -807,7 +812,7 @@ TEST_F(KVDBREGTEST, KvdbReverseCursorSeekTest) {
 
     bool eof = false;
     KVDBData prefix{};
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, false);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, false, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // Do a seek to added element.
@@ -895,7 +900,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixReverseCursorSeekTest) {
     KVDBData prefix{(const uint8_t*)"3", 1};
     bool eof = false;
 
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, false);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, false, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // Do a seek to added element.
@@ -949,13 +954,13 @@ TEST_F(KVDBREGTEST, KvdbTxnIsolationTest) {
     KVDBData val2{(const uint8_t*)"v2", strlen("v2") + 1};
     KVDBData val3{(const uint8_t*)"v3", strlen("v3") + 1};
 
-    ClientTxn* txn = new ClientTxn((dynamic_cast<KVDBImpl&>(_db)).kvdb_handle());
+    ClientTxn* txn = new ClientTxn(_db);
     ASSERT_FALSE(txn == 0);
 
     st = txn->begin();
     ASSERT_EQUALS(0, st.getErrno());
 
-    st = _db.kvs_put(_kvsHandles[0], txn, key2, val2);
+    st = _db.kvs_put(_kvsHandles[0], txn, key2, val2, 0);
     ASSERT_EQUALS(0, st.getErrno());
 
     st = txn->commit();
@@ -965,7 +970,7 @@ TEST_F(KVDBREGTEST, KvdbTxnIsolationTest) {
     ASSERT_EQUALS(0, st.getErrno());
 
     // do a put
-    st = _db.kvs_put(_kvsHandles[0], txn, key1, val1);
+    st = _db.kvs_put(_kvsHandles[0], txn, key1, val1, 0);
     ASSERT_EQUALS(0, st.getErrno());
 
     // do a get
@@ -1018,7 +1023,7 @@ TEST_F(KVDBREGTEST, KvdbUpdateNoTxnTest) {
     ASSERT_EQUALS(0, st.getErrno());
 
     // create cursor
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], pref, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // iterate
@@ -1101,7 +1106,7 @@ TEST_F(KVDBREGTEST, KvdbUpdateTxnTest) {
 
 
     // create cursor
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], pref, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // iterate
@@ -1127,14 +1132,14 @@ TEST_F(KVDBREGTEST, KvdbUpdateTxnTest) {
 
 
     // Create a txn put a third key/val and commit
-    ClientTxn* txn = new ClientTxn(_db.kvdb_handle());
+    ClientTxn* txn = new ClientTxn(_db);
     ASSERT_FALSE(txn == 0);
 
     st = txn->begin();
     ASSERT_EQUALS(0, st.getErrno());
 
     // do a put
-    st = _db.kvs_put(_kvsHandles[0], txn, key3, val3);
+    st = _db.kvs_put(_kvsHandles[0], txn, key3, val3, 0);
     ASSERT_EQUALS(0, st.getErrno());
 
     st = txn->commit();
@@ -1198,7 +1203,7 @@ TEST_F(KVDBREGTEST, KvdbDeleteKeyCursorTest) {
 
 
     // create cursor
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], pref, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // iterate
@@ -1236,7 +1241,7 @@ TEST_F(KVDBREGTEST, KvdbDeleteKeyCursorTest) {
     ASSERT_EQUALS(0, st.getErrno());
 
     // Recreate the cursor and iterate
-    cursor = create_cursor(_kvsHandles[0], pref, true);
+    cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     st = cursor->read(cKey, cVal, eof);
@@ -1282,7 +1287,7 @@ TEST_F(KVDBREGTEST, KvdbDeleteTxnCursorTest) {
 
 
     // create cursor
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], pref, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     // iterate
@@ -1316,7 +1321,7 @@ TEST_F(KVDBREGTEST, KvdbDeleteTxnCursorTest) {
     delete cursor;
 
     // Create a txn and delete third key/val and commit
-    ClientTxn* txn = new ClientTxn(_db.kvdb_handle());
+    ClientTxn* txn = new ClientTxn(_db);
     ASSERT_FALSE(txn == 0);
 
     st = txn->begin();
@@ -1332,7 +1337,7 @@ TEST_F(KVDBREGTEST, KvdbDeleteTxnCursorTest) {
     delete txn;
 
     // Recreate the cursor and iterate
-    cursor = create_cursor(_kvsHandles[0], pref, true);
+    cursor = _db.kvs_cursor_create(_kvsHandles[0], pref, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     st = cursor->read(cKey, cVal, eof);
@@ -1372,7 +1377,7 @@ TEST_F(KVDBREGTEST, KvdbProbeTxnTest) {
     ASSERT_EQUALS(0, st.getErrno());
 
     // Create a txn and delete third key/val and commit
-    ClientTxn* txn = new ClientTxn(_db.kvdb_handle());
+    ClientTxn* txn = new ClientTxn(_db);
     ASSERT_FALSE(txn == 0);
 
     st = txn->begin();
@@ -1423,7 +1428,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixDeleteTest) {
 
     // Do a scan
     bool eof = false;
-    hse::KvsCursor* cursor = create_cursor(_kvsHandles[0], prefix, true);
+    hse::KvsCursor* cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     KVDBData cKey{};
@@ -1438,7 +1443,7 @@ TEST_F(KVDBREGTEST, KvdbPrefixDeleteTest) {
     ASSERT_EQUALS(0, st.getErrno());
 
     // Do a scan
-    cursor = create_cursor(_kvsHandles[0], prefix, true);
+    cursor = _db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr);
     ASSERT_FALSE(cursor == 0);
 
     st = cursor->read(cKey, cVal, eof);
@@ -1450,10 +1455,73 @@ TEST_F(KVDBREGTEST, KvdbPrefixDeleteTest) {
     ASSERT(freeKeyVals(keyVals));
 }
 
+TEST_F(KVDBREGTEST, KvdbExportLoadTest) {
+    hse::Status st{};
+
+    // Enough pairs, some with large values, to span several export blocks.
+    const int numKeys = 20000;
+    for (int i = 0; i < numKeys; i++) {
+        string key = "key" + std::to_string(1000000 + i);
+        string val(i % 100 ? 64 : HSE_KVS_VALUE_LEN_MAX, 'a' + i % 26);
+        st = _db.kvs_sub_txn_put(_kvsHandles[0], KVDBData{key}, KVDBData{val});
+        ASSERT_EQUALS(0, st.getErrno());
+    }
+
+    mongo::unittest::TempDir dir("hse_export_test");
+    const string path = dir.path() + "/export";
+
+    // Every other key is loaded with values compressed.
+    mongo::KVDBExport::Kvs kvs{"KVS1", _kvsHandles[0], [](const KVDBData& key) {
+        return key.data()[key.len() - 1] % 2 ? HSE_KVS_PUT_VCOMP_ON : 0U;
+    }};
+    auto notInterrupted = [] { return mongo::Status::OK(); };
+    mongo::BSONObjBuilder writeStats;
+    ASSERT_OK(mongo::KVDBExport::write(_db, {kvs}, path, notInterrupted, &writeStats));
+    ASSERT_EQUALS(numKeys, writeStats.obj()["KVS1"]["keys"].numberLong());
+
+    // An interrupt stops the write after the first block.
+    int blocks = 0;
+    auto interrupted = [&blocks] {
+        blocks++;
+        return mongo::Status(mongo::ErrorCodes::Interrupted, "interrupted");
+    };
+    mongo::BSONObjBuilder stoppedStats;
+    mongo::Status stopped = mongo::KVDBExport::write(
+        _db, {kvs}, dir.path() + "/stopped", interrupted, &stoppedStats);
+    ASSERT_EQUALS(mongo::ErrorCodes::Interrupted, stopped.code());
+    ASSERT_EQUALS(1, blocks);
+
+    // Load into the second KVS, then both must hold the same pairs.
+    auto openKvs = [&](const string& name) -> mongo::StatusWith<KVSHandle> {
+        ASSERT_EQUALS("KVS1", name);
+        return _kvsHandles[1];
+    };
+    mongo::BSONObjBuilder loadStats;
+    ASSERT_OK(mongo::KVDBExport::load(_db, path, openKvs, &loadStats));
+    ASSERT_EQUALS(numKeys, loadStats.obj()["KVS1"]["keys"].numberLong());
+
+    KVDBData prefix{(uint8_t*)"", 0};
+    std::unique_ptr<KvsCursor> src(_db.kvs_cursor_create(_kvsHandles[0], prefix, true, nullptr));
+    std::unique_ptr<KvsCursor> dst(_db.kvs_cursor_create(_kvsHandles[1], prefix, true, nullptr));
+    int n = 0;
+    for (;; n++) {
+        KVDBData sKey{}, sVal{}, dKey{}, dVal{};
+        bool sEof = false, dEof = false;
+        ASSERT_EQUALS(0, src->read(sKey, sVal, sEof).getErrno());
+        ASSERT_EQUALS(0, dst->read(dKey, dVal, dEof).getErrno());
+        ASSERT_EQUALS(sEof, dEof);
+        if (sEof)
+            break;
+        ASSERT(sKey == dKey);
+        ASSERT(sVal == dVal);
+    }
+    ASSERT_EQUALS(numKeys, n);
+}
+
 TEST_F(KVDBREGTEST, KvdbTransactionTest) {
     hse::Status st{};
 
-    ClientTxn* txn = new ClientTxn(_db.kvdb_handle());
+    ClientTxn* txn = new ClientTxn(_db);
     ASSERT_FALSE(txn == 0);
 
     st = txn->begin();
@@ -1470,4 +1538,163 @@ TEST_F(KVDBREGTEST, KvdbTransactionTest) {
 
     delete txn;
 }
+
+TEST(KVDBStatTest, LatencyBucketBounds) {
+    using hse_stat::KVDBStatLatency;
+
+    for (int b = 0; b + 1 < KVDBStatLatency::kBuckets; ++b) {
+        int64_t lo = KVDBStatLatency::bucketLowerBound(b);
+        int64_t hi = KVDBStatLatency::bucketLowerBound(b + 1);
+
+        ASSERT_LT(lo, hi);
+        ASSERT_EQUALS(b, KVDBStatLatency::bucketOf(lo));
+        ASSERT_EQUALS(b, KVDBStatLatency::bucketOf(hi - 1));
+
+        // No bucket is wider than 1/kSubBuckets of its lower bound.
+        ASSERT_LTE((hi - lo) * KVDBStatLatency::kSubBuckets, std::max<int64_t>(lo, 8));
+    }
+
+    ASSERT_EQUALS(KVDBStatLatency::kBuckets - 1, KVDBStatLatency::bucketOf(INT64_MAX));
+}
+
+TEST(KVDBBackoffTest, DelayBounds) {
+    using hse::KVDBBackoff;
+
+    const uint32_t hot = KVDBBackoff::kScale;
+
+    // An isolated conflict is retried at once.
+    ASSERT_EQUALS(0, KVDBBackoff::delayMicros(0, 0, 12345));
+    ASSERT_EQUALS(0, KVDBBackoff::delayMicros(KVDBBackoff::kFreeRetries - 1, 0, 12345));
+    ASSERT_GT(KVDBBackoff::delayMicros(0, hot, 0), 0);
+
+    int64_t prevFloor = 0;
+    for (int attempt = 0; attempt < 40; ++attempt) {
+        for (uint32_t contention : {0u, KVDBBackoff::kHotContention, hot}) {
+            int64_t lo = KVDBBackoff::delayMicros(attempt, contention, 0);
+            int64_t hi = KVDBBackoff::delayMicros(attempt, contention, UINT32_MAX);
+
+            ASSERT_LTE(lo, hi);
+            ASSERT_LTE(hi, KVDBBackoff::kMaxDelayMicros);
+            ASSERT_GTE(lo * 2 + 1, hi);
+        }
+
+        // The shortest delay never shrinks with more attempts, and grows with contention.
+        int64_t floor = KVDBBackoff::delayMicros(attempt, hot, 0);
+        ASSERT_GTE(floor, prevFloor);
+        ASSERT_GTE(floor, KVDBBackoff::delayMicros(attempt, 0, 0));
+        prevFloor = floor;
+    }
+
+    ASSERT_EQUALS(KVDBBackoff::kMaxDelayMicros / 2, prevFloor);
+}
+
+TEST(KVDBMockTest, TxnConflicts) {
+    KVDBMock db;
+    KVSHandle kvs;
+    vector<string> params{};
+
+    ASSERT_EQUALS(0, db.kvdb_make("mock-txn-conflicts", params).getErrno());
+    ASSERT_EQUALS(EEXIST, db.kvdb_make("mock-txn-conflicts", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_open("mock-txn-conflicts", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_make("kvs", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_open("kvs", params, kvs).getErrno());
+
+    KVDBData key{(const uint8_t*)"k", 1};
+    KVDBData val1{(const uint8_t*)"v1", 2};
+    KVDBData val2{(const uint8_t*)"v2", 2};
+    ClientTxn t1(db), t2(db);
+
+    ASSERT_EQUALS(0, t1.begin().getErrno());
+    ASSERT_EQUALS(0, t2.begin().getErrno());
+
+    // A key written by an active transaction.
+    ASSERT_EQUALS(0, db.kvs_put(kvs, &t1, key, val1, 0).getErrno());
+    ASSERT_EQUALS(ECANCELED, db.kvs_put(kvs, &t2, key, val2, 0).getErrno());
+    ASSERT_EQUALS(0, t1.commit().getErrno());
+
+    // A key committed after the transaction began, which still reads the older view.
+    bool found = true;
+    ASSERT_EQUALS(0, db.kvs_probe_key(kvs, &t2, key, found).getErrno());
+    ASSERT_FALSE(found);
+    ASSERT_EQUALS(ECANCELED, db.kvs_put(kvs, &t2, key, val2, 0).getErrno());
+    ASSERT_EQUALS(0, t2.abort().getErrno());
+
+    ASSERT_EQUALS(0, t2.begin().getErrno());
+    ASSERT_EQUALS(0, db.kvs_put(kvs, &t2, key, val2, 0).getErrno());
+    ASSERT_EQUALS(0, t2.commit().getErrno());
+
+    uint8_t buf[16];
+    KVDBData val{};
+    val.setReadBuf(buf, sizeof(buf));
+    ASSERT_EQUALS(0, db.kvs_get(kvs, nullptr, key, val, found).getErrno());
+    ASSERT(found);
+    ASSERT(val == val2);
+
+    ASSERT_EQUALS(EBUSY, db.kvdb_kvs_drop("kvs").getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_close(kvs).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_drop("kvs").getErrno());
+    ASSERT_EQUALS(0, db.kvdb_close().getErrno());
+}
+
+TEST(KVDBMockTest, CursorMergesTxnWrites) {
+    KVDBMock db;
+    KVSHandle kvs;
+    vector<string> params{};
+
+    ASSERT_EQUALS(0, db.kvdb_make("mock-cursor", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_open("mock-cursor", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_make("kvs", params).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_kvs_open("kvs", params, kvs).getErrno());
+
+    for (auto k : {"a1", "p1", "p3", "p5", "z1"}) {
+        KVDBData kv{(const uint8_t*)k, 2};
+        ASSERT_EQUALS(0, db.kvs_put(kvs, kv, kv).getErrno());
+    }
+
+    ClientTxn txn(db);
+    ASSERT_EQUALS(0, txn.begin().getErrno());
+    KVDBData p2{(const uint8_t*)"p2", 2};
+    KVDBData p3{(const uint8_t*)"p3", 2};
+    ASSERT_EQUALS(0, db.kvs_put(kvs, &txn, p2, p3, 0).getErrno());
+    ASSERT_EQUALS(0, db.kvs_delete(kvs, &txn, p3).getErrno());
+
+    KVDBData prefix{(const uint8_t*)"p", 1};
+    for (bool forward : {true, false}) {
+        vector<string> expected{"p1", "p2", "p5"};
+        if (!forward)
+            reverse(expected.begin(), expected.end());
+
+        unique_ptr<KvsCursor> cursor(db.kvs_cursor_create(kvs, prefix, forward, &txn));
+        KVDBData key{}, val{};
+        bool eof = false;
+        vector<string> keys;
+        while (true) {
+            ASSERT_EQUALS(0, cursor->read(key, val, eof).getErrno());
+            if (eof)
+                break;
+            keys.emplace_back((const char*)key.data(), key.len());
+        }
+        ASSERT(keys == expected);
+
+        // Seeks past the prefix land on its first key in cursor order.
+        KVDBData pos{};
+        KVDBData past{(const uint8_t*)(forward ? "a" : "q"), 1};
+        ASSERT_EQUALS(0, cursor->seek(past, 0, &pos).getErrno());
+        ASSERT_EQUALS(expected[0], string((const char*)pos.data(), pos.len()));
+    }
+
+    // Not seen by a cursor outside the transaction.
+    unique_ptr<KvsCursor> cursor(db.kvs_cursor_create(kvs, prefix, true, nullptr));
+    KVDBData key{}, val{};
+    bool eof = false;
+    ASSERT_EQUALS(0, cursor->seek(p2, 0, nullptr).getErrno());
+    ASSERT_EQUALS(0, cursor->read(key, val, eof).getErrno());
+    ASSERT_FALSE(eof);
+    ASSERT_EQUALS(string("p3"), string((const char*)key.data(), key.len()));
+
+    ASSERT_EQUALS(0, txn.abort().getErrno());
+    cursor.reset();
+    ASSERT_EQUALS(0, db.kvdb_kvs_close(kvs).getErrno());
+    ASSERT_EQUALS(0, db.kvdb_close().getErrno());
+}
 }  // namespace mongo
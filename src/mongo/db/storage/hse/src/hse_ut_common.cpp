@@ -46,13 +46,22 @@ KVDBTestSuiteFixture::KVDBTestSuiteFixture() {
         _kvdbHome = envStr;
     }
 
-    hse::Status st = hse::init(_globalParams);
-    ASSERT_EQUALS(0, st.getErrno());
+    envStr = getenv("MONGO_UT_KVDB");
+    _mock = envStr && string(envStr) == "mock";
+    if (_mock) {
+        _db.reset(new KVDBMock());
+    } else {
+        _db.reset(new KVDBImpl());
+    }
+
+    _init();
+
+    hse::Status st{};
 
     int err{0};
     vector<string> params{};
     while (true) {
-        st = _db.kvdb_make(_kvdbHome.c_str(), params);
+        st = _db->kvdb_make(_kvdbHome.c_str(), params);
 
         err = st.getErrno();
         if (EAGAIN != err) {
@@ -66,7 +75,7 @@ KVDBTestSuiteFixture::KVDBTestSuiteFixture() {
 
     ASSERT_EQUALS(0, err);
 
-    st = _db.kvdb_open(_kvdbHome.c_str(), params);
+    st = _db->kvdb_open(_kvdbHome.c_str(), params);
     ASSERT_EQUALS(0, st.getErrno());
 
     _dbClosed = false;
@@ -74,11 +83,10 @@ KVDBTestSuiteFixture::KVDBTestSuiteFixture() {
 
 void KVDBTestSuiteFixture::reset() {
     if (_dbClosed) {
-        hse::Status st = hse::init(_globalParams);
-        ASSERT_EQUALS(0, st.getErrno());
+        _init();
 
         vector<string> params{};
-        st = _db.kvdb_open(_kvdbHome.c_str(), params);
+        hse::Status st = _db->kvdb_open(_kvdbHome.c_str(), params);
         ASSERT_EQUALS(0, st.getErrno());
 
         _dbClosed = false;
@@ -88,38 +96,50 @@ void KVDBTestSuiteFixture::reset() {
     char** kvsList = nullptr;
     size_t count = 0;
 
-    hse::Status st = _db.kvdb_get_names(&count, &kvsList);
+    hse::Status st = _db->kvdb_get_names(&count, &kvsList);
     ASSERT_EQUALS(0, st.getErrno());
 
     for (unsigned int i = 0; i < count; i++) {
-        st = _db.kvdb_kvs_drop(kvsList[i]);
+        st = _db->kvdb_kvs_drop(kvsList[i]);
         ASSERT_EQUALS(0, st.getErrno());
     }
 
-    _db.kvdb_free_names(kvsList);
+    _db->kvdb_free_names(kvsList);
 }
 
 KVDBTestSuiteFixture::~KVDBTestSuiteFixture() {
     if (_dbClosed) {
-        hse::Status st = hse::init(_globalParams);
-        ASSERT_EQUALS(0, st.getErrno());
+        _init();
 
         vector<string> params{};
-        st = _db.kvdb_open(_kvdbHome.c_str(), params);
+        hse::Status st = _db->kvdb_open(_kvdbHome.c_str(), params);
         ASSERT_EQUALS(0, st.getErrno());
 
         _dbClosed = false;
     }
 
-    hse::Status st = _db.kvdb_close();
+    hse::Status st = _db->kvdb_close();
     ASSERT_EQUALS(0, st.getErrno());
 
-    hse::fini();
+    _fini();
     _dbClosed = true;
 }
 
+void KVDBTestSuiteFixture::_init() {
+    if (!_mock) {
+        hse::Status st = hse::init(_globalParams);
+        ASSERT_EQUALS(0, st.getErrno());
+    }
+}
+
+void KVDBTestSuiteFixture::_fini() {
+    if (!_mock) {
+        hse::fini();
+    }
+}
+
 KVDB& KVDBTestSuiteFixture::getDb() {
-    return _db;
+    return *_db;
 }
 
 string KVDBTestSuiteFixture::getDbHome() {
@@ -129,10 +149,10 @@ string KVDBTestSuiteFixture::getDbHome() {
 void KVDBTestSuiteFixture::closeDb() {
 
     if (!_dbClosed) {
-        hse::Status st = _db.kvdb_close();
+        hse::Status st = _db->kvdb_close();
         ASSERT_EQUALS(0, st.getErrno());
 
-        hse::fini();
+        _fini();
         _dbClosed = true;
     }
 }
@@ -34,7 +34,9 @@
 #include "mongo/platform/basic.h"
 
 #include "hse_impl.h"
+#include "hse_kvdb_mock.h"
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include "mongo/unittest/unittest.h"
@@ -58,10 +60,15 @@ public:
     void reset();
 
 private:
+    void _init();
+    void _fini();
+
     const vector<string> _globalParams{"rest.enabled=false"};
     string _kvdbHome{"/var/tmp/mongo-ut-kvdbs/kvdb1"};
 
-    KVDBImpl _db{};
+    // A KVDBMock if MONGO_UT_KVDB is "mock", else a KVDBImpl.
+    bool _mock = false;
+    unique_ptr<KVDB> _db;
     bool _dbClosed = true;
 };
 }  // namespace hse
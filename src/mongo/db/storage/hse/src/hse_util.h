@@ -39,6 +39,7 @@
 #include <thread>
 
 #include "hse.h"
+#include "hse_backoff.h"
 #include "mongo/db/record_id.h"
 #include "mongo/platform/basic.h"
 #include "mongo/util/time_support.h"
@@ -237,7 +238,7 @@ inline mongo::Status hseToMongoStatus(const Status& status, const char* prefix =
 
 #define SUB_TXN_OP_RETRY_LOOP_BEGIN             \
     do {                                        \
-        ClientTxn cTxn{_handle};                \
+        ClientTxn cTxn{*this};                  \
         int retries = 0;                        \
         while (retries < SUB_TXN_MAX_RETRIES) { \
             cTxn.begin();                       \
@@ -253,17 +254,13 @@ inline mongo::Status hseToMongoStatus(const Status& status, const char* prefix =
         cTxn.abort();                                         \
     }                                                         \
     if ((rval).getErrno() == ECANCELED) {                     \
-        if (retries < 4) {                                    \
-        } else if (retries < 10) {                            \
-            this_thread::sleep_for(chrono::milliseconds(1));  \
-        } else if (retries < 100) {                           \
-            this_thread::sleep_for(chrono::milliseconds(5));  \
-        } else {                                              \
-            this_thread::sleep_for(chrono::milliseconds(10)); \
-        }                                                     \
+        _hseSubTxnRetryCounter.add();                         \
+        KVDBBackoff::noteConflict();                          \
+        KVDBBackoff::pause(retries);                          \
         retries++;                                            \
         continue;                                             \
     }                                                         \
+    KVDBBackoff::noteSuccess();                               \
     break;                                                    \
     }                                                         \
     }                                                         \
@@ -315,22 +312,69 @@ static inline string _makeChunkKey(const string& prefix, const RecordId& loc, ui
         std::string(reinterpret_cast<const char*>(&bigLoc), sizeof(int64_t));
 }
 
-static inline unsigned int _getValueOffset(const KVDBData& value) {
-    return value.len() <= VALUE_META_THRESHOLD_LEN ? 0 : VALUE_META_SIZE;
+// Ident prefixes are stored big endian, so that all keys of an ident sort together.
+static inline string encodePrefix(uint32_t prefix) {
+    uint32_t bigEndianPrefix = mongo::endian::nativeToBig(prefix);
+    return string(reinterpret_cast<const char*>(&bigEndianPrefix), sizeof(uint32_t));
 }
 
-static inline unsigned int _getValueLength(const KVDBData& value) {
-    if (value.len() <= VALUE_META_THRESHOLD_LEN) {
-        return value.len();
-    } else {
-        // First four bytes are metadata containing the value length.
+/**
+ * How a record store splits a value too big for one KVS value.
+ *
+ * A value of at most inlineMax bytes is stored as is in the collection kvs. A larger value
+ * is stored there as a VALUE_META_SIZE big endian length header followed by its first headLen
+ * bytes, and the rest goes in chunks of chunkLen bytes to the large kvs. A value as long as
+ * a header and head would read as one, so it is stored as a large value too.
+ *
+ * The default layout fills a KVS value with the header and head, as collections always did.
+ * withThreshold() keeps only the header in the collection kvs, so that its scans skip over
+ * large values and every chunk is written straight from the caller's buffer.
+ */
+struct KVDBValueLayout {
+    // Chunk numbers are one byte, and the longest value is a little over 16MB.
+    static const unsigned int kMinChunkLen = 128 * 1024;
+
+    static KVDBValueLayout withThreshold(unsigned int threshold, unsigned int chunkLen) {
+        KVDBValueLayout layout;
+
+        layout.inlineMax = threshold;
+        layout.headLen = 0;
+        layout.chunkLen = chunkLen;
+        return layout;
+    }
+
+    bool isLarge(unsigned int len) const {
+        return len > inlineMax || len == VALUE_META_SIZE + headLen;
+    }
+
+    // The methods below take a value as read from the collection kvs. Only its length and,
+    // for a large value, its first VALUE_META_SIZE bytes are looked at.
+    bool hasHeader(const KVDBData& value) const {
+        return value.len() == VALUE_META_SIZE + headLen;
+    }
+
+    unsigned int valueOffset(const KVDBData& value) const {
+        return hasHeader(value) ? VALUE_META_SIZE : 0;
+    }
+
+    unsigned int valueLength(const KVDBData& value) const {
+        if (!hasHeader(value))
+            return value.len();
+
         return mongo::endian::bigToNative(*(uint32_t*)value.data());
     }
-}
 
-static inline unsigned int _getNumChunks(const int len) {
-    return (len + VALUE_META_SIZE - 1) / HSE_KVS_VALUE_LEN_MAX;
-}
+    unsigned int numChunks(unsigned int len) const {
+        if (!isLarge(len) || len <= headLen)
+            return 0;
+
+        return (len - headLen + chunkLen - 1) / chunkLen;
+    }
+
+    unsigned int inlineMax{VALUE_META_THRESHOLD_LEN - 1};
+    unsigned int headLen{VALUE_META_THRESHOLD_LEN};
+    unsigned int chunkLen{HSE_KVS_VALUE_LEN_MAX};
+};
 
 hse::Status _cursorRead(mongo::KVDBRecoveryUnit* ru,
                         shared_ptr<mongo::KVDBOplogBlockManager> opBlkMgr,
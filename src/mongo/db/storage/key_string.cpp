@@ -37,8 +37,13 @@
 #include <cmath>
 #include <type_traits>
 
+#if defined(_M_AMD64) || defined(__amd64__)
+#include <emmintrin.h>
+#endif
+
 #include "mongo/base/data_view.h"
 #include "mongo/platform/bits.h"
+#include "mongo/platform/endian.h"
 #include "mongo/platform/strnlen.h"
 #include "mongo/util/hex.h"
 #include "mongo/util/log.h"
@@ -1749,25 +1754,82 @@ std::string KeyString::toString() const {
 }
 
 int KeyString::compare(const KeyString& other) const {
-    int a = getSize();
-    int b = other.getSize();
-
-    int min = std::min(a, b);
+    return compare(other.getBuffer(), other.getSize());
+}
 
-    int cmp = memcmp(getBuffer(), other.getBuffer(), min);
+int KeyString::compare(const char* buffer, size_t size) const {
+    const size_t a = getSize();
+    const size_t min = std::min(a, size);
 
-    if (cmp) {
-        if (cmp < 0)
-            return -1;
-        return 1;
+    const size_t common = commonPrefixLength(getBuffer(), buffer, min);
+    if (common < min) {
+        // Bytes compare unsigned, as memcmp does.
+        const unsigned char lhs = getBuffer()[common];
+        const unsigned char rhs = buffer[common];
+        return lhs < rhs ? -1 : 1;
     }
 
     // keys match
 
-    if (a == b)
+    if (a == size)
         return 0;
 
-    return a < b ? -1 : 1;
+    return a < size ? -1 : 1;
+}
+
+size_t KeyString::commonPrefixLength(const char* lhs, const char* rhs, size_t size) {
+    // Keys of a range share most of their leading bytes, so compare 16 bytes at a time where
+    // SSE2 is always available, else 8, rather than leave short keys to a memcmp call. The last
+    // block overlaps the one before it instead of falling back to single bytes.
+#if defined(_M_AMD64) || defined(__amd64__)
+    if (size >= sizeof(__m128i)) {
+        auto differ = [&](size_t i) -> uint32_t {
+            const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+            return ~_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) & 0xffff;
+        };
+
+        size_t i = 0;
+        for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+            if (uint32_t bits = differ(i))
+                return i + countTrailingZeros64(bits);
+        }
+        if (i < size) {
+            i = size - sizeof(__m128i);
+            if (uint32_t bits = differ(i))
+                return i + countTrailingZeros64(bits);
+        }
+        return size;
+    }
+#endif
+
+    if (size >= sizeof(uint64_t)) {
+        // Big endian words order their bytes as memory does.
+        auto differ = [&](size_t i) -> uint64_t {
+            uint64_t l, r;
+            memcpy(&l, lhs + i, sizeof(l));
+            memcpy(&r, rhs + i, sizeof(r));
+            return endian::nativeToBig(l ^ r);
+        };
+
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            if (uint64_t bits = differ(i))
+                return i + countLeadingZeros64(bits) / 8;
+        }
+        if (i < size) {
+            i = size - sizeof(uint64_t);
+            if (uint64_t bits = differ(i))
+                return i + countLeadingZeros64(bits) / 8;
+        }
+        return size;
+    }
+
+    size_t i = 0;
+    while (i < size && lhs[i] == rhs[i])
+        i++;
+
+    return i;
 }
 
 void KeyString::TypeBits::resetFromBuffer(BufReader* reader) {
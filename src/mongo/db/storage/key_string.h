@@ -340,6 +340,17 @@ public:
 
     int compare(const KeyString& other) const;
 
+    /**
+     * Compares this key with the KeyString bytes [buffer, buffer + size), as compare() would,
+     * without copying them into a KeyString first.
+     */
+    int compare(const char* buffer, size_t size) const;
+
+    /**
+     * Returns how many leading bytes lhs and rhs have in common, up to size.
+     */
+    static size_t commonPrefixLength(const char* lhs, const char* rhs, size_t size);
+
     /**
      * @return a hex encoding of this key
      */
@@ -50,6 +50,7 @@
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/hex.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/timer.h"
 
 using std::string;
@@ -1293,3 +1294,69 @@ TEST_F(KeyStringTest, DecimalFromUniformDoublePerf) {
     }
     perfTest(version, numbers);
 }
+
+TEST_F(KeyStringTest, CompareBuffers) {
+    // Lengths on either side of the 8 and 16 byte blocks, differing at every position.
+    for (size_t len = 0; len < 40; len++) {
+        std::string base(len, 'k');
+        for (size_t i = 0; i < len; i++)
+            base[i] = static_cast<char>(i * 37);
+
+        ASSERT_EQ(len, KeyString::commonPrefixLength(base.data(), base.data(), len));
+
+        for (size_t pos = 0; pos < len; pos++) {
+            std::string other = base;
+            other[pos] = static_cast<char>(other[pos] + 0x80);
+
+            ASSERT_EQ(pos, KeyString::commonPrefixLength(base.data(), other.data(), len));
+
+            KeyString ks(version);
+            ks.resetFromBuffer(base.data(), len);
+            const int expected = memcmp(base.data(), other.data(), len) < 0 ? -1 : 1;
+            ASSERT_EQ(expected, ks.compare(other.data(), len));
+        }
+
+        // A prefix sorts first.
+        KeyString ks(version);
+        ks.resetFromBuffer(base.data(), len);
+        ASSERT_EQ(0, ks.compare(base.data(), len));
+        if (len > 0) {
+            ASSERT_EQ(1, ks.compare(base.data(), len - 1));
+        }
+    }
+}
+
+TEST_F(KeyStringTest, ComparePerf) {
+    // Compound keys of one range, compared in place against the end position as an index
+    // cursor reads them.
+    std::vector<std::string> keys;
+    for (int i = 0; i < 10000; i++) {
+        str::stream name;
+        name << "tenant-000042/orders/" << 1000000 + i;
+        KeyString ks(
+            version, BSON("" << std::string(name) << "" << i), ALL_ASCENDING, RecordId(i + 1));
+        keys.emplace_back(ks.getBuffer(), ks.getSize());
+    }
+    KeyString end(version, BSON("" << "tenant-000042/orders/2" << "" << 0), ALL_ASCENDING);
+
+    uint64_t micros = 0;
+    uint64_t passes = 0;
+    uint64_t below = 0;
+    for (uint64_t iters = 16; iters < (1 << 30) && micros < kMinPerfMicros; iters *= 2) {
+        Timer t;
+
+        // Every key is below the end, in each of the passes of the last round.
+        passes = iters;
+        below = 0;
+        for (uint64_t i = 0; i < iters; i++)
+            for (const auto& key : keys)
+                below += end.compare(key.data(), key.size()) > 0;
+
+        micros = t.micros();
+    }
+    ASSERT_EQ(passes * keys.size(), below);
+
+    log() << 1E3 * micros / static_cast<double>(passes * keys.size()) << " ns per "
+          << mongo::KeyString::versionToString(version) << " compare of "
+          << keys.front().size() << " byte keys" << (kDebugBuild ? " (DEBUG BUILD!)" : "");
+}
@@ -450,6 +450,44 @@ public:
     }
 };
 
+// Covered range scans over a secondary index, reading only index keys. Each timed() is
+// one scan of kScanKeys keys, so rps * kScanKeys is the index keys/sec.
+class IndexRangeScan : public B {
+public:
+    enum { kDocs = 100000, kScanKeys = 1000 };
+
+    string name() {
+        return "index-range-scan-1000-keys";
+    }
+    virtual int howLongMillis() {
+        return 3000;
+    }
+    virtual bool showDurStats() {
+        return false;
+    }
+    virtual unsigned batchSize() {
+        return 1;
+    }
+    void prep() {
+        client()->createIndex(ns(), BSON("x" << 1));
+        for (int i = 0; i < kDocs; i++) {
+            insert(ns(), BSON("_id" << i << "x" << i));
+        }
+        client()->getLastError();
+    }
+    void timed() {
+        const BSONObj fields = BSON("_id" << 0 << "x" << 1);
+        Query q = QUERY("x" << GTE << _start << LT << _start + kScanKeys).hint(BSON("x" << 1));
+
+        std::unique_ptr<DBClientCursor> cursor = client()->query(ns(), q, 0, 0, &fields);
+        ASSERT_EQUALS(int(kScanKeys), cursor->itcount());
+
+        _start = (_start + kScanKeys) % (kDocs - kScanKeys);
+    }
+
+private:
+    int _start = 0;
+};
 
 class All : public Suite {
 public:
@@ -463,6 +501,7 @@ public:
         add<boosttimed_mutexspeed>();
         add<stdmutexspeed>();
         add<stdtimed_mutexspeed>();
+        add<IndexRangeScan>();
     }
 } myall;
 }